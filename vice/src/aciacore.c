@@ -160,13 +160,17 @@ typedef struct acia_struct {
     /*! \brief The handshake lines as currently seen by the ACIA */
     enum rs232handshake_out rs232_status_lines;
 
+    /*! \brief the receiver is enabled, but the RX alarm is not set
+      until rs232drv reports data through acia_rx_notify() */
+    int rx_waiting;
+
 } acia_type;
 
 /******************************************************************/
 
 static acia_type acia = { NULL, NULL, 0, 0, 0, (enum acia_tx_state)0,
                           0, 0, 0, 0, 0, 0, 0, 0xff, 0, 0, 0, 0, 0, 0, 0,
-                          (enum cpu_int)0, 0, 0, (enum rs232handshake_out)0 };
+                          (enum cpu_int)0, 0, 0, (enum rs232handshake_out)0, 0 };
 
 static void acia_preinit(void)
 {
@@ -182,6 +186,7 @@ static void acia_preinit(void)
 
 static void int_acia_tx(CLOCK offset, void *data);
 static void int_acia_rx(CLOCK offset, void *data);
+static void acia_rx_notify(void *data);
 
 /******************************************************************/
 
@@ -424,6 +429,7 @@ static void set_acia_ticks(void)
         acia.alarm_clk_rx = myclk + acia.ticks;
         alarm_set(acia.alarm_rx, acia.alarm_clk_rx);
         acia.alarm_active_rx = 1;
+        acia.rx_waiting = 0;
     }
 
     /*
@@ -708,6 +714,7 @@ void myacia_reset(void)
     }
     acia.alarm_active_tx = 0;
     acia.alarm_active_rx = 0;
+    acia.rx_waiting = 0;
 
     acia_set_int(acia.irq_type, acia.int_num, IK_NONE);
     acia.irq = 0;
@@ -784,7 +791,8 @@ int myacia_snapshot_write_module(snapshot_t *p)
     }
 
     if (acia.alarm_active_rx) {
-        aar = acia.alarm_clk_rx - myclk;
+        /* a waiting receiver looks again one character later */
+        aar = acia.rx_waiting ? (CLOCK)acia.ticks : acia.alarm_clk_rx - myclk;
     } else {
         aar = 0;
     }
@@ -838,6 +846,7 @@ int myacia_snapshot_read_module(snapshot_t *p)
     alarm_unset(acia.alarm_rx);   /* just in case we don't find module */
     acia.alarm_active_tx = 0;
     acia.alarm_active_rx = 0;
+    acia.rx_waiting = 0;
 
     mycpu_set_int_noclk(acia.int_num, 0);
 
@@ -1224,6 +1233,8 @@ static void int_acia_tx(CLOCK offset, void *data)
 */
 static void int_acia_rx(CLOCK offset, void *data)
 {
+    int received = 0;
+
     DEBUG_VERBOSE_LOG_MESSAGE((acia.log, "int_acia_rx(offset=%ld, myclk=%d", offset, myclk));
 
     assert(data == NULL);
@@ -1235,9 +1246,10 @@ static void int_acia_rx(CLOCK offset, void *data)
             break;
         }
 
-        if (!rs232drv_getc(acia.fd, &received_byte)) {
+        if (rs232drv_getc(acia.fd, &received_byte) <= 0) {
             break;
         }
+        received = 1;
 
         DEBUG_LOG_MESSAGE((acia.log, "received byte: %u = '%c'.",
                            (unsigned) received_byte, received_byte));
@@ -1263,14 +1275,38 @@ static void int_acia_rx(CLOCK offset, void *data)
     } while (0);
 
     if (acia.alarm_active_rx == 1) {
-        acia.alarm_clk_rx = myclk + acia.ticks;
-        alarm_set(acia.alarm_rx, acia.alarm_clk_rx);
-        /*acia.alarm_active_rx = 1;*/
+        if (!received && rs232drv_notify_rx(acia.fd, acia_rx_notify, NULL)) {
+            /* the line is idle, sleep until the driver has something */
+            alarm_unset(acia.alarm_rx);
+            acia.rx_waiting = 1;
+        } else {
+            acia.alarm_clk_rx = myclk + acia.ticks;
+            alarm_set(acia.alarm_rx, acia.alarm_clk_rx);
+            /*acia.alarm_active_rx = 1;*/
+        }
     } else {
         alarm_unset(acia.alarm_rx);
     }
 }
 
+/*! \internal \brief Wake up the receiver
+
+ Called by rs232drv when data is waiting for a receiver that went to sleep
+ in int_acia_rx(). The byte is complete one character time later, as if it
+ had just started to come in.
+
+ \param data
+   Unused
+*/
+static void acia_rx_notify(void *data)
+{
+    if (acia.rx_waiting && acia.alarm_active_rx) {
+        acia.alarm_clk_rx = myclk + acia.ticks;
+        alarm_set(acia.alarm_rx, acia.alarm_clk_rx);
+    }
+    acia.rx_waiting = 0;
+}
+
 int acia_dump(void)
 {
     uint8_t st;
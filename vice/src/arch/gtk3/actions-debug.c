@@ -50,6 +50,7 @@
 
 #include "hotkeys.h"
 #include "machine.h"
+#include "mainchannel.h"
 #include "resources.h"
 #include "uiactions.h"
 #include "uidebug.h"
@@ -93,7 +94,7 @@ static void debug_resource_toggle_action(ui_action_map_t *self)
 
     resources_get_int(resource, &enabled);
     enabled = !enabled;
-    resources_set_int(resource, enabled);
+    mainchannel_post_resource_int(resource, enabled);
     vhk_gtk_set_check_item_blocked_by_action(self->action, (gboolean)enabled);
 }
 
@@ -41,6 +41,7 @@
 #include <stdbool.h>
 
 #include "hotkeys.h"
+#include "mainchannel.h"
 #include "resources.h"
 #include "ui.h"
 #include "uiactions.h"
@@ -115,7 +116,7 @@ static void keyset_joystick_toggle_action(ui_action_map_t *self)
     int enabled = 0;
 
     resources_get_int("KeySetEnable", &enabled);
-    resources_set_int("KeySetEnable", !enabled);
+    mainchannel_post_resource_int("KeySetEnable", !enabled);
     vhk_gtk_set_check_item_blocked_by_action(self->action, !enabled);
 }
 
@@ -34,6 +34,7 @@
 #include "archdep.h"
 #include "basedialogs.h"
 #include "machine.h"
+#include "mainchannel.h"
 #include "mainlock.h"
 #include "monitor.h"
 #include "resources.h"
@@ -133,7 +134,7 @@ static void diagnostic_pin_toggle_action(ui_action_map_t *self)
     int active = 0;
 
     resources_get_int("DiagPin", &active);
-    resources_set_int("DiagPin", !active);
+    mainchannel_post_resource_int("DiagPin", !active);
 }
 
 /** \brief  Toggle SuperCPU JiffyDOS switch
@@ -179,12 +180,14 @@ static const ui_action_map_t machine_actions[] = {
         .uithread = true
     },
     {   .action  = ACTION_MACHINE_RESET_CPU,
-        .handler = machine_reset_action,
-        .data    = vice_int_to_ptr(MACHINE_RESET_MODE_RESET_CPU)
+        .handler   = machine_reset_action,
+        .data      = vice_int_to_ptr(MACHINE_RESET_MODE_RESET_CPU),
+        .emuthread = true
     },
     {   .action  = ACTION_MACHINE_POWER_CYCLE,
-        .handler = machine_reset_action,
-        .data    = vice_int_to_ptr(MACHINE_RESET_MODE_POWER_CYCLE)
+        .handler   = machine_reset_action,
+        .data      = vice_int_to_ptr(MACHINE_RESET_MODE_POWER_CYCLE),
+        .emuthread = true
     },
     {   .action  = ACTION_DIAGNOSTIC_PIN_TOGGLE,
         .handler = diagnostic_pin_toggle_action,
@@ -41,10 +41,11 @@
 #include "hotkeys.h"
 #include "lib.h"
 #include "log.h"
+#include "types.h"
 #include "ui.h"
 #include "kbddebugwidget.h"
 #include "keyboard.h"
-#include "mainlock.h"
+#include "mainchannel.h"
 #include "uiactions.h"
 #include "uimenu.h"
 #include "uimedia.h"
@@ -237,28 +238,49 @@ static void kbd_fix_shift_clear(void)
     capslock_state = 0;
 }
 
+/** \brief  Release all keys in the keyboard emulation (VICE thread)
+ *
+ * \param[in]   param   unused
+ */
+static void do_key_clear(void *param)
+{
+    keyboard_key_clear();
+}
+
+/** \brief  Set shift lock of the keyboard emulation (VICE thread)
+ *
+ * \param[in]   param   new shift lock state
+ */
+static void do_sync_shiftlock(void *param)
+{
+    int lock = vice_ptr_to_int(param);
+
+    if (keyboard_get_shiftlock() != lock) {
+        keyboard_set_shiftlock(lock);
+    }
+}
+
+/** \brief  Release all keys in the keyboard emulation
+ */
+static void kbd_key_clear(void)
+{
+    mainchannel_post(do_key_clear, NULL);
+}
+
 /** \brief  sync caps lock status with the keyboard emulation
  */
 static void kbd_sync_caps_lock(void)
 {
-#ifdef MACOS_COMPILE
-    if (keyboard_get_shiftlock() != capslock_lock_state) {
-        keyboard_set_shiftlock(capslock_lock_state);
-    }
-#else
+#ifndef MACOS_COMPILE
     GdkDisplay *display = gdk_display_get_default();
     GdkKeymap *keymap = gdk_keymap_get_for_display(display);
-    int capslock = gdk_keymap_get_caps_lock_state(keymap);
 
-    if (keyboard_get_shiftlock() != capslock) {
-        keyboard_set_shiftlock(capslock);
-        capslock_lock_state = capslock;
-    }
+    capslock_lock_state = gdk_keymap_get_caps_lock_state(keymap);
 #endif
 #if 0
-    printf("kbd_sync_caps_lock host caps-lock: %d kbd shift-lock: %d gtk lock state: %d\n",
-        capslock, keyboard_get_shiftlock(), capslock_lock_state);
+    printf("kbd_sync_caps_lock gtk lock state: %d\n", capslock_lock_state);
 #endif
+    mainchannel_post(do_sync_shiftlock, vice_int_to_ptr(capslock_lock_state));
 }
 
 /** \brief  Get modifiers keys for keyboard event
@@ -636,7 +658,7 @@ static gboolean kbd_event_handler(GtkWidget *w, GdkEvent *report, gpointer gp)
                 key = report->key.keyval = GDK_KEY_ISO_Level3_Shift;
                 report->key.state &= ~GDK_MOD2_MASK;
                 /* release control in the emulated keymap */
-                keyboard_key_released(GDK_KEY_Control_L, KBD_MOD_LCTRL);
+                mainchannel_post_key(GDK_KEY_Control_L, KBD_MOD_LCTRL, false);
             } else if (report->key.state & GDK_MOD2_MASK) {
                 report->key.state &= ~GDK_MOD2_MASK;
                 report->key.state |= GDK_MOD5_MASK;
@@ -656,24 +678,21 @@ static gboolean kbd_event_handler(GtkWidget *w, GdkEvent *report, gpointer gp)
              */
             ui_statusbar_update_kbd_debug(report);
 
-            /* Don't hold the mainlock while dealing with hotkeys. Some of these
-               need to run with an unlocked handler in order to avoid glitching VICE. */
-            mainlock_release();
+            /* This handler runs without the mainlock, hotkeys that need it
+               take it themselves. */
             if (gtk_window_activate_key(GTK_WINDOW(w), (GdkEventKey *)report)) {
-                mainlock_obtain();
                 /* mnemonic or accelerator was found and activated. */
                 /* release all previously pressed keys to prevent stuck keys,
                    except we detected a "reset" hotkey (because certain cartridges
                    or kernals want you to hold a key on reset for certain features) */
                 if (!isresethotkey(report)) {
                     keyspressed = 0;
-                    keyboard_key_clear();
+                    kbd_key_clear();
                     kbd_fix_shift_clear();
                 }
                 kbd_sync_caps_lock();
                 return TRUE;
             }
-            mainlock_obtain();
 
             /* only press keys that were not yet pressed */
             if (addpressedkey(report, &key, &mod)) {
@@ -683,7 +702,7 @@ static gboolean kbd_event_handler(GtkWidget *w, GdkEvent *report, gpointer gp)
                     report->key.keyval, report->key.state, report->key.hardware_keycode,
                     shiftl_state, shiftr_state, capslock_state, mod);
 #endif
-                keyboard_key_pressed((signed long)key, mod);
+                mainchannel_post_key((signed long)key, mod, true);
             }
 /* HACK: on windows the caps-lock key generates an invalid keycode of 0xffffff,
          so when we see this in the event we explicitly sync caps-lock state
@@ -726,12 +745,12 @@ static gboolean kbd_event_handler(GtkWidget *w, GdkEvent *report, gpointer gp)
                     keyspressed, report->key.keyval, report->key.state, report->key.hardware_keycode,
                     shiftl_state, shiftr_state, capslock_state, mod);
 #endif
-                keyboard_key_released(key, mod);
+                mainchannel_post_key(key, mod, false);
             } else {
                 /* we released a key that was not pressed, something is wrong */
                 keyspressed = 0;
                 kbd_fix_shift_clear();
-                keyboard_key_clear();
+                kbd_key_clear();
                 kbd_sync_caps_lock();
             }
 /* HACK: on windows the caps-lock key generates an invalid keycode of 0xffffff,
@@ -752,20 +771,20 @@ static gboolean kbd_event_handler(GtkWidget *w, GdkEvent *report, gpointer gp)
         case GDK_LEAVE_NOTIFY:
             keyspressed = 0;
             kbd_fix_shift_clear();
-            keyboard_key_clear();
+            kbd_key_clear();
             kbd_sync_caps_lock();
             break;
         case GDK_ENTER_NOTIFY:
             keyspressed = 0;
             kbd_fix_shift_clear();
-            keyboard_key_clear();
+            kbd_key_clear();
             kbd_sync_caps_lock();
             break;
         /* focus change */
         case GDK_FOCUS_CHANGE:
             keyspressed = 0;
             kbd_fix_shift_clear();
-            keyboard_key_clear();
+            kbd_key_clear();
             kbd_sync_caps_lock();
             break;
         default:
@@ -782,27 +801,27 @@ static gboolean kbd_event_handler(GtkWidget *w, GdkEvent *report, gpointer gp)
  */
 void kbd_connect_handlers(GtkWidget *widget, void *data)
 {
-    g_signal_connect(
+    g_signal_connect_unlocked(
             G_OBJECT(widget),
             "key-press-event",
             G_CALLBACK(kbd_event_handler), data);
-    g_signal_connect(
+    g_signal_connect_unlocked(
             G_OBJECT(widget),
             "key-release-event",
             G_CALLBACK(kbd_event_handler), data);
-    g_signal_connect(
+    g_signal_connect_unlocked(
             G_OBJECT(widget),
             "enter-notify-event",
             G_CALLBACK(kbd_event_handler), data);
-    g_signal_connect(
+    g_signal_connect_unlocked(
             G_OBJECT(widget),
             "leave-notify-event",
             G_CALLBACK(kbd_event_handler), data);
-    g_signal_connect(
+    g_signal_connect_unlocked(
             G_OBJECT(widget),
             "focus-in-event",
             G_CALLBACK(kbd_event_handler), data);
-    g_signal_connect(
+    g_signal_connect_unlocked(
             G_OBJECT(widget),
             "focus-out-event",
             G_CALLBACK(kbd_event_handler), data);
@@ -71,7 +71,6 @@
 #endif
 
 #include "archdep.h"
-#include "attach.h"
 #include "autostart.h"
 #include "basedialogs.h"
 #include "cmdline.h"
@@ -91,6 +90,7 @@
 #include "lightpen.h"
 #include "log.h"
 #include "machine.h"
+#include "mainchannel.h"
 #include "mainlock.h"
 #include "mixerwidget.h"
 #include "monitor.h"
@@ -957,7 +957,7 @@ static void on_drag_data_received(GtkWidget        *widget,
 
         switch (drop_mode) {
             case AUTOSTART_DROP_MODE_ATTACH:
-                file_system_attach_disk(8, 0, filename);
+                mainchannel_post_attach_disk(8, 0, filename);
                 break;
             case AUTOSTART_DROP_MODE_LOAD:
                 autostart_autodetect(filename, NULL, 0, AUTOSTART_MODE_LOAD);
@@ -1174,9 +1174,21 @@ static gboolean ui_action_dispatch_impl(gpointer data)
     return G_SOURCE_REMOVE;
 }
 
+/** \brief  Run UI action handler on the VICE thread
+ *
+ * \param[in]   data    UI action map
+ */
+static void ui_action_dispatch_emu(void *data)
+{
+    ui_action_map_t *map = data;
+
+    map->handler(map);
+}
+
 /** \brief  Dispatcher for UI actions
  *
- * Executes UI action handler on the the UI thread if requested.
+ * Executes UI action handler on the the UI thread or the VICE thread if
+ * requested.
  *
  * \param[in]   map UI action map
  */
@@ -1185,6 +1197,9 @@ static void ui_action_dispatch(ui_action_map_t *map)
     if ((map->uithread || map->dialog) && mainlock_is_vice_thread()) {
         /* we're on the main thread and we need the UI thread: push to UI thread */
         gdk_threads_add_timeout(0, ui_action_dispatch_impl, (void*)map);
+    } else if (map->emuthread && !mainlock_is_vice_thread()) {
+        /* let the VICE thread pick it up at its next safe point */
+        mainchannel_post(ui_action_dispatch_emu, map);
     } else {
         map->handler(map);
     }
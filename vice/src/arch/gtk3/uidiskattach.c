@@ -39,7 +39,6 @@
 
 #include <gtk/gtk.h>
 
-#include "attach.h"
 #include "autostart.h"
 #include "basedialogs.h"
 #include "contentpreviewwidget.h"
@@ -52,6 +51,7 @@
 #include "imagecontents.h"
 #include "lastdir.h"
 #include "log.h"
+#include "mainchannel.h"
 #include "mainlock.h"
 #include "resources.h"
 #include "ui.h"
@@ -242,7 +242,6 @@ static void do_attach(GtkWidget *widget, gpointer user_data)
 {
     gchar *filename;
     gchar *filename_locale;
-    gchar buffer[1024];
 
     lastdir_update(widget, &last_dir, &last_file);
 
@@ -250,19 +249,12 @@ static void do_attach(GtkWidget *widget, gpointer user_data)
     /* convert filename to current locale */
     filename_locale = file_chooser_convert_to_locale(filename);
 
-    /* copied from Gtk2: I fail to see how brute-forcing your way
-        * through file types is 'smart', but hell, it works */
-    if (file_system_attach_disk(unit_number, drive_number, filename_locale) < 0) {
-        /* failed */
-        g_snprintf(buffer, sizeof buffer,
-                   "Unit #%d: failed to attach '%s'",
-                   unit_number, filename);
-    } else {
-        g_snprintf(buffer, sizeof buffer,
-                   "Unit #%d: attached '%s'",
-                   unit_number, filename);
-    }
-    ui_display_statustext(buffer, true);
+    /* attached on the VICE thread, which also reports the result in the
+     * status bar */
+    mainchannel_post_attach_disk((unsigned int)unit_number,
+                                 (unsigned int)drive_number,
+                                 filename_locale);
+    g_free(filename);
     g_free(filename_locale);
 }
 
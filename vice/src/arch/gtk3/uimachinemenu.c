@@ -242,31 +242,37 @@ static const ui_menu_item_t datasette_2_control_submenu[] = {
 /** \brief  File->Reset submenu
  */
 static const ui_menu_item_t reset_submenu[] = {
-    {   .label  = "Reset machine CPU",
-        .type   = UI_MENU_TYPE_ITEM_ACTION,
-        .action = ACTION_MACHINE_RESET_CPU
+    {   .label    = "Reset machine CPU",
+        .type     = UI_MENU_TYPE_ITEM_ACTION,
+        .action   = ACTION_MACHINE_RESET_CPU,
+        .unlocked = true
     },
-    {   .label  = "Power cycle machine",
-        .type   = UI_MENU_TYPE_ITEM_ACTION,
-        .action = ACTION_MACHINE_POWER_CYCLE
+    {   .label    = "Power cycle machine",
+        .type     = UI_MENU_TYPE_ITEM_ACTION,
+        .action   = ACTION_MACHINE_POWER_CYCLE,
+        .unlocked = true
     },
     UI_MENU_SEPARATOR,
 
-    {   .label  = "Reset drive #8",
-        .type   = UI_MENU_TYPE_ITEM_ACTION,
-        .action = ACTION_RESET_DRIVE_8
+    {   .label    = "Reset drive #8",
+        .type     = UI_MENU_TYPE_ITEM_ACTION,
+        .action   = ACTION_RESET_DRIVE_8,
+        .unlocked = true
     },
-    {   .label  = "Reset drive #9",
-        .type   = UI_MENU_TYPE_ITEM_ACTION,
-        .action = ACTION_RESET_DRIVE_9
+    {   .label    = "Reset drive #9",
+        .type     = UI_MENU_TYPE_ITEM_ACTION,
+        .action   = ACTION_RESET_DRIVE_9,
+        .unlocked = true
     },
-    {   .label  = "Reset drive #10",
-        .type   = UI_MENU_TYPE_ITEM_ACTION,
-        .action = ACTION_RESET_DRIVE_10
+    {   .label    = "Reset drive #10",
+        .type     = UI_MENU_TYPE_ITEM_ACTION,
+        .action   = ACTION_RESET_DRIVE_10,
+        .unlocked = true
     },
-    {   .label  = "Reset drive #11",
-        .type   = UI_MENU_TYPE_ITEM_ACTION,
-        .action = ACTION_RESET_DRIVE_11
+    {   .label    = "Reset drive #11",
+        .type     = UI_MENU_TYPE_ITEM_ACTION,
+        .action   = ACTION_RESET_DRIVE_11,
+        .unlocked = true
     },
     UI_MENU_TERMINATOR
 };
@@ -59,6 +59,7 @@
 
 #include "vice.h"
 #include <stdio.h>
+#include <string.h>
 #include <gtk/gtk.h>
 
 #include "archdep_defs.h"
@@ -85,6 +86,7 @@
 #include "lib.h"
 #include "log.h"
 #include "machine.h"
+#include "mainchannel.h"
 #include "mainlock.h"
 #include "resources.h"
 #include "statusbarledwidget.h"
@@ -314,25 +316,6 @@ typedef struct ui_sb_state_s {
     /** \brief Color descriptors for the drive LED colors, 0=red, 1=green */
     int drive_led_types[NUM_DISK_UNITS][2][DRIVE_LEDS_MAX];
 
-    /** \brief Current intensity of each drive LED, 0=off,
-     *         1000=max. */
-    unsigned int current_drive_leds[NUM_DISK_UNITS][2][DRIVE_LEDS_MAX];
-
-    /** \brief true if a drive led has been changed */
-    bool current_drive_leds_updated[NUM_DISK_UNITS][2][DRIVE_LEDS_MAX];
-
-    /** \brief unit:drive label for each unit and its drives */
-    char current_drive_unit_str[NUM_DISK_UNITS][2][DRIVE_UNIT_STR_MAX_LEN];
-
-    /** \brief true if a drive unit string has been changed */
-    bool current_drive_unit_str_updated[NUM_DISK_UNITS][2];
-
-    /** \brief device:track.halftrack label for each unit and its drives */
-    char current_drive_track_str[NUM_DISK_UNITS][2][DRIVE_TRACK_STR_MAX_LEN];
-
-    /** \brief true if a drive track string has been changed */
-    bool current_drive_track_str_updated[NUM_DISK_UNITS][2];
-
     /** \brief Current state for each of the joyports.
      *
      *  This is an 7-bit bitmask, representing, from least to most
@@ -384,6 +367,14 @@ static pthread_mutex_t sb_state_lock = PTHREAD_MUTEX_INITIALIZER;
 static ui_sb_state_t sb_state_do_not_use_directly;
 
 
+/** \brief Current intensity of each drive LED, 0=off, 1000=max.
+ *
+ * Copied from the main channel state by ui_update_statusbars(), only used
+ * on the UI thread.
+ */
+static unsigned int drive_leds[NUM_DISK_UNITS][2][DRIVE_LEDS_MAX];
+
+
 /** \brief The full structure representing a status bar widget.
  *
  *  This includes the top-level widget and then every subwidget that
@@ -481,6 +472,12 @@ typedef struct ui_statusbar_s {
      */
     int displayed_tape_counter[TAPEPORT_MAX_PORTS];
 
+    /** \brief  Used to optimise drive track widget updates */
+    unsigned int displayed_drive_half_track[NUM_DISK_UNITS][2];
+
+    /** \brief  Used to optimise drive track widget updates */
+    unsigned int displayed_drive_side[NUM_DISK_UNITS][2];
+
     /** \brief The joyport status widget. */
     GtkWidget *joysticks;
 
@@ -757,9 +754,9 @@ static gboolean draw_drive_led_cb(GtkWidget *widget, cairo_t *cr, gpointer data)
     for (i = 0; i < DRIVE_LEDS_MAX; ++i) {
         int led_color = sb_state->drive_led_types[unit][drive][i];
         if (led_color) {
-            green += sb_state->current_drive_leds[unit][drive][i] / 1000.0;
+            green += drive_leds[unit][drive][i] / 1000.0;
         } else {
-            red += sb_state->current_drive_leds[unit][drive][i] / 1000.0;
+            red += drive_leds[unit][drive][i] / 1000.0;
         }
     }
     unlock_sb_state();
@@ -2464,6 +2461,8 @@ void ui_statusbar_init(void)
 
         allocated_bars[i].displayed_tape_counter[0] = -1;
         allocated_bars[i].displayed_tape_counter[1] = -1;
+        memset(allocated_bars[i].displayed_drive_half_track, 0xff,
+               sizeof allocated_bars[i].displayed_drive_half_track);
     }
 
     sb_state = lock_sb_state();
@@ -3111,7 +3110,8 @@ void ui_display_tape_current_image(int port, const char *image)
 
 /** \brief  Statusbar API function to report changes in drive LED intensity.
  *
- * This function simply updates global state, rendering occurs in ui_update_statusbars().
+ * This function is a NOP, ui_update_statusbars() reads the drive LEDs from the
+ * state published by the VICE thread through the main channel.
  *
  *  \param  drive_number    The unit to update (0-3 for drives 8-11)
  *  \param  drive_base      Drive 0 or 1 of dualdrives
@@ -3129,28 +3129,14 @@ void ui_display_drive_led(unsigned int drive_number,
                           unsigned int led_pwm1,
                           unsigned int led_pwm2)
 {
-    ui_sb_state_t *sb_state;
-
-    /* Ok to call from VICE thread */
-
-    if (drive_number > NUM_DISK_UNITS - 1) {
-        /* TODO: Fatal error? */
-        debug_gtk3("Error: illegal drive number %u.", drive_number);
-        abort();
-    }
-
-    sb_state = lock_sb_state();
-    sb_state->current_drive_leds[drive_number][drive_base][0] = led_pwm1;
-    sb_state->current_drive_leds[drive_number][drive_base][1] = led_pwm2;
-    sb_state->current_drive_leds_updated[drive_number][drive_base][0] = true;
-    sb_state->current_drive_leds_updated[drive_number][drive_base][1] = true;
-    unlock_sb_state();
+    /* NOP */
 }
 
 
 /** \brief  Statusbar API function to report changes in drive head location.
  *
- * This function simply updates global state, rendering occurs in ui_update_statusbars().
+ * This function is a NOP, ui_update_statusbars() reads the head positions
+ * from the state published by the VICE thread through the main channel.
  *
  *  \param  drive_number        The unit to update (0-3 for drives 8-11)
  *  \param  drive_base          Drive 0 or 1 of dualdrives
@@ -3167,57 +3153,7 @@ void ui_display_drive_track(unsigned int drive_number,
                             unsigned int half_track_number,
                             unsigned int drive_side)
 {
-    ui_sb_state_t *sb_state;
-    int doubleside, dualdrive;
-
-    /* Ok to call from VICE thread */
-
-    if (drive_number > NUM_DISK_UNITS - 1) {
-        /* TODO: Fatal error? */
-        return;
-    }
-
-    sb_state = lock_sb_state();
-    doubleside = drive_get_num_heads(sb_state->drives_type[drive_number]) == 2 ? 1 : 0;
-    dualdrive = drive_check_dual(sb_state->drives_type[drive_number]);
-
-    if (dualdrive) {
-        snprintf(
-            sb_state->current_drive_unit_str[drive_number][drive_base],
-            DRIVE_UNIT_STR_MAX_LEN - 1,
-            "%u:%u",
-            drive_number + 8,
-            drive_base);
-    } else {
-        snprintf(
-            sb_state->current_drive_unit_str[drive_number][drive_base],
-            DRIVE_UNIT_STR_MAX_LEN - 1,
-            "%u",
-            drive_number + 8);
-    }
-    sb_state->current_drive_unit_str[drive_number][drive_base][DRIVE_UNIT_STR_MAX_LEN - 1] = '\0';
-    sb_state->current_drive_unit_str_updated[drive_number][drive_base] = true;
-
-    if (doubleside) {
-        snprintf(
-            sb_state->current_drive_track_str[drive_number][drive_base],
-            DRIVE_TRACK_STR_MAX_LEN - 1,
-            " %u:%04.1lf",  /* space instead of 0 padding looks weird with the
-                               drive side in front */
-            drive_side,
-            half_track_number / 2.0);
-    } else {
-        snprintf(
-            sb_state->current_drive_track_str[drive_number][drive_base],
-            DRIVE_TRACK_STR_MAX_LEN - 1,
-            " %4.1lf",
-            half_track_number / 2.0);
-    }
-
-    sb_state->current_drive_track_str[drive_number][drive_base][DRIVE_TRACK_STR_MAX_LEN - 1] = '\0';
-    sb_state->current_drive_track_str_updated[drive_number][drive_base] = true;
-
-    unlock_sb_state();
+    /* NOP */
 }
 
 
@@ -3260,7 +3196,6 @@ void ui_enable_drive_status(ui_drive_enable_t state, int *drive_led_color)
             if (enabled & 1) {
                 for (i = 0; i < DRIVE_LEDS_MAX; i++) {
                     sb_state->drive_led_types[unit][drive][i] = (drive_led_color[unit] >> i) & 1;
-                    sb_state->current_drive_leds[unit][drive][i] = 0;
                 }
             }
         }
@@ -3422,6 +3357,54 @@ void ui_update_vsid_statusbar(void)
 }
 
 
+/** \brief  Update unit and track labels of a drive
+ *
+ * \param[in]       state_snapshot      status bar state
+ * \param[in,out]   number              unit number label (can be NULL)
+ * \param[in,out]   head                track label (can be NULL)
+ * \param[in]       drive_number        unit (0-3 for drives 8-11)
+ * \param[in]       drive_base          drive 0 or 1 of dualdrives
+ * \param[in]       half_track_number   twice the head location
+ * \param[in]       drive_side          drive side for dual-head drives
+ */
+static void update_drive_track_widgets(const ui_sb_state_t *state_snapshot,
+                                       GtkWidget *number,
+                                       GtkWidget *head,
+                                       unsigned int drive_number,
+                                       unsigned int drive_base,
+                                       unsigned int half_track_number,
+                                       unsigned int drive_side)
+{
+    char unit_str[DRIVE_UNIT_STR_MAX_LEN];
+    char track_str[DRIVE_TRACK_STR_MAX_LEN];
+    int drive_type = state_snapshot->drives_type[drive_number];
+
+    if (number != NULL) {
+        if (drive_check_dual(drive_type)) {
+            g_snprintf(unit_str, sizeof unit_str, "%u:%u",
+                       drive_number + 8, drive_base);
+        } else {
+            g_snprintf(unit_str, sizeof unit_str, "%u", drive_number + 8);
+        }
+        gtk_label_set_text(GTK_LABEL(number), unit_str);
+    }
+
+    if (head != NULL) {
+        if (drive_get_num_heads(drive_type) == 2) {
+            g_snprintf(track_str, sizeof track_str,
+                       " %u:%04.1lf",  /* space instead of 0 padding looks
+                                          weird with the drive side in front */
+                       drive_side,
+                       half_track_number / 2.0);
+        } else {
+            g_snprintf(track_str, sizeof track_str, " %4.1lf",
+                       half_track_number / 2.0);
+        }
+        gtk_label_set_text(GTK_LABEL(head), track_str);
+    }
+}
+
+
 /** \brief  Update status bars for non-VSID machines
  */
 void ui_update_statusbars(void)
@@ -3433,6 +3416,10 @@ void ui_update_statusbars(void)
     int j;
     ui_sb_state_t *sb_state;
     ui_sb_state_t state_snapshot;
+    const mainchannel_state_t *channel_state;
+    unsigned int drive_half_track[NUM_DISK_UNITS][2];
+    unsigned int drive_side[NUM_DISK_UNITS][2];
+    bool drive_leds_updated[NUM_DISK_UNITS][2];
     uint32_t active_joyports;
     bool active_joyports_changed = false;
     int unit;
@@ -3451,23 +3438,26 @@ void ui_update_statusbars(void)
     /* Reset any 'updated needed' flags */
     sb_state->drives_layout_needed = false;
 
-    for (j = 0; j < NUM_DISK_UNITS; ++j) {
-        sb_state->current_drive_track_str_updated[j][0] = false;
-        sb_state->current_drive_track_str_updated[j][1] = false;
-        sb_state->current_drive_unit_str_updated[j][0]  = false;
-        sb_state->current_drive_unit_str_updated[j][1]  = false;
-        for (int d = 0; d < 2; d++) {
-            sb_state->current_drive_leds_updated[j][d][0] = false;
-            sb_state->current_drive_leds_updated[j][d][1] = false;
-        }
-    }
-
     /* statusbar messages */
     statusbar_update_message(sb_state);
 
     /* we can release the lock now */
     unlock_sb_state();
 
+    /* Drive LEDs and head positions come from the VICE thread's snapshot,
+     * copy them since the speed widget gets a newer snapshot below */
+    channel_state = mainchannel_state_get();
+    memcpy(drive_half_track, channel_state->drive_half_track, sizeof drive_half_track);
+    memcpy(drive_side, channel_state->drive_side, sizeof drive_side);
+    for (j = 0; j < NUM_DISK_UNITS; ++j) {
+        for (int d = 0; d < 2; d++) {
+            drive_leds_updated[j][d] = memcmp(drive_leds[j][d],
+                                              channel_state->drive_led_pwm[j][d],
+                                              sizeof drive_leds[j][d]) != 0;
+        }
+    }
+    memcpy(drive_leds, channel_state->drive_led_pwm, sizeof drive_leds);
+
     for (i = 0; i < MAX_STATUS_BARS; ++i) {
         bar = &allocated_bars[i];
         if (bar->bar == NULL) {
@@ -3532,23 +3522,20 @@ void ui_update_statusbars(void)
                 GtkWidget *number = drive_get_number_widget(i, unit, drive);
                 GtkWidget *head = drive_get_head_widget(i, unit, drive);
                 GtkWidget *led = drive_get_led_widget(i, unit, drive);
-
-                if (state_snapshot.current_drive_track_str_updated[unit - DRIVE_UNIT_MIN][drive]) {
-                    if (head != NULL) {
-                        char *s = state_snapshot.current_drive_track_str[unit - DRIVE_UNIT_MIN][drive];
-                        gtk_label_set_text(GTK_LABEL(head), s);
-                    }
-                }
-
-                if (state_snapshot.current_drive_unit_str_updated[unit - DRIVE_UNIT_MIN][drive]) {
-                    if (number != NULL) {
-                        char *s = state_snapshot.current_drive_unit_str[unit - DRIVE_UNIT_MIN][drive];
-                        gtk_label_set_text(GTK_LABEL(number), s);
-                    }
+                int u = unit - DRIVE_UNIT_MIN;
+
+                if (state_snapshot.drives_layout_needed
+                        || bar->displayed_drive_half_track[u][drive] != drive_half_track[u][drive]
+                        || bar->displayed_drive_side[u][drive] != drive_side[u][drive]) {
+                    update_drive_track_widgets(&state_snapshot, number, head, u, drive,
+                                               drive_half_track[u][drive],
+                                               drive_side[u][drive]);
+                    bar->displayed_drive_half_track[u][drive] = drive_half_track[u][drive];
+                    bar->displayed_drive_side[u][drive] = drive_side[u][drive];
                 }
 
                 /* Only draw the LEDs if they have changed */
-                if (state_snapshot.current_drive_leds_updated[unit - DRIVE_UNIT_MIN][drive][0]) {
+                if (drive_leds_updated[u][drive]) {
                     if (led != NULL) {
                         gtk_widget_queue_draw(led);
                     }
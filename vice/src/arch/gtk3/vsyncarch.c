@@ -53,6 +53,11 @@ void vsyncarch_postsync(void)
     }
 }
 
+void vsyncarch_poll_input(void)
+{
+    /* key events come in from the UI thread, joysticks are polled by vsync */
+}
+
 void vsyncarch_advance_frame(void)
 {
     ui_pause_disable();
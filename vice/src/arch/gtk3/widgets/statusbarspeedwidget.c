@@ -43,6 +43,7 @@
 #include "keyboard.h"
 #include "lib.h"
 #include "machine.h"
+#include "mainchannel.h"
 #include "petpia.h"
 #include "resources.h"
 #include "statusbarledwidget.h"
@@ -480,6 +481,7 @@ void statusbar_speed_widget_update(GtkWidget *widget,
     double vsync_metric_cpu_percent;
     double vsync_metric_emulated_fps;
     int vsync_metric_warp_enabled;
+    const mainchannel_state_t *speed;
     tick_t now;
 
     /*
@@ -536,7 +538,11 @@ void statusbar_speed_widget_update(GtkWidget *widget,
         }
     }
 
-    vsyncarch_get_metrics(&vsync_metric_cpu_percent, &vsync_metric_emulated_fps, &vsync_metric_warp_enabled);
+    /* published by the VICE thread each frame, no need to lock anything */
+    speed = mainchannel_state_get();
+    vsync_metric_cpu_percent = speed->cpu_percent;
+    vsync_metric_emulated_fps = speed->emulated_fps;
+    vsync_metric_warp_enabled = speed->warp_enabled;
 
     /*
      * Updating GTK labels is expensive and this is called each frame,
@@ -77,6 +77,10 @@ void vsyncarch_postsync(void)
     }
 }
 
+void vsyncarch_poll_input(void)
+{
+}
+
 void vsyncarch_advance_frame(void)
 {
     ui_pause_disable();
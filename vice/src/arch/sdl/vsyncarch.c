@@ -125,6 +125,14 @@ void vsyncarch_postsync(void)
     }
 }
 
+void vsyncarch_poll_input(void)
+{
+    /* the virtual keyboard and the menus only look for input once a frame */
+    if (!(sdl_vkbd_state & SDL_VKBD_ACTIVE)) {
+        ui_dispatch_events();
+    }
+}
+
 void vsyncarch_advance_frame(void)
 {
     ui_pause_disable();
@@ -73,6 +73,7 @@
 #include "archdep_fix_permissions.h"
 #include "archdep_fix_streams.h"
 #include "archdep_fseeko.h"
+#include "archdep_fsync.h"
 #include "archdep_ftello.h"
 #include "archdep_get_current_drive.h"
 #include "archdep_get_runtime_info.h"
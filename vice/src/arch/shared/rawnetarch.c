@@ -62,6 +62,7 @@
 #ifdef HAVE_RAWNET
 
 #include "archdep_rawnet_capability.h"
+#include "rawnet.h"
 #include "rawnetarch.h"
 
 #ifdef WINDOWS_COMPILE
@@ -69,8 +70,10 @@
 #endif
 
 #ifdef UNIX_COMPILE
-/* On Unix, we implement an abstraction layer to support two rawnet drivers:
- * one based on libpcap, and one based on TUN/TAP.
+/* On Unix, we implement an abstraction layer to support several rawnet
+ * drivers: one based on libpcap, one based on TUN/TAP, and for testing one
+ * replaying a capture file and one connecting emulator instances through a
+ * local virtual switch.
  */
 
 /* Pointer to the rawnet driver in use. */
@@ -81,7 +84,7 @@ char *rawnet_arch_driver_name = NULL;
 
 /* Resources configuration ***************************************************/
 
-static int set_ethernet_driver(const char *name, void *param)
+static int set_ethernet_driver_locked(const char *name)
 {
     const rawnet_arch_driver_t *old_driver = rawnet_arch_driver;
     const char *ifname;
@@ -112,6 +115,12 @@ static int set_ethernet_driver(const char *name, void *param)
         rawnet_arch_driver = &rawnet_arch_driver_tuntap;
     }
 #endif
+    if (strcmp(name, rawnet_arch_driver_pcapfile.name) == 0) {
+        rawnet_arch_driver = &rawnet_arch_driver_pcapfile;
+    }
+    if (strcmp(name, rawnet_arch_driver_vswitch.name) == 0) {
+        rawnet_arch_driver = &rawnet_arch_driver_vswitch;
+    }
 
     if (rawnet_arch_driver != NULL) {
         util_string_set(&rawnet_arch_driver_name, rawnet_arch_driver->name);
@@ -140,6 +149,17 @@ static int set_ethernet_driver(const char *name, void *param)
     return -1; /* Unsupported driver */
 }
 
+/* the packet I/O thread must not use a driver while it is switched */
+static int set_ethernet_driver(const char *name, void *param)
+{
+    int result;
+
+    rawnet_lock();
+    result = set_ethernet_driver_locked(name);
+    rawnet_unlock();
+    return result;
+}
+
 static resource_string_t resources_string[] = {
     { "ETHERNET_DRIVER", NULL, RES_EVENT_NO, NULL,
       &rawnet_arch_driver_name, set_ethernet_driver, NULL },
@@ -190,7 +210,7 @@ static const cmdline_option_t cmdline_options[] =
 {
     { "-ethernetiodriver", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "ETHERNET_DRIVER", NULL,
-      "<Name>", "Set the low-level driver for Ethernet emulation (tuntap, pcap)." },
+      "<Name>", "Set the low-level driver for Ethernet emulation (tuntap, pcap, pcapfile, vswitch)." },
     CMDLINE_LIST_END
 };
 
@@ -344,7 +364,9 @@ void rawnet_arch_transmit(int force, int onecoll, int inhibit_crc, int tx_pad_di
 #ifdef RAWNET_DEBUG_PKTDUMP
     rawnet_arch_debug_output("Transmit frame: ", txframe, txlength);
 #endif /* #ifdef RAWNET_DEBUG_PKTDUMP */
-    rawnet_arch_driver->transmit(force, onecoll, inhibit_crc, tx_pad_dis, txlength, txframe);
+    if (rawnet_arch_driver != NULL) {
+        rawnet_arch_driver->transmit(force, onecoll, inhibit_crc, tx_pad_dis, txlength, txframe);
+    }
 }
 
 int rawnet_arch_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_index, int *prx_ok, int *pcorrect_mac, int *pbroadcast, int *pcrc_error)
@@ -354,9 +376,19 @@ int rawnet_arch_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_in
             "rawnet_arch_receive() called, with *plen=%u (driver: %s).",
             *plen, rawnet_arch_driver->name);
 #endif
+    if (rawnet_arch_driver == NULL) {
+        return 0;
+    }
     return rawnet_arch_driver->receive(pbuffer, plen, phashed, phash_index, prx_ok, pcorrect_mac, pbroadcast, pcrc_error);
 }
 
+void rawnet_arch_vsync(void)
+{
+    if (rawnet_arch_driver != NULL && rawnet_arch_driver->vsync != NULL) {
+        rawnet_arch_driver->vsync();
+    }
+}
+
 int rawnet_arch_enumadapter_open(void)
 {
     if (rawnet_arch_driver != NULL) {
@@ -400,6 +432,10 @@ static char *rawnetdrivernames[] = {
 #endif
 #ifdef HAVE_PCAP
     "pcap",
+#endif
+#ifdef UNIX_COMPILE
+    "pcapfile",
+    "vswitch",
 #endif
     NULL
 };
@@ -411,6 +447,10 @@ static char *rawnetdriverdescs[] = {
 #endif
 #ifdef HAVE_PCAP
     "PCAP",
+#endif
+#ifdef UNIX_COMPILE
+    "pcap file replay",
+    "virtual switch",
 #endif
     NULL
 };
@@ -421,13 +461,18 @@ int rawnet_arch_enumdriver_open(void)
     /* HACK! remove pcap from the list when its not available */
 #ifdef HAVE_PCAP
     if (!archdep_rawnet_capability()) {
-#ifdef HAVE_TUNTAP
-        rawnetdrivernames[2] = NULL;
-        rawnetdriverdescs[2] = NULL;
-#else
-        rawnetdrivernames[1] = NULL;
-        rawnetdriverdescs[1] = NULL;
-#endif
+        int i;
+        int j = 0;
+
+        for (i = 0; rawnetdrivernames[i] != NULL; i++) {
+            if (strcmp(rawnetdrivernames[i], "pcap") != 0) {
+                rawnetdrivernames[j] = rawnetdrivernames[i];
+                rawnetdriverdescs[j] = rawnetdriverdescs[i];
+                j++;
+            }
+        }
+        rawnetdrivernames[j] = NULL;
+        rawnetdriverdescs[j] = NULL;
     }
 #endif
     return 1;
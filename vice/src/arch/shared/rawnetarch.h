@@ -64,6 +64,8 @@ void rawnet_arch_transmit(int force, int onecoll, int inhibit_crc, int tx_pad_di
 
 int rawnet_arch_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_index, int *prx_ok, int *pcorrect_mac, int *pbroadcast, int *pcrc_error);
 
+void rawnet_arch_vsync(void);
+
 int rawnet_arch_enumadapter_open(void);
 int rawnet_arch_enumadapter(char **ppname, char **ppdescription);
 int rawnet_arch_enumadapter_close(void);
@@ -110,6 +112,9 @@ typedef struct rawnet_arch_driver_s {
     int (*enumadapter_close)(void);
 
     char *(*get_standard_interface)(void);
+
+    /* called at the end of every emulated frame, may be NULL */
+    void (*vsync)(void);
 } rawnet_arch_driver_t;
 
 #ifdef HAVE_PCAP
@@ -118,6 +123,8 @@ extern rawnet_arch_driver_t rawnet_arch_driver_pcap;
 #ifdef HAVE_TUNTAP
 extern rawnet_arch_driver_t rawnet_arch_driver_tuntap;
 #endif
+extern rawnet_arch_driver_t rawnet_arch_driver_pcapfile;
+extern rawnet_arch_driver_t rawnet_arch_driver_vswitch;
 
 #endif /* ifdef UNIX_COMPILE */
 
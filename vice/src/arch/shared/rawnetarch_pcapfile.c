@@ -0,0 +1,368 @@
+/** \file   rawnetarch_pcapfile.c
+ * \brief   Raw ethernet driver for Unix that replays a pcap capture file
+ *
+ * Meant for testing and measuring the ethernet emulation without a real
+ * network: the interface name is "rx.pcap" or "rx.pcap,tx.pcap". Frames from
+ * rx.pcap are received with the timing they were captured with, counted from
+ * the time the driver was activated. Transmitted frames are written to
+ * tx.pcap, if given, so they can be looked at with the usual tools.
+ *
+ * Only classic pcap files with ethernet frames are supported, libpcap is not
+ * needed.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include <stdint.h>
+
+#include "vice.h"
+
+#ifdef HAVE_RAWNET
+#ifdef UNIX_COMPILE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "lib.h"
+#include "log.h"
+#include "rawnetarch.h"
+#include "types.h"
+
+#define PCAP_MAGIC          0xa1b2c3d4
+#define PCAP_MAGIC_SWAPPED  0xd4c3b2a1
+#define PCAP_LINKTYPE_ETH   1
+
+#define PCAP_SNAPLEN        1518
+
+static FILE *rx_file = NULL;
+static FILE *tx_file = NULL;
+
+/* the rx file was written on a host with the other byte order */
+static int rx_swapped = 0;
+
+/* next frame of the rx file, read ahead so its time is known */
+static uint8_t rx_frame[PCAP_SNAPLEN];
+static int rx_frame_len = -1;
+static uint64_t rx_frame_time;     /* microseconds since the first frame */
+static uint64_t rx_first_time;
+static int rx_first = 1;
+
+static tick_t start_tick;
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    uint32_t value = get_le32(p);
+
+    if (rx_swapped) {
+        value = (value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24);
+    }
+    return value;
+}
+
+static void put_le32(uint8_t *p, uint32_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+}
+
+/* Read the next frame of the rx file, rx_frame_len is -1 at the end */
+static void read_next_frame(void)
+{
+    uint8_t header[16];
+    uint32_t caplen;
+    uint32_t origlen;
+    uint64_t time;
+
+    rx_frame_len = -1;
+
+    while (fread(header, 1, sizeof header, rx_file) == sizeof header) {
+        caplen = get_u32(header + 8);
+        origlen = get_u32(header + 12);
+
+        if (caplen > PCAP_SNAPLEN || caplen > origlen) {
+            log_error(rawnet_arch_log, "pcapfile: broken frame header, stopping replay.");
+            return;
+        }
+        if (fread(rx_frame, 1, caplen, rx_file) != caplen) {
+            return;
+        }
+        if (caplen < origlen || caplen < 14) {
+            /* truncated by the capture, useless */
+            continue;
+        }
+
+        time = (uint64_t)get_u32(header) * 1000000 + get_u32(header + 4);
+        if (rx_first) {
+            rx_first_time = time;
+            rx_first = 0;
+        }
+        rx_frame_time = time >= rx_first_time ? time - rx_first_time : 0;
+        rx_frame_len = (int)caplen;
+        return;
+    }
+}
+
+static int open_rx_file(const char *name)
+{
+    uint8_t header[24];
+    uint32_t magic;
+
+    rx_file = fopen(name, "rb");
+    if (rx_file == NULL) {
+        log_error(rawnet_arch_log, "pcapfile: cannot open `%s': %s", name, strerror(errno));
+        return 0;
+    }
+
+    if (fread(header, 1, sizeof header, rx_file) != sizeof header) {
+        log_error(rawnet_arch_log, "pcapfile: `%s' is too short.", name);
+        return 0;
+    }
+
+    magic = get_le32(header);
+    if (magic == PCAP_MAGIC) {
+        rx_swapped = 0;
+    } else if (magic == PCAP_MAGIC_SWAPPED) {
+        rx_swapped = 1;
+    } else {
+        log_error(rawnet_arch_log, "pcapfile: `%s' is not a pcap file.", name);
+        return 0;
+    }
+
+    if (get_u32(header + 20) != PCAP_LINKTYPE_ETH) {
+        log_error(rawnet_arch_log, "pcapfile: `%s' does not contain ethernet frames.", name);
+        return 0;
+    }
+
+    rx_first = 1;
+    read_next_frame();
+    return 1;
+}
+
+static int open_tx_file(const char *name)
+{
+    uint8_t header[24];
+
+    tx_file = fopen(name, "wb");
+    if (tx_file == NULL) {
+        log_error(rawnet_arch_log, "pcapfile: cannot create `%s': %s", name, strerror(errno));
+        return 0;
+    }
+
+    put_le32(header, PCAP_MAGIC);
+    header[4] = 2;      /* version 2.4 */
+    header[5] = 0;
+    header[6] = 4;
+    header[7] = 0;
+    put_le32(header + 8, 0);
+    put_le32(header + 12, 0);
+    put_le32(header + 16, PCAP_SNAPLEN);
+    put_le32(header + 20, PCAP_LINKTYPE_ETH);
+
+    return fwrite(header, 1, sizeof header, tx_file) == sizeof header;
+}
+
+/* ------------------------------------------------------------------------- */
+/*    the architecture-dependend functions                                   */
+
+static void rawnet_arch_pcapfile_deactivate(void);
+
+static void rawnet_arch_pcapfile_pre_reset(void)
+{
+}
+
+static void rawnet_arch_pcapfile_post_reset(void)
+{
+}
+
+static int rawnet_arch_pcapfile_activate(const char *interface_name)
+{
+    char *rx_name;
+    char *tx_name;
+    int result;
+
+    if (interface_name == NULL || *interface_name == '\0') {
+        log_error(rawnet_arch_log, "pcapfile: no capture file given.");
+        return 0;
+    }
+
+    rx_name = lib_strdup(interface_name);
+    tx_name = strchr(rx_name, ',');
+    if (tx_name != NULL) {
+        *tx_name++ = '\0';
+    }
+
+    result = open_rx_file(rx_name);
+    if (result && tx_name != NULL && *tx_name != '\0') {
+        result = open_tx_file(tx_name);
+    }
+
+    if (result) {
+        log_message(rawnet_arch_log, "pcapfile: replaying `%s'%s%s.", rx_name,
+                    tx_file != NULL ? ", writing to " : "", tx_file != NULL ? tx_name : "");
+        start_tick = tick_now();
+    } else {
+        rawnet_arch_pcapfile_deactivate();
+    }
+
+    lib_free(rx_name);
+    return result;
+}
+
+static void rawnet_arch_pcapfile_deactivate(void)
+{
+    if (rx_file != NULL) {
+        fclose(rx_file);
+        rx_file = NULL;
+    }
+    if (tx_file != NULL) {
+        fclose(tx_file);
+        tx_file = NULL;
+    }
+    rx_frame_len = -1;
+}
+
+static void rawnet_arch_pcapfile_set_mac(const uint8_t mac[6])
+{
+}
+
+static void rawnet_arch_pcapfile_set_hashfilter(const uint32_t hash_mask[2])
+{
+}
+
+static void rawnet_arch_pcapfile_recv_ctl(int bBroadcast, int bIA, int bMulticast, int bCorrect, int bPromiscuous, int bIAHash)
+{
+}
+
+static void rawnet_arch_pcapfile_line_ctl(int bEnableTransmitter, int bEnableReceiver)
+{
+}
+
+static void rawnet_arch_pcapfile_transmit(int force, int onecoll, int inhibit_crc,
+                                          int tx_pad_dis, int txlength, uint8_t *txframe)
+{
+    uint8_t header[16];
+    uint64_t time = TICK_TO_MICRO(tick_now_delta(start_tick));
+
+    if (tx_file == NULL) {
+        return;
+    }
+
+    put_le32(header, (uint32_t)(time / 1000000));
+    put_le32(header + 4, (uint32_t)(time % 1000000));
+    put_le32(header + 8, (uint32_t)txlength);
+    put_le32(header + 12, (uint32_t)txlength);
+
+    if (fwrite(header, 1, sizeof header, tx_file) != sizeof header
+        || fwrite(txframe, 1, (size_t)txlength, tx_file) != (size_t)txlength) {
+        log_error(rawnet_arch_log, "pcapfile: cannot write frame: %s", strerror(errno));
+    }
+}
+
+static int rawnet_arch_pcapfile_receive(uint8_t *pbuffer, int *plen, int *phashed,
+                                        int *phash_index, int *prx_ok,
+                                        int *pcorrect_mac, int *pbroadcast,
+                                        int *pcrc_error)
+{
+    int len = rx_frame_len;
+
+    if (len < 0 || rx_frame_time > TICK_TO_MICRO(tick_now_delta(start_tick))) {
+        return 0;
+    }
+
+    memcpy(pbuffer, rx_frame, (size_t)(len < *plen ? len : *plen));
+    if (len & 1) {
+        /* the chip only deals with whole words */
+        ++len;
+    }
+    *plen = len;
+
+    /* leave the filtering to the emulated chip */
+    *phashed = 0;
+    *phash_index = 0;
+    *pbroadcast = 0;
+    *pcorrect_mac = 0;
+    *pcrc_error = 0;
+    *prx_ok = 1;
+
+    read_next_frame();
+    return 1;
+}
+
+static int rawnet_arch_pcapfile_enumadapter_open(void)
+{
+    return 1;
+}
+
+static int rawnet_arch_pcapfile_enumadapter(char **ppname, char **ppdescription)
+{
+    /* any file name will do */
+    return 0;
+}
+
+static int rawnet_arch_pcapfile_enumadapter_close(void)
+{
+    return 1;
+}
+
+static char *rawnet_arch_pcapfile_get_standard_interface(void)
+{
+    return NULL;
+}
+
+rawnet_arch_driver_t rawnet_arch_driver_pcapfile = {
+    "pcapfile",
+    rawnet_arch_pcapfile_pre_reset,
+    rawnet_arch_pcapfile_post_reset,
+    rawnet_arch_pcapfile_activate,
+    rawnet_arch_pcapfile_deactivate,
+    rawnet_arch_pcapfile_set_mac,
+    rawnet_arch_pcapfile_set_hashfilter,
+
+    rawnet_arch_pcapfile_recv_ctl,
+
+    rawnet_arch_pcapfile_line_ctl,
+
+    rawnet_arch_pcapfile_transmit,
+
+    rawnet_arch_pcapfile_receive,
+
+    rawnet_arch_pcapfile_enumadapter_open,
+    rawnet_arch_pcapfile_enumadapter,
+    rawnet_arch_pcapfile_enumadapter_close,
+
+    rawnet_arch_pcapfile_get_standard_interface,
+
+    NULL    /* vsync */
+};
+
+#endif /* ifdef UNIX_COMPILE */
+#endif /* ifdef HAVE_RAWNET */
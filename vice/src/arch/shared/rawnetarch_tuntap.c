@@ -338,7 +338,9 @@ rawnet_arch_driver_t rawnet_arch_driver_tuntap = {
     rawnet_arch_tuntap_enumadapter,
     rawnet_arch_tuntap_enumadapter_close,
 
-    rawnet_arch_tuntap_get_standard_interface
+    rawnet_arch_tuntap_get_standard_interface,
+
+    NULL    /* vsync */
 };
 
 #endif /* #ifdef HAVE_TUNTAP */
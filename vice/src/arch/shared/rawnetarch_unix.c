@@ -537,7 +537,9 @@ rawnet_arch_driver_t rawnet_arch_driver_pcap = {
     rawnet_arch_pcap_enumadapter,
     rawnet_arch_pcap_enumadapter_close,
 
-    rawnet_arch_pcap_get_standard_interface
+    rawnet_arch_pcap_get_standard_interface,
+
+    NULL    /* vsync */
 };
 
 #endif /* #ifdef HAVE_PCAP */
@@ -0,0 +1,855 @@
+/** \file   rawnetarch_vswitch.c
+ * \brief   Raw ethernet driver for Unix connecting emulator instances
+ *
+ * All instances that use the same directory as interface name form a
+ * virtual ethernet segment, no root privileges or real interfaces needed.
+ * Each instance binds a Unix datagram socket in that directory and sends its
+ * frames to the sockets of all others; the emulated chips do the address
+ * filtering like on a real hub.
+ *
+ * Frames sent during an emulated frame are collected and go out together at
+ * its end, packed into as few datagrams as possible.
+ *
+ * With "dir,sync" as interface name, delivery is reproducible: every frame
+ * carries the number of the emulated frame and the cycle within that frame
+ * it was sent at, and is received exactly one emulated frame later at the
+ * same cycle. At the end of each frame an instance waits until all other
+ * instances have finished that frame as well, so they run in lockstep. Runs
+ * are repeatable if all instances are started together: with "dir,sync,N"
+ * the first frame only ends once N instances have joined. An instance that
+ * does not keep up for a second is no longer waited for.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include <stdint.h>
+
+#include "vice.h"
+
+#ifdef HAVE_RAWNET
+#ifdef UNIX_COMPILE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "archdep.h"
+#include "lib.h"
+#include "log.h"
+#include "maincpu.h"
+#include "rawnet.h"
+#include "rawnetarch.h"
+#include "types.h"
+#include "util.h"
+
+#define VSWITCH_MAGIC           0x31575356  /* "VSW1" */
+
+#define VSWITCH_FRAME_MAX       1518
+
+/* the last datagram of an emulated frame */
+#define VSWITCH_FLAG_END        0x0001
+
+#define VSWITCH_DATAGRAM_MAX    65536
+
+/* frames sent and waiting for delivery per emulated frame */
+#define VSWITCH_TX_MAX          128
+#define VSWITCH_RX_MAX          512
+
+#define VSWITCH_PEERS_MAX       32
+
+/* without sync, look for new instances every this many frames */
+#define VSWITCH_RESCAN_FRAMES   50
+
+/* how long to wait for a peer before it is no longer waited for */
+#define VSWITCH_PEER_TIMEOUT_US 1000000
+
+/* how long to wait for the other instances to start */
+#define VSWITCH_START_TIMEOUT_US 60000000
+
+typedef struct vswitch_header_s {
+    uint32_t magic;
+    uint32_t sender;
+    uint32_t frame;     /* number of the emulated frame of the sender */
+    uint16_t flags;
+    uint16_t count;     /* number of frames following */
+} vswitch_header_t;
+
+typedef struct vswitch_frame_header_s {
+    uint32_t offset;    /* cycles since the start of the emulated frame */
+    uint16_t len;
+    uint16_t pad;
+} vswitch_frame_header_t;
+
+typedef struct vswitch_frame_s {
+    uint32_t seq;       /* order of arrival */
+    uint32_t sender;
+    uint32_t frame;
+    uint32_t offset;
+    int len;
+    uint8_t data[VSWITCH_FRAME_MAX];
+} vswitch_frame_t;
+
+typedef struct vswitch_peer_s {
+    char *path;
+    uint32_t id;
+    int lockstep;       /* wait for it in sync mode */
+    uint32_t done;      /* number of frames it has finished */
+} vswitch_peer_t;
+
+static int sock_fd = -1;
+static char *dir_name = NULL;
+static char *sock_name = NULL;
+static uint32_t own_id;
+static int sync_mode = 0;
+
+/* in sync mode, number of other instances to wait for before the first frame */
+static int sync_expected = 0;
+
+static vswitch_peer_t peers[VSWITCH_PEERS_MAX];
+static int peer_count = 0;
+
+/* instances that are gone but whose socket could not be removed */
+static uint32_t dead_ids[VSWITCH_PEERS_MAX];
+static int dead_count = 0;
+
+/* frames sent in the current emulated frame */
+static vswitch_frame_t *tx_frames = NULL;
+static int tx_count = 0;
+
+/* frames received, in sync mode not all of them due yet */
+static vswitch_frame_t *rx_frames = NULL;
+static int rx_count = 0;
+static uint32_t rx_seq = 0;
+
+static uint8_t *datagram = NULL;
+
+/* number of the current emulated frame and the clock it started at */
+static uint32_t frame_number = 0;
+static CLOCK frame_start_clk = 0;
+
+static unsigned long stats_tx_frames;
+static unsigned long stats_tx_datagrams;
+static unsigned long stats_rx_frames;
+static unsigned long stats_dropped;
+static uint64_t stats_wait_ticks;
+static tick_t stats_start;
+
+
+/* ------------------------------------------------------------------------- */
+/*    peers                                                                  */
+
+static vswitch_peer_t *find_peer(uint32_t id)
+{
+    int i;
+
+    for (i = 0; i < peer_count; i++) {
+        if (peers[i].id == id) {
+            return &peers[i];
+        }
+    }
+    return NULL;
+}
+
+static void remove_peer(vswitch_peer_t *peer)
+{
+    lib_free(peer->path);
+    *peer = peers[--peer_count];
+}
+
+static int is_dead(uint32_t id)
+{
+    int i;
+
+    for (i = 0; i < dead_count; i++) {
+        if (dead_ids[i] == id) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* An instance that crashed leaves its socket behind. Remove it, so it is not
+   found again, or remember the id if that is not possible. */
+static void remove_stale_socket(uint32_t id, const char *path)
+{
+    if (unlink(path) == 0) {
+        log_message(rawnet_arch_log, "vswitch: removed the stale socket of instance %u.", (unsigned int)id);
+    } else if (!is_dead(id) && dead_count < VSWITCH_PEERS_MAX) {
+        dead_ids[dead_count++] = id;
+    }
+}
+
+/* check if an instance is bound to the socket */
+static int socket_alive(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+    int alive = 1;
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof addr.sun_path - 1);
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return 1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof addr) < 0 && errno == ECONNREFUSED) {
+        alive = 0;
+    }
+    close(fd);
+    return alive;
+}
+
+/* sockets are named vice-<id>.sock, where id is the process id */
+static void scan_peers(void)
+{
+    DIR *dir = opendir(dir_name);
+    struct dirent *entry;
+    unsigned long id;
+    char *end;
+    char *path;
+
+    if (dir == NULL) {
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "vice-", 5) != 0) {
+            continue;
+        }
+        id = strtoul(entry->d_name + 5, &end, 10);
+        if (strcmp(end, ".sock") != 0 || id == own_id || find_peer((uint32_t)id) != NULL
+            || is_dead((uint32_t)id)) {
+            continue;
+        }
+        path = util_concat(dir_name, "/", entry->d_name, NULL);
+        if (!socket_alive(path)) {
+            remove_stale_socket((uint32_t)id, path);
+            lib_free(path);
+            continue;
+        }
+        if (peer_count == VSWITCH_PEERS_MAX) {
+            log_warning(rawnet_arch_log, "vswitch: too many instances, ignoring %s.", entry->d_name);
+            lib_free(path);
+            continue;
+        }
+        peers[peer_count].path = path;
+        peers[peer_count].id = (uint32_t)id;
+        peers[peer_count].lockstep = sync_mode;
+        peers[peer_count].done = 0;
+        peer_count++;
+    }
+    closedir(dir);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/*    receiving                                                              */
+
+static void store_frames(const uint8_t *data, ssize_t size)
+{
+    vswitch_header_t header;
+    vswitch_frame_header_t fh;
+    vswitch_peer_t *peer;
+    size_t pos = sizeof header;
+    int i;
+
+    if (size < (ssize_t)sizeof header) {
+        return;
+    }
+    memcpy(&header, data, sizeof header);
+    if (header.magic != VSWITCH_MAGIC) {
+        return;
+    }
+
+    peer = find_peer(header.sender);
+    if (peer == NULL) {
+        scan_peers();
+        peer = find_peer(header.sender);
+    }
+
+    for (i = 0; i < header.count; i++) {
+        if (pos + sizeof fh > (size_t)size) {
+            break;
+        }
+        memcpy(&fh, data + pos, sizeof fh);
+        pos += sizeof fh;
+        if (fh.len > VSWITCH_FRAME_MAX || pos + fh.len > (size_t)size) {
+            break;
+        }
+        if (rx_count == VSWITCH_RX_MAX) {
+            stats_dropped++;
+        } else {
+            vswitch_frame_t *frame = &rx_frames[rx_count++];
+
+            frame->seq = rx_seq++;
+            frame->sender = header.sender;
+            frame->frame = header.frame;
+            frame->offset = fh.offset;
+            frame->len = fh.len;
+            memcpy(frame->data, data + pos, fh.len);
+        }
+        pos += (fh.len + 3) & ~3;
+    }
+
+    if (peer != NULL && (header.flags & VSWITCH_FLAG_END)) {
+        peer->done = header.frame + 1;
+    }
+}
+
+/* read all datagrams waiting on the socket */
+static void drain_socket(void)
+{
+    ssize_t size;
+
+    while ((size = recv(sock_fd, datagram, VSWITCH_DATAGRAM_MAX, MSG_DONTWAIT)) >= 0) {
+        store_frames(datagram, size);
+    }
+}
+
+/* Sort key: without sync, frames are delivered in the order they arrived.
+   With sync, they are delivered by emulated time, frames sent at the same
+   time by different instances by their source MAC address, so the order
+   does not depend on process ids or on which datagram arrived first. */
+static int frame_before(const vswitch_frame_t *a, const vswitch_frame_t *b)
+{
+    int cmp;
+
+    if (!sync_mode) {
+        return (int32_t)(a->seq - b->seq) < 0;
+    }
+    if (a->frame != b->frame) {
+        return (int32_t)(a->frame - b->frame) < 0;
+    }
+    if (a->offset != b->offset) {
+        return a->offset < b->offset;
+    }
+    cmp = memcmp(a->data + 6, b->data + 6, 6);
+    if (cmp != 0) {
+        return cmp < 0;
+    }
+    return a->sender < b->sender;
+}
+
+/* index of the next frame to deliver, or -1 */
+static int next_frame(void)
+{
+    int best = -1;
+    int i;
+
+    for (i = 0; i < rx_count; i++) {
+        if (best < 0 || frame_before(&rx_frames[i], &rx_frames[best])) {
+            best = i;
+        }
+    }
+    if (best >= 0 && sync_mode) {
+        const vswitch_frame_t *frame = &rx_frames[best];
+        uint32_t due_frame = frame->frame + 1;
+
+        /* frames sent during frame N arrive in frame N + 1 at the same
+           cycle, late ones (before the instances were in lockstep) as soon
+           as possible */
+        if ((int32_t)(frame_number - due_frame) < 0) {
+            return -1;
+        }
+        if (frame_number == due_frame && maincpu_clk - frame_start_clk < frame->offset) {
+            return -1;
+        }
+    }
+    return best;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/*    sending                                                                */
+
+static int send_datagram(vswitch_peer_t *peer, const uint8_t *data, size_t size)
+{
+    struct sockaddr_un addr;
+    tick_t start = 0;
+    struct pollfd pfd;
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, peer->path, sizeof addr.sun_path - 1);
+
+    while (sendto(sock_fd, data, size, MSG_DONTWAIT, (struct sockaddr *)&addr, sizeof addr) < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+            /* the instance is gone, after a crash its socket is still there */
+            if (errno == ECONNREFUSED) {
+                remove_stale_socket(peer->id, peer->path);
+            }
+            return -1;
+        }
+        /* the peer is busy; keep reading so two instances sending to each
+           other cannot block each other */
+        if (start == 0) {
+            start = tick_now();
+        } else if (TICK_TO_MICRO(tick_now_delta(start)) > VSWITCH_PEER_TIMEOUT_US) {
+            return 0;
+        }
+        drain_socket();
+        pfd.fd = sock_fd;
+        pfd.events = POLLIN;
+        poll(&pfd, 1, 1);
+    }
+    return 1;
+}
+
+static void send_to_all(const uint8_t *data, size_t size)
+{
+    int i = 0;
+
+    while (i < peer_count) {
+        int result = send_datagram(&peers[i], data, size);
+
+        if (result < 0) {
+            log_message(rawnet_arch_log, "vswitch: instance %u left.", (unsigned int)peers[i].id);
+            remove_peer(&peers[i]);
+            continue;
+        }
+        if (result == 0) {
+            stats_dropped += ((const vswitch_header_t *)data)->count;
+        }
+        i++;
+    }
+    stats_tx_datagrams++;
+}
+
+/* send the frames queued so far, end is set when the emulated frame is over */
+static void flush_frames(int end)
+{
+    vswitch_header_t header;
+    size_t pos = sizeof header;
+    int i;
+
+    header.magic = VSWITCH_MAGIC;
+    header.sender = own_id;
+    header.frame = frame_number;
+    header.flags = 0;
+    header.count = 0;
+
+    for (i = 0; i < tx_count; i++) {
+        const vswitch_frame_t *frame = &tx_frames[i];
+        vswitch_frame_header_t fh;
+        size_t need = sizeof fh + ((frame->len + 3) & ~3);
+
+        if (pos + need > VSWITCH_DATAGRAM_MAX) {
+            memcpy(datagram, &header, sizeof header);
+            send_to_all(datagram, pos);
+            pos = sizeof header;
+            header.count = 0;
+        }
+
+        fh.offset = frame->offset;
+        fh.len = (uint16_t)frame->len;
+        fh.pad = 0;
+        memcpy(datagram + pos, &fh, sizeof fh);
+        memcpy(datagram + pos + sizeof fh, frame->data, frame->len);
+        memset(datagram + pos + sizeof fh + frame->len, 0, need - sizeof fh - frame->len);
+        pos += need;
+        header.count++;
+    }
+
+    /* in sync mode an empty datagram tells the peers this frame is done */
+    if (header.count > 0 || (end && sync_mode)) {
+        header.flags = end ? VSWITCH_FLAG_END : 0;
+        memcpy(datagram, &header, sizeof header);
+        send_to_all(datagram, pos);
+    }
+
+    stats_tx_frames += tx_count;
+    tx_count = 0;
+}
+
+/* drop the instances that went away without sending anything */
+static void check_peers(void)
+{
+    int i = 0;
+
+    while (i < peer_count) {
+        if (!socket_alive(peers[i].path)) {
+            log_message(rawnet_arch_log, "vswitch: instance %u left.", (unsigned int)peers[i].id);
+            remove_stale_socket(peers[i].id, peers[i].path);
+            remove_peer(&peers[i]);
+            continue;
+        }
+        i++;
+    }
+}
+
+/* wait until the expected number of instances has joined */
+static void wait_for_start(void)
+{
+    tick_t start = tick_now();
+
+    scan_peers();
+    while (peer_count < sync_expected) {
+        if (TICK_TO_MICRO(tick_now_delta(start)) > VSWITCH_START_TIMEOUT_US) {
+            log_warning(rawnet_arch_log, "vswitch: only %d of %d other instance(s) joined, starting anyway.",
+                        peer_count, sync_expected);
+            break;
+        }
+        tick_sleep(tick_per_second() / 100);
+        check_peers();
+        scan_peers();
+    }
+    stats_wait_ticks += tick_now_delta(start);
+}
+
+/* wait until all peers in lockstep have finished the current frame */
+static void wait_for_peers(void)
+{
+    tick_t start = tick_now();
+    struct pollfd pfd;
+    int i;
+
+    for (;;) {
+        int waiting = 0;
+
+        drain_socket();
+        for (i = 0; i < peer_count; i++) {
+            if (peers[i].lockstep && (int32_t)(peers[i].done - (frame_number + 1)) < 0) {
+                waiting = 1;
+                if (TICK_TO_MICRO(tick_now_delta(start)) > VSWITCH_PEER_TIMEOUT_US) {
+                    log_warning(rawnet_arch_log, "vswitch: instance %u does not answer, no longer waiting for it.",
+                                (unsigned int)peers[i].id);
+                    peers[i].lockstep = 0;
+                }
+            }
+        }
+        if (!waiting) {
+            break;
+        }
+
+        pfd.fd = sock_fd;
+        pfd.events = POLLIN;
+        poll(&pfd, 1, 1);
+    }
+
+    stats_wait_ticks += tick_now_delta(start);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/*    the architecture-dependend functions                                   */
+
+static void rawnet_arch_vswitch_deactivate(void);
+
+static void rawnet_arch_vswitch_pre_reset(void)
+{
+}
+
+static void rawnet_arch_vswitch_post_reset(void)
+{
+}
+
+static int rawnet_arch_vswitch_activate(const char *interface_name)
+{
+    struct sockaddr_un addr;
+    char *options;
+    char id_str[32];
+
+    if (interface_name == NULL || *interface_name == '\0') {
+        log_error(rawnet_arch_log, "vswitch: no directory given.");
+        return 0;
+    }
+
+    dir_name = lib_strdup(interface_name);
+    options = strchr(dir_name, ',');
+    sync_mode = 0;
+    sync_expected = 0;
+    if (options != NULL) {
+        *options++ = '\0';
+        if (strncmp(options, "sync", 4) == 0 && (options[4] == '\0' || options[4] == ',')) {
+            sync_mode = 1;
+            if (options[4] == ',') {
+                sync_expected = atoi(options + 5) - 1;
+            }
+        }
+    }
+
+    if (mkdir(dir_name, 0700) < 0 && errno != EEXIST) {
+        log_error(rawnet_arch_log, "vswitch: cannot create `%s': %s", dir_name, strerror(errno));
+        rawnet_arch_vswitch_deactivate();
+        return 0;
+    }
+
+    own_id = (uint32_t)getpid();
+    sprintf(id_str, "/vice-%u.sock", (unsigned int)own_id);
+    sock_name = util_concat(dir_name, id_str, NULL);
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(sock_name) >= sizeof addr.sun_path) {
+        log_error(rawnet_arch_log, "vswitch: path `%s' too long.", sock_name);
+        rawnet_arch_vswitch_deactivate();
+        return 0;
+    }
+    strcpy(addr.sun_path, sock_name);
+
+    sock_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (sock_fd < 0) {
+        log_error(rawnet_arch_log, "vswitch: cannot create socket: %s", strerror(errno));
+        rawnet_arch_vswitch_deactivate();
+        return 0;
+    }
+    unlink(sock_name);
+    if (bind(sock_fd, (struct sockaddr *)&addr, sizeof addr) < 0) {
+        log_error(rawnet_arch_log, "vswitch: cannot bind `%s': %s", sock_name, strerror(errno));
+        close(sock_fd);
+        sock_fd = -1;
+        rawnet_arch_vswitch_deactivate();
+        return 0;
+    }
+
+    tx_frames = lib_malloc(VSWITCH_TX_MAX * sizeof(vswitch_frame_t));
+    rx_frames = lib_malloc(VSWITCH_RX_MAX * sizeof(vswitch_frame_t));
+    datagram = lib_malloc(VSWITCH_DATAGRAM_MAX);
+    tx_count = 0;
+    rx_count = 0;
+    rx_seq = 0;
+    dead_count = 0;
+    frame_number = 0;
+    frame_start_clk = maincpu_clk;
+
+    stats_tx_frames = 0;
+    stats_tx_datagrams = 0;
+    stats_rx_frames = 0;
+    stats_dropped = 0;
+    stats_wait_ticks = 0;
+    stats_start = tick_now();
+
+    scan_peers();
+
+    if (sync_mode) {
+        /* frames are due at a given cycle */
+        rawnet_request_synchronous_io();
+    }
+
+    log_message(rawnet_arch_log, "vswitch: joined `%s' as instance %u%s, %d other instance(s) found.",
+                dir_name, (unsigned int)own_id, sync_mode ? " in sync mode" : "", peer_count);
+    return 1;
+}
+
+static void rawnet_arch_vswitch_deactivate(void)
+{
+    if (sock_fd >= 0) {
+        double seconds = (double)TICK_TO_MICRO(tick_now_delta(stats_start)) / 1000000.0;
+
+        log_message(rawnet_arch_log,
+                    "vswitch: sent %lu frames in %lu datagrams, received %lu frames, %lu dropped, %.0f frames/s through the switch, %.3f s waited for other instances.",
+                    stats_tx_frames, stats_tx_datagrams, stats_rx_frames, stats_dropped,
+                    seconds > 0.0 ? (double)(stats_tx_frames + stats_rx_frames) / seconds : 0.0,
+                    (double)TICK_TO_MICRO(stats_wait_ticks) / 1000000.0);
+        close(sock_fd);
+        sock_fd = -1;
+    }
+    if (sock_name != NULL) {
+        unlink(sock_name);
+        lib_free(sock_name);
+        sock_name = NULL;
+    }
+    while (peer_count > 0) {
+        remove_peer(&peers[0]);
+    }
+    lib_free(dir_name);
+    dir_name = NULL;
+    lib_free(tx_frames);
+    tx_frames = NULL;
+    lib_free(rx_frames);
+    rx_frames = NULL;
+    lib_free(datagram);
+    datagram = NULL;
+}
+
+static void rawnet_arch_vswitch_set_mac(const uint8_t mac[6])
+{
+}
+
+static void rawnet_arch_vswitch_set_hashfilter(const uint32_t hash_mask[2])
+{
+}
+
+static void rawnet_arch_vswitch_recv_ctl(int bBroadcast, int bIA, int bMulticast, int bCorrect, int bPromiscuous, int bIAHash)
+{
+}
+
+static void rawnet_arch_vswitch_line_ctl(int bEnableTransmitter, int bEnableReceiver)
+{
+}
+
+static void rawnet_arch_vswitch_transmit(int force, int onecoll, int inhibit_crc,
+                                         int tx_pad_dis, int txlength, uint8_t *txframe)
+{
+    vswitch_frame_t *frame;
+
+    if (sock_fd < 0) {
+        return;
+    }
+    if (tx_count == VSWITCH_TX_MAX) {
+        /* more than a real 10 MBit line could carry in a frame, the peers
+           must not take the frame as done yet */
+        flush_frames(0);
+    }
+    if (txlength > VSWITCH_FRAME_MAX) {
+        txlength = VSWITCH_FRAME_MAX;
+    }
+
+    frame = &tx_frames[tx_count++];
+    frame->offset = sync_mode ? (uint32_t)(maincpu_clk - frame_start_clk) : 0;
+    frame->len = txlength;
+    memcpy(frame->data, txframe, (size_t)txlength);
+}
+
+static int rawnet_arch_vswitch_receive(uint8_t *pbuffer, int *plen, int *phashed,
+                                       int *phash_index, int *prx_ok,
+                                       int *pcorrect_mac, int *pbroadcast,
+                                       int *pcrc_error)
+{
+    vswitch_frame_t *frame;
+    int index;
+    int len;
+
+    if (sock_fd < 0) {
+        return 0;
+    }
+
+    /* in sync mode everything due has arrived while waiting for the peers */
+    if (!sync_mode) {
+        drain_socket();
+    }
+
+    index = next_frame();
+    if (index < 0) {
+        return 0;
+    }
+
+    frame = &rx_frames[index];
+    len = frame->len;
+    memcpy(pbuffer, frame->data, (size_t)(len < *plen ? len : *plen));
+    if (len & 1) {
+        ++len;
+    }
+    *plen = len;
+
+    /* the order in the array does not matter */
+    if (index != rx_count - 1) {
+        *frame = rx_frames[rx_count - 1];
+    }
+    rx_count--;
+    stats_rx_frames++;
+
+    /* leave the filtering to the emulated chip */
+    *phashed = 0;
+    *phash_index = 0;
+    *pbroadcast = 0;
+    *pcorrect_mac = 0;
+    *pcrc_error = 0;
+    *prx_ok = 1;
+
+    return 1;
+}
+
+static void rawnet_arch_vswitch_vsync(void)
+{
+    if (sock_fd < 0) {
+        return;
+    }
+
+    if (sync_mode) {
+        /* new instances must get this frame and be waited for right away */
+        if (frame_number == 0) {
+            wait_for_start();
+        }
+        scan_peers();
+    } else if (frame_number % VSWITCH_RESCAN_FRAMES == 0) {
+        scan_peers();
+    }
+
+    flush_frames(1);
+    if (sync_mode) {
+        wait_for_peers();
+    }
+
+    frame_number++;
+    frame_start_clk = maincpu_clk;
+}
+
+static int rawnet_arch_vswitch_enumadapter_open(void)
+{
+    return 1;
+}
+
+static int rawnet_arch_vswitch_enumadapter(char **ppname, char **ppdescription)
+{
+    /* any directory will do */
+    return 0;
+}
+
+static int rawnet_arch_vswitch_enumadapter_close(void)
+{
+    return 1;
+}
+
+static char *rawnet_arch_vswitch_get_standard_interface(void)
+{
+    return NULL;
+}
+
+rawnet_arch_driver_t rawnet_arch_driver_vswitch = {
+    "vswitch",
+    rawnet_arch_vswitch_pre_reset,
+    rawnet_arch_vswitch_post_reset,
+    rawnet_arch_vswitch_activate,
+    rawnet_arch_vswitch_deactivate,
+    rawnet_arch_vswitch_set_mac,
+    rawnet_arch_vswitch_set_hashfilter,
+
+    rawnet_arch_vswitch_recv_ctl,
+
+    rawnet_arch_vswitch_line_ctl,
+
+    rawnet_arch_vswitch_transmit,
+
+    rawnet_arch_vswitch_receive,
+
+    rawnet_arch_vswitch_enumadapter_open,
+    rawnet_arch_vswitch_enumadapter,
+    rawnet_arch_vswitch_enumadapter_close,
+
+    rawnet_arch_vswitch_get_standard_interface,
+
+    rawnet_arch_vswitch_vsync
+};
+
+#endif /* ifdef UNIX_COMPILE */
+#endif /* ifdef HAVE_RAWNET */
@@ -394,6 +394,10 @@ void rawnet_arch_line_ctl(int bEnableTransmitter, int bEnableReceiver)
 #endif
 }
 
+void rawnet_arch_vsync(void)
+{
+}
+
 typedef struct Ethernet_PCAP_internal_s {
     unsigned int len;
     uint8_t *buffer;
@@ -66,6 +66,9 @@ typedef struct ui_action_map_s {
                                  is allowed at a time), this implies using the
                                  UI thread */
     bool   uithread;        /**< must run on the UI thread */
+    bool   emuthread;       /**< run on the VICE thread at its next safe point,
+                                 posted through the main channel instead of
+                                 running with the mainlock held */
 
     /* state */
     bool   is_busy;         /**< action is busy */
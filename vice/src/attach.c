@@ -311,6 +311,21 @@ struct vdrive_s *file_system_get_vdrive(unsigned int unit)
     return file_system[unit - 8].vdrive;
 }
 
+/* Check if a virtual drive or filesystem device has a channel open that
+   writes to the host. */
+int file_system_write_channel_open(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < NUM_DISK_UNITS; i++) {
+        if (vdrive_write_channel_open(file_system[i].vdrive)
+            || fsdevice_write_channel_open(i + 8)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 struct disk_image_s *file_system_get_image(unsigned int unit, unsigned int drive)
 {
     return vdrive_get_image(file_system_get_vdrive(unit), drive);
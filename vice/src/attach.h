@@ -55,6 +55,7 @@ void file_system_detach_disk(unsigned int unit, unsigned int drive);
 void file_system_detach_disk_all(void);
 void file_system_detach_disk_shutdown(void);
 struct vdrive_s *file_system_get_vdrive(unsigned int unit);
+int file_system_write_channel_open(void);
 struct disk_image_s *file_system_get_image(unsigned int unit, unsigned int drive);
 int file_system_bam_get_disk_id(unsigned int unit, unsigned int drive, uint8_t *id);
 int file_system_bam_set_disk_id(unsigned int unit, unsigned int drive, uint8_t *id);
@@ -78,6 +78,22 @@ static io_source_list_t c64io_dd00_head = { NULL, NULL, NULL };
 static io_source_list_t c64io_de00_head = { NULL, NULL, NULL };
 static io_source_list_t c64io_df00_head = { NULL, NULL, NULL };
 
+/* per-address dispatch tables, one for each I/O page, see cartio.h */
+static io_source_t io_source_shared;
+#define IO_SOURCE_SHARED (&io_source_shared)
+
+static io_source_t *c64io_d000_dispatch[0x100];
+static io_source_t *c64io_d100_dispatch[0x100];
+static io_source_t *c64io_d200_dispatch[0x100];
+static io_source_t *c64io_d300_dispatch[0x100];
+static io_source_t *c64io_d400_dispatch[0x100];
+static io_source_t *c64io_d500_dispatch[0x100];
+static io_source_t *c64io_d600_dispatch[0x100];
+static io_source_t *c64io_d700_dispatch[0x100];
+static io_source_t *c64io_dd00_dispatch[0x100];
+static io_source_t *c64io_de00_dispatch[0x100];
+static io_source_t *c64io_df00_dispatch[0x100];
+
 static void io_source_detach(io_source_detach_t *source)
 {
     switch (source->det_id) {
@@ -292,9 +308,10 @@ static void io_source_log_collisions(uint16_t addr, int amount, io_source_list_t
     }
 }
 
-static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
+static inline uint8_t io_read(io_source_list_t *list, io_source_t **dispatch, uint16_t addr)
 {
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0xff];
     int io_source_counter = 0;
     int io_source_valid = 0;
     uint8_t realval = 0;
@@ -304,6 +321,18 @@ static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
 
     vicii_handle_pending_alarms_external(0);
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->read != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            retval = device->read((uint16_t)(addr & device->address_mask));
+            if (device->io_source_valid) {
+                return retval;
+            }
+        }
+        return vicii_read_phi1();
+    }
+
     while (current) {
         if (current->device->read != NULL) {
             if ((addr >= current->device->start_address) && (addr <= current->device->end_address)) {
@@ -390,15 +419,25 @@ static inline uint8_t io_peek(io_source_list_t *list, uint16_t addr)
     return vicii_read_phi1();
 }
 
-static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value)
+static inline void io_store(io_source_list_t *list, io_source_t **dispatch, uint16_t addr, uint8_t value)
 {
     int writes = 0;
     uint16_t addy = 0xffff;
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0xff];
     void (*store)(uint16_t address, uint8_t data) = NULL;
 
     vicii_handle_pending_alarms_external_write();
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->store != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            device->store((uint16_t)(addr & device->address_mask), value);
+        }
+        return;
+    }
+
     while (current) {
         if (current->device->store != NULL) {
             if (addr >= current->device->start_address && addr <= current->device->end_address) {
@@ -422,6 +461,46 @@ static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value
 
 /* ---------------------------------------------------------------------------------------------------------- */
 
+static void io_source_dispatch_build(io_source_list_t *list, io_source_t **dispatch, unsigned int base)
+{
+    io_source_list_t *current = list->next;
+    unsigned int start;
+    unsigned int end;
+    unsigned int i;
+
+    memset(dispatch, 0, sizeof(io_source_t *) * 0x100);
+
+    while (current) {
+        start = current->device->start_address;
+        end = current->device->end_address;
+        if (start < base) {
+            start = base;
+        }
+        if (end > base + 0xff) {
+            end = base + 0xff;
+        }
+        for (i = start; i <= end; i++) {
+            dispatch[i - base] = dispatch[i - base] ? IO_SOURCE_SHARED : current->device;
+        }
+        current = current->next;
+    }
+}
+
+void io_source_dispatch_update(void)
+{
+    io_source_dispatch_build(&c64io_d000_head, c64io_d000_dispatch, 0xd000);
+    io_source_dispatch_build(&c64io_d100_head, c64io_d100_dispatch, 0xd100);
+    io_source_dispatch_build(&c64io_d200_head, c64io_d200_dispatch, 0xd200);
+    io_source_dispatch_build(&c64io_d300_head, c64io_d300_dispatch, 0xd300);
+    io_source_dispatch_build(&c64io_d400_head, c64io_d400_dispatch, 0xd400);
+    io_source_dispatch_build(&c64io_d500_head, c64io_d500_dispatch, 0xd500);
+    io_source_dispatch_build(&c64io_d600_head, c64io_d600_dispatch, 0xd600);
+    io_source_dispatch_build(&c64io_d700_head, c64io_d700_dispatch, 0xd700);
+    io_source_dispatch_build(&c64io_dd00_head, c64io_dd00_dispatch, 0xdd00);
+    io_source_dispatch_build(&c64io_de00_head, c64io_de00_dispatch, 0xde00);
+    io_source_dispatch_build(&c64io_df00_head, c64io_df00_dispatch, 0xdf00);
+}
+
 io_source_list_t *io_source_register(io_source_t *device)
 {
     io_source_list_t *current = NULL;
@@ -482,6 +561,8 @@ io_source_list_t *io_source_register(io_source_t *device)
     retval->next = NULL;
     retval->device->order = order++;
 
+    io_source_dispatch_update();
+
     return retval;
 }
 
@@ -506,6 +587,8 @@ void io_source_unregister(io_source_list_t *device)
     }
 
     lib_free(device);
+
+    io_source_dispatch_update();
 }
 
 void cartio_shutdown(void)
@@ -589,7 +672,7 @@ void cartio_set_highest_order(unsigned int nr)
 uint8_t c64io_d000_read(uint16_t addr)
 {
     DBGRW(("IO: io-d000 r %04x", addr));
-    return io_read(&c64io_d000_head, addr);
+    return io_read(&c64io_d000_head, c64io_d000_dispatch, addr);
 }
 
 uint8_t c64io_d000_peek(uint16_t addr)
@@ -601,13 +684,13 @@ uint8_t c64io_d000_peek(uint16_t addr)
 void c64io_d000_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d000 w %04x %02x", addr, value));
-    io_store(&c64io_d000_head, addr, value);
+    io_store(&c64io_d000_head, c64io_d000_dispatch, addr, value);
 }
 
 uint8_t c64io_d100_read(uint16_t addr)
 {
     DBGRW(("IO: io-d100 r %04x", addr));
-    return io_read(&c64io_d100_head, addr);
+    return io_read(&c64io_d100_head, c64io_d100_dispatch, addr);
 }
 
 uint8_t c64io_d100_peek(uint16_t addr)
@@ -619,13 +702,13 @@ uint8_t c64io_d100_peek(uint16_t addr)
 void c64io_d100_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d100 w %04x %02x", addr, value));
-    io_store(&c64io_d100_head, addr, value);
+    io_store(&c64io_d100_head, c64io_d100_dispatch, addr, value);
 }
 
 uint8_t c64io_d200_read(uint16_t addr)
 {
     DBGRW(("IO: io-d200 r %04x", addr));
-    return io_read(&c64io_d200_head, addr);
+    return io_read(&c64io_d200_head, c64io_d200_dispatch, addr);
 }
 
 uint8_t c64io_d200_peek(uint16_t addr)
@@ -637,13 +720,13 @@ uint8_t c64io_d200_peek(uint16_t addr)
 void c64io_d200_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d200 w %04x %02x", addr, value));
-    io_store(&c64io_d200_head, addr, value);
+    io_store(&c64io_d200_head, c64io_d200_dispatch, addr, value);
 }
 
 uint8_t c64io_d300_read(uint16_t addr)
 {
     DBGRW(("IO: io-d300 r %04x", addr));
-    return io_read(&c64io_d300_head, addr);
+    return io_read(&c64io_d300_head, c64io_d300_dispatch, addr);
 }
 
 uint8_t c64io_d300_peek(uint16_t addr)
@@ -655,13 +738,13 @@ uint8_t c64io_d300_peek(uint16_t addr)
 void c64io_d300_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d300 w %04x %02x", addr, value));
-    io_store(&c64io_d300_head, addr, value);
+    io_store(&c64io_d300_head, c64io_d300_dispatch, addr, value);
 }
 
 uint8_t c64io_d400_read(uint16_t addr)
 {
     DBGRW(("IO: io-d400 r %04x", addr));
-    return io_read(&c64io_d400_head, addr);
+    return io_read(&c64io_d400_head, c64io_d400_dispatch, addr);
 }
 
 uint8_t c64io_d400_peek(uint16_t addr)
@@ -673,13 +756,13 @@ uint8_t c64io_d400_peek(uint16_t addr)
 void c64io_d400_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d400 w %04x %02x", addr, value));
-    io_store(&c64io_d400_head, addr, value);
+    io_store(&c64io_d400_head, c64io_d400_dispatch, addr, value);
 }
 
 uint8_t c64io_d500_read(uint16_t addr)
 {
     DBGRW(("IO: io-d500 r %04x", addr));
-    return io_read(&c64io_d500_head, addr);
+    return io_read(&c64io_d500_head, c64io_d500_dispatch, addr);
 }
 
 uint8_t c64io_d500_peek(uint16_t addr)
@@ -691,13 +774,13 @@ uint8_t c64io_d500_peek(uint16_t addr)
 void c64io_d500_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d500 w %04x %02x", addr, value));
-    io_store(&c64io_d500_head, addr, value);
+    io_store(&c64io_d500_head, c64io_d500_dispatch, addr, value);
 }
 
 uint8_t c64io_d600_read(uint16_t addr)
 {
     DBGRW(("IO: io-d600 r %04x", addr));
-    return io_read(&c64io_d600_head, addr);
+    return io_read(&c64io_d600_head, c64io_d600_dispatch, addr);
 }
 
 uint8_t c64io_d600_peek(uint16_t addr)
@@ -709,13 +792,13 @@ uint8_t c64io_d600_peek(uint16_t addr)
 void c64io_d600_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d600 w %04x %02x", addr, value));
-    io_store(&c64io_d600_head, addr, value);
+    io_store(&c64io_d600_head, c64io_d600_dispatch, addr, value);
 }
 
 uint8_t c64io_d700_read(uint16_t addr)
 {
     DBGRW(("IO: io-d700 r %04x", addr));
-    return io_read(&c64io_d700_head, addr);
+    return io_read(&c64io_d700_head, c64io_d700_dispatch, addr);
 }
 
 uint8_t c64io_d700_peek(uint16_t addr)
@@ -727,13 +810,13 @@ uint8_t c64io_d700_peek(uint16_t addr)
 void c64io_d700_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d700 w %04x %02x", addr, value));
-    io_store(&c64io_d700_head, addr, value);
+    io_store(&c64io_d700_head, c64io_d700_dispatch, addr, value);
 }
 
 uint8_t c64io_dd00_read(uint16_t addr)
 {
     DBGRW(("IO: io-dd00 r %04x", addr));
-    return io_read(&c64io_dd00_head, addr);
+    return io_read(&c64io_dd00_head, c64io_dd00_dispatch, addr);
 }
 
 uint8_t c64io_dd00_peek(uint16_t addr)
@@ -745,13 +828,13 @@ uint8_t c64io_dd00_peek(uint16_t addr)
 void c64io_dd00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-dd00 w %04x %02x", addr, value));
-    io_store(&c64io_dd00_head, addr, value);
+    io_store(&c64io_dd00_head, c64io_dd00_dispatch, addr, value);
 }
 
 uint8_t c64io_de00_read(uint16_t addr)
 {
     DBGRW(("IO: io-de00 r %04x", addr));
-    return io_read(&c64io_de00_head, addr);
+    return io_read(&c64io_de00_head, c64io_de00_dispatch, addr);
 }
 
 uint8_t c64io_de00_peek(uint16_t addr)
@@ -763,13 +846,13 @@ uint8_t c64io_de00_peek(uint16_t addr)
 void c64io_de00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-de00 w %04x %02x", addr, value));
-    io_store(&c64io_de00_head, addr, value);
+    io_store(&c64io_de00_head, c64io_de00_dispatch, addr, value);
 }
 
 uint8_t c64io_df00_read(uint16_t addr)
 {
     DBGRW(("IO: io-df00 r %04x", addr));
-    return io_read(&c64io_df00_head, addr);
+    return io_read(&c64io_df00_head, c64io_df00_dispatch, addr);
 }
 
 uint8_t c64io_df00_peek(uint16_t addr)
@@ -781,7 +864,7 @@ uint8_t c64io_df00_peek(uint16_t addr)
 void c64io_df00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-df00 w %04x %02x", addr, value));
-    io_store(&c64io_df00_head, addr, value);
+    io_store(&c64io_df00_head, c64io_df00_dispatch, addr, value);
 }
 
 /* ---------------------------------------------------------------------------------------------------------- */
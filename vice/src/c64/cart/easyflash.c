@@ -336,6 +336,161 @@ static int easyflash_write_chip_if_not_empty(FILE* fd, crt_chip_header_t *chip,
     return 0;
 }
 
+/* Has the 8KiB chip of the given bank and half been changed since the
+   image was last written? */
+static int easyflash_chip_dirty(int bank, int high)
+{
+    flash040_context_t *state = high ? easyflash_state_high : easyflash_state_low;
+
+    return flash040core_sector_is_dirty(state, (unsigned int)(bank * 0x2000) / flash040core_sector_size(state));
+}
+
+static int easyflash_chip_empty(int bank, int high)
+{
+    uint8_t *data = (high ? easyflash_state_high : easyflash_state_low)->flash_data + bank * 0x2000;
+    int i;
+
+    for (i = 0; i < 0x2000; i++) {
+        if (data[i] != 0xff) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int easyflash_image_dirty(void)
+{
+    int bank;
+
+    for (bank = 0; bank < EASYFLASH_N_BANKS; bank++) {
+        if (easyflash_chip_dirty(bank, 0) || easyflash_chip_dirty(bank, 1)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void easyflash_journal_open(void)
+{
+    char *name;
+
+    name = util_concat(easyflash_filename, ".roml.journal", NULL);
+    flash040core_journal_open(easyflash_state_low, name);
+    lib_free(name);
+    name = util_concat(easyflash_filename, ".romh.journal", NULL);
+    flash040core_journal_open(easyflash_state_high, name);
+    lib_free(name);
+}
+
+/* Write the changed banks into the existing .bin file, returns -1 if the
+   file has to be written completely. */
+static int easyflash_bin_update(const char *filename)
+{
+    FILE *fd;
+    int bank;
+    int high;
+    long offset;
+
+    fd = fopen(filename, MODE_READ_WRITE);
+    if (fd == NULL) {
+        return -1;
+    }
+
+    if (archdep_file_size(fd) != (off_t)(0x4000 * EASYFLASH_N_BANKS)) {
+        fclose(fd);
+        return -1;
+    }
+
+    for (bank = 0; bank < EASYFLASH_N_BANKS; bank++) {
+        for (high = 0; high < 2; high++) {
+            if (easyflash_chip_dirty(bank, high)) {
+                offset = bank * 0x4000 + high * 0x2000;
+                if (util_fpwrite(fd, (high ? easyflash_state_high : easyflash_state_low)->flash_data + bank * 0x2000, 0x2000, offset) < 0) {
+                    fclose(fd);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    fclose(fd);
+    return 0;
+}
+
+/* Write the changed chips into the existing .crt file. This only works if
+   the layout of the file stays the same, that is every changed chip has a
+   CHIP packet of its own, or is empty and left out by the optimizer.
+   Otherwise returns -1 and the file has to be written completely. */
+static int easyflash_crt_update(const char *filename)
+{
+    FILE *fd;
+    crt_header_t header;
+    crt_chip_header_t chip;
+    long offsets[EASYFLASH_N_BANKS][2];
+    uint8_t *data;
+    int bank;
+    int high;
+    int empty;
+
+    for (bank = 0; bank < EASYFLASH_N_BANKS; bank++) {
+        offsets[bank][0] = offsets[bank][1] = -1;
+    }
+
+    fd = crt_open(filename, &header);
+    if (fd == NULL) {
+        return -1;
+    }
+    if (header.type != CARTRIDGE_EASYFLASH) {
+        fclose(fd);
+        return -1;
+    }
+    while (crt_read_chip_header(&chip, fd) == 0) {
+        if (chip.size != 0x2000 || chip.bank >= EASYFLASH_N_BANKS) {
+            fclose(fd);
+            return -1;
+        }
+        offsets[chip.bank][(chip.start & 0x2000) ? 1 : 0] = ftell(fd);
+        if (fseek(fd, chip.size + chip.skip, SEEK_CUR) != 0) {
+            fclose(fd);
+            return -1;
+        }
+    }
+    fclose(fd);
+
+    for (bank = 0; bank < EASYFLASH_N_BANKS; bank++) {
+        for (high = 0; high < 2; high++) {
+            if (!easyflash_chip_dirty(bank, high)) {
+                continue;
+            }
+            empty = easyflash_crt_optimize && easyflash_chip_empty(bank, high);
+            if (empty && offsets[bank][high] < 0) {
+                continue;
+            }
+            if (empty || offsets[bank][high] < 0) {
+                return -1;
+            }
+        }
+    }
+
+    fd = fopen(filename, MODE_READ_WRITE);
+    if (fd == NULL) {
+        return -1;
+    }
+    for (bank = 0; bank < EASYFLASH_N_BANKS; bank++) {
+        for (high = 0; high < 2; high++) {
+            if (easyflash_chip_dirty(bank, high) && offsets[bank][high] >= 0) {
+                data = (high ? easyflash_state_high : easyflash_state_low)->flash_data + bank * 0x2000;
+                if (util_fpwrite(fd, data, 0x2000, offsets[bank][high]) < 0) {
+                    fclose(fd);
+                    return -1;
+                }
+            }
+        }
+    }
+    fclose(fd);
+    return 0;
+}
+
 /* ---------------------------------------------------------------------*/
 
 static const resource_int_t resources_int[] = {
@@ -495,6 +650,11 @@ void easyflash_config_setup(uint8_t *rawcart)
         memcpy(easyflash_state_high->flash_data + i * 0x2000, rawcart + i * 0x4000 + 0x2000, 0x2000);
     }
 
+    /* recover changes that were not written back before a crash */
+    if (easyflash_crt_write && easyflash_filename != NULL) {
+        easyflash_journal_open();
+    }
+
     /*
      * check for presence of EAPI
      */
@@ -578,7 +738,10 @@ int easyflash_crt_attach(FILE *fd, uint8_t *rawcart, const char *filename)
 void easyflash_detach(void)
 {
     if (easyflash_crt_write) {
-        easyflash_flush_image();
+        if (easyflash_flush_image() == 0) {
+            flash040core_journal_close(easyflash_state_low, 1);
+            flash040core_journal_close(easyflash_state_high, 1);
+        }
     }
     flash040core_shutdown(easyflash_state_low);
     flash040core_shutdown(easyflash_state_high);
@@ -595,13 +758,30 @@ void easyflash_detach(void)
 
 int easyflash_flush_image(void)
 {
+    int rc;
+
     if (easyflash_filename != NULL) {
+        if (!easyflash_image_dirty()) {
+            return 0;
+        }
         if (easyflash_filetype == CARTRIDGE_FILETYPE_BIN) {
-            return easyflash_bin_save(easyflash_filename);
+            rc = easyflash_bin_update(easyflash_filename);
+            if (rc < 0) {
+                rc = easyflash_bin_save(easyflash_filename);
+            }
         } else if (easyflash_filetype == CARTRIDGE_FILETYPE_CRT) {
-            return easyflash_crt_save(easyflash_filename);
+            rc = easyflash_crt_update(easyflash_filename);
+            if (rc < 0) {
+                rc = easyflash_crt_save(easyflash_filename);
+            }
+        } else {
+            return -1;
         }
-        return -1;
+        if (rc == 0) {
+            flash040core_clear_dirty(easyflash_state_low);
+            flash040core_clear_dirty(easyflash_state_high);
+        }
+        return rc;
     }
     return -2;
 }
@@ -1097,9 +1097,14 @@ static int mmc64_clockport_dump(void)
 
 static int mmc64_dump(void)
 {
+    unsigned long hits, misses, writes;
+
     mon_out("Clockport is %s.\n", mmc64_clockport_enabled ? "enabled" : "disabled");
     mon_out("Clockport mapped to $%04x.\n", (unsigned int)mmc64_hw_clockport);
     mon_out("Clockport device %s\n", clockport_device_id_to_name(clockport_device_id));
+    if (mmc_get_cache_stats(&hits, &misses, &writes)) {
+        mon_out("Card cache: %lu hits, %lu misses, %lu blocks written.\n", hits, misses, writes);
+    }
 
     return 0;
 }
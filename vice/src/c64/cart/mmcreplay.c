@@ -1911,10 +1911,15 @@ static void mmcreplay_clockport_store(uint16_t address, uint8_t byte)
 
 static int mmcreplay_dump(void)
 {
+    unsigned long hits, misses, writes;
+
     /* FIXME: incomplete */
     /* mon_out("MMC Replay registers are %s.\n", mmcr_active ? "enabled" : "disabled"); */
     mon_out("Clockport is %s.\n", mmcr_clockport_enabled ? "enabled" : "disabled");
     mon_out("Clockport device: %s.\n", clockport_device_id_to_name(clockport_device_id));
+    if (mmc_get_cache_stats(&hits, &misses, &writes)) {
+        mon_out("Card cache: %lu hits, %lu misses, %lu blocks written.\n", hits, misses, writes);
+    }
 
     return 0;
 }
@@ -477,6 +477,8 @@ static void ramlink_scan_io(void)
         }
         current = current->next;
     }
+    /* the REU range may have been changed in place */
+    io_source_dispatch_update();
     rl_scanned = 1;
 }
 
@@ -498,6 +500,7 @@ static void ramlink_restore_io(void)
     ramlink_devices_io1_georam = -1;
     ramlink_devices_io2_reu = -1;
     ramlink_devices_io2_georam = -1;
+    io_source_dispatch_update();
 }
 
 /* turn off any other IO1 resources */
@@ -64,6 +64,7 @@
 #include "machine-printer.h"
 #include "pet/petpia.h"
 #include "printer.h"
+#include "rs232drv.h"
 #include "sampler.h"
 #include "snapshot.h"
 #include "tap.h"
@@ -391,6 +392,12 @@ void printer_formfeed(unsigned int prnr)
 {
 }
 
+/* needed from runahead.c */
+int printer_is_open(void)
+{
+    return 0;
+}
+
 
 /*******************************************************************************
     rtc
@@ -722,6 +729,11 @@ void fsdevice_set_directory(char *filename, unsigned int unit)
 {
 }
 
+int fsdevice_write_channel_open(unsigned int unit)
+{
+    return 0;
+}
+
 int fsdevice_limit_namelength(vdrive_t *vdrive, uint8_t *name)
 {
     return 0;
@@ -1015,6 +1027,11 @@ void vdrive_device_shutdown(vdrive_t *vdrive)
 {
 }
 
+int vdrive_write_channel_open(vdrive_t *vdrive)
+{
+    return 0;
+}
+
 int vdrive_iec_attach(unsigned int unit, const char *name)
 {
     return 0;
@@ -1283,6 +1300,16 @@ bool driver_select_has_graphics_output(const char *drv_name)
 }
 
 
+/*******************************************************************************
+    RS232
+*******************************************************************************/
+
+/* needed from runahead.c */
+int rs232drv_is_open(void)
+{
+    return 0;
+}
+
 /*******************************************************************************
     UI
 *******************************************************************************/
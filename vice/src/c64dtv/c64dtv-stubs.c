@@ -36,6 +36,7 @@
 #include "datasette.h"
 #include "ds1307.h"
 #include "rtc-58321a.h"
+#include "rs232drv.h"
 #include "rsuser.h"
 #include "c64parallel.h"
 #include "c64cart.h"
@@ -329,6 +330,10 @@ int rsuser_cmdline_options_init(void)
 {
     return -1;
 }
+int rs232drv_is_open(void)
+{
+    return 0;
+}
 int parallel_cable_cpu_resources_init(void)
 {
     return -1;
@@ -198,6 +198,15 @@ static const trap_t c64_serial_traps[] = {
         c64memrom_trap_read,
         c64memrom_trap_store
     },
+    {
+        "SerialLoad",
+        0xF4F3,
+        0xF528,
+        { 0xA9, 0xFD, 0x25 },
+        serial_trap_load,
+        c64memrom_trap_read,
+        c64memrom_trap_store
+    },
     {
         "SerialReady",
         0xEEA9,
@@ -692,7 +701,7 @@ int machine_specific_init(void)
         return -1;
     }
 
-    serial_trap_init(0xa4);
+    serial_trap_init(0xa4, 0xae);
     serial_iec_bus_init();
 
     gfxoutput_init();
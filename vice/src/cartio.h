@@ -280,6 +280,14 @@ typedef struct io_source_detach_s {
 io_source_list_t *io_source_register(io_source_t *device);
 void io_source_unregister(io_source_list_t *device);
 
+/* Each I/O page has a per-address dispatch table. An entry holds the only
+   device covering that address, NULL if no device covers it, or a 'shared'
+   marker if several devices do, in which case the source list is walked with
+   full collision handling. The tables are rebuilt when a device is registered
+   or unregistered; code that changes the address range of a registered device
+   in place must call io_source_dispatch_update() itself. */
+void io_source_dispatch_update(void);
+
 void cartio_shutdown(void);
 
 void c64io_vicii_init(void);
@@ -74,6 +74,19 @@ static io_source_list_t cbm2io_dd00_head = { NULL, NULL, NULL };
 static io_source_list_t cbm2io_de00_head = { NULL, NULL, NULL };
 static io_source_list_t cbm2io_df00_head = { NULL, NULL, NULL };
 
+/* per-address dispatch tables, one for each I/O page, see cartio.h */
+static io_source_t io_source_shared;
+#define IO_SOURCE_SHARED (&io_source_shared)
+
+static io_source_t *cbm2io_d800_dispatch[0x100];
+static io_source_t *cbm2io_d900_dispatch[0x100];
+static io_source_t *cbm2io_da00_dispatch[0x100];
+static io_source_t *cbm2io_db00_dispatch[0x100];
+static io_source_t *cbm2io_dc00_dispatch[0x100];
+static io_source_t *cbm2io_dd00_dispatch[0x100];
+static io_source_t *cbm2io_de00_dispatch[0x100];
+static io_source_t *cbm2io_df00_dispatch[0x100];
+
 static void io_source_detach(io_source_detach_t *source)
 {
     switch (source->det_id) {
@@ -288,9 +301,10 @@ static void io_source_log_collisions(uint16_t addr, int amount, io_source_list_t
     }
 }
 
-static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
+static inline uint8_t io_read(io_source_list_t *list, io_source_t **dispatch, uint16_t addr)
 {
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0xff];
     int io_source_counter = 0;
     int io_source_valid = 0;
     uint8_t realval = 0;
@@ -298,6 +312,18 @@ static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
     uint8_t firstval = 0;
     unsigned int lowest_order = 0xffffffff;
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->read != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            retval = device->read((uint16_t)(addr & device->address_mask));
+            if (device->io_source_valid) {
+                return retval;
+            }
+        }
+        return read_unused(addr);
+    }
+
     while (current) {
         if (current->device->read != NULL) {
             if ((addr >= current->device->start_address) && (addr <= current->device->end_address)) {
@@ -384,13 +410,23 @@ static inline uint8_t io_peek(io_source_list_t *list, uint16_t addr)
     return read_unused(addr);
 }
 
-static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value)
+static inline void io_store(io_source_list_t *list, io_source_t **dispatch, uint16_t addr, uint8_t value)
 {
     int writes = 0;
     uint16_t addy = 0xffff;
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0xff];
     void (*store)(uint16_t address, uint8_t data) = NULL;
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->store != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            device->store((uint16_t)(addr & device->address_mask), value);
+        }
+        return;
+    }
+
     while (current) {
         if (current->device->store != NULL) {
             if (addr >= current->device->start_address && addr <= current->device->end_address) {
@@ -414,6 +450,43 @@ static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value
 
 /* ---------------------------------------------------------------------------------------------------------- */
 
+static void io_source_dispatch_build(io_source_list_t *list, io_source_t **dispatch, unsigned int base)
+{
+    io_source_list_t *current = list->next;
+    unsigned int start;
+    unsigned int end;
+    unsigned int i;
+
+    memset(dispatch, 0, sizeof(io_source_t *) * 0x100);
+
+    while (current) {
+        start = current->device->start_address;
+        end = current->device->end_address;
+        if (start < base) {
+            start = base;
+        }
+        if (end > base + 0xff) {
+            end = base + 0xff;
+        }
+        for (i = start; i <= end; i++) {
+            dispatch[i - base] = dispatch[i - base] ? IO_SOURCE_SHARED : current->device;
+        }
+        current = current->next;
+    }
+}
+
+void io_source_dispatch_update(void)
+{
+    io_source_dispatch_build(&cbm2io_d800_head, cbm2io_d800_dispatch, 0xd800);
+    io_source_dispatch_build(&cbm2io_d900_head, cbm2io_d900_dispatch, 0xd900);
+    io_source_dispatch_build(&cbm2io_da00_head, cbm2io_da00_dispatch, 0xda00);
+    io_source_dispatch_build(&cbm2io_db00_head, cbm2io_db00_dispatch, 0xdb00);
+    io_source_dispatch_build(&cbm2io_dc00_head, cbm2io_dc00_dispatch, 0xdc00);
+    io_source_dispatch_build(&cbm2io_dd00_head, cbm2io_dd00_dispatch, 0xdd00);
+    io_source_dispatch_build(&cbm2io_de00_head, cbm2io_de00_dispatch, 0xde00);
+    io_source_dispatch_build(&cbm2io_df00_head, cbm2io_df00_dispatch, 0xdf00);
+}
+
 io_source_list_t *io_source_register(io_source_t *device)
 {
     io_source_list_t *current = NULL;
@@ -465,6 +538,8 @@ io_source_list_t *io_source_register(io_source_t *device)
     retval->next = NULL;
     retval->device->order = order++;
 
+    io_source_dispatch_update();
+
     return retval;
 }
 
@@ -489,6 +564,8 @@ void io_source_unregister(io_source_list_t *device)
     }
 
     lib_free(device);
+
+    io_source_dispatch_update();
 }
 
 void cartio_shutdown(void)
@@ -554,7 +631,7 @@ void cartio_set_highest_order(unsigned int nr)
 uint8_t cbm2io_d800_read(uint16_t addr)
 {
     DBGRW(("IO: io-d800 r %04x\n", addr));
-    return io_read(&cbm2io_d800_head, addr);
+    return io_read(&cbm2io_d800_head, cbm2io_d800_dispatch, addr);
 }
 
 uint8_t cbm2io_d800_peek(uint16_t addr)
@@ -566,13 +643,13 @@ uint8_t cbm2io_d800_peek(uint16_t addr)
 void cbm2io_d800_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d800 w %04x %02x\n", addr, value));
-    io_store(&cbm2io_d800_head, addr, value);
+    io_store(&cbm2io_d800_head, cbm2io_d800_dispatch, addr, value);
 }
 
 uint8_t cbm2io_d900_read(uint16_t addr)
 {
     DBGRW(("IO: io-d900 r %04x\n", addr));
-    return io_read(&cbm2io_d900_head, addr);
+    return io_read(&cbm2io_d900_head, cbm2io_d900_dispatch, addr);
 }
 
 uint8_t cbm2io_d900_peek(uint16_t addr)
@@ -584,13 +661,13 @@ uint8_t cbm2io_d900_peek(uint16_t addr)
 void cbm2io_d900_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d900 w %04x %02x\n", addr, value));
-    io_store(&cbm2io_d900_head, addr, value);
+    io_store(&cbm2io_d900_head, cbm2io_d900_dispatch, addr, value);
 }
 
 uint8_t cbm2io_da00_read(uint16_t addr)
 {
     DBGRW(("IO: io-da00 r %04x\n", addr));
-    return io_read(&cbm2io_da00_head, addr);
+    return io_read(&cbm2io_da00_head, cbm2io_da00_dispatch, addr);
 }
 
 uint8_t cbm2io_da00_peek(uint16_t addr)
@@ -602,13 +679,13 @@ uint8_t cbm2io_da00_peek(uint16_t addr)
 void cbm2io_da00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-da00 w %04x %02x\n", addr, value));
-    io_store(&cbm2io_da00_head, addr, value);
+    io_store(&cbm2io_da00_head, cbm2io_da00_dispatch, addr, value);
 }
 
 uint8_t cbm2io_db00_read(uint16_t addr)
 {
     DBGRW(("IO: io-db00 r %04x\n", addr));
-    return io_read(&cbm2io_db00_head, addr);
+    return io_read(&cbm2io_db00_head, cbm2io_db00_dispatch, addr);
 }
 
 uint8_t cbm2io_db00_peek(uint16_t addr)
@@ -620,13 +697,13 @@ uint8_t cbm2io_db00_peek(uint16_t addr)
 void cbm2io_db00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-db00 w %04x %02x\n", addr, value));
-    io_store(&cbm2io_db00_head, addr, value);
+    io_store(&cbm2io_db00_head, cbm2io_db00_dispatch, addr, value);
 }
 
 uint8_t cbm2io_dc00_read(uint16_t addr)
 {
     DBGRW(("IO: io-dc00 r %04x\n", addr));
-    return io_read(&cbm2io_dc00_head, addr);
+    return io_read(&cbm2io_dc00_head, cbm2io_dc00_dispatch, addr);
 }
 
 uint8_t cbm2io_dc00_peek(uint16_t addr)
@@ -638,13 +715,13 @@ uint8_t cbm2io_dc00_peek(uint16_t addr)
 void cbm2io_dc00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-dc00 w %04x %02x\n", addr, value));
-    io_store(&cbm2io_dc00_head, addr, value);
+    io_store(&cbm2io_dc00_head, cbm2io_dc00_dispatch, addr, value);
 }
 
 uint8_t cbm2io_dd00_read(uint16_t addr)
 {
     DBGRW(("IO: io-dd00 r %04x\n", addr));
-    return io_read(&cbm2io_dd00_head, addr);
+    return io_read(&cbm2io_dd00_head, cbm2io_dd00_dispatch, addr);
 }
 
 uint8_t cbm2io_dd00_peek(uint16_t addr)
@@ -656,13 +733,13 @@ uint8_t cbm2io_dd00_peek(uint16_t addr)
 void cbm2io_dd00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-dd00 w %04x %02x\n", addr, value));
-    io_store(&cbm2io_dd00_head, addr, value);
+    io_store(&cbm2io_dd00_head, cbm2io_dd00_dispatch, addr, value);
 }
 
 uint8_t cbm2io_de00_read(uint16_t addr)
 {
     DBGRW(("IO: io-de00 r %04x\n", addr));
-    return io_read(&cbm2io_de00_head, addr);
+    return io_read(&cbm2io_de00_head, cbm2io_de00_dispatch, addr);
 }
 
 uint8_t cbm2io_de00_peek(uint16_t addr)
@@ -674,13 +751,13 @@ uint8_t cbm2io_de00_peek(uint16_t addr)
 void cbm2io_de00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-de00 w %04x %02x\n", addr, value));
-    io_store(&cbm2io_de00_head, addr, value);
+    io_store(&cbm2io_de00_head, cbm2io_de00_dispatch, addr, value);
 }
 
 uint8_t cbm2io_df00_read(uint16_t addr)
 {
     DBGRW(("IO: io-df00 r %04x\n", addr));
-    return io_read(&cbm2io_df00_head, addr);
+    return io_read(&cbm2io_df00_head, cbm2io_df00_dispatch, addr);
 }
 
 uint8_t cbm2io_df00_peek(uint16_t addr)
@@ -692,7 +769,7 @@ uint8_t cbm2io_df00_peek(uint16_t addr)
 void cbm2io_df00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-df00 w %04x %02x\n", addr, value));
-    io_store(&cbm2io_df00_head, addr, value);
+    io_store(&cbm2io_df00_head, cbm2io_df00_dispatch, addr, value);
 }
 
 /* ---------------------------------------------------------------------------------------------------------- */
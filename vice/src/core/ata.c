@@ -37,6 +37,7 @@
 #include "archdep.h"
 #include "log.h"
 #include "ata.h"
+#include "blockcache.h"
 #include "snapshot.h"
 #include "types.h"
 #include "util.h"
@@ -79,6 +80,8 @@ struct ata_drive_s {
     int bufp;
     uint8_t *buffer;
     FILE *file;
+    blockcache_t *cache;
+    off_t block; /* next sector to transfer */
     char *filename;
     char *myname;
     ata_drive_geometry_t geometry;
@@ -247,9 +250,7 @@ static int seek_sector(ata_drive_t *drv)
     drv->busy |= 2;
     alarm_set(drv->head_alarm, maincpu_clk + (CLOCK)(abs(drv->pos - lba) * drv->seek_time / drv->geometry.size));
     ata_change_power_mode(drv, 0xff);
-    if (archdep_fseeko(drv->file, (off_t)lba * drv->sector_size, SEEK_SET)) {
-        drv->error = drv->atapi ? 0x54 : ATA_IDNF;
-    }
+    drv->block = lba;
     drv->pos = lba;
     return drv->error;
 }
@@ -282,16 +283,12 @@ static int read_sector(ata_drive_t *drv)
         return drv->error;
     }
 
-    clearerr(drv->file);
-    if (fread(drv->buffer, drv->sector_size, 1, drv->file) != 1) {
-        memset(drv->buffer, 0, drv->sector_size);
-    }
-
-    if (ferror(drv->file)) {
+    if (blockcache_read_block(drv->cache, drv->block, drv->buffer) < 0) {
         ata_set_command_block(drv);
         drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
         drv->cmd = 0x00;
     } else {
+        drv->block++;
         drv->pos++;
         drv->bufp = 0;
     }
@@ -324,21 +321,14 @@ static int write_sector(ata_drive_t *drv)
         return drv->error;
     }
 
-    if (fwrite(drv->buffer, 1, drv->sector_size, drv->file) != (size_t)drv->sector_size) {
+    if (blockcache_write_block(drv->cache, drv->block, drv->buffer) < 0) {
         ata_set_command_block(drv);
         drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
         drv->cmd = 0x00;
     } else {
+        drv->block++;
         drv->pos++;
     }
-
-    if (!drv->wcache) {
-        if (fflush(drv->file)) {
-            ata_set_command_block(drv);
-            drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
-            drv->cmd = 0x00;
-        }
-    }
     return drv->error;
 }
 
@@ -726,7 +716,7 @@ static void ata_execute_command(ata_drive_t *drv, uint8_t value)
             }
             debug((drv->log, "FLUSH CACHE"));
             if (drv->file) {
-                if (fflush(drv->file)) {
+                if (blockcache_flush(drv->cache)) {
                     drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
                 }
             }
@@ -831,7 +821,7 @@ static void ata_execute_command(ata_drive_t *drv, uint8_t value)
                     debug((drv->log, "SET DISABLE WRITE CACHE"));
                     drv->wcache = 0;
                     if (drv->file) {
-                        fflush(drv->file);
+                        blockcache_flush(drv->cache);
                     }
                     return;
                 case 0x99:
@@ -1193,7 +1183,9 @@ void ata_register_store(ata_drive_t *drv, uint16_t addr, uint16_t value)
                                     drv->bufp = 0;
                                     return;
                                 }
-                                if (!drv->file || fflush(drv->file)) {
+                                /* with the write cache enabled the blocks stay
+                                   cached until flushed or evicted */
+                                if (!drv->file || (!drv->wcache && blockcache_flush(drv->cache))) {
                                     drv->error = drv->atapi ? 0x54 : (ATA_UNC | ATA_ABRT);
                                     break;
                                 }
@@ -1258,6 +1250,8 @@ void ata_register_store(ata_drive_t *drv, uint16_t addr, uint16_t value)
 void ata_image_attach(ata_drive_t *drv, char *filename, ata_drive_type_t type, ata_drive_geometry_t geometry)
 {
     if (drv->file != NULL) {
+        blockcache_destroy(drv->cache);
+        drv->cache = NULL;
         fclose(drv->file);
         drv->file = NULL;
     }
@@ -1307,6 +1301,9 @@ void ata_image_attach(ata_drive_t *drv, char *filename, ata_drive_type_t type, a
     }
 
     if (drv->file) {
+        /* the sector size depends on the drive type set up above */
+        drv->cache = blockcache_new(drv->file, drv->sector_size, drv->myname);
+        drv->block = 0;
         if (drv->atapi) {
             log_message(drv->log, "Attached `%s' %u sectors total.",
                     drv->filename, (unsigned int)drv->geometry.size);
@@ -1327,6 +1324,8 @@ void ata_image_attach(ata_drive_t *drv, char *filename, ata_drive_type_t type, a
 void ata_image_detach(ata_drive_t *drv)
 {
     if (drv->file != NULL) {
+        blockcache_destroy(drv->cache);
+        drv->cache = NULL;
         fclose(drv->file);
         drv->file = NULL;
         log_message(drv->log, "Detached.");
@@ -1396,10 +1395,9 @@ int ata_snapshot_write_module(ata_drive_t *drv, snapshot_t *s)
         standby_clk = drv->standby_alarm->context->pending_alarms[drv->standby_alarm->pending_idx].clk;
     }
     if (drv->file) {
-        pos = archdep_ftello(drv->file);
-        if (pos < 0) {
-            pos = 0;
-        }
+        /* make sure the image on disk is up to date */
+        blockcache_flush(drv->cache);
+        pos = drv->block;
     }
 
     SMW_STR(m, drv->filename);
@@ -1425,7 +1423,7 @@ int ata_snapshot_write_module(ata_drive_t *drv, snapshot_t *s)
     SMW_B(m, (uint8_t)drv->heads);
     SMW_B(m, (uint8_t)drv->sectors);
     SMW_DW(m, drv->pos);
-    SMW_DW(m, (uint32_t)(pos / drv->sector_size));
+    SMW_DW(m, (uint32_t)pos);
     SMW_B(m, (uint8_t)drv->wcache);
     SMW_B(m, (uint8_t)drv->lookahead);
     SMW_B(m, (uint8_t)drv->busy);
@@ -1566,9 +1564,7 @@ int ata_snapshot_read_module(ata_drive_t *drv, snapshot_t *s)
         alarm_unset(drv->standby_alarm);
     }
 
-    if (drv->file) {
-        archdep_fseeko(drv->file, (off_t)pos * drv->sector_size, SEEK_SET);
-    }
+    drv->block = pos;
     if (!drv->atapi) { /* atapi supports disc change events */
         drv->readonly = 1; /* make sure for ata that there's no filesystem corruption */
     }
@@ -0,0 +1,554 @@
+/*
+ * blockcache.c - Block cache for hard disk and memory card images
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The image is accessed through a cache of fixed size blocks that are
+   replaced in least recently used order. A miss that continues a sequential
+   run of accesses reads a number of blocks ahead with a single fread.
+   Writes only mark the cached block dirty, dirty blocks are sorted and
+   written back in runs of consecutive blocks when a dirty block gets
+   evicted and when the cache is flushed. */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "blockcache.h"
+#include "lib.h"
+#include "log.h"
+#include "types.h"
+
+/* #define DEBUG_BLOCKCACHE */
+
+#ifdef DEBUG_BLOCKCACHE
+#define LOG(x)  log_debug x
+#else
+#define LOG(x)
+#endif
+
+#define BLOCKCACHE_BYTES        0x40000 /* total size of the cached data */
+#define BLOCKCACHE_MIN_ENTRIES  64
+#define BLOCKCACHE_READAHEAD    32      /* blocks, also the longest write run */
+
+typedef struct blockcache_entry_s {
+    off_t block;
+    int prev, next;     /* LRU list, most recently used first */
+    int hash_next;
+    int valid;
+    int dirty;
+} blockcache_entry_t;
+
+typedef struct blockcache_sort_s {
+    off_t block;
+    int index;
+} blockcache_sort_t;
+
+struct blockcache_s {
+    FILE *file;
+    char *name;
+    unsigned int block_size;
+    off_t size;         /* in bytes, including data that is only cached so far */
+
+    int entries;
+    blockcache_entry_t *entry;
+    uint8_t *data;
+    int *hash;
+    unsigned int hash_mask;
+    int lru_head, lru_tail;
+
+    uint8_t *readbuf;   /* BLOCKCACHE_READAHEAD blocks each */
+    uint8_t *writebuf;
+    blockcache_sort_t *sortbuf;
+    off_t last_block;
+
+    int dirty_blocks;
+
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long writes;
+};
+
+/* dirty blocks in all caches */
+static int blockcache_dirty_total = 0;
+
+static unsigned int blockcache_hash(blockcache_t *bc, off_t block)
+{
+    return (unsigned int)(block ^ (block >> 11)) & bc->hash_mask;
+}
+
+static uint8_t *blockcache_data(blockcache_t *bc, int i)
+{
+    return bc->data + (size_t)i * bc->block_size;
+}
+
+static void blockcache_set_dirty(blockcache_t *bc, int i, int dirty)
+{
+    if (bc->entry[i].dirty != dirty) {
+        bc->entry[i].dirty = dirty;
+        bc->dirty_blocks += dirty ? 1 : -1;
+        blockcache_dirty_total += dirty ? 1 : -1;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void lru_unlink(blockcache_t *bc, int i)
+{
+    blockcache_entry_t *e = &bc->entry[i];
+
+    if (e->prev >= 0) {
+        bc->entry[e->prev].next = e->next;
+    } else {
+        bc->lru_head = e->next;
+    }
+    if (e->next >= 0) {
+        bc->entry[e->next].prev = e->prev;
+    } else {
+        bc->lru_tail = e->prev;
+    }
+}
+
+static void lru_push_front(blockcache_t *bc, int i)
+{
+    blockcache_entry_t *e = &bc->entry[i];
+
+    e->prev = -1;
+    e->next = bc->lru_head;
+    if (bc->lru_head >= 0) {
+        bc->entry[bc->lru_head].prev = i;
+    } else {
+        bc->lru_tail = i;
+    }
+    bc->lru_head = i;
+}
+
+static void lru_touch(blockcache_t *bc, int i)
+{
+    if (bc->lru_head != i) {
+        lru_unlink(bc, i);
+        lru_push_front(bc, i);
+    }
+}
+
+static int hash_find(blockcache_t *bc, off_t block)
+{
+    int i = bc->hash[blockcache_hash(bc, block)];
+
+    while (i >= 0 && bc->entry[i].block != block) {
+        i = bc->entry[i].hash_next;
+    }
+    return i;
+}
+
+static void hash_insert(blockcache_t *bc, int i)
+{
+    unsigned int h = blockcache_hash(bc, bc->entry[i].block);
+
+    bc->entry[i].hash_next = bc->hash[h];
+    bc->hash[h] = i;
+}
+
+static void hash_remove(blockcache_t *bc, int i)
+{
+    int *p = &bc->hash[blockcache_hash(bc, bc->entry[i].block)];
+
+    while (*p >= 0) {
+        if (*p == i) {
+            *p = bc->entry[i].hash_next;
+            return;
+        }
+        p = &bc->entry[*p].hash_next;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* write 'count' blocks from the write buffer to 'block', without padding the
+   image to a multiple of the block size */
+static int blockcache_write_run(blockcache_t *bc, off_t block, int count)
+{
+    off_t offset = block * bc->block_size;
+    size_t len = (size_t)count * bc->block_size;
+
+    if (offset + (off_t)len > bc->size) {
+        len = (size_t)(bc->size - offset);
+    }
+
+    if (archdep_fseeko(bc->file, offset, SEEK_SET) != 0
+        || fwrite(bc->writebuf, 1, len, bc->file) != len) {
+        log_error(LOG_DEFAULT, "%s: could not write block %lu.", bc->name, (unsigned long)block);
+        return -1;
+    }
+    bc->writes += count;
+    return 0;
+}
+
+static int blockcache_sort_compare(const void *a, const void *b)
+{
+    off_t x = ((const blockcache_sort_t *)a)->block;
+    off_t y = ((const blockcache_sort_t *)b)->block;
+
+    return (x > y) - (x < y);
+}
+
+/* returns the number of blocks written, or -1 on error */
+static int blockcache_writeback(blockcache_t *bc)
+{
+    int i, n = 0, start, count, ret = 0;
+
+    for (i = bc->lru_head; i >= 0; i = bc->entry[i].next) {
+        if (bc->entry[i].dirty) {
+            bc->sortbuf[n].block = bc->entry[i].block;
+            bc->sortbuf[n].index = i;
+            n++;
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+    qsort(bc->sortbuf, (size_t)n, sizeof(blockcache_sort_t), blockcache_sort_compare);
+
+    start = 0;
+    while (start < n) {
+        count = 1;
+        while (start + count < n && count < BLOCKCACHE_READAHEAD
+               && bc->sortbuf[start + count].block == bc->sortbuf[start].block + count) {
+            count++;
+        }
+        for (i = 0; i < count; i++) {
+            memcpy(bc->writebuf + (size_t)i * bc->block_size,
+                   blockcache_data(bc, bc->sortbuf[start + i].index), bc->block_size);
+        }
+        if (blockcache_write_run(bc, bc->sortbuf[start].block, count) < 0) {
+            ret = -1;
+        } else {
+            for (i = 0; i < count; i++) {
+                blockcache_set_dirty(bc, bc->sortbuf[start + i].index, 0);
+            }
+        }
+        start += count;
+    }
+    return (ret < 0) ? ret : n;
+}
+
+/* get an entry for 'block', reusing the least recently used one */
+static int blockcache_alloc(blockcache_t *bc, off_t block)
+{
+    int i = bc->lru_tail;
+
+    if (bc->entry[i].dirty) {
+        /* write back everything, so neighbouring blocks go out together */
+        if (blockcache_writeback(bc) < 0) {
+            return -1;
+        }
+    }
+    if (bc->entry[i].valid) {
+        hash_remove(bc, i);
+    }
+    bc->entry[i].block = block;
+    bc->entry[i].valid = 1;
+    blockcache_set_dirty(bc, i, 0);
+    hash_insert(bc, i);
+    lru_touch(bc, i);
+    return i;
+}
+
+/* read 'count' blocks starting at 'block' into the cache, blocks that are
+   cached already are left alone as they may be dirty */
+static int blockcache_fill(blockcache_t *bc, off_t block, int count)
+{
+    off_t offset = block * bc->block_size;
+    off_t avail = (bc->size - offset + bc->block_size - 1) / bc->block_size;
+    size_t len;
+    int i, n, first = -1;
+
+    if (count > avail) {
+        count = (int)avail;
+    }
+    /* do not read over blocks that are cached already */
+    for (n = 1; n < count; n++) {
+        if (hash_find(bc, block + n) >= 0) {
+            break;
+        }
+    }
+    count = n;
+
+    if (archdep_fseeko(bc->file, offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    clearerr(bc->file);
+    len = fread(bc->readbuf, 1, (size_t)count * bc->block_size, bc->file);
+    if (ferror(bc->file)) {
+        return -1;
+    }
+    /* blocks not (or only partially) in the file yet are padded with zeroes */
+    memset(bc->readbuf + len, 0, (size_t)count * bc->block_size - len);
+
+    /* insert backwards so the requested block ends up most recently used */
+    for (n = count - 1; n >= 0; n--) {
+        i = blockcache_alloc(bc, block + n);
+        if (i < 0) {
+            return -1;
+        }
+        memcpy(blockcache_data(bc, i), bc->readbuf + (size_t)n * bc->block_size, bc->block_size);
+        first = i;
+    }
+    return first;
+}
+
+/* return the entry holding 'block', loading it from the image if 'load' is
+   set and zero filling it otherwise, -1 on error */
+static int blockcache_lookup(blockcache_t *bc, off_t block, int load)
+{
+    int i = hash_find(bc, block);
+
+    if (i >= 0) {
+        bc->hits++;
+        lru_touch(bc, i);
+    } else {
+        bc->misses++;
+        if (load) {
+            /* read ahead when continuing a sequential run */
+            i = blockcache_fill(bc, block, (block == bc->last_block + 1) ? BLOCKCACHE_READAHEAD : 1);
+        } else {
+            i = blockcache_alloc(bc, block);
+            if (i >= 0) {
+                memset(blockcache_data(bc, i), 0, bc->block_size);
+            }
+        }
+    }
+    bc->last_block = block;
+    return i;
+}
+
+/* ------------------------------------------------------------------------- */
+
+blockcache_t *blockcache_new(FILE *file, unsigned int block_size, const char *name)
+{
+    blockcache_t *bc;
+    int i;
+
+    bc = lib_calloc(1, sizeof(blockcache_t));
+    bc->file = file;
+    bc->name = lib_strdup(name);
+    bc->block_size = block_size;
+    bc->size = archdep_file_size(file);
+    if (bc->size < 0) {
+        bc->size = 0;
+    }
+
+    bc->entries = BLOCKCACHE_BYTES / block_size;
+    if (bc->entries < BLOCKCACHE_MIN_ENTRIES) {
+        bc->entries = BLOCKCACHE_MIN_ENTRIES;
+    }
+    bc->hash_mask = 1;
+    while (bc->hash_mask < (unsigned int)bc->entries) {
+        bc->hash_mask <<= 1;
+    }
+    bc->hash = lib_malloc((bc->hash_mask << 1) * sizeof(int));
+    bc->hash_mask = (bc->hash_mask << 1) - 1;
+    for (i = 0; i <= (int)bc->hash_mask; i++) {
+        bc->hash[i] = -1;
+    }
+
+    bc->entry = lib_calloc((size_t)bc->entries, sizeof(blockcache_entry_t));
+    bc->data = lib_malloc((size_t)bc->entries * block_size);
+    bc->readbuf = lib_malloc((size_t)BLOCKCACHE_READAHEAD * block_size);
+    bc->writebuf = lib_malloc((size_t)BLOCKCACHE_READAHEAD * block_size);
+    bc->sortbuf = lib_malloc((size_t)bc->entries * sizeof(blockcache_sort_t));
+    bc->lru_head = bc->lru_tail = -1;
+    for (i = 0; i < bc->entries; i++) {
+        lru_push_front(bc, i);
+    }
+    bc->last_block = -2;
+
+    return bc;
+}
+
+void blockcache_destroy(blockcache_t *bc)
+{
+    if (bc == NULL) {
+        return;
+    }
+
+    blockcache_flush(bc);
+    /* blocks that could not be written back are lost */
+    blockcache_dirty_total -= bc->dirty_blocks;
+    log_message(LOG_DEFAULT, "%s: block cache %lu hits, %lu misses, %lu blocks written.",
+                bc->name, bc->hits, bc->misses, bc->writes);
+
+    lib_free(bc->sortbuf);
+    lib_free(bc->writebuf);
+    lib_free(bc->readbuf);
+    lib_free(bc->data);
+    lib_free(bc->entry);
+    lib_free(bc->hash);
+    lib_free(bc->name);
+    lib_free(bc);
+}
+
+FILE *blockcache_get_file(blockcache_t *bc)
+{
+    return bc->file;
+}
+
+off_t blockcache_get_size(blockcache_t *bc)
+{
+    return bc->size;
+}
+
+void blockcache_get_stats(blockcache_t *bc, unsigned long *hits, unsigned long *misses, unsigned long *writes)
+{
+    *hits = bc->hits;
+    *misses = bc->misses;
+    *writes = bc->writes;
+}
+
+int blockcache_read_block(blockcache_t *bc, off_t block, uint8_t *data)
+{
+    int i;
+
+    if (block < 0 || block * bc->block_size >= bc->size) {
+        memset(data, 0, bc->block_size);
+        return 1;
+    }
+
+    i = blockcache_lookup(bc, block, 1);
+    if (i < 0) {
+        LOG((LOG_DEFAULT, "%s: could not read block %lu", bc->name, (unsigned long)block));
+        return -1;
+    }
+    memcpy(data, blockcache_data(bc, i), bc->block_size);
+    return 0;
+}
+
+int blockcache_write_block(blockcache_t *bc, off_t block, const uint8_t *data)
+{
+    int i;
+
+    if (block < 0) {
+        return -1;
+    }
+
+    i = blockcache_lookup(bc, block, 0);
+    if (i < 0) {
+        return -1;
+    }
+    memcpy(blockcache_data(bc, i), data, bc->block_size);
+    blockcache_set_dirty(bc, i, 1);
+    if ((block + 1) * bc->block_size > bc->size) {
+        bc->size = (block + 1) * bc->block_size;
+    }
+    return 0;
+}
+
+size_t blockcache_read(blockcache_t *bc, off_t offset, uint8_t *data, size_t len)
+{
+    size_t done = 0;
+    size_t chunk;
+    unsigned int pos;
+    int i;
+
+    if (offset < 0 || offset >= bc->size) {
+        return 0;
+    }
+    if (offset + (off_t)len > bc->size) {
+        len = (size_t)(bc->size - offset);
+    }
+
+    while (done < len) {
+        i = blockcache_lookup(bc, offset / bc->block_size, 1);
+        if (i < 0) {
+            break;
+        }
+        pos = (unsigned int)(offset % bc->block_size);
+        chunk = bc->block_size - pos;
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        memcpy(data + done, blockcache_data(bc, i) + pos, chunk);
+        done += chunk;
+        offset += chunk;
+    }
+    return done;
+}
+
+int blockcache_write(blockcache_t *bc, off_t offset, const uint8_t *data, size_t len)
+{
+    off_t block;
+    size_t chunk;
+    unsigned int pos;
+    int load;
+    int i;
+
+    if (offset < 0) {
+        return -1;
+    }
+
+    while (len > 0) {
+        block = offset / bc->block_size;
+        pos = (unsigned int)(offset % bc->block_size);
+        chunk = bc->block_size - pos;
+        if (chunk > len) {
+            chunk = len;
+        }
+        /* partially written blocks inside the image need their old contents */
+        load = (chunk != bc->block_size) && (block * bc->block_size < bc->size);
+        i = blockcache_lookup(bc, block, load);
+        if (i < 0) {
+            return -1;
+        }
+        memcpy(blockcache_data(bc, i) + pos, data, chunk);
+        blockcache_set_dirty(bc, i, 1);
+        data += chunk;
+        offset += chunk;
+        len -= chunk;
+        if (offset > bc->size) {
+            bc->size = offset;
+        }
+    }
+    return 0;
+}
+
+/* Check if any cache holds changes that are not in the image yet */
+int blockcache_any_dirty(void)
+{
+    return blockcache_dirty_total > 0;
+}
+
+int blockcache_flush(blockcache_t *bc)
+{
+    int ret;
+
+    if (bc == NULL) {
+        return 0;
+    }
+
+    ret = blockcache_writeback(bc);
+    if (ret > 0 && fflush(bc->file) != 0) {
+        ret = -1;
+    }
+    return (ret < 0) ? -1 : 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * blockcache.h - Block cache for hard disk and memory card images
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_BLOCKCACHE_H
+#define VICE_BLOCKCACHE_H
+
+#include "vice.h"
+
+/* required for off_t on some platforms */
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#include <stdio.h>
+
+#include "types.h"
+
+struct blockcache_s;
+typedef struct blockcache_s blockcache_t;
+
+/* The cache does not own the file, it has to be destroyed (which writes
+   back dirty blocks) before the file is closed. */
+blockcache_t *blockcache_new(FILE *file, unsigned int block_size, const char *name);
+void blockcache_destroy(blockcache_t *bc);
+
+FILE *blockcache_get_file(blockcache_t *bc);
+off_t blockcache_get_size(blockcache_t *bc);
+void blockcache_get_stats(blockcache_t *bc, unsigned long *hits, unsigned long *misses, unsigned long *writes);
+
+/* whole blocks, returns 0 on success, 1 if the block is beyond the end of
+   the image (data is zero filled) and -1 on error */
+int blockcache_read_block(blockcache_t *bc, off_t block, uint8_t *data);
+int blockcache_write_block(blockcache_t *bc, off_t block, const uint8_t *data);
+
+/* byte ranges, read returns the number of bytes that were inside the image */
+size_t blockcache_read(blockcache_t *bc, off_t offset, uint8_t *data, size_t len);
+int blockcache_write(blockcache_t *bc, off_t offset, const uint8_t *data, size_t len);
+
+int blockcache_flush(blockcache_t *bc);
+int blockcache_any_dirty(void);
+
+#endif
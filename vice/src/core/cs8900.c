@@ -43,6 +43,7 @@
 #include "lib.h"
 #include "log.h"
 #include "monitor.h"
+#include "rawnet.h"
 #include "rawnetarch.h"
 #include "resources.h"
 #include "snapshot.h"
@@ -358,7 +359,7 @@ void cs8900_reset(void)
     assert(cs8900);
     assert(cs8900_packetpage);
 
-    rawnet_arch_pre_reset();
+    rawnet_pre_reset();
 
     /* initialize visible IO register and PacketPage registers */
     memset(cs8900, 0, CS8900_COUNT_IO_REGISTER);
@@ -420,7 +421,7 @@ void cs8900_reset(void)
     cs8900_set_transmitter(0);
     cs8900_set_receiver(0);
 
-    rawnet_arch_post_reset();
+    rawnet_post_reset();
 
     log_message(cs8900_log, "CS8900a rev.D reset");
 }
@@ -459,7 +460,7 @@ int cs8900_activate(const char *net_interface)
     log_message(cs8900_log, "\tcs8900 at $%08X, cs8900_packetpage at $%08X", cs8900, cs8900_packetpage);
 #endif
 
-    if (!rawnet_arch_activate(net_interface)) {
+    if (!rawnet_activate(net_interface)) {
         lib_free(cs8900_packetpage);
         lib_free(cs8900);
         cs8900 = NULL;
@@ -480,7 +481,7 @@ int cs8900_deactivate(void)
 
     assert(cs8900 && cs8900_packetpage);
 
-    rawnet_arch_deactivate();
+    rawnet_deactivate();
 
     lib_free(cs8900);
     cs8900 = NULL;
@@ -643,92 +644,76 @@ static uint16_t cs8900_receive(void)
     int rx_ok;
     int correct_mac;
     int broadcast;
-    int multicast = 0; /* avoid warning */
+    int multicast;
     int crc_error;
 
     int newframe;
 
-    int ready;
+    len = MAX_RXLENGTH;
 
-    do {
-        len = MAX_RXLENGTH;
+    /* only frames that passed cs8900_should_accept() come back */
+    newframe = rawnet_receive(buffer, &len, &hashed, &hash_index, &rx_ok, &correct_mac, &broadcast, &multicast, &crc_error);
 
-        ready = 1;  /* assume we will find a good frame */
+    assert((len & 1) == 0); /* length has to be even! */
 
-        newframe = rawnet_arch_receive(buffer, &len, &hashed, &hash_index, &rx_ok, &correct_mac, &broadcast, &crc_error);
-
-        assert((len & 1) == 0); /* length has to be even! */
-
-        if (newframe) {
-            if (hashed || correct_mac || broadcast) {
-                /* we already know the type of frame: Trust it! */
+    if (newframe) {
 #ifdef RAWNET_DEBUG_FRAMES
-                log_message( cs8900_log, "+++ cs8900_receive(): *** hashed=%u, correct_mac=%u, broadcast=%u", hashed, correct_mac, broadcast);
+        log_message( cs8900_log, "+++ cs8900_receive(): *** hashed=%u, correct_mac=%u, broadcast=%u", hashed, correct_mac, broadcast);
 #endif
-            } else {
-                /* determine ourself the type of frame */
-                if (!cs8900_should_accept(buffer, len, &hashed, &hash_index, &correct_mac, &broadcast, &multicast)) {
-                    /* if we should not accept this frame, just do nothing
-                     * now, look for another one */
-                    ready = 0; /* try another frame */
-                    continue;
-                }
-            }
 
-            /* we did receive a frame, return that status */
-            ret_val |= rx_ok ? 0x0100 : 0;
-            ret_val |= multicast ? 0x0200 : 0;
+        /* we did receive a frame, return that status */
+        ret_val |= rx_ok ? 0x0100 : 0;
+        ret_val |= multicast ? 0x0200 : 0;
 
-            if (!multicast) {
-                ret_val |= hashed ? 0x0040 : 0;
-            }
+        if (!multicast) {
+            ret_val |= hashed ? 0x0040 : 0;
+        }
 
-            if (hashed && rx_ok) {
-                /* we have the 2nd, special format with hash index: */
-                assert(hash_index < 64);
-                ret_val |= hash_index << 9;
-            } else {
-                /* we have the regular format */
-                ret_val |= correct_mac ? 0x0400 : 0;
-                ret_val |= broadcast ? 0x0800 : 0;
-                ret_val |= crc_error ? 0x1000 : 0;
-                ret_val |= (len < MIN_RXLENGTH) ? 0x2000 : 0;
-                ret_val |= (len > MAX_RXLENGTH) ? 0x4000 : 0;
-            }
+        if (hashed && rx_ok) {
+            /* we have the 2nd, special format with hash index: */
+            assert(hash_index < 64);
+            ret_val |= hash_index << 9;
+        } else {
+            /* we have the regular format */
+            ret_val |= correct_mac ? 0x0400 : 0;
+            ret_val |= broadcast ? 0x0800 : 0;
+            ret_val |= crc_error ? 0x1000 : 0;
+            ret_val |= (len < MIN_RXLENGTH) ? 0x2000 : 0;
+            ret_val |= (len > MAX_RXLENGTH) ? 0x4000 : 0;
+        }
 
-            /* discard any octets that are beyond the MAX_RXLEN */
-            if (len > MAX_RXLENGTH) {
-                len = MAX_RXLENGTH;
-            }
+        /* discard any octets that are beyond the MAX_RXLEN */
+        if (len > MAX_RXLENGTH) {
+            len = MAX_RXLENGTH;
+        }
 
-            if (rx_ok) {
-                int i;
+        if (rx_ok) {
+            int i;
 
-                /* set relevant parts of the PP area to correct values */
-                SET_PP_16(CS8900_PP_ADDR_RXLENGTH, len);
+            /* set relevant parts of the PP area to correct values */
+            SET_PP_16(CS8900_PP_ADDR_RXLENGTH, len);
 
-                for (i = 0; i < len; i++) {
-                    SET_PP_8(CS8900_PP_ADDR_RX_FRAMELOC + i, buffer[i]);
-                }
+            for (i = 0; i < len; i++) {
+                SET_PP_8(CS8900_PP_ADDR_RX_FRAMELOC + i, buffer[i]);
+            }
 
-                /* set rx_buffer to where start reading *
-                 * According to 4.10.9 (pp. 76-77), we start with RxStatus and RxLength!
-                 */
-                rx_buffer = CS8900_PP_ADDR_RXSTATUS;
-                rx_length = len;
-                rx_count = 0;
+            /* set rx_buffer to where start reading *
+             * According to 4.10.9 (pp. 76-77), we start with RxStatus and RxLength!
+             */
+            rx_buffer = CS8900_PP_ADDR_RXSTATUS;
+            rx_length = len;
+            rx_count = 0;
 #ifdef CS8900_DEBUG_WARN_RXTX
-                if (rx_state != CS8900_RX_IDLE) {
-                    log_message(cs8900_log, "WARNING! New frame overwrites pending one!");
-                }
+            if (rx_state != CS8900_RX_IDLE) {
+                log_message(cs8900_log, "WARNING! New frame overwrites pending one!");
+            }
 #endif
-                rx_state = CS8900_RX_GOT_FRAME;
+            rx_state = CS8900_RX_GOT_FRAME;
 #ifdef CS8900_DEBUG_RXTX_STATE
-                log_message(cs8900_log, "RX: recvd frame (length=%04x,status=%04x)", rx_length, ret_val);
+            log_message(cs8900_log, "RX: recvd frame (length=%04x,status=%04x)", rx_length, ret_val);
 #endif
-            }
         }
-    } while (!ready);
+    }
 
 #ifdef RAWNET_DEBUG_FRAMES
     if (ret_val != 0x0004) {
@@ -784,7 +769,7 @@ static void cs8900_write_tx_buffer(uint8_t value, int odd_address)
             } else {
                 /* send frame */
                 uint16_t txcmd = GET_PP_16(CS8900_PP_ADDR_CC_TXCMD);
-                rawnet_arch_transmit(
+                rawnet_transmit(
                     txcmd & 0x0100 ? 1 : 0,   /* FORCE: Delete waiting frames in transmit buffer */
                     txcmd & 0x0200 ? 1 : 0,   /* ONECOLL: Terminate after just one collision */
                     txcmd & 0x1000 ? 1 : 0,   /* INHIBITCRC: Do not append CRC to the transmission */
@@ -906,6 +891,7 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
             break;
         case CS8900_PP_ADDR_CC_RXCTL:
             if (cs8900_recv_control != content) {
+                rawnet_lock();
                 cs8900_recv_broadcast = content & 0x0800; /* broadcast */
                 cs8900_recv_mac = content & 0x0400; /* individual address (IA) */
                 cs8900_recv_multicast = content & 0x0200; /* multicast if address passes the hash filter */
@@ -918,6 +904,9 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
                             on_off_str(cs8900_recv_broadcast), on_off_str(cs8900_recv_mac), on_off_str(cs8900_recv_multicast), on_off_str(cs8900_recv_correct), on_off_str(cs8900_recv_promiscuous), on_off_str(cs8900_recv_hashfilter));
 
                 rawnet_arch_recv_ctl(cs8900_recv_broadcast, cs8900_recv_mac, cs8900_recv_multicast, cs8900_recv_correct, cs8900_recv_promiscuous, cs8900_recv_hashfilter);
+                /* the frames in the ring went through the old filter */
+                rawnet_drop_received();
+                rawnet_unlock();
             }
             break;
         case CS8900_PP_ADDR_CC_LINECTL:
@@ -926,7 +915,13 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
                 int enable_rx = (content & 0x0040) == 0x0040;
 
                 if ((enable_tx != tx_enabled) || (enable_rx != rx_enabled)) {
+                    rawnet_lock();
                     rawnet_arch_line_ctl(enable_tx, enable_rx);
+                    if (enable_rx && !rx_enabled) {
+                        /* do not hand out what arrived while it was off */
+                        rawnet_flush_received();
+                    }
+                    rawnet_unlock();
                     cs8900_set_transmitter(enable_tx);
                     cs8900_set_receiver(enable_rx);
 
@@ -1012,10 +1007,12 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
                 unsigned int pos = 8 * (ppaddress - CS8900_PP_ADDR_LOG_ADDR_FILTER + odd_address);
                 uint32_t *p = (pos < 32) ? &cs8900_hash_mask[0] : &cs8900_hash_mask[1];
 
+                rawnet_lock();
                 *p &= ~(0xFF << pos); /* clear out relevant bits */
                 *p |= GET_PP_8(ppaddress + odd_address) << pos;
 
                 rawnet_arch_set_hashfilter(cs8900_hash_mask);
+                rawnet_unlock();
 
 #if 0
                 if (odd_address && (ppaddress == CS8900_PP_ADDR_LOG_ADDR_FILTER + 6)) {
@@ -1029,8 +1026,10 @@ static void cs8900_sideeffects_write_pp(uint16_t ppaddress, int odd_address)
         case CS8900_PP_ADDR_MAC_ADDR + 2:
         case CS8900_PP_ADDR_MAC_ADDR + 4:
             /* the MAC address has been changed */
+            rawnet_lock();
             cs8900_ia_mac[ppaddress - CS8900_PP_ADDR_MAC_ADDR + odd_address] = GET_PP_8(ppaddress + odd_address);
             rawnet_arch_set_mac(cs8900_ia_mac);
+            rawnet_unlock();
             if (odd_address && (ppaddress == CS8900_PP_ADDR_MAC_ADDR + 4)) {
                 log_message(cs8900_log, "set MAC address: %02x:%02x:%02x:%02x:%02x:%02x",
                             cs8900_ia_mac[0], cs8900_ia_mac[1], cs8900_ia_mac[2], cs8900_ia_mac[3], cs8900_ia_mac[4], cs8900_ia_mac[5]);
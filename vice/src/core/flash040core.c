@@ -31,12 +31,16 @@
 #include <string.h>
 
 #include "alarm.h"
+#include "archdep.h"
+#include "crc32.h"
 #include "flash040.h"
 #include "lib.h"
 #include "log.h"
+#include "machine.h"
 #include "maincpu.h"
 #include "snapshot.h"
 #include "types.h"
+#include "util.h"
 
 /* -------------------------------------------------------------------------- */
 
@@ -106,6 +110,9 @@ static const flash_types_t flash_types[FLASH040_TYPE_NUM] = {
       50, 500000, 64000000}, /* may take up to 3.5s and 128s */
 };
 
+/* journals with changes waiting for the next sync */
+static int flash_journals_pending = 0;
+
 /* -------------------------------------------------------------------------- */
 
 inline static int flash_magic_1(flash040_context_t *flash040_context, unsigned int addr)
@@ -149,6 +156,25 @@ inline static void flash_add_sector_to_erase_mask(flash040_context_t *flash040_c
     flash040_context->erase_mask[sector_num >> 3] |= (uint8_t)(1 << (sector_num & 0x7));
 }
 
+inline static void flash_mark_sector_dirty(flash040_context_t *flash040_context, unsigned int sector)
+{
+    uint8_t m = (uint8_t)(1 << (sector & 0x7));
+
+    flash040_context->dirty_mask[sector >> 3] |= m;
+
+    if (flash040_context->journal_filename != NULL) {
+        flash040_context->journal_mask[sector >> 3] |= m;
+        /* changes are batched, the journal is written some time after the
+           first change instead of on every programmed byte. the file itself
+           is only created then, too */
+        if (!flash040_context->journal_pending) {
+            alarm_set(flash040_context->journal_alarm, maincpu_clk + (CLOCK)machine_get_cycles_per_second());
+            flash040_context->journal_pending = 1;
+            flash_journals_pending++;
+        }
+    }
+}
+
 inline static void flash_erase_sector(flash040_context_t *flash040_context, unsigned int sector)
 {
     unsigned int sector_size = flash_types[flash040_context->flash_type].sector_size;
@@ -159,13 +185,19 @@ inline static void flash_erase_sector(flash040_context_t *flash040_context, unsi
     FLASH_DEBUG(("Erasing 0x%x - 0x%x", sector_addr, sector_addr + sector_size - 1));
     memset(&(flash040_context->flash_data[sector_addr]), 0xff, sector_size);
     flash040_context->flash_dirty = 1;
+    flash_mark_sector_dirty(flash040_context, sector);
 }
 
 inline static void flash_erase_chip(flash040_context_t *flash040_context)
 {
+    unsigned int i;
+
     FLASH_DEBUG(("Erasing chip"));
     memset(flash040_context->flash_data, 0xff, flash_types[flash040_context->flash_type].size);
     flash040_context->flash_dirty = 1;
+    for (i = 0; i < flash040core_sector_count(flash040_context); i++) {
+        flash_mark_sector_dirty(flash040_context, i);
+    }
 }
 
 inline static int flash_program_byte(flash040_context_t *flash040_context, unsigned int addr, uint8_t byte)
@@ -177,6 +209,9 @@ inline static int flash_program_byte(flash040_context_t *flash040_context, unsig
     flash040_context->program_byte = byte;
     flash040_context->flash_data[addr] = new_data;
     flash040_context->flash_dirty = 1;
+    if (new_data != old_data) {
+        flash_mark_sector_dirty(flash040_context, flash_addr_to_sector_number(flash040_context, addr));
+    }
 
     return (new_data == byte) ? 1 : 0;
 }
@@ -489,17 +524,372 @@ void flash040core_init(struct flash040_context_s *flash040_context,
     flash_clear_erase_mask(flash040_context);
     flash040_context->flash_dirty = 0;
     flash040_context->erase_alarm = alarm_new(alarm_context, "Flash040Alarm", erase_alarm_handler, flash040_context);
+    memset(flash040_context->dirty_mask, 0, FLASH040_SECTOR_MASK_SIZE);
+    memset(flash040_context->journal_mask, 0, FLASH040_SECTOR_MASK_SIZE);
+    flash040_context->journal = NULL;
+    flash040_context->journal_filename = NULL;
+    flash040_context->journal_size = 0;
+    flash040_context->journal_image_crc = 0;
+    flash040_context->journal_pending = 0;
+    flash040_context->journal_alarm = NULL;
 }
 
 void flash040core_shutdown(flash040_context_t *flash040_context)
 {
     FLASH_DEBUG(("Shutdown"));
+    /* keep whatever was not written back for the next attach */
+    flash040core_journal_close(flash040_context, 0);
+}
+
+/* -------------------------------------------------------------------------- */
+
+unsigned int flash040core_sector_size(flash040_context_t *flash040_context)
+{
+    return flash_types[flash040_context->flash_type].sector_size;
+}
+
+unsigned int flash040core_sector_count(flash040_context_t *flash040_context)
+{
+    return flash_types[flash040_context->flash_type].size >> flash_types[flash040_context->flash_type].sector_shift;
+}
+
+int flash040core_sector_is_dirty(flash040_context_t *flash040_context, unsigned int sector)
+{
+    return (flash040_context->dirty_mask[sector >> 3] >> (sector & 0x7)) & 1;
+}
+
+static uint32_t flash_image_crc(flash040_context_t *flash040_context);
+static void flash_journal_update_sector_crcs(flash040_context_t *flash040_context);
+
+/* Called after the image was written back, the journal is not needed for
+   those changes anymore. */
+void flash040core_clear_dirty(flash040_context_t *flash040_context)
+{
+    memset(flash040_context->dirty_mask, 0, FLASH040_SECTOR_MASK_SIZE);
+    memset(flash040_context->journal_mask, 0, FLASH040_SECTOR_MASK_SIZE);
+    flash040_context->flash_dirty = 0;
+
+    if (flash040_context->journal_filename != NULL) {
+        /* the image holds the current contents now, the next change starts
+           a new journal */
+        if (flash040_context->journal != NULL) {
+            fclose(flash040_context->journal);
+            flash040_context->journal = NULL;
+            archdep_remove(flash040_context->journal_filename);
+        }
+        flash040_context->journal_image_crc = flash_image_crc(flash040_context);
+        flash_journal_update_sector_crcs(flash040_context);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+/* Journal file format:
+
+   type  | name   | description
+   ----------------------------
+   ARRAY | magic  | "VICEFLASHJNL"
+   BYTE  | version| 2
+   BYTE  | type   | flash type
+   WORD  | unused | 0
+   DWORD | image  | CRC32 of the image contents (big endian)
+
+   followed by any number of records:
+
+   DWORD | sector | sector number (big endian)
+   ARRAY | data   | sector contents
+   DWORD | crc    | CRC32 of the sector contents (big endian)
+
+   Records are only ever appended, a later record for the same sector
+   supersedes an earlier one. A truncated or damaged record at the end
+   (crash while writing) is ignored.
+ */
+
+static const char flash_journal_magic[12] = "VICEFLASHJNL";
+#define FLASH_JOURNAL_VERSION     2
+#define FLASH_JOURNAL_HEADER_SIZE 20
+
+static uint32_t flash_image_crc(flash040_context_t *flash040_context)
+{
+    return crc32_buf((const char *)flash040_context->flash_data, flash_types[flash040_context->flash_type].size);
+}
+
+static void journal_alarm_handler(CLOCK offset, void *data)
+{
+    flash040_context_t *flash040_context = (flash040_context_t *)data;
+
+    alarm_unset(flash040_context->journal_alarm);
+    flash040_context->journal_pending = 0;
+    flash_journals_pending--;
+
+    flash040core_journal_sync(flash040_context);
+}
+
+static uint32_t flash_sector_crc(flash040_context_t *flash040_context, unsigned int sector)
+{
+    return crc32_buf((const char *)&(flash040_context->flash_data[flash_sector_to_addr(flash040_context, sector)]), flash040core_sector_size(flash040_context));
+}
+
+/* remember the current contents as the ones the journal restores */
+static void flash_journal_update_sector_crcs(flash040_context_t *flash040_context)
+{
+    unsigned int i;
+
+    for (i = 0; i < flash040core_sector_count(flash040_context); i++) {
+        flash040_context->journal_sector_crc[i] = flash_sector_crc(flash040_context, i);
+    }
+}
+
+static int flash_journal_write_sector(flash040_context_t *flash040_context, unsigned int sector)
+{
+    unsigned int sector_size = flash040core_sector_size(flash040_context);
+    uint8_t *data = &(flash040_context->flash_data[flash_sector_to_addr(flash040_context, sector)]);
+    uint32_t crc = crc32_buf((const char *)data, sector_size);
+    uint8_t buf[4];
+
+    util_dword_to_be_buf(buf, (uint32_t)sector);
+    if (fwrite(buf, 1, 4, flash040_context->journal) != 4) {
+        return -1;
+    }
+    if (fwrite(data, 1, sector_size, flash040_context->journal) != sector_size) {
+        return -1;
+    }
+    util_dword_to_be_buf(buf, crc);
+    if (fwrite(buf, 1, 4, flash040_context->journal) != 4) {
+        return -1;
+    }
+    flash040_context->journal_size += sector_size + 8;
+    flash040_context->journal_sector_crc[sector] = crc;
+    return 0;
+}
+
+/* start a new journal holding all sectors that differ from the image */
+static int flash_journal_create(flash040_context_t *flash040_context)
+{
+    uint8_t header[FLASH_JOURNAL_HEADER_SIZE];
+    unsigned int i;
+
+    flash040_context->journal = fopen(flash040_context->journal_filename, MODE_WRITE);
+    if (flash040_context->journal == NULL) {
+        log_error(LOG_DEFAULT, "Flash040: could not create journal `%s'.", flash040_context->journal_filename);
+        return -1;
+    }
+
+    memset(header, 0, FLASH_JOURNAL_HEADER_SIZE);
+    memcpy(header, flash_journal_magic, sizeof(flash_journal_magic));
+    header[12] = FLASH_JOURNAL_VERSION;
+    header[13] = (uint8_t)flash040_context->flash_type;
+    util_dword_to_be_buf(&header[16], flash040_context->journal_image_crc);
+    if (fwrite(header, 1, FLASH_JOURNAL_HEADER_SIZE, flash040_context->journal) != FLASH_JOURNAL_HEADER_SIZE) {
+        goto fail;
+    }
+    flash040_context->journal_size = FLASH_JOURNAL_HEADER_SIZE;
+
+    for (i = 0; i < flash040core_sector_count(flash040_context); i++) {
+        if (flash040core_sector_is_dirty(flash040_context, i)) {
+            if (flash_journal_write_sector(flash040_context, i) < 0) {
+                goto fail;
+            }
+        }
+    }
+    memset(flash040_context->journal_mask, 0, FLASH040_SECTOR_MASK_SIZE);
+
+    if (archdep_fsync(flash040_context->journal) != 0) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    log_error(LOG_DEFAULT, "Flash040: could not write journal `%s'.", flash040_context->journal_filename);
+    fclose(flash040_context->journal);
+    flash040_context->journal = NULL;
+    return -1;
+}
+
+/* stop journaling after the journal could not be written, instead of trying
+   again on every change. the alarm stays until the journal is closed */
+static void flash_journal_disable(flash040_context_t *flash040_context)
+{
+    memset(flash040_context->journal_mask, 0, FLASH040_SECTOR_MASK_SIZE);
+    lib_free(flash040_context->journal_filename);
+    flash040_context->journal_filename = NULL;
+}
+
+/* apply the records of an existing journal, returns the number of records
+   restored, -1 if the file is not a journal for this flash type or -2 if it
+   was written for a different image */
+static int flash_journal_replay(flash040_context_t *flash040_context, FILE *f)
+{
+    unsigned int sector_size = flash040core_sector_size(flash040_context);
+    unsigned int sector;
+    uint8_t header[FLASH_JOURNAL_HEADER_SIZE];
+    uint8_t buf[4];
+    uint8_t *data;
+    int restored = 0;
+
+    if (fread(header, 1, FLASH_JOURNAL_HEADER_SIZE, f) != FLASH_JOURNAL_HEADER_SIZE
+        || memcmp(header, flash_journal_magic, sizeof(flash_journal_magic)) != 0
+        || header[12] != FLASH_JOURNAL_VERSION
+        || header[13] != (uint8_t)flash040_context->flash_type) {
+        return -1;
+    }
+    if (util_be_buf_to_dword(&header[16]) != flash040_context->journal_image_crc) {
+        return -2;
+    }
+
+    data = lib_malloc(sector_size);
+
+    while (fread(buf, 1, 4, f) == 4) {
+        sector = util_be_buf_to_dword(buf);
+        if (sector >= flash040core_sector_count(flash040_context)
+            || fread(data, 1, sector_size, f) != sector_size
+            || fread(buf, 1, 4, f) != 4
+            || util_be_buf_to_dword(buf) != crc32_buf((const char *)data, sector_size)) {
+            break;
+        }
+        memcpy(&(flash040_context->flash_data[flash_sector_to_addr(flash040_context, sector)]), data, sector_size);
+        flash040_context->dirty_mask[sector >> 3] |= (uint8_t)(1 << (sector & 0x7));
+        restored++;
+    }
+
+    lib_free(data);
+    return restored;
+}
+
+int flash040core_journal_open(flash040_context_t *flash040_context, const char *filename)
+{
+    FILE *f;
+    int restored = 0;
+
+    flash040core_journal_close(flash040_context, 0);
+
+    flash040_context->journal_filename = lib_strdup(filename);
+    flash040_context->journal_image_crc = flash_image_crc(flash040_context);
+
+    flash040_context->journal_alarm = alarm_new(flash040_context->erase_alarm->context, "Flash040JournalAlarm", journal_alarm_handler, flash040_context);
+    flash040_context->journal_pending = 0;
+
+    /* without an existing journal, the file is only created once the flash
+       is programmed or erased */
+    f = fopen(filename, MODE_READ);
+    if (f != NULL) {
+        restored = flash_journal_replay(flash040_context, f);
+        fclose(f);
+        if (restored == -2) {
+            log_warning(LOG_DEFAULT, "Flash040: journal `%s' belongs to a different image, ignoring it.", filename);
+            restored = 0;
+        } else if (restored < 0) {
+            log_warning(LOG_DEFAULT, "Flash040: ignoring invalid journal `%s'.", filename);
+            restored = 0;
+        } else if (restored > 0) {
+            log_message(LOG_DEFAULT, "Flash040: restored %d sector(s) from journal `%s'.", restored, filename);
+            flash040_context->flash_dirty = 1;
+        }
+
+        /* rewriting also drops superseded records of the old journal */
+        if (flash_journal_create(flash040_context) < 0) {
+            flash_journal_disable(flash040_context);
+            return -1;
+        }
+    }
+
+    flash_journal_update_sector_crcs(flash040_context);
+
+    return restored;
+}
+
+/* append all sectors changed since the last sync */
+int flash040core_journal_sync(flash040_context_t *flash040_context)
+{
+    unsigned int i;
+    int written = 0;
+
+    if (flash040_context->journal_filename == NULL) {
+        return 0;
+    }
+
+    if (flash040_context->journal == NULL) {
+        /* first change since the journal was opened or the image was
+           written back */
+        for (i = 0; i < FLASH040_SECTOR_MASK_SIZE; i++) {
+            if (flash040_context->journal_mask[i] != 0) {
+                break;
+            }
+        }
+        if (i == FLASH040_SECTOR_MASK_SIZE) {
+            return 0;
+        }
+        if (flash_journal_create(flash040_context) < 0) {
+            flash_journal_disable(flash040_context);
+            return -1;
+        }
+        return 0;
+    }
+
+    /* once the journal holds much more than the whole chip, start over */
+    if (flash040_context->journal_size > 2 * flash_types[flash040_context->flash_type].size) {
+        fclose(flash040_context->journal);
+        if (flash_journal_create(flash040_context) < 0) {
+            flash_journal_disable(flash040_context);
+            return -1;
+        }
+        return 0;
+    }
+
+    for (i = 0; i < flash040core_sector_count(flash040_context); i++) {
+        if ((flash040_context->journal_mask[i >> 3] >> (i & 0x7)) & 1) {
+            if (flash_journal_write_sector(flash040_context, i) < 0) {
+                log_error(LOG_DEFAULT, "Flash040: could not write journal `%s'.", flash040_context->journal_filename);
+                return -1;
+            }
+            written++;
+        }
+    }
+    memset(flash040_context->journal_mask, 0, FLASH040_SECTOR_MASK_SIZE);
+
+    if (written > 0 && archdep_fsync(flash040_context->journal) != 0) {
+        log_error(LOG_DEFAULT, "Flash040: could not write journal `%s'.", flash040_context->journal_filename);
+        return -1;
+    }
+    return 0;
+}
+
+/* Check if any journal has changes that are not written yet */
+int flash040core_journal_any_pending(void)
+{
+    return flash_journals_pending > 0;
+}
+
+void flash040core_journal_close(flash040_context_t *flash040_context, int remove_file)
+{
+    if (flash040_context->journal_filename != NULL) {
+        if (!remove_file) {
+            flash040core_journal_sync(flash040_context);
+        }
+        if (flash040_context->journal != NULL) {
+            fclose(flash040_context->journal);
+            flash040_context->journal = NULL;
+        }
+        if (remove_file) {
+            archdep_remove(flash040_context->journal_filename);
+        }
+    }
+    if (flash040_context->journal_alarm != NULL) {
+        alarm_destroy(flash040_context->journal_alarm);
+        flash040_context->journal_alarm = NULL;
+    }
+    if (flash040_context->journal_pending) {
+        flash040_context->journal_pending = 0;
+        flash_journals_pending--;
+    }
+    lib_free(flash040_context->journal_filename);
+    flash040_context->journal_filename = NULL;
 }
 
 /* -------------------------------------------------------------------------- */
 
 #define FLASH040_DUMP_VER_MAJOR   2
-#define FLASH040_DUMP_VER_MINOR   0
+#define FLASH040_DUMP_VER_MINOR   1
 
 int flash040core_snapshot_write_module(snapshot_t *s, flash040_context_t *flash040_context, const char *name)
 {
@@ -519,7 +909,8 @@ int flash040core_snapshot_write_module(snapshot_t *s, flash040_context_t *flash0
         || (SMW_B(m, base_state) < 0)
         || (SMW_B(m, flash040_context->program_byte) < 0)
         || (SMW_BA(m, flash040_context->erase_mask, FLASH040_ERASE_MASK_SIZE) < 0)
-        || (SMW_B(m, flash040_context->last_read) < 0)) {
+        || (SMW_B(m, flash040_context->last_read) < 0)
+        || (SMW_BA(m, flash040_context->dirty_mask, FLASH040_SECTOR_MASK_SIZE) < 0)) {
         snapshot_module_close(m);
         return -1;
     }
@@ -531,7 +922,9 @@ int flash040core_snapshot_write_module(snapshot_t *s, flash040_context_t *flash0
 int flash040core_snapshot_read_module(snapshot_t *s, flash040_context_t *flash040_context, const char *name)
 {
     uint8_t vmajor, vminor, state, base_state;
+    uint8_t dirty_mask[FLASH040_SECTOR_MASK_SIZE];
     snapshot_module_t *m;
+    unsigned int i;
 
     m = snapshot_module_open(s, name, &vmajor, &vminor);
     if (m == NULL) {
@@ -553,11 +946,38 @@ int flash040core_snapshot_read_module(snapshot_t *s, flash040_context_t *flash04
         return -1;
     }
 
+    /* older snapshots do not know which sectors differ from the image */
+    if (vminor > 0) {
+        if (SMR_BA(m, dirty_mask, FLASH040_SECTOR_MASK_SIZE) < 0) {
+            snapshot_module_close(m);
+            return -1;
+        }
+    } else {
+        memset(dirty_mask, 0xff, FLASH040_SECTOR_MASK_SIZE);
+    }
+
     snapshot_module_close(m);
 
     flash040_context->flash_state = (flash040_state_t)state;
     flash040_context->flash_base_state = (flash040_state_t)base_state;
 
+    /* sectors changed in either state still differ from the image. Run-ahead
+       and netplay load a snapshot every frame, so only sectors whose
+       contents differ from what the journal restores are queued for it,
+       and an already scheduled sync is left alone. */
+    for (i = 0; i < flash040core_sector_count(flash040_context); i++) {
+        uint8_t bit = (uint8_t)(1 << (i & 0x7));
+
+        if (((flash040_context->dirty_mask[i >> 3] | dirty_mask[i >> 3]) & bit) == 0) {
+            continue;
+        }
+        flash040_context->dirty_mask[i >> 3] |= bit;
+        if (flash040_context->journal_filename != NULL
+            && flash_sector_crc(flash040_context, i) != flash040_context->journal_sector_crc[i]) {
+            flash_mark_sector_dirty(flash040_context, i);
+        }
+    }
+
     /* Restore alarm if needed */
     switch (flash040_context->flash_state) {
         case FLASH040_STATE_SECTOR_ERASE_TIMEOUT:
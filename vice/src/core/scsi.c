@@ -82,7 +82,11 @@ static off_t scsi_getmaxsize(struct scsi_context_s *context)
     if (context->file[(context->target << 3) | context->lun]) {
         if (!context->max_imagesize) {
             /* if the max length setting is zero, return the image length */
-            work = archdep_file_size(context->file[(context->target << 3) | context->lun]);
+            if (context->cache[(context->target << 3) | context->lun]) {
+                work = blockcache_get_size(context->cache[(context->target << 3) | context->lun]);
+            } else {
+                work = archdep_file_size(context->file[(context->target << 3) | context->lun]);
+            }
             /* turn the file size into 512 byte sectors */
             work = (work >> 9) + (work & 511 ? 1 : 0);
             return work;
@@ -115,12 +119,73 @@ static int32_t scsi_imagecheck(struct scsi_context_s *context)
     return 0;
 }
 
+/* get the block cache of the current target and lun, it is set up when the
+   file is accessed for the first time. files shared with other code have no
+   cache, nothing would tell it when the other code writes the file */
+static blockcache_t *scsi_image_cache(struct scsi_context_s *context)
+{
+    int disk = (context->target << 3) | context->lun;
+
+    if (context->shared[disk]) {
+        return NULL;
+    }
+
+    if (!context->cache[disk]) {
+        context->cache[disk] = blockcache_new(context->file[disk], 512, context->myname);
+    }
+
+    return context->cache[disk];
+}
+
+/* write back and drop the block cache of a disk, this must be done before
+   its file is closed or replaced */
+void scsi_image_release(struct scsi_context_s *context, int disk)
+{
+    if (disk < 0 || disk > 55) {
+        return;
+    }
+
+    if (context->cache[disk]) {
+        blockcache_destroy(context->cache[disk]);
+        context->cache[disk] = NULL;
+    }
+}
+
+void scsi_image_release_all(struct scsi_context_s *context)
+{
+    int32_t i;
+
+    for (i = 0; i < 56; i++) {
+        scsi_image_release(context, i);
+    }
+}
+
+/* write back the dirty blocks of the current target and lun */
+int32_t scsi_image_flush(struct scsi_context_s *context)
+{
+    int disk = (context->target << 3) | context->lun;
+
+    if (context->target >= MAXIDS || context->lun >= MAXLUNS
+        || !context->cache[disk]) {
+        return 0;
+    }
+
+    if (blockcache_flush(context->cache[disk]) < 0) {
+        CRIT((LOG, "SCSI: error writing disk %d", context->target));
+        return -4;
+    }
+
+    return 0;
+}
+
 int scsi_image_detach(struct scsi_context_s *context, int disk)
 {
     if (disk < 0 || disk > 55) {
         return 2;
     }
 
+    scsi_image_release(context, disk);
+
     if (context->file[disk]) {
         fclose(context->file[disk]);
         context->file[disk] = NULL;
@@ -158,15 +223,12 @@ int scsi_image_attach(struct scsi_context_s *context, int disk, char *filename)
     }
 }
 
-int32_t scsi_image_read(struct scsi_context_s *context)
+/* read a block of a file that is not cached */
+static int32_t scsi_file_read(struct scsi_context_s *context)
 {
     int32_t i;
     FILE *fhd;
 
-    if (scsi_imagecheck(context)) {
-        return -1;
-    }
-
     fhd = context->file[(context->target << 3) | context->lun];
 
     if (archdep_fseeko(fhd, (off_t)context->address * 512, SEEK_SET) < 0) {
@@ -189,6 +251,57 @@ int32_t scsi_image_read(struct scsi_context_s *context)
         }
     }
 
+    return 0;
+}
+
+/* write a block of a file that is not cached */
+static int32_t scsi_file_write(struct scsi_context_s *context)
+{
+    FILE *fhd;
+
+    fhd = context->file[(context->target << 3) | context->lun];
+
+    if (archdep_fseeko(fhd, (off_t)context->address * 512, SEEK_SET) < 0) {
+        CRIT((LOG, "SCSI: error seeking disk %d at sector 0x%x",
+            context->target, context->address));
+        return -3;
+    }
+
+    if (fwrite(context->data_buf, 512, 1, fhd) < 1) {
+        CRIT((LOG, "SCSI: error writing disk %d at sector 0x%x",
+            context->target, context->address));
+        return -4;
+    }
+    fflush(fhd);
+
+    return 0;
+}
+
+int32_t scsi_image_read(struct scsi_context_s *context)
+{
+    blockcache_t *cache;
+    int32_t rc;
+
+    if (scsi_imagecheck(context)) {
+        return -1;
+    }
+
+    cache = scsi_image_cache(context);
+    if (cache) {
+        /* a read beyond the EOF is filled with zeros and considered good */
+        if (blockcache_read_block(cache, (off_t)context->address,
+                                  context->data_buf) < 0) {
+            CRIT((LOG, "SCSI: error reading disk %d at sector 0x%x",
+                context->target, context->address));
+            return -4;
+        }
+    } else {
+        rc = scsi_file_read(context);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
     LOG2((LOG, "SCSI: read disk %d at sector 0x%x", context->target,
         context->address));
 
@@ -203,7 +316,8 @@ int32_t scsi_image_read(struct scsi_context_s *context)
 
 int32_t scsi_image_write(struct scsi_context_s *context)
 {
-    FILE *fhd;
+    blockcache_t *cache;
+    int32_t rc;
 
     if (scsi_imagecheck(context)) {
         return -1;
@@ -215,20 +329,22 @@ int32_t scsi_image_write(struct scsi_context_s *context)
         context->user_write(context);
     }
 
-    fhd = context->file[(context->target << 3) | context->lun];
-
-    if (archdep_fseeko(fhd, (off_t)context->address * 512, SEEK_SET) < 0) {
-        CRIT((LOG, "SCSI: error seeking disk %d at sector 0x%x",
-            context->target, context->address));
-        return -3;
-    }
-
-    if (fwrite(context->data_buf, 512, 1, fhd) < 1) {
-        CRIT((LOG, "SCSI: error writing disk %d at sector 0x%x",
-            context->target, context->address));
-        return -4;
+    cache = scsi_image_cache(context);
+    if (cache) {
+        /* the block stays in the cache until the command is complete, so the
+           blocks of a multi block write go out together */
+        if (blockcache_write_block(cache, (off_t)context->address,
+                                   context->data_buf) < 0) {
+            CRIT((LOG, "SCSI: error writing disk %d at sector 0x%x",
+                context->target, context->address));
+            return -4;
+        }
+    } else {
+        rc = scsi_file_write(context);
+        if (rc < 0) {
+            return rc;
+        }
     }
-    fflush(fhd);
 
     LOG2((LOG, "SCSI: write disk %d at sector 0x%x", context->target,
         context->address));
@@ -249,6 +365,7 @@ static void scsi_format_sector0(struct scsi_context_s *context)
     }
 
     scsi_image_write(context);
+    scsi_image_flush(context);
 }
 
 uint8_t scsi_get_bus(struct scsi_context_s *context)
@@ -409,6 +526,7 @@ void scsi_process_ack(struct scsi_context_s *context)
                     context->command == SCSI_COMMAND_WRITE_10 ||
                     context->command == SCSI_COMMAND_WRITE_VERIFY) {
                     if (scsi_image_write(context)) {
+                        scsi_image_flush(context);
                         context->status = SCSI_STATUS_CHECKCONDITION;
                         context->state = SCSI_STATE_STATUS;
                         break;
@@ -419,11 +537,16 @@ void scsi_process_ack(struct scsi_context_s *context)
                     /* count down the number of blocks received, keep going
                         if necessary */
                     if (!context->blocks) {
-                        context->status = SCSI_STATUS_GOOD;
+                        if (scsi_image_flush(context)) {
+                            context->status = SCSI_STATUS_CHECKCONDITION;
+                        } else {
+                            context->status = SCSI_STATUS_GOOD;
+                        }
                         context->state = SCSI_STATE_STATUS;
                         break;
                     }
                     if (context->address >= scsi_getmaxsize(context)) {
+                        scsi_image_flush(context);
                         context->sensekey = SCSI_SENSEKEY_ILLEGALREQUEST;
                         context->asc = SCSI_SASC_LOGICALBLOCKADDRESSOUTOFRANGE;
                         context->status = SCSI_STATUS_CHECKCONDITION;
@@ -920,6 +1043,12 @@ void scsi_reset(struct scsi_context_s *context)
 int scsi_snapshot_write_module(struct scsi_context_s *context, snapshot_t *s)
 {
     snapshot_module_t *m;
+    int32_t i;
+
+    /* make sure the images on disk are up to date */
+    for (i = 0; i < 56; i++) {
+        blockcache_flush(context->cache[i]);
+    }
 
     m = snapshot_module_create(s, context->myname, SNAP_MAJOR, SNAP_MINOR);
 
@@ -27,6 +27,7 @@
 #ifndef VICE_SCSI_H
 #define VICE_SCSI_H
 
+#include "blockcache.h"
 #include "types.h"
 
 struct scsi_context_s;
@@ -64,6 +65,8 @@ typedef struct scsi_context_s {
     uint32_t limit_imagesize; /* in 512 byte sectors */
     uint32_t log;
     FILE *file[56];
+    blockcache_t *cache[56];
+    uint8_t shared[56]; /* file is also written by other code, do not cache it */
     void *p;
     void (*user_format)(struct scsi_context_s *);
     void (*user_read)(struct scsi_context_s *);
@@ -211,8 +214,11 @@ MSG C/D I/O   Phase Name          Direction Of Transfer         Comment
 int scsi_image_detach(struct scsi_context_s *context, int disk);
 void scsi_image_detach_all(struct scsi_context_s *context);
 int scsi_image_attach(struct scsi_context_s *context, int disk, char *filename);
+void scsi_image_release(struct scsi_context_s *context, int disk);
+void scsi_image_release_all(struct scsi_context_s *context);
 int32_t scsi_image_read(struct scsi_context_s *context);
 int32_t scsi_image_write(struct scsi_context_s *context);
+int32_t scsi_image_flush(struct scsi_context_s *context);
 uint8_t scsi_get_bus(struct scsi_context_s *context);
 int scsi_set_bus(struct scsi_context_s *context, uint8_t value);
 void scsi_process_noack(struct scsi_context_s *context);
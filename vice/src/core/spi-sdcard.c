@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "blockcache.h"
 #include "log.h"
 #include "snapshot.h"
 #include "spi-sdcard.h"
@@ -102,6 +103,10 @@ static sd_addr_t mmc_image_pointer;
 /* write sequence counter */
 static unsigned int mmc_write_sequence;
 
+/* start address and data of the block being written */
+static sd_addr_t mmc_write_address;
+static uint8_t mmc_write_buffer[0x1000];
+
 static uint8_t mmc_card_inserted;
 static uint8_t mmc_card_state;
 static uint8_t mmc_card_reset_count;
@@ -169,6 +174,30 @@ static uint8_t mmc_read_buffer_getbyte(void)
     return value;
 }
 
+/* ---------------------------------------------------------------------*/
+/*    image block cache                                                  */
+
+/* The image is accessed through a block cache of 512 byte blocks, writes
+   only reach the file when blocks get evicted and when the cache is flushed
+   (on detach and before taking a snapshot). */
+#define MMC_CACHE_BLOCK_SIZE    0x200
+
+static blockcache_t *mmc_cache = NULL;
+static int mmc_image_readonly = 0;
+
+/* returns 0 if no card image is open */
+int mmc_get_cache_stats(unsigned long *hits, unsigned long *misses, unsigned long *writes)
+{
+    if (mmc_cache == NULL) {
+        *hits = 0;
+        *misses = 0;
+        *writes = 0;
+        return 0;
+    }
+    blockcache_get_stats(mmc_cache, hits, misses, writes);
+    return 1;
+}
+
 /* Resets the card */
 static void mmc_reset_card(void)
 {
@@ -638,26 +667,27 @@ static void mmc_execute_cmd(void)
 #ifdef DEBUG_MMC
                     log_debug(LOG_DEFAULT, "Address: %08x", mmc_current_address_pointer);
 #endif
-                    if (fseek(mmc_image_file, mmc_current_address_pointer, SEEK_SET) != 0) {
-                        mmc_card_state = MMC_CARD_DUMMY_READ;
-                    } else {
-                        uint8_t readbuf[0x1000];    /* FIXME */
+                    uint8_t readbuf[0x1000];    /* FIXME */
+                    size_t len = mmc_block_size;
+                    size_t done;
+
+                    if (len > sizeof(readbuf)) {
+                        len = sizeof(readbuf);
+                    }
 #ifdef DEBUG_MMC
-                        log_debug(LOG_DEFAULT, "Buffering: %08x", mmc_current_address_pointer);
-#endif
-                        fseek(mmc_image_file, mmc_current_address_pointer, SEEK_SET);
-                        if (!feof(mmc_image_file)) {
-                            if (fread(readbuf, 1, mmc_block_size, mmc_image_file) > 0) {
-                                mmc_read_buffer_readptr = 0;
-                                mmc_read_buffer_writeptr = 0;
-                                mmc_read_buffer_set(readbuf, mmc_block_size);
+                    log_debug(LOG_DEFAULT, "Buffering: %08x", mmc_current_address_pointer);
+#endif
+                    done = blockcache_read(mmc_cache, (off_t)mmc_current_address_pointer, readbuf, len);
+                    if (done > 0) {
+                        memset(readbuf + done, 0, len - done);
+                        mmc_read_buffer_readptr = 0;
+                        mmc_read_buffer_writeptr = 0;
+                        mmc_read_buffer_set(readbuf, (int)len);
 #ifdef DEBUG_MMC
-                                log_debug(LOG_DEFAULT, "Buffered: %02x %02x", readbuf[0], readbuf[1]);
+                        log_debug(LOG_DEFAULT, "Buffered: %02x %02x", readbuf[0], readbuf[1]);
 #endif
-                            } else {
-                                /* FIXME: handle error */
-                            }
-                        }
+                    } else {
+                        /* FIXME: handle error */
                     }
                 }
             } else {
@@ -680,6 +710,7 @@ static void mmc_execute_cmd(void)
                     log_debug(LOG_DEFAULT, "Address Overflow: %08x", mmc_current_address_pointer);
 #endif
                 } else {
+                    mmc_write_address = mmc_current_address_pointer;
                     mmc_write_sequence = 0;
                     mmc_card_state = MMC_CARD_WRITE;
                 }
@@ -801,14 +832,18 @@ static void mmc_write_to_mmc(uint8_t value)
             }
             break;
         case 1:
-            if (mmc_card_state == MMC_CARD_WRITE) {
-                if (fwrite(&value, 1, 1, mmc_image_file) != 1) {
-                    LOG(("could not write to mmc image file"));
-                    /* FIXME: handle error */
-                }
+            if (mmc_image_pointer < sizeof(mmc_write_buffer)) {
+                mmc_write_buffer[mmc_image_pointer] = value;
             }
             mmc_image_pointer++;
             if (mmc_image_pointer == mmc_block_size) {
+                /* the whole block was received, hand it to the cache */
+                if (mmc_card_state == MMC_CARD_WRITE && !mmc_image_readonly) {
+                    if (blockcache_write(mmc_cache, (off_t)mmc_write_address, mmc_write_buffer,
+                                         mmc_block_size < sizeof(mmc_write_buffer) ? mmc_block_size : sizeof(mmc_write_buffer)) < 0) {
+                        LOG(("could not write to mmc image file"));
+                    }
+                }
                 mmc_write_sequence++;
             }
             break;
@@ -862,6 +897,7 @@ int mmc_open_card_image(char *name, int rw)
         } else {
             /* FIXME */
             spi_mmc_set_card_inserted(MMC_CARD_INSERTED);
+            mmc_image_readonly = 1;
             LOG(("opened sd card image (ro): %s", mmc_image_filename));
             /* mmc_image_file_readonly = 1; */
             /* mmcreplay_hw_writeprotect = 1; */
@@ -870,8 +906,10 @@ int mmc_open_card_image(char *name, int rw)
     } else {
         /* mmc_image_file_readonly = 0; */
         spi_mmc_set_card_inserted(MMC_CARD_INSERTED);
+        mmc_image_readonly = 0;
         LOG(("opened sd card image (rw): %s", mmc_image_filename));
     }
+    mmc_cache = blockcache_new(mmc_image_file, MMC_CACHE_BLOCK_SIZE, "SD card");
     mmc_card_rw = rw;
     return 0;
 }
@@ -880,6 +918,8 @@ void mmc_close_card_image(void)
 {
     /* unmount mmc cart image */
     if (mmc_image_file != NULL) {
+        blockcache_destroy(mmc_cache);
+        mmc_cache = NULL;
         fclose(mmc_image_file);
         mmc_image_file = NULL;
         spi_mmc_set_card_inserted(MMC_CARD_NOTINSERTED);
@@ -898,6 +938,11 @@ int mmc_snapshot_write_module(snapshot_t *s)
 {
     snapshot_module_t *m;
 
+    /* make sure the image on disk is up to date */
+    if (mmc_cache != NULL) {
+        blockcache_flush(mmc_cache);
+    }
+
     m = snapshot_module_create(s, SNAP_MODULE_NAME,
                                CART_DUMP_VER_MAJOR, CART_DUMP_VER_MINOR);
     if (m == NULL) {
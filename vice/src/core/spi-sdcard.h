@@ -48,6 +48,7 @@ void spi_mmc_data_write(uint8_t value);
 int  mmc_open_card_image(char *name, int rw);
 void mmc_close_card_image(void);
 uint8_t mmc_set_card_type(uint8_t value);
+int mmc_get_cache_stats(unsigned long *hits, unsigned long *misses, unsigned long *writes);
 
 struct snapshot_s;
 
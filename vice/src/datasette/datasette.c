@@ -143,6 +143,20 @@ static void datasette_event_record(int command);
 static void datasette_control_internal(int port, int command);
 
 static void datasette_set_motor(int port, int flag);
+/* Check if record is pressed on any datasette with a tape image */
+int datasette_is_recording(void)
+{
+    int port;
+
+    for (port = 0; port < TAPEPORT_MAX_PORTS; port++) {
+        if (current_image[port] != NULL
+            && current_image[port]->mode == DATASETTE_CONTROL_RECORD) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 static void datasette_toggle_write_bit(int port, int write_bit);
 
 static int datasette_write_snapshot(int port, snapshot_t *s, int write_image);
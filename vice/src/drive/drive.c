@@ -66,6 +66,7 @@
 #include "machine-drive.h"
 #include "machine.h"
 #include "maincpu.h"
+#include "mainchannel.h"
 #include "resources.h"
 #include "rotation.h"
 #include "sound.h"
@@ -866,6 +867,30 @@ void drive_gcr_data_writeback_all(void)
     }
 }
 
+/* Check if a drive has GCR data that is not in the disk image yet, or is
+   writing to the disk right now */
+int drive_gcr_data_pending(void)
+{
+    drive_t *drive;
+    unsigned int i, j;
+
+    for (i = 0; i < NUM_DISK_UNITS; i++) {
+        if (!diskunit_context[i]->enable) {
+            continue;
+        }
+        for (j = 0; j < 2; j++) {
+            drive = diskunit_context[i]->drives[j];
+            if (drive && drive->image
+                && (drive->GCR_dirty_track || drive->P64_dirty
+                    || (drive->read_write_mode == 0
+                        && (drive->byte_ready_active & BRA_MOTOR_ON)))) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
 /* ------------------------------------------------------------------------- */
 
 static void drive_led_update(diskunit_context_t *unit, drive_t *drive, int base)
@@ -920,6 +945,10 @@ static void drive_led_update(diskunit_context_t *unit, drive_t *drive, int base)
 
     if (led_pwm1 != drive->led_last_pwm
         || my_led_status != drive->old_led_status) {
+        mainchannel_state_t *state = mainchannel_state_edit();
+
+        state->drive_led_pwm[drive->diskunit->mynumber][base][0] = led_pwm1;
+        state->drive_led_pwm[drive->diskunit->mynumber][base][1] = (my_led_status & 2) ? 1000 : 0;
         ui_display_drive_led(drive->diskunit->mynumber, base, led_pwm1,
                              (my_led_status & 2) ? 1000 : 0);
         drive->led_last_pwm = led_pwm1;
@@ -931,6 +960,7 @@ static void drive_led_update(diskunit_context_t *unit, drive_t *drive, int base)
 void drive_update_ui_status(void)
 {
     int i;
+    mainchannel_state_t *state = mainchannel_state_edit();
 
     if (console_mode || (machine_class == VICE_MACHINE_VSID)) {
         return;
@@ -949,6 +979,8 @@ void drive_update_ui_status(void)
                 || drive0->side != drive0->old_side) {
                 drive0->old_half_track = drive0->current_half_track;
                 drive0->old_side = drive0->side;
+                state->drive_half_track[i][0] = drive0->current_half_track;
+                state->drive_side[i][0] = drive0->side;
                 ui_display_drive_track(i, 0, drive0->current_half_track, drive0->side);
             }
             /* update LED and track of the second drive for dual drives */
@@ -958,6 +990,8 @@ void drive_update_ui_status(void)
                     || drive1->side != drive1->old_side) {
                     drive1->old_half_track = drive1->current_half_track;
                     drive1->old_side = drive1->side;
+                    state->drive_half_track[i][1] = drive1->current_half_track;
+                    state->drive_side[i][1] = drive1->side;
                     ui_display_drive_track(i, 1, drive1->current_half_track, drive1->side);
                 }
             }
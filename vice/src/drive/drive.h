@@ -402,6 +402,7 @@ void drive_enable_update_ui(struct diskunit_context_s *drv);
 void drive_update_ui_status(void);
 void drive_gcr_data_writeback(struct drive_s *drive);
 void drive_gcr_data_writeback_all(void);
+int drive_gcr_data_pending(void);
 void drive_set_active_led_color(unsigned int type, unsigned int dnr);
 int drive_set_disk_drive_type(unsigned int drive_type,
                               struct diskunit_context_s *drv);
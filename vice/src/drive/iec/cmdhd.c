@@ -327,6 +327,7 @@ static void cmdhd_scsiformat(struct scsi_context_s *scsi)
             }
             /* write it back */
             scsi_image_write(scsi);
+            scsi_image_flush(scsi);
             break;
         }
         /* otherwise, keep looking */
@@ -1166,6 +1167,7 @@ void cmdhd_shutdown(cmdhd_context_t *hd)
 /*    alarm_destroy(hd->reset_alarm); */
     viacore_shutdown(hd->via9);
     viacore_shutdown(hd->via10);
+    scsi_image_release_all(hd->scsi);
     lib_free(hd->scsi->myname);
     lib_free(hd->scsi);
     lib_free(hd->i8255a);
@@ -1308,6 +1310,7 @@ void cmdhd_reset(cmdhd_context_t *hd)
             }
         } else {
             /* remove scsi ID 0 */
+            scsi_image_release(hd->scsi, 0);
             hd->scsi->file[0] = NULL;
         }
     }
@@ -1365,8 +1368,13 @@ int cmdhd_attach_image(disk_image_t *image, unsigned int unit)
         return -1;
     }
 
-    /* copy file FD to the scsi module */
+    /* drop any cached blocks of the previous files */
+    scsi_image_release_all(hd->scsi);
+
+    /* copy file FD to the scsi module, the disk image layer writes to the
+       same file when true drive emulation is off, so it is not cached */
     hd->scsi->file[0] = image->media.fsimage->fd;
+    hd->scsi->shared[0] = 1;
 
     /* find the base lba */
     cmdhd_findbaselba(hd);
@@ -1474,6 +1482,7 @@ int cmdhd_detach_image(disk_image_t *image, unsigned int unit)
     hd->image = NULL;
     hd->imagesize = 0;
     hd->baselba = UINT32_MAX;
+    scsi_image_release_all(hd->scsi);
     hd->scsi->file[0] = NULL;
 
     /* close all additional SCSI ID files */
@@ -26,6 +26,8 @@
 #ifndef VICE_FLASH040_H
 #define VICE_FLASH040_H
 
+#include <stdio.h>
+
 #include "types.h"
 
 enum flash040_type_s {
@@ -68,6 +70,9 @@ typedef enum flash040_state_s flash040_state_t;
 
 #define FLASH040_ERASE_MASK_SIZE 8
 
+/* one bit per sector, enough for the largest supported chip */
+#define FLASH040_SECTOR_MASK_SIZE 16
+
 typedef struct flash040_context_s {
     uint8_t *flash_data;
     flash040_state_t flash_state;
@@ -81,6 +86,22 @@ typedef struct flash040_context_s {
 
     uint8_t last_read;
     struct alarm_s *erase_alarm;
+
+    /* sectors changed since the image was last written back */
+    uint8_t dirty_mask[FLASH040_SECTOR_MASK_SIZE];
+
+    /* sectors changed since the journal was last synced */
+    uint8_t journal_mask[FLASH040_SECTOR_MASK_SIZE];
+    FILE *journal;
+    char *journal_filename;
+    unsigned long journal_size;
+    /* CRC32 of the contents as stored in the image, a journal is only
+       replayed onto the image it was written for */
+    uint32_t journal_image_crc;
+    /* CRC32 of each sector as the image and the journal would restore it */
+    uint32_t journal_sector_crc[FLASH040_SECTOR_MASK_SIZE * 8];
+    int journal_pending;
+    struct alarm_s *journal_alarm;
 } flash040_context_t;
 
 struct alarm_context_s;
@@ -98,6 +119,22 @@ uint8_t flash040core_read(struct flash040_context_s *flash040_context,
 uint8_t flash040core_peek(struct flash040_context_s *flash040_context,
                           unsigned int addr);
 
+unsigned int flash040core_sector_size(struct flash040_context_s *flash040_context);
+unsigned int flash040core_sector_count(struct flash040_context_s *flash040_context);
+int flash040core_sector_is_dirty(struct flash040_context_s *flash040_context,
+                                 unsigned int sector);
+void flash040core_clear_dirty(struct flash040_context_s *flash040_context);
+
+/* The journal keeps a copy of every changed sector in a sidecar file, so
+   the changes survive a crash before the image is written back. The file
+   is only created once the flash is changed. */
+int flash040core_journal_open(struct flash040_context_s *flash040_context,
+                              const char *filename);
+int flash040core_journal_sync(struct flash040_context_s *flash040_context);
+void flash040core_journal_close(struct flash040_context_s *flash040_context,
+                                int remove_file);
+int flash040core_journal_any_pending(void);
+
 struct snapshot_s;
 
 int flash040core_snapshot_write_module(struct snapshot_s *s,
@@ -45,5 +45,6 @@ void fsdevice_shutdown(void);
 
 int fsdevice_attach(unsigned int device, unsigned int drive, const char *name);
 void fsdevice_set_directory(char *filename, unsigned int unit);
+int fsdevice_write_channel_open(unsigned int unit);
 
 #endif
@@ -28,7 +28,9 @@
 
 #include "vice.h"
 
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "archdep.h"
 #include "charset.h"
@@ -94,16 +96,277 @@
 
 #define MAXDIRPOSMARK (10+26+26)
 
-static int _limit_longname(archdep_dir_t *archdep_dir, vdrive_t *vdrive, char *longname, int mode)
+static const char *dirposmark[2] = {
+    "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ",
+    "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"};
+
+/*
+    The names in the work directory of each unit are kept in a cache, so a
+    directory listing or opening a file does not have to scan the host
+    directory again for every name.
+
+    For every entry the cache holds the name (ASCII and PETSCII), the short
+    name as it is listed in either mode, and the name that expand_shortname
+    matches against. The tables are sorted so that names are found with a
+    binary search. The cache is rebuilt when the work directory changes, when
+    the modification time of the host directory changes and after fsdevice
+    created, renamed or removed a file itself.
+*/
+
+typedef struct fsdevice_dircache_s {
+    char *path;
+    time_t mtime;
+    time_t scantime;
+    int num;
+    char **name[2];         /* name of the entry, ASCII and PETSCII */
+    char **shortname[2];    /* shortened name or NULL if it can not be shortened */
+    char **expandname[2];   /* name expand_shortname compares against */
+    int *name_index[2];     /* entries sorted by name */
+    int *expand_index[2];   /* entries sorted by expandname */
+} fsdevice_dircache_t;
+
+static fsdevice_dircache_t dircache[FSDEVICE_DEVICE_MAX];
+
+/* table used by the qsort() comparison functions */
+static char **dircache_sort_names;
+
+static int dircache_compare(const void *a, const void *b)
+{
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+    int r = strcmp(dircache_sort_names[ia], dircache_sort_names[ib]);
+
+    /* keep the order of the directory for equal names */
+    return r ? r : ia - ib;
+}
+
+static int dircache_compare_prefix(const void *a, const void *b)
+{
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+    int r = strncmp(dircache_sort_names[ia], dircache_sort_names[ib], 14);
+
+    return r ? r : ia - ib;
+}
+
+static int *dircache_sort(fsdevice_dircache_t *dc, char **names,
+                          int (*compare)(const void *, const void *))
+{
+    int *index;
+    int i;
+
+    index = lib_malloc((dc->num ? dc->num : 1) * sizeof(int));
+    for (i = 0; i < dc->num; i++) {
+        index[i] = i;
+    }
+    dircache_sort_names = names;
+    qsort(index, (size_t)dc->num, sizeof(int), compare);
+    return index;
+}
+
+/* find the first entry (in directory order) with the given name, or -1 */
+static int dircache_find(fsdevice_dircache_t *dc, char **names, int *index, const char *name)
+{
+    int lo = 0;
+    int hi = dc->num;
+    int mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (strcmp(names[index[mid]], name) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < dc->num && !strcmp(names[index[lo]], name)) {
+        return index[lo];
+    }
+    return -1;
+}
+
+/* create the short names for 'mode'. the entries that have the same first 14
+   characters are counted in directory order, the count goes into the short
+   name, followed by the marker */
+static void dircache_make_shortnames(fsdevice_dircache_t *dc, int mode)
+{
+    char **names = dc->name[mode];
+    int *index;
+    int i, start, dirpos;
+    char *shortname;
+
+    dc->shortname[mode] = lib_calloc((dc->num ? dc->num : 1), sizeof(char *));
+
+    index = dircache_sort(dc, names, dircache_compare_prefix);
+    for (i = 0, start = 0; i < dc->num; i++) {
+        if (strncmp(names[index[start]], names[index[i]], 14)) {
+            start = i;
+        }
+        if (strlen(names[index[i]]) <= 16) {
+            continue;
+        }
+        dirpos = i - start + 1;
+        if (dirpos >= MAXDIRPOSMARK) {
+            log_error(LOG_DEFAULT, "could not make a unique short name for '%s'", names[index[i]]);
+            continue;
+        }
+        shortname = lib_strdup(names[index[i]]);
+        shortname[14] = dirposmark[mode][dirpos];
+        shortname[15] = LONGNAMEMARKER;
+        shortname[16] = 0;
+        dc->shortname[mode][index[i]] = shortname;
+    }
+    lib_free(index);
+
+    /* an entry with the same name as an earlier one gets its short name */
+    index = dircache_sort(dc, names, dircache_compare);
+    for (i = 1; i < dc->num; i++) {
+        if (!strcmp(names[index[i - 1]], names[index[i]])) {
+            lib_free(dc->shortname[mode][index[i]]);
+            dc->shortname[mode][index[i]] = NULL;
+            if (dc->shortname[mode][index[i - 1]] != NULL) {
+                dc->shortname[mode][index[i]] = lib_strdup(dc->shortname[mode][index[i - 1]]);
+            }
+        }
+    }
+    dc->name_index[mode] = index;
+}
+
+static void dircache_free(fsdevice_dircache_t *dc)
+{
+    int i, mode;
+
+    for (mode = 0; mode < 2; mode++) {
+        for (i = 0; i < dc->num; i++) {
+            lib_free(dc->name[mode][i]);
+            lib_free(dc->shortname[mode][i]);
+            lib_free(dc->expandname[mode][i]);
+        }
+        lib_free(dc->name[mode]);
+        lib_free(dc->shortname[mode]);
+        lib_free(dc->expandname[mode]);
+        lib_free(dc->name_index[mode]);
+        lib_free(dc->expand_index[mode]);
+        dc->name[mode] = NULL;
+        dc->shortname[mode] = NULL;
+        dc->expandname[mode] = NULL;
+        dc->name_index[mode] = NULL;
+        dc->expand_index[mode] = NULL;
+    }
+    lib_free(dc->path);
+    dc->path = NULL;
+    dc->num = 0;
+}
+
+static int dircache_scan(fsdevice_dircache_t *dc, const char *path)
 {
+    archdep_dir_t *host_dir;
     const char *direntry;
-    char newname[ARCHDEP_PATH_MAX];
+    int i, mode;
+
+    dircache_free(dc);
+
+    archdep_stat_mtime(path, &dc->mtime);
+    dc->scantime = time(NULL);
+
+    host_dir = archdep_opendir(path, ARCHDEP_OPENDIR_ALL_FILES);
+    if (host_dir == NULL) {
+        return -1;
+    }
+
+    dc->path = lib_strdup(path);
+    dc->num = archdep_readdir_num_entries(host_dir);
+    for (mode = 0; mode < 2; mode++) {
+        dc->name[mode] = lib_calloc((dc->num ? dc->num : 1), sizeof(char *));
+        dc->expandname[mode] = lib_calloc((dc->num ? dc->num : 1), sizeof(char *));
+    }
+
+    for (i = 0; i < dc->num; i++) {
+        direntry = archdep_readdir(host_dir);
+        dc->name[0][i] = lib_strdup(direntry);
+        dc->name[1][i] = lib_strdup(direntry);
+        charset_petconvstring((uint8_t *)dc->name[1][i], CONVERT_TO_PETSCII);   /* ASCII name to PETSCII */
+    }
+    archdep_closedir(host_dir);
+
+    for (mode = 0; mode < 2; mode++) {
+        dircache_make_shortnames(dc, mode);
+    }
+
+    /* expand_shortname always shortens the ASCII name */
+    for (i = 0; i < dc->num; i++) {
+        dc->expandname[0][i] = lib_strdup(dc->shortname[0][i] ? dc->shortname[0][i] : dc->name[0][i]);
+        dc->expandname[1][i] = lib_strdup(dc->expandname[0][i]);
+        charset_petconvstring((uint8_t *)dc->expandname[1][i], CONVERT_TO_PETSCII);   /* ASCII name to PETSCII */
+    }
+    for (mode = 0; mode < 2; mode++) {
+        dc->expand_index[mode] = dircache_sort(dc, dc->expandname[mode], dircache_compare);
+    }
+
+    DBG(("dircache_scan '%s' %d entries\n", path, dc->num));
+    return 0;
+}
+
+/* get the cache for the work directory of 'vdrive', scanning it if needed */
+static fsdevice_dircache_t *dircache_get(vdrive_t *vdrive)
+{
+    fsdevice_dircache_t *dc;
+    char *path;
+    time_t mtime;
+
+    if (vdrive->unit < 8 || vdrive->unit >= 8 + FSDEVICE_DEVICE_MAX) {
+        return NULL;
+    }
+    dc = &dircache[vdrive->unit - 8];
+
+    path = fsdevice_get_path(vdrive->unit);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    /* a change within the second of the last scan does not show in the
+       modification time, so do not trust the cache until a later scan */
+    if (dc->path != NULL && !strcmp(dc->path, path)
+        && archdep_stat_mtime(path, &mtime) == 0
+        && mtime == dc->mtime && dc->scantime > mtime) {
+        return dc;
+    }
+
+    if (dircache_scan(dc, path) < 0) {
+        return NULL;
+    }
+    return dc;
+}
+
+/* drop the cache of 'unit' after fsdevice changed its work directory */
+void fsdevice_dircache_invalidate(unsigned int unit)
+{
+    if (unit >= 8 && unit < 8 + FSDEVICE_DEVICE_MAX) {
+        dircache_free(&dircache[unit - 8]);
+    }
+}
+
+void fsdevice_dircache_shutdown(void)
+{
+    int i;
+
+    for (i = 0; i < FSDEVICE_DEVICE_MAX; i++) {
+        dircache_free(&dircache[i]);
+    }
+}
+
+/*
+    convert real (long) name into shortened representation
+
+    mode    0 - name is ASCII
+            1 - name is PETSCII
+*/
+
+static int limit_longname(vdrive_t *vdrive, char *longname, int mode)
+{
+    fsdevice_dircache_t *dc;
     int longnames;
-    int dirpos = 0;
-    int tmppos;
-    char *dirposmark[2] = {
-        "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ",
-        "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"};
+    int i;
 
     DBG(("limit_longname enter '%s' mode: %d\n", longname, mode));
     if (resources_get_int("FSDeviceLongNames", &longnames) < 0) {
@@ -112,38 +375,18 @@ static int _limit_longname(archdep_dir_t *archdep_dir, vdrive_t *vdrive, char *l
 
     if (!longnames) {
         if (strlen(longname) > 16) {
-            tmppos = archdep_telldir(archdep_dir);
-            archdep_rewinddir(archdep_dir);
-
-            while(1) {
-                direntry = archdep_readdir(archdep_dir);
-                if (direntry == NULL) {
-                    break;
-                }
-                strcpy(newname, direntry);
-                if (mode) {
-                    charset_petconvstring((uint8_t *)newname, CONVERT_TO_PETSCII);   /* ASCII name to PETSCII */
-                }
-                if (!strncmp(newname, longname, 14)) {
-                    dirpos++;
-                    /* handle max count */
-                    if (dirpos == MAXDIRPOSMARK) {
-                        log_error(LOG_DEFAULT, "could not make a unique short name for '%s'", longname);
-                        archdep_seekdir(archdep_dir, tmppos);
-                        return -1;
-                    }
-                    DBG(("limit_longname found partial '%s'\n", longname));
-                }
-                DBG(("limit_longname>%d '%s'->'%s' (%s)\n", dirpos, direntry, newname, longname));
-                if (!strcmp(newname, longname)) {
-                    DBG(("limit_longname found full '%s'\n", longname));
-                    longname[14] = dirposmark[mode][dirpos];
-                    longname[15] = LONGNAMEMARKER;
-                    longname[16] = 0;
-                    break;
+            dc = dircache_get(vdrive);
+            if (dc == NULL) {
+                return -1;
+            }
+            i = dircache_find(dc, dc->name[mode], dc->name_index[mode], longname);
+            if (i >= 0) {
+                if (dc->shortname[mode][i] == NULL) {
+                    return -1;
                 }
+                DBG(("limit_longname found full '%s'\n", longname));
+                strcpy(longname, dc->shortname[mode][i]);
             }
-            archdep_seekdir(archdep_dir, tmppos);
         }
     }
     DBG(("limit_longname return '%s'\n", longname));
@@ -151,23 +394,6 @@ static int _limit_longname(archdep_dir_t *archdep_dir, vdrive_t *vdrive, char *l
     return 0;
 }
 
-static int limit_longname(vdrive_t *vdrive, char *longname, int mode)
-{
-    archdep_dir_t *archdep_dir;
-    char *prefix;
-    int ret = -1;
-
-    prefix = fsdevice_get_path(vdrive->unit);
-    DBG(("limit_longname path '%s'\n", prefix));
-
-    archdep_dir = archdep_opendir(prefix, ARCHDEP_OPENDIR_ALL_FILES);
-    if (archdep_dir != NULL) {
-        ret = _limit_longname(archdep_dir, vdrive, longname, mode);
-        archdep_closedir(archdep_dir);
-    }
-    return ret;
-}
-
 /*
     convert shortened name into the actual (long) name
 
@@ -177,11 +403,10 @@ static int limit_longname(vdrive_t *vdrive, char *longname, int mode)
 
 static char *expand_shortname(vdrive_t *vdrive, char *shortname, int mode)
 {
-    archdep_dir_t *host_dir;
-    const char *direntry;
-    char *prefix;
+    fsdevice_dircache_t *dc;
     char *longname;
     int longnames;
+    int i;
 
     if (resources_get_int("FSDeviceLongNames", &longnames) < 0) {
         longnames = 0;
@@ -193,36 +418,18 @@ static char *expand_shortname(vdrive_t *vdrive, char *shortname, int mode)
     longname = lib_malloc(ARCHDEP_PATH_MAX);
 
     if (!longnames) {
-        prefix = fsdevice_get_path(vdrive->unit);
-        DBG(("expand_shortname path '%s'\n", prefix));
-
-        host_dir = archdep_opendir(prefix, ARCHDEP_OPENDIR_ALL_FILES);
-        if (host_dir == NULL) {
+        dc = dircache_get(vdrive);
+        if (dc == NULL) {
+            lib_free(longname);
             return NULL;
         }
 
-        while(1) {
-            direntry = archdep_readdir(host_dir);
-            if (direntry == NULL) {
-                break;
-            }
-            /* create the short name for this entry and see if it matches */
-            strcpy(longname, direntry);
-            _limit_longname(host_dir, vdrive, longname, 0);
-            if (mode) {
-                charset_petconvstring((uint8_t *)longname, CONVERT_TO_PETSCII);   /* ASCII name to PETSCII */
-            }
-            DBG(("expand_shortname>'%s'->'%s'('%s')\n", direntry, longname, shortname));
-            if (!strcmp(longname, shortname)) {
-                strcpy(longname, direntry);
-                if (mode) {
-                    charset_petconvstring((uint8_t *)longname, CONVERT_TO_PETSCII);   /* ASCII name to PETSCII */
-                }
-                archdep_closedir(host_dir);
-                return longname;
-            }
+        i = dircache_find(dc, dc->expandname[mode], dc->expand_index[mode], shortname);
+        if (i >= 0) {
+            DBG(("expand_shortname>'%s'->'%s'\n", shortname, dc->name[mode][i]));
+            strcpy(longname, dc->name[mode][i]);
+            return longname;
         }
-        archdep_closedir(host_dir);
     }
     /* copy original string to the new name */
     strcpy(longname, shortname);
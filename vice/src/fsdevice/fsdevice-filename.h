@@ -38,4 +38,7 @@ int fsdevice_limit_namelength_ascii(vdrive_t *vdrive, char *name);
 char *fsdevice_expand_shortname(vdrive_t *vdrive, char *name);
 char *fsdevice_expand_shortname_ascii(vdrive_t *vdrive, char *name);
 
+void fsdevice_dircache_invalidate(unsigned int unit);
+void fsdevice_dircache_shutdown(void);
+
 #endif
@@ -797,10 +797,12 @@ void fsdevice_flush(vdrive_t *vdrive, unsigned int secondary)
                   here and only limit the last portion? */
         fsdevice_limit_createnamelength(vdrive, arg);
         er = fsdevice_flush_mkdir(vdrive, arg);
+        fsdevice_dircache_invalidate(vdrive->unit);
     } else if (!strcmp(cmd, "rd")) {
         realname = fsdevice_expand_shortname_ascii(vdrive, arg);
         er = fsdevice_flush_rmdir(vdrive, realname);
         lib_free(realname);
+        fsdevice_dircache_invalidate(vdrive->unit);
     } else if ((!strcmp(cmd, "ui")) || (!strcmp(cmd, "u9"))) {
         er = fsdevice_flush_reset();
     } else if ((!strcmp(cmd, "uj")) || (!strcmp(cmd, "u:"))) {
@@ -811,8 +813,10 @@ void fsdevice_flush(vdrive_t *vdrive, unsigned int secondary)
         er = fsdevice_flush_validate(vdrive);
     } else if (*cmd == 'n' && arg != NULL) {
         er = fsdevice_flush_new(vdrive, realarg);
+        fsdevice_dircache_invalidate(vdrive->unit);
     } else if (*cmd == 'r' && arg != NULL) {
         er = fsdevice_flush_rename(vdrive, realarg);
+        fsdevice_dircache_invalidate(vdrive->unit);
     } else if (*cmd == 'c' && arg != NULL) {
         /* FIXME: not implemented */
     } else if (*cmd == 'p') {
@@ -824,6 +828,7 @@ void fsdevice_flush(vdrive_t *vdrive, unsigned int secondary)
         realname = fsdevice_expand_shortname(vdrive, realarg);
         er = fsdevice_flush_scratch(vdrive, realarg);
         lib_free(realname);
+        fsdevice_dircache_invalidate(vdrive->unit);
     }
 
     fsdevice_error(vdrive, er);
@@ -285,6 +285,7 @@ static int fsdevice_open_file(vdrive_t *vdrive, unsigned int secondary,
 
         if (finfo != NULL) {
             bufinfo[secondary].fileio_info = finfo;
+            fsdevice_dircache_invalidate(vdrive->unit);
             fsdevice_error(vdrive, CBMDOS_IPE_OK);
             return FLOPPY_COMMAND_OK;
         } else {
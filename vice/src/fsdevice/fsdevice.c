@@ -46,6 +46,7 @@
 #include "cbmdos.h"
 #include "fileio.h"
 #include "fsdevice-close.h"
+#include "fsdevice-filename.h"
 #include "fsdevice-flush.h"
 #include "fsdevice-open.h"
 #include "fsdevice-read.h"
@@ -186,6 +187,29 @@ int fsdevice_error_get_byte(vdrive_t *vdrive, uint8_t *data)
     return rc;
 }
 
+/* Check if a file is open for writing on the given unit.  */
+int fsdevice_write_channel_open(unsigned int unit)
+{
+    bufinfo_t *bufinfo;
+    unsigned int i;
+
+    if (unit < 8 || unit >= 8 + FSDEVICE_DEVICE_MAX) {
+        return 0;
+    }
+
+    bufinfo = fsdevice_dev[unit - 8].bufinfo;
+
+    for (i = 0; i < FSDEVICE_BUFFER_MAX; i++) {
+        if (bufinfo[i].fileio_info != NULL
+            && (bufinfo[i].mode == Write
+                || bufinfo[i].mode == Append
+                || bufinfo[i].mode == Relative)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 int fsdevice_attach(unsigned int device, unsigned int drive, const char *name)
 {
     vdrive_t *vdrive;
@@ -247,4 +271,6 @@ void fsdevice_shutdown(void)
         lib_free(fsdevice_dev[i].errorl);
         lib_free(fsdevice_dev[i].cmdbuf);
     }
+
+    fsdevice_dircache_shutdown();
 }
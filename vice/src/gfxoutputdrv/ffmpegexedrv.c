@@ -230,6 +230,10 @@ static int current_audio_port = SOCKETS_RANGE_FIRST + 1;
 /* input video stream */
 #define INPUT_VIDEO_BPP     3
 
+/* palette appended to each frame in indexed mode, 256 native endian ARGB
+   words, as expected by the ffmpeg "pal8" raw video format */
+#define INPUT_PALETTE_SIZE  (256 * 4)
+
 static double time_base;
 static double fps;                  /* frames per second */
 static uint64_t framecounter = 0;   /* number of processed video frames */
@@ -289,6 +293,7 @@ static int video_codec;
 static int audio_bitrate;
 static int video_bitrate;
 static int video_halve_framerate;
+static int video_indexed;
 
 static int set_container_format(const char *val, void *param)
 {
@@ -368,6 +373,20 @@ static int set_video_halve_framerate(int value, void *param)
     return 0;
 }
 
+static int set_video_indexed(int value, void *param)
+{
+    int val = value ? 1 : 0;
+
+    if (video_indexed != val && screenshot_is_recording()) {
+        ui_error("Can't change the video input format while recording. Try again later.");
+        return 0;
+    }
+
+    video_indexed = val;
+
+    return 0;
+}
+
 /*---------- Resources ------------------------------------------------*/
 
 static const resource_string_t resources_string[] = {
@@ -391,6 +410,8 @@ static const resource_int_t resources_int[] = {
       &video_codec, set_video_codec, NULL },
     { "FFMPEGVideoHalveFramerate", 0, RES_EVENT_NO, NULL,
       &video_halve_framerate, set_video_halve_framerate, NULL },
+    { "FFMPEGVideoIndexed", 0, RES_EVENT_NO, NULL,
+      &video_indexed, set_video_indexed, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -417,6 +438,12 @@ static const cmdline_option_t cmdline_options[] =
     { "-ffmpegvideobitrate", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "FFMPEGVideoBitrate", NULL,
       "<value>", "Set bitrate for video stream in media file" },
+    { "-ffmpegvideoindexed", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "FFMPEGVideoIndexed", (resource_value_t)1,
+      NULL, "Pass palettised frames to ffmpeg and let it do the RGB conversion" },
+    { "+ffmpegvideoindexed", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "FFMPEGVideoIndexed", (resource_value_t)0,
+      NULL, "Pass RGB frames to ffmpeg" },
     CMDLINE_LIST_END
 };
 
@@ -436,6 +463,7 @@ static void log_resource_values(const char *func)
     DBG(("%s FFMPEGAudioCodec:%d:'%s'", func, audio_codec, av_codec_get_option(audio_codec)));
     DBG(("%s FFMPEGAudioBitrate:%d", func, audio_bitrate));
     DBG(("%s FFMPEGVideoHalveFramerate:%d", func, video_halve_framerate));
+    DBG(("%s FFMPEGVideoIndexed:%d", func, video_indexed));
 }
 
 static void prepare_port_numbers(void)
@@ -449,9 +477,18 @@ static void prepare_port_numbers(void)
     log_message(ffmpeg_log, "prepare_port_numbers %d:%d", current_video_port, current_audio_port);
 }
 
+/* size of one frame as sent to ffmpeg */
+static ssize_t video_frame_size(void)
+{
+    if (video_indexed) {
+        return (video_height * video_width) + INPUT_PALETTE_SIZE;
+    }
+    return INPUT_VIDEO_BPP * video_height * video_width;
+}
+
 static ssize_t write_video_frame(VIDEOFrame *pic)
 {
-    ssize_t len = INPUT_VIDEO_BPP * video_height * video_width;
+    ssize_t len = video_frame_size();
     ssize_t res;
 
     if ((video_has_codec > 0) && (video_codec != AV_CODEC_ID_NONE)) {
@@ -473,7 +510,7 @@ static int write_initial_video_frames(void)
     int len;
     int frm;
     /* clear frame */
-    len = INPUT_VIDEO_BPP * video_height * video_width;
+    len = (int)video_frame_size();
     DBG(("video len:%d (%d)", len, len * DUMMY_FRAMES_VIDEO));
     memset(video_st_frame->data, 0, len);
     for (frm = 0; frm < DUMMY_FRAMES_VIDEO; frm++) {
@@ -678,7 +715,7 @@ static int start_ffmpeg_executable(void)
     if ((video_has_codec > 0) && (video_codec != AV_CODEC_ID_NONE)) {
         sprintf(tempcommand,
                 "-f rawvideo "
-                "-pixel_format rgb24 "
+                "-pixel_format %s "
                 "-framerate %s "              /* exact fps */
                 "-r %s "              /* exact fps */
                 "-s %dx%d "                         /* size */
@@ -690,6 +727,7 @@ static int start_ffmpeg_executable(void)
 #else
                 "-i tcp://127.0.0.1:%d?listen "
 #endif
+                , video_indexed ? "pal8" : "rgb24"
                 , fpsstring, fpsstring
                 , video_width, video_height
                 , current_video_port
@@ -1097,6 +1135,29 @@ static int video_fill_rgb_image(screenshot_t *screenshot, VIDEOFrame *pic)
     bufferoffset = screenshot->x_offset + (dx < 0 ? -dx : 0)
         + (screenshot->y_offset + (dy < 0 ? -dy : 0)) * screenshot->draw_buffer_line_size;
 
+    if (video_indexed) {
+        /* copy the pixels as they are and append the palette, ffmpeg
+           converts to RGB on its side */
+        uint8_t *pal = pic->data + (video_width * video_height);
+        unsigned int i;
+
+        pic->linesize = video_width;
+        for (y = 0; y < video_height; y++) {
+            memcpy(pic->data + pix, screenshot->draw_buffer + bufferoffset, video_width);
+            bufferoffset += screenshot->draw_buffer_line_size;
+            pix += pic->linesize;
+        }
+        memset(pal, 0, INPUT_PALETTE_SIZE);
+        for (i = 0; i < screenshot->palette->num_entries && i < 256; i++) {
+            uint32_t argb = 0xff000000U
+                            | ((uint32_t)screenshot->palette->entries[i].red << 16)
+                            | ((uint32_t)screenshot->palette->entries[i].green << 8)
+                            | (uint32_t)screenshot->palette->entries[i].blue;
+            memcpy(pal + (i * 4), &argb, 4);
+        }
+        return 0;
+    }
+
     for (y = 0; y < video_height; y++) {
         for (x = 0; x < video_width; x++) {
             colnum = screenshot->draw_buffer[bufferoffset + x];
@@ -1112,7 +1173,7 @@ static int video_fill_rgb_image(screenshot_t *screenshot, VIDEOFrame *pic)
 }
 
 /* called by ffmpegexedrv_open_video() */
-static VIDEOFrame* video_alloc_picture(int bpp, int width, int height)
+static VIDEOFrame* video_alloc_picture(int size, int width)
 {
     VIDEOFrame *picture;
 
@@ -1120,7 +1181,7 @@ static VIDEOFrame* video_alloc_picture(int bpp, int width, int height)
     if (!picture) {
         return NULL;
     }
-    picture->data = lib_malloc(bpp * width * height);
+    picture->data = lib_malloc(size);
     if (!picture->data) {
         lib_free(picture);
         log_debug(ffmpeg_log, "ffmpegexedrv: Could not allocate frame data");
@@ -1145,7 +1206,7 @@ static int ffmpegexedrv_open_video(void)
     video_is_open = 1;
 
     /* allocate the encoded raw picture */
-    video_st_frame = video_alloc_picture(INPUT_VIDEO_BPP, video_width, video_height);
+    video_st_frame = video_alloc_picture((int)video_frame_size(), video_width);
     if (!video_st_frame) {
         log_debug(ffmpeg_log, "ffmpegexedrv: could not allocate picture");
         return -1;
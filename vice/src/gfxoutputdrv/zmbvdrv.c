@@ -33,6 +33,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#endif
+
 #include "archdep.h"
 #include "cmdline.h"
 #include "gfxoutput.h"
@@ -78,18 +82,71 @@
 /* each KEYFRAME_INTERVAL frame will be key one */
 #define KEYFRAME_INTERVAL  (300)
 
+/* frames and audio chunks waiting for the encoder */
+#define QUEUE_FRAMES    4
+#define QUEUE_JOBS      64
+
 /******************************************************************************/
 
 static int frameno = 0;
 
+/* a keyframe is due, cleared by the next frame actually encoded. Dropped
+   frames only repeat the previous one, so they cannot be keyframes. */
+static int keyframe_due = 0;
+
 static zmvb_init_flags_t iflg = ZMBV_INIT_FLAG_NONE;
 
 static int complevel = -1;  /* compression level, -1 means default */
 static int no_zlib = 0;
 
-static uint8_t cur_pal[PALETTE_SIZE];
+/*
+ * Encoding and writing the file is done by a worker thread if the emulator
+ * is built with threads. The emulation thread only copies the palettised
+ * frame (or the audio samples) into the queue. When all frame buffers are
+ * in use, the emulation thread either waits for the encoder or the frame is
+ * dropped (written as an empty chunk, which repeats the previous frame),
+ * depending on ZMBVDropFrames. Without threads, every job is encoded right
+ * away.
+ */
+enum {
+    JOB_VIDEO,
+    JOB_VIDEO_DROPPED,
+    JOB_AUDIO
+};
 
-static int16_t cur_audio[MAX_AUDIO_BUFFER_SIZE];
+typedef struct zmbv_job_s {
+    int type;
+    int frame;  /* frame buffer used by JOB_VIDEO */
+    int size;   /* bytes of audio used by JOB_AUDIO */
+    int16_t audio[MAX_AUDIO_BUFFER_SIZE];
+} zmbv_job_t;
+
+typedef struct zmbv_frame_s {
+    uint8_t *screen;
+    uint8_t pal[PALETTE_SIZE];
+} zmbv_frame_t;
+
+static zmbv_job_t *jobs = NULL;
+static zmbv_frame_t frames[QUEUE_FRAMES];
+static int num_jobs;
+static int num_frames;
+static int job_head, job_tail, job_count;
+static int frame_head, frames_free;
+static int encode_error;
+
+/* statistics, reported when the recording is stopped */
+static unsigned int frames_recorded;
+static unsigned int frames_dropped;
+static unsigned int encoder_waits;
+
+#ifdef USE_VICE_THREAD
+static pthread_t encode_thread;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_space_cond = PTHREAD_COND_INITIALIZER;
+static int encode_thread_running = 0;
+static int encode_thread_quit;
+#endif
 
 static zmbv_avi_t zavi;
 static zmbv_codec_t zcodec;
@@ -101,8 +158,6 @@ static void *video_work_buffer = NULL;
 static int video_codec;
 static int audio_codec;
 
-static uint8_t *cur_screen = NULL;
-
 /* general */
 static int file_init_done = 1;
 
@@ -121,6 +176,7 @@ static unsigned int framecounter;
 /* resources */
 static int format_index = 0;
 static char *zmbv_format = NULL;
+static int drop_frames = 0;
 
 /* these are dictated by the emulator */
 static int audio_freq = 48000;    /* initialized by zmbv_soundmovie_init */
@@ -218,6 +274,12 @@ static int set_video_codec(int val, void *param)
     return 0;
 }
 
+static int set_drop_frames(int val, void *param)
+{
+    drop_frames = val ? 1 : 0;
+    return 0;
+}
+
 /*---------- Resources ------------------------------------------------*/
 
 static const resource_string_t resources_string[] = {
@@ -231,6 +293,8 @@ static const resource_int_t resources_int[] = {
       &audio_codec, set_audio_codec, NULL },
     { "ZMBVVideoCodec", AV_CODEC_ID_ZMBV, RES_EVENT_NO, NULL,
       &video_codec, set_video_codec, NULL },
+    { "ZMBVDropFrames", 0, RES_EVENT_NO, NULL,
+      &drop_frames, set_drop_frames, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -248,6 +312,12 @@ static int zmbvdrv_resources_init(void)
 
 static const cmdline_option_t cmdline_options[] =
 {
+    { "-zmbvdropframes", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "ZMBVDropFrames", (resource_value_t)1,
+      NULL, "Drop video frames when the ZMBV encoder can not keep up" },
+    { "+zmbvdropframes", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "ZMBVDropFrames", (resource_value_t)0,
+      NULL, "Wait for the ZMBV encoder when it can not keep up" },
     CMDLINE_LIST_END
 };
 
@@ -259,6 +329,226 @@ static int zmbvdrv_cmdline_options_init(void)
 
 /*---------------------------------------------------------------------*/
 
+/*---------------*/
+/* encoder queue */
+/*---------------*/
+
+static void zmbvdrv_next_frame(void)
+{
+    if (frameno % KEYFRAME_INTERVAL == 0) {
+        keyframe_due = 1;
+    }
+    frameno++;
+}
+
+static int zmbvdrv_encode_frame(zmbv_frame_t *frame)
+{
+    int32_t written;
+    int flags;
+    int y;
+
+    zmbvdrv_next_frame();
+    flags = (keyframe_due ? ZMBV_PREP_FLAG_KEYFRAME : ZMBV_PREP_FLAG_NONE);
+    keyframe_due = 0;
+
+    LOGFRAMES(("zmbvdrv_encode_frame: frame %d", frameno));
+
+    /* encode video frame */
+    if (zmbv_encode_prepare_frame(zcodec, flags, fmt, frame->pal, video_work_buffer, work_buffer_size) < 0) {
+        LOG(("FATAL: can't prepare frame for screen #%d", frameno));
+        return -1;
+    }
+    for (y = 0; y < video_height; ++y) {
+        if (zmbv_encode_line(zcodec, frame->screen + (y * video_width)) < 0) {
+            LOG(("FATAL: can't encode line #%d for screen #%d", y, frameno));
+            return -1;
+        }
+    }
+    written = zmvb_encode_finish_frame(zcodec);
+    if (written < 0) {
+        LOG(("FATAL: can't finish frame for screen #%d", frameno));
+        return -1;
+    }
+    /* write avi chunk */
+    if (zmbv_avi_write_chunk_video(zavi, video_work_buffer, written) < 0) {
+        LOG(("FATAL: can't write compressed frame for screen #%d", frameno));
+        return -1;
+    }
+    return 0;
+}
+
+static int zmbvdrv_process_job(zmbv_job_t *job)
+{
+    switch (job->type) {
+        case JOB_VIDEO:
+            return zmbvdrv_encode_frame(&frames[job->frame]);
+        case JOB_VIDEO_DROPPED:
+            zmbvdrv_next_frame();
+            return zmbv_avi_write_chunk_video_empty(zavi);
+        case JOB_AUDIO:
+            if (zmbv_avi_write_chunk_audio(zavi, job->audio, job->size) < 0) {
+                LOG(("FATAL: can't write audio frame for screen #%d", frameno));
+                return -1;
+            }
+            return 0;
+    }
+    return -1;
+}
+
+#ifdef USE_VICE_THREAD
+static void *zmbvdrv_encode_thread(void *unused)
+{
+    zmbv_job_t *job;
+    int res;
+
+    pthread_mutex_lock(&queue_lock);
+    for (;;) {
+        while (job_count == 0 && !encode_thread_quit) {
+            pthread_cond_wait(&queue_job_cond, &queue_lock);
+        }
+        if (job_count == 0) {
+            break;
+        }
+        job = &jobs[job_tail];
+        pthread_mutex_unlock(&queue_lock);
+
+        res = zmbvdrv_process_job(job);
+
+        pthread_mutex_lock(&queue_lock);
+        if (res < 0) {
+            encode_error = 1;
+        }
+        if (job->type == JOB_VIDEO) {
+            frames_free++;
+        }
+        job_tail = (job_tail + 1) % num_jobs;
+        job_count--;
+        pthread_cond_broadcast(&queue_space_cond);
+    }
+    pthread_mutex_unlock(&queue_lock);
+
+    return NULL;
+}
+#endif
+
+/* Get the next job to fill, for a video job this also decides whether the
+   frame is encoded or dropped. */
+static zmbv_job_t *zmbvdrv_job_reserve(int video)
+{
+    zmbv_job_t *job;
+
+#ifdef USE_VICE_THREAD
+    pthread_mutex_lock(&queue_lock);
+    while (job_count == num_jobs || (video && frames_free == 0 && !drop_frames)) {
+        encoder_waits++;
+        pthread_cond_wait(&queue_space_cond, &queue_lock);
+    }
+#endif
+    job = &jobs[job_head];
+    if (!video) {
+        job->type = JOB_AUDIO;
+    } else if (frames_free > 0) {
+        job->type = JOB_VIDEO;
+        job->frame = frame_head;
+        frame_head = (frame_head + 1) % num_frames;
+        frames_free--;
+        frames_recorded++;
+    } else {
+        job->type = JOB_VIDEO_DROPPED;
+        frames_dropped++;
+    }
+#ifdef USE_VICE_THREAD
+    pthread_mutex_unlock(&queue_lock);
+#endif
+    return job;
+}
+
+/* hand the filled job to the encoder */
+static int zmbvdrv_job_commit(zmbv_job_t *job)
+{
+#ifdef USE_VICE_THREAD
+    int res;
+
+    pthread_mutex_lock(&queue_lock);
+    job_head = (job_head + 1) % num_jobs;
+    job_count++;
+    res = encode_error ? -1 : 0;
+    pthread_cond_signal(&queue_job_cond);
+    pthread_mutex_unlock(&queue_lock);
+    return res;
+#else
+    int res = zmbvdrv_process_job(job);
+
+    if (job->type == JOB_VIDEO) {
+        frames_free++;
+    }
+    return res;
+#endif
+}
+
+static int zmbvdrv_queue_start(void)
+{
+    int i;
+
+#ifdef USE_VICE_THREAD
+    num_jobs = QUEUE_JOBS;
+    num_frames = QUEUE_FRAMES;
+#else
+    num_jobs = 1;
+    num_frames = 1;
+#endif
+    jobs = lib_malloc(num_jobs * sizeof(zmbv_job_t));
+    for (i = 0; i < num_frames; i++) {
+        frames[i].screen = lib_malloc(video_width * video_height);
+    }
+    job_head = job_tail = job_count = 0;
+    frame_head = 0;
+    frames_free = num_frames;
+    encode_error = 0;
+    frames_recorded = frames_dropped = encoder_waits = 0;
+
+#ifdef USE_VICE_THREAD
+    encode_thread_quit = 0;
+    if (pthread_create(&encode_thread, NULL, zmbvdrv_encode_thread, NULL) != 0) {
+        log_error(LOG_DEFAULT, "zmbvdrv: Cannot start encoder thread");
+        return -1;
+    }
+    encode_thread_running = 1;
+#endif
+    return 0;
+}
+
+/* wait until everything queued is written, then free the queue */
+static void zmbvdrv_queue_stop(void)
+{
+    int i;
+
+    if (jobs == NULL) {
+        return;
+    }
+
+#ifdef USE_VICE_THREAD
+    if (encode_thread_running) {
+        pthread_mutex_lock(&queue_lock);
+        encode_thread_quit = 1;
+        pthread_cond_signal(&queue_job_cond);
+        pthread_mutex_unlock(&queue_lock);
+        pthread_join(encode_thread, NULL);
+        encode_thread_running = 0;
+    }
+#endif
+
+    log_message(LOG_DEFAULT, "zmbvdrv: %u frames recorded, %u dropped, waited %u times for the encoder.",
+                frames_recorded, frames_dropped, encoder_waits);
+
+    for (i = 0; i < num_frames; i++) {
+        lib_free(frames[i].screen);
+        frames[i].screen = NULL;
+    }
+    lib_free(jobs);
+    jobs = NULL;
+}
+
 /*-----------------------*/
 /* audio stream encoding */
 /*-----------------------*/
@@ -333,34 +623,34 @@ static int zmbv_soundmovie_encode(soundmovie_buffer_t *audio_in)
     LOGFRAMES(("zmbv_soundmovie_encode(size:%d used:%d channels:%d) clk:%ld frame:%d",
                audio_in->size, audio_in->used, audio_channels, clk_this_audio_frame, frameno));
 
+    if (!file_init_done) {
+        audio_in->used = 0;
+        return 0;
+    }
+
     /* FIXME: we might have an endianess problem here, we might have to swap lo/hi on BE machines */
     if (audio_channels == 1) {
         int i, o;
+        zmbv_job_t *job = zmbvdrv_job_reserve(0);
 #if 1
         /* convert mono -> stereo */
         for (i = o = 0; i < audio_in->used; i++, o+=2) {
-            cur_audio[o] = audio_in->buffer[i];
-            cur_audio[o+1] = audio_in->buffer[i];
-        }
-        /* write avi chunks */
-        if (zmbv_avi_write_chunk_audio(zavi, &cur_audio[0], audio_in->used * 4) < 0) {
-            LOG(("FATAL: can't write audio frame for screen #%d", frameno));
-            ret = -1;
+            job->audio[o] = audio_in->buffer[i];
+            job->audio[o+1] = audio_in->buffer[i];
         }
+        job->size = audio_in->used * 4;
 #else
         /* FIXME: we should write the mono stream into the avi instead */
 #endif
+        /* write avi chunks */
+        ret = zmbvdrv_job_commit(job);
     } else if (audio_channels == 2) {
-        int i, o;
-        for (i = o = 0; i < audio_in->used; i+=2, o+=2) {
-            cur_audio[o] = audio_in->buffer[i];
-            cur_audio[o+1] = audio_in->buffer[i+1];
-        }
+        zmbv_job_t *job = zmbvdrv_job_reserve(0);
+
+        memcpy(job->audio, audio_in->buffer, audio_in->used * 2);
+        job->size = audio_in->used * 2;
         /* write avi chunks */
-        if (zmbv_avi_write_chunk_audio(zavi, &audio_in->buffer[0], audio_in->used * 2) < 0) {
-            LOG(("FATAL: can't write audio frame for screen #%d", frameno));
-            ret = -1;
-        }
+        ret = zmbvdrv_job_commit(job);
     } else {
         ret = -1;
     }
@@ -387,7 +677,7 @@ static soundmovie_funcs_t zmbvdrv_soundmovie_funcs = {
 /*-----------------------*/
 /* video stream encoding */
 /*-----------------------*/
-static int zmbvdrv_fill_rgb_image(screenshot_t *screenshot)
+static int zmbvdrv_fill_rgb_image(screenshot_t *screenshot, zmbv_frame_t *frame)
 {
     int x, y;
     int dx, dy;
@@ -406,15 +696,15 @@ static int zmbvdrv_fill_rgb_image(screenshot_t *screenshot)
         + (screenshot->y_offset + (dy < 0 ? -dy : 0)) * screenshot->draw_buffer_line_size;
 
     for (x = 0; x < PALETTE_NUM_COLORS; x++) {
-        cur_pal[(x * (PALETTE_COLORS_BPP / 8)) + 0] = screenshot->palette->entries[x].red;
-        cur_pal[(x * (PALETTE_COLORS_BPP / 8)) + 1] = screenshot->palette->entries[x].green;
-        cur_pal[(x * (PALETTE_COLORS_BPP / 8)) + 2] = screenshot->palette->entries[x].blue;
+        frame->pal[(x * (PALETTE_COLORS_BPP / 8)) + 0] = screenshot->palette->entries[x].red;
+        frame->pal[(x * (PALETTE_COLORS_BPP / 8)) + 1] = screenshot->palette->entries[x].green;
+        frame->pal[(x * (PALETTE_COLORS_BPP / 8)) + 2] = screenshot->palette->entries[x].blue;
     }
 
     LOGFRAMES(("zmbvdrv_fill_rgb_image video_width/height: %dx%d", video_width, video_height));
     for (y = 0; y < video_height; y++) {
         for (x = 0; x < video_width; x++) {
-            cur_screen[(y * video_width) + x] = screenshot->draw_buffer[bufferoffset + x];
+            frame->screen[(y * video_width) + x] = screenshot->draw_buffer[bufferoffset + x];
         }
         bufferoffset += screenshot->draw_buffer_line_size;
     }
@@ -423,25 +713,14 @@ static int zmbvdrv_fill_rgb_image(screenshot_t *screenshot)
     return 0;
 }
 
-static uint8_t *zmbvdrv_alloc_picture(int width, int height)
-{
-    /* the pixel format is always 8bpp, with a 256 entries, 24bit, palette */
-    LOG(("zmbvdrv_alloc_picture width:%d height:%d", width, height));
-    return lib_malloc(width * height);
-}
-
 /* called by zmbvdrv_init_file() */
 static int zmbvdrv_open_video(int width, int height)
 {
     LOG(("zmbvdrv_open_video width:%d height:%d", width, height));
     /* MOVE? open the codec */
     video_is_open = 1;
-    /* FIXME: allocate the encoded raw picture */
-    cur_screen = zmbvdrv_alloc_picture(width, height);
-    if (cur_screen == NULL) {
-        return -1;
-    }
-    return 0;
+    /* the pixel format is always 8bpp, with a 256 entries, 24bit, palette */
+    return zmbvdrv_queue_start();
 }
 
 /* called by zmbvdrv_close() */
@@ -449,10 +728,7 @@ static void zmbvdrv_close_video(void)
 {
     LOG(("zmbvdrv_close_video"));
     video_is_open = 0;
-    if (cur_screen != NULL) {
-        lib_free (cur_screen);
-        cur_screen = NULL;
-    }
+    zmbvdrv_queue_stop();
 }
 /* called by zmbvdrv_save */
 static void zmbvdrv_init_video(screenshot_t *screenshot)
@@ -554,6 +830,7 @@ static int zmbvdrv_save(screenshot_t *screenshot, const char *filename)
     }
 
     frameno = 0;
+    keyframe_due = 0;
 
     soundmovie_start(&zmbvdrv_soundmovie_funcs);
 
@@ -590,9 +867,7 @@ static int zmbvdrv_close(screenshot_t *screenshot)
 /* triggered by screenshot_record, periodically called to output video data stream */
 static int zmbvdrv_record(screenshot_t *screenshot)
 {
-    int ret = -1;
-    int32_t written;
-    int flags;
+    zmbv_job_t *job;
     CLOCK clk_diff;
 
     if (audio_init_done && video_init_done && !file_init_done) {
@@ -617,38 +892,17 @@ static int zmbvdrv_record(screenshot_t *screenshot)
         }
     }
 
-    zmbvdrv_fill_rgb_image(screenshot);
-
-    flags = ((frameno % KEYFRAME_INTERVAL == 0) ? ZMBV_PREP_FLAG_KEYFRAME : ZMBV_PREP_FLAG_NONE);
-
-    frameno++;
-
-    LOGFRAMES(("zmbvdrv_record: frame %d (clk:%ld)", frameno, clk_this_video_frame));
-
-    /* encode video frame */
-    if (zmbv_encode_prepare_frame(zcodec, flags, fmt, cur_pal, video_work_buffer, work_buffer_size) < 0) {
-        LOG(("FATAL: can't prepare frame for screen #%d", frameno));
-        goto quit;
-    }
-    for (int y = 0; y < video_height; ++y) {
-        if (zmbv_encode_line(zcodec, cur_screen+(y*video_width)) < 0) {
-            LOG(("FATAL: can't encode line #%d for screen #%d", y, frameno));
-            goto quit;
-        }
-    }
-    written = zmvb_encode_finish_frame(zcodec);
-    if (written < 0) {
-        LOG(("FATAL: can't finish frame for screen #%d", frameno));
-        goto quit;
+    if (!file_init_done) {
+        /* waiting for the audio stream to be set up */
+        return 0;
     }
-    /* write avi chunk */
-    if (zmbv_avi_write_chunk_video(zavi, video_work_buffer, written) < 0) {
-        LOG(("FATAL: can't write compressed frame for screen #%d", frameno));
-        goto quit;
+
+    job = zmbvdrv_job_reserve(1);
+    if (job->type == JOB_VIDEO) {
+        zmbvdrv_fill_rgb_image(screenshot, &frames[job->frame]);
     }
-    ret = 0;
-quit:
-    if (ret < 0) {
+
+    if (zmbvdrv_job_commit(job) < 0) {
         log_debug(LOG_DEFAULT, "Error while writing video frame");
         return -1;
     }
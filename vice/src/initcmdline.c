@@ -312,6 +312,12 @@ static int cmdline_console(const char *param, void *extra_param)
 }
 #endif
 
+static int cmdline_maxthroughput(const char *param, void *extra_param)
+{
+    max_throughput_mode = true;
+    return 0;
+}
+
 static int cmdline_seed(const char *param, void *extra_param)
 {
     lib_rand_seed(strtoul(param, NULL, 0));
@@ -422,6 +428,9 @@ static const cmdline_option_t common_cmdline_options[] =
       cmdline_console, NULL, NULL, NULL,
       NULL, "Console mode (for music playback)" },
 #endif
+    { "-maxthroughput", CALL_FUNCTION, CMDLINE_ATTRIB_NONE,
+      cmdline_maxthroughput, NULL, NULL, NULL,
+      NULL, "Run as fast as possible without speed limit, display updates or sound output, and report the speed on exit" },
     { "-seed", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
       cmdline_seed, NULL, NULL, NULL,
       "<value>", "Set random seed (for debugging)" },
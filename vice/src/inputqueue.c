@@ -0,0 +1,178 @@
+/** \file   inputqueue.c
+ * \brief   Host input events timestamped in host time
+ *
+ * When "InputPollLines" is set, key events from the UI are not handed to the
+ * keyboard emulation right away. They are stamped with the host time and
+ * queued, and the emulation drains the queue every few raster lines. An event
+ * is delivered once the emulated clock has reached the point that the pacing
+ * clock in vsync.c maps its host time to, so events keep their spacing and
+ * land mid-frame instead of at the next frame or sync point.
+ *
+ * The SDL UI polls the host input on the VICE thread itself. The GTK3 UI
+ * posts key events to the main channel, stamped with the host time on the UI
+ * thread, and the VICE thread drains the channel whenever it polls the input,
+ * so those events keep their host time as well.
+ *
+ * The queue is only touched from the VICE thread, or with the mainlock held
+ * where a UI still calls into the keyboard code directly, so it needs no
+ * locking of its own.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include "archdep.h"
+#include "inputqueue.h"
+#include "keyboard.h"
+#include "log.h"
+#include "maincpu.h"
+#include "types.h"
+#include "vsync.h"
+
+#define INPUT_QUEUE_SIZE    64  /* must be a power of two */
+
+typedef struct input_event_s {
+    tick_t tick;        /* host time the event was queued */
+    signed long key;
+    int mod;
+    int pressed;
+} input_event_t;
+
+static input_event_t input_queue[INPUT_QUEUE_SIZE];
+static unsigned int input_queue_read;
+static unsigned int input_queue_write;
+
+static int input_queue_enabled = 0;
+
+/* set while events are handed to the keyboard, so they are not queued again */
+static int input_queue_delivering = 0;
+
+/* latency from queueing to delivery */
+static unsigned long stats_events;
+static uint64_t stats_latency_total;
+static tick_t stats_latency_max;
+
+static void deliver(const input_event_t *event)
+{
+    tick_t latency = tick_now_delta(event->tick);
+
+    stats_events++;
+    stats_latency_total += latency;
+    if (latency > stats_latency_max) {
+        stats_latency_max = latency;
+    }
+
+    input_queue_delivering = 1;
+    if (event->pressed) {
+        keyboard_key_pressed(event->key, event->mod);
+    } else {
+        keyboard_key_released(event->key, event->mod);
+    }
+    input_queue_delivering = 0;
+}
+
+/* take the oldest event off the queue before delivering it, the keyboard code
+   may clear the queue meanwhile */
+static void deliver_next(void)
+{
+    input_event_t event = input_queue[input_queue_read];
+
+    input_queue_read = (input_queue_read + 1) & (INPUT_QUEUE_SIZE - 1);
+    deliver(&event);
+}
+
+static void flush(void)
+{
+    while (input_queue_read != input_queue_write) {
+        deliver_next();
+    }
+}
+
+/** \brief  Turn queueing of host input on or off
+ *
+ * \param[in]   enable  queue key events instead of passing them on directly
+ */
+void input_queue_enable(int enable)
+{
+    if (!enable) {
+        flush();
+    }
+    input_queue_enabled = enable;
+}
+
+/** \brief  Queue a host key event
+ *
+ * \param[in]   key     VICE keysym
+ * \param[in]   mod     modifiers
+ * \param[in]   pressed 1 for a key press, 0 for a release
+ * \param[in]   tick    host time of the event
+ *
+ * \return  1 if the event was queued, 0 if the caller has to process it now
+ */
+int input_queue_key(signed long key, int mod, int pressed, tick_t tick)
+{
+    unsigned int next = (input_queue_write + 1) & (INPUT_QUEUE_SIZE - 1);
+
+    if (!input_queue_enabled || input_queue_delivering || next == input_queue_read) {
+        return 0;
+    }
+
+    input_queue[input_queue_write].tick = tick;
+    input_queue[input_queue_write].key = key;
+    input_queue[input_queue_write].mod = mod;
+    input_queue[input_queue_write].pressed = pressed;
+    input_queue_write = next;
+
+    return 1;
+}
+
+/** \brief  Deliver the queued events that are due at the current emulated time
+ */
+void input_queue_process(void)
+{
+    while (input_queue_read != input_queue_write) {
+        if (vsync_host_tick_to_clk(input_queue[input_queue_read].tick) > maincpu_clk) {
+            break;
+        }
+        deliver_next();
+    }
+}
+
+/** \brief  Drop all queued events, used when the keyboard state is cleared
+ */
+void input_queue_clear(void)
+{
+    input_queue_read = input_queue_write;
+}
+
+/** \brief  Log the latency statistics
+ */
+void input_queue_shutdown(void)
+{
+    if (stats_events > 0) {
+        log_message(LOG_DEFAULT, "Input queue: %lu events, latency avg %.3f ms, max %.3f ms.",
+                    stats_events,
+                    (double)TICK_TO_MICRO(stats_latency_total / stats_events) / 1000.0,
+                    (double)TICK_TO_MICRO(stats_latency_max) / 1000.0);
+    }
+}
@@ -225,6 +225,13 @@ static void joystick_latch_matrix(CLOCK offset)
     }
 }
 
+/* Apply the host joystick state latched so far again after the emulation
+   state was rewound by loading a snapshot. */
+void joystick_latch_resync(void)
+{
+    joystick_latch_matrix(maincpu_clk);
+}
+
 /*-----------------------------------------------------------------------*/
 
 static void joystick_event_record(void)
@@ -50,6 +50,7 @@
 #include "alarm.h"
 #include "archdep.h"
 #include "cmdline.h"
+#include "inputqueue.h"
 #include "joystick.h"
 #include "kbd.h"
 #include "keyboard.h"
@@ -333,6 +334,20 @@ static void keyboard_latch_matrix(CLOCK offset)
     }
 }
 
+/* Apply the host keys latched so far again after the emulation state was
+   rewound by loading a snapshot, and restart the delay of queued keys from
+   the new clock. */
+void keyboard_latch_resync(void)
+{
+    if (keyboard_latch_timestamp > maincpu_clk) {
+        keyboard_latch_timestamp = maincpu_clk;
+    }
+    keyboard_latch_matrix(maincpu_clk);
+    if (kbd_queue_read != kbd_queue_write) {
+        kbd_retrigger_alarm();
+    }
+}
+
 /* update keyboard latch, returns 0 on success, -1 on error */
 static int keyboard_set_latch_keyarr(int row, int col, int pressed)
 {
@@ -764,6 +779,11 @@ void keyboard_key_pressed(signed long key, int mod)
     DBGKEY(("keyboard_key_pressed:   [PRESSED]      maincpu_clk: %12lu key:%3ld mod:0x%04x",
             maincpu_clk, key, (unsigned)mod));
 
+    /* picked up again by the emulation when it polls host input */
+    if (input_queue_key(key, mod, 1, tick_now())) {
+        return;
+    }
+
     if (event_playback_active()) {
         return;
     }
@@ -815,6 +835,10 @@ void keyboard_key_released(signed long key, int mod)
     DBGKEY(("keyboard_key_released:  [RELEASED]     maincpu_clk: %12lu key:%3ld mod:0x%04x idx:%d",
             maincpu_clk, key, (unsigned)mod, idx));
 
+    if (input_queue_key(key, mod, 0, tick_now())) {
+        return;
+    }
+
     if (event_playback_active()) {
         return;
     }
@@ -870,6 +894,8 @@ static void keyboard_key_clear_internal(void)
 /* called by the ui */
 void keyboard_key_clear(void)
 {
+    input_queue_clear();
+
     if (event_playback_active()) {
         return;
     }
@@ -1361,5 +1387,6 @@ void keyboard_init(void)
 
 void keyboard_shutdown(void)
 {
+    input_queue_shutdown();
     keymap_shutdown();
 }
@@ -153,6 +153,8 @@ struct zmbv_codec_s {
 
   int blockcount;
   zmbv_frame_block_t *blocks;
+  int xblocks, blockwidth, blockheight;
+  uint8_t *blockdirty; /* per block: differs from the previous frame */
 
   int workUsed, workPos;
 
@@ -230,8 +232,15 @@ static inline void zmbv_add_xor_frame_##_pxsize (zmbv_codec_t zc) { \
     zmbv_frame_block_t *block = &zc->blocks[b]; \
     int bestvx = 0; \
     int bestvy = 0; \
-    int bestchange = zmbv_compare_block_##_pxsize(zc, 0, 0, block); \
+    int bestchange; \
     int possibles = 64; \
+    if (!zc->blockdirty[b]) { \
+      /* known to be unchanged, no need to compare or search */ \
+      vectors[b*2+0] = 0; \
+      vectors[b*2+1] = 0; \
+      continue; \
+    } \
+    bestchange = zmbv_compare_block_##_pxsize(zc, 0, 0, block); \
     for (int v = 0; v < zc->vector_count && possibles; ++v) { \
       if (bestchange < 4) break; \
       int vx = zc->vector_table[v].x; \
@@ -379,10 +388,12 @@ zmbv_codec_t zmbv_codec_new (zmvb_init_flags_t flags, int complevel) {
 static void zmbv_free_buffers (zmbv_codec_t zc) {
   if (zc != NULL) {
     if (zc->blocks != NULL) free(zc->blocks);
+    if (zc->blockdirty != NULL) free(zc->blockdirty);
     if (zc->buf1 != NULL) free(zc->buf1);
     if (zc->buf2 != NULL) free(zc->buf2);
     if (zc->work != NULL) free(zc->work);
     zc->blocks = NULL;
+    zc->blockdirty = NULL;
     zc->buf1 = NULL;
     zc->buf2 = NULL;
     zc->work = NULL;
@@ -451,7 +462,11 @@ static int zmbv_setup_buffers (zmbv_codec_t zc, zmbv_format_t format, int blockw
 
     zc->blockcount = yblocks*xblocks;
     zc->blocks = malloc(sizeof(zmbv_frame_block_t)*zc->blockcount);
-    if (zc->blocks == NULL) { zmbv_free_buffers(zc); return -1; }
+    zc->blockdirty = malloc(zc->blockcount);
+    if (zc->blocks == NULL || zc->blockdirty == NULL) { zmbv_free_buffers(zc); return -1; }
+    zc->xblocks = xblocks;
+    zc->blockwidth = blockwidth;
+    zc->blockheight = blockheight;
 
     i = 0;
     for (int y = 0; y < yblocks; ++y) {
@@ -534,6 +549,8 @@ int zmbv_encode_prepare_frame (zmbv_codec_t zc, zmvb_prepare_flags_t flags, zmbv
   /* reset the work buffer */
   zc->workUsed = 0;
   zc->workPos = 0;
+  /* blocks are marked dirty while the lines come in */
+  memset(zc->blockdirty, 0, zc->blockcount);
   if (flags&ZMBV_PREP_FLAG_KEYFRAME) {
     /* make a keyframe */
     *firstByte |= FRAME_MASK_KEYFRAME;
@@ -583,13 +600,30 @@ int zmbv_encode_lines (zmbv_codec_t zc, int line_count, const void *const line_p
   if (zc != NULL && zc->mode == ZMBV_MODE_ENCODER) {
     int line_pitch = zc->pitch*zc->pixelsize;
     int line_width = zc->width*zc->pixelsize;
-    uint8_t *destStart = zc->newframe+zc->pixelsize*(MAX_VECTOR+(zc->compress.lines_done+MAX_VECTOR)*zc->pitch);
+    int offset = zc->pixelsize*(MAX_VECTOR+(zc->compress.lines_done+MAX_VECTOR)*zc->pitch);
+    uint8_t *destStart = zc->newframe+offset;
+    const uint8_t *oldStart = zc->oldframe+offset;
+    int keyframe = (*zc->compress.outbuf&FRAME_MASK_KEYFRAME);
     int i = 0;
     if (line_count > 0 && line_ptrs == NULL) return -1;
     while (i < line_count && zc->compress.lines_done < zc->height) {
       if (line_ptrs[i] == NULL) return -1;
       memcpy(destStart, line_ptrs[i], line_width);
+      if (!keyframe) {
+        /* find the blocks this line changes, so unchanged blocks can be
+           skipped by the delta encoder */
+        uint8_t *dirty = zc->blockdirty+(zc->compress.lines_done/zc->blockheight)*zc->xblocks;
+        int bytes = zc->blockwidth*zc->pixelsize;
+        for (int x = 0; x < zc->xblocks; ++x) {
+          int pos = x*bytes;
+          if (!dirty[x]) {
+            int len = (pos+bytes > line_width ? line_width-pos : bytes);
+            dirty[x] = (memcmp(destStart+pos, oldStart+pos, len) != 0);
+          }
+        }
+      }
       destStart += line_pitch;
+      oldStart += line_pitch;
       ++i;
       ++zc->compress.lines_done;
     }
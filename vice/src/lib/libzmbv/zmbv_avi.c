@@ -322,6 +322,17 @@ int zmbv_avi_write_chunk_video (zmbv_avi_t zavi, const void *framedata, int size
 }
 
 
+/* an empty video chunk repeats the previous frame */
+int zmbv_avi_write_chunk_video_empty (zmbv_avi_t zavi) {
+  int res = -1;
+  if (zavi != NULL && zavi->fd >= 0 && !zavi->was_file_error) {
+    res = zmbv_avi_write_chunk(zavi, "00dc", 0, NULL, 0);
+    if (res == 0) ++zavi->frames;
+  }
+  return res;
+}
+
+
 int zmbv_avi_write_chunk_audio (zmbv_avi_t zavi, const void *data, int size) {
   if (zavi != NULL && zavi->fd >= 0 && !zavi->was_file_error && (size == 0 || data != NULL)) {
     if (size < 0) return -1;
@@ -34,6 +34,7 @@ extern int zmbv_avi_stop (zmbv_avi_t zavi);
 extern int zmbv_avi_write_chunk (zmbv_avi_t zavi, const char tag[4], uint32_t size, const void *data, uint32_t flags);
 
 extern int zmbv_avi_write_chunk_video (zmbv_avi_t zavi, const void *framedata, int size);
+extern int zmbv_avi_write_chunk_video_empty (zmbv_avi_t zavi);
 extern int zmbv_avi_write_chunk_audio (zmbv_avi_t zavi, const void *data, int size);
 
 
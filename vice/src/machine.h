@@ -73,6 +73,7 @@ extern int machine_class;
 /* These variable live in src/main.c: */
 extern bool console_mode;
 extern bool video_disabled_mode;
+extern bool max_throughput_mode;
 extern bool help_requested;
 extern bool default_settings_requested;
 
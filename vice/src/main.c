@@ -88,6 +88,15 @@ bool console_mode = false;
 /* FIXME: currently never set to true */
 bool video_disabled_mode = false;
 
+/** \brief  Maximum throughput mode requested on the command line
+ *
+ * The command line contained \c -maxthroughput: run as fast as possible,
+ * without pacing, canvas updates or sound output.
+ *
+ * Include "machine.h" to use this variable.
+ */
+bool max_throughput_mode = false;
+
 /** \brief  Help was requested on the command line
  *
  * The command line contained -?/-h/-help/--help.
@@ -0,0 +1,381 @@
+/** \file   mainchannel.c
+ * \brief   Message passing between the UI and the VICE thread
+ *
+ * Commands from the UI go through a lock-free multiple producer, single
+ * consumer queue, so posting one never waits for the VICE thread to yield
+ * the mainlock. The other way round the VICE thread publishes a snapshot of
+ * the status bar data through a triple buffer.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef USE_VICE_THREAD
+#include <stdatomic.h>
+#endif
+
+#include "archdep.h"
+#include "attach.h"
+#include "inputqueue.h"
+#include "keyboard.h"
+#include "lib.h"
+#include "log.h"
+#include "mainchannel.h"
+#include "resources.h"
+#include "types.h"
+#include "uiapi.h"
+
+
+typedef struct mainchannel_node_s {
+#ifdef USE_VICE_THREAD
+    _Atomic(struct mainchannel_node_s *) next;
+#else
+    struct mainchannel_node_s *next;
+#endif
+    mainchannel_func_t func;
+    void *param;
+    bool free_param;    /* param was allocated by mainchannel_post_*() */
+} mainchannel_node_t;
+
+/* parameters of the typed commands */
+
+typedef struct resource_command_s {
+    int value;
+    char name[];
+} resource_command_t;
+
+typedef struct attach_command_s {
+    unsigned int unit;
+    unsigned int drive;
+    char filename[];
+} attach_command_t;
+
+typedef struct key_command_s {
+    tick_t tick;        /* host time the key was pressed or released */
+    signed long key;
+    int mod;
+    bool pressed;
+} key_command_t;
+
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef USE_VICE_THREAD
+
+/*
+ * Intrusive MPSC queue after Dmitry Vyukov. Producers only swap themselves
+ * into queue_head and then link the previous node to them, the consumer
+ * walks from queue_tail. The stub node keeps the queue from ever being
+ * really empty.
+ */
+
+static mainchannel_node_t queue_stub;
+static _Atomic(mainchannel_node_t *) queue_head = &queue_stub;
+static mainchannel_node_t *queue_tail = &queue_stub;
+
+static void queue_push(mainchannel_node_t *node)
+{
+    mainchannel_node_t *prev;
+
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    prev = atomic_exchange_explicit(&queue_head, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+static mainchannel_node_t *queue_pop(void)
+{
+    mainchannel_node_t *tail = queue_tail;
+    mainchannel_node_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &queue_stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        queue_tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+
+    if (next != NULL) {
+        queue_tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&queue_head, memory_order_acquire)) {
+        /* a producer has not linked its node yet, get it next time */
+        return NULL;
+    }
+
+    queue_push(&queue_stub);
+
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next != NULL) {
+        queue_tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+#else
+
+static mainchannel_node_t *queue_first;
+static mainchannel_node_t *queue_last;
+
+static void queue_push(mainchannel_node_t *node)
+{
+    node->next = NULL;
+    if (queue_last != NULL) {
+        queue_last->next = node;
+    } else {
+        queue_first = node;
+    }
+    queue_last = node;
+}
+
+static mainchannel_node_t *queue_pop(void)
+{
+    mainchannel_node_t *node = queue_first;
+
+    if (node != NULL) {
+        queue_first = node->next;
+        if (queue_first == NULL) {
+            queue_last = NULL;
+        }
+    }
+    return node;
+}
+
+#endif
+
+static void post_node(mainchannel_func_t func, void *param, bool free_param)
+{
+    mainchannel_node_t *node = lib_malloc(sizeof(mainchannel_node_t));
+
+    node->func = func;
+    node->param = param;
+    node->free_param = free_param;
+
+    queue_push(node);
+}
+
+/** \brief  Run func(param) on the VICE thread at the next safe point
+ *
+ * \param[in]   func    function to call
+ * \param[in]   param   parameter, owned by the caller
+ */
+void mainchannel_post(mainchannel_func_t func, void *param)
+{
+    post_node(func, param, false);
+}
+
+/** \brief  Execute all commands posted so far (VICE thread only)
+ */
+void mainchannel_process(void)
+{
+    mainchannel_node_t *node;
+
+    while ((node = queue_pop()) != NULL) {
+        node->func(node->param);
+        if (node->free_param) {
+            lib_free(node->param);
+        }
+        lib_free(node);
+    }
+}
+
+/** \brief  Drop all pending commands without executing them
+ */
+void mainchannel_shutdown(void)
+{
+    mainchannel_node_t *node;
+
+    while ((node = queue_pop()) != NULL) {
+        if (node->free_param) {
+            lib_free(node->param);
+        }
+        lib_free(node);
+    }
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+static void do_set_resource(void *param)
+{
+    resource_command_t *cmd = param;
+
+    if (resources_set_int(cmd->name, cmd->value) < 0) {
+        log_error(LOG_DEFAULT, "Cannot set resource `%s'.", cmd->name);
+    }
+}
+
+/** \brief  Set an integer resource at the next safe point
+ *
+ * \param[in]   name    resource name, copied
+ * \param[in]   value   new value
+ */
+void mainchannel_post_resource_int(const char *name, int value)
+{
+    size_t len = strlen(name) + 1;
+    resource_command_t *cmd = lib_malloc(sizeof(resource_command_t) + len);
+
+    cmd->value = value;
+    memcpy(cmd->name, name, len);
+    post_node(do_set_resource, cmd, true);
+}
+
+static void do_attach_disk(void *param)
+{
+    attach_command_t *cmd = param;
+    char buffer[256];
+
+    if (file_system_attach_disk(cmd->unit, cmd->drive, cmd->filename) < 0) {
+        log_error(LOG_DEFAULT, "Cannot attach `%s' to unit %u drive %u.",
+                  cmd->filename, cmd->unit, cmd->drive);
+        snprintf(buffer, sizeof buffer, "Unit #%u: failed to attach '%s'",
+                 cmd->unit, cmd->filename);
+    } else {
+        snprintf(buffer, sizeof buffer, "Unit #%u: attached '%s'",
+                 cmd->unit, cmd->filename);
+    }
+    ui_display_statustext(buffer, true);
+}
+
+/** \brief  Attach a disk image at the next safe point
+ *
+ * \param[in]   unit        unit number (8-11)
+ * \param[in]   drive       drive number (0-1)
+ * \param[in]   filename    disk image, copied
+ */
+void mainchannel_post_attach_disk(unsigned int unit, unsigned int drive, const char *filename)
+{
+    size_t len = strlen(filename) + 1;
+    attach_command_t *cmd = lib_malloc(sizeof(attach_command_t) + len);
+
+    cmd->unit = unit;
+    cmd->drive = drive;
+    memcpy(cmd->filename, filename, len);
+    post_node(do_attach_disk, cmd, true);
+}
+
+static void do_key(void *param)
+{
+    key_command_t *cmd = param;
+
+    /* with "InputPollLines" the key is delivered at its host time */
+    if (input_queue_key(cmd->key, cmd->mod, cmd->pressed ? 1 : 0, cmd->tick)) {
+        return;
+    }
+
+    if (cmd->pressed) {
+        keyboard_key_pressed(cmd->key, cmd->mod);
+    } else {
+        keyboard_key_released(cmd->key, cmd->mod);
+    }
+}
+
+/** \brief  Press or release a key at the next safe point, or at its host time
+ *         when "InputPollLines" queues host input
+ *
+ * \param[in]   key     VICE keysym
+ * \param[in]   mod     modifiers
+ * \param[in]   pressed true for a key press, false for a release
+ */
+void mainchannel_post_key(signed long key, int mod, bool pressed)
+{
+    key_command_t *cmd = lib_malloc(sizeof(key_command_t));
+
+    cmd->tick = tick_now();
+    cmd->key = key;
+    cmd->mod = mod;
+    cmd->pressed = pressed;
+    post_node(do_key, cmd, true);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+static mainchannel_state_t state_working;
+
+#ifdef USE_VICE_THREAD
+
+/*
+ * Triple buffer: the VICE thread fills state_buffers[state_back] and swaps
+ * it with the middle one, the reader swaps the middle one with its front
+ * buffer whenever STATE_FRESH says there is something new.
+ */
+
+#define STATE_INDEX_MASK    0x03
+#define STATE_FRESH         0x04
+
+static mainchannel_state_t state_buffers[3];
+static int state_back = 0;
+static atomic_int state_middle = 1;
+static int state_front = 2;
+
+#endif
+
+/** \brief  Get the snapshot the VICE thread is filling in
+ *
+ * \return  state, only to be used on the VICE thread
+ */
+mainchannel_state_t *mainchannel_state_edit(void)
+{
+    return &state_working;
+}
+
+/** \brief  Make the current state visible to mainchannel_state_get()
+ */
+void mainchannel_state_publish(void)
+{
+    state_working.serial++;
+
+#ifdef USE_VICE_THREAD
+    state_buffers[state_back] = state_working;
+    state_back = atomic_exchange_explicit(&state_middle, state_back | STATE_FRESH,
+                                          memory_order_acq_rel) & STATE_INDEX_MASK;
+#endif
+}
+
+/** \brief  Get the latest published state
+ *
+ * \return  state, valid until the next call
+ */
+const mainchannel_state_t *mainchannel_state_get(void)
+{
+#ifdef USE_VICE_THREAD
+    if (atomic_load_explicit(&state_middle, memory_order_relaxed) & STATE_FRESH) {
+        state_front = atomic_exchange_explicit(&state_middle, state_front,
+                                               memory_order_acq_rel) & STATE_INDEX_MASK;
+    }
+    return &state_buffers[state_front];
+#else
+    return &state_working;
+#endif
+}
@@ -0,0 +1,81 @@
+/** \file   mainchannel.h
+ * \brief   Message passing between the UI and the VICE thread - header
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_MAIN_CHANNEL_H
+#define VICE_MAIN_CHANNEL_H
+
+#include "vice.h"
+
+#include <stdbool.h>
+
+#include "drive.h"
+
+/*
+ * UI -> VICE thread
+ *
+ * Commands can be posted from any thread without taking the mainlock. They
+ * are executed in order on the VICE thread at the next safe point, which is
+ * the next sync point of vsync (every few milliseconds) or the next frame.
+ */
+
+typedef void (*mainchannel_func_t)(void *param);
+
+void mainchannel_post(mainchannel_func_t func, void *param);
+void mainchannel_post_resource_int(const char *name, int value);
+void mainchannel_post_attach_disk(unsigned int unit, unsigned int drive, const char *filename);
+void mainchannel_post_key(signed long key, int mod, bool pressed);
+
+/* VICE thread only */
+void mainchannel_process(void);
+void mainchannel_shutdown(void);
+
+/*
+ * VICE thread -> UI
+ *
+ * The VICE thread publishes a snapshot of the data shown in status bars once
+ * per frame. Reading it never blocks either side.
+ */
+
+typedef struct mainchannel_state_s {
+    unsigned long serial;   /* incremented with every published snapshot */
+
+    double cpu_percent;
+    double emulated_fps;
+    int warp_enabled;
+
+    unsigned int drive_led_pwm[NUM_DISK_UNITS][2][DRIVE_LEDS_MAX];  /* unit, drive, led */
+    unsigned int drive_half_track[NUM_DISK_UNITS][2];
+    unsigned int drive_side[NUM_DISK_UNITS][2];
+} mainchannel_state_t;
+
+/* VICE thread only: the snapshot being prepared, and making it visible */
+mainchannel_state_t *mainchannel_state_edit(void);
+void mainchannel_state_publish(void);
+
+/* Latest published snapshot. Must always be called from the same thread, the
+   result stays valid until the next call. */
+const mainchannel_state_t *mainchannel_state_get(void);
+
+#endif
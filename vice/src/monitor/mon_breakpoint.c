@@ -206,6 +206,7 @@ static void remove_checkpoint(mon_checkpoint_t *cp)
     mem = addr_memspace(cp->start_addr);
 
     mon_delete_conditional(cp->condition);
+    mon_delete_program(cp->program);
     lib_free(cp->command);
     cp->command = NULL;
 
@@ -369,7 +370,10 @@ void mon_breakpoint_set_checkpoint_condition(int cp_num,
         if (!cp) {
             mon_out("#%d not a valid checkpoint\n", cp_num);
         } else {
+            mon_delete_conditional(cp->condition);
+            mon_delete_program(cp->program);
             cp->condition = cnode;
+            cp->program = mon_compile_conditional(cnode);
 
             mon_out("Setting checkpoint %d condition to: ", cp_num);
             mon_print_conditional(cnode);
@@ -518,7 +522,11 @@ bool mon_breakpoint_check_checkpoint(MEMSPACE mem, unsigned int addr, unsigned i
         ptr = ptr->next;
         if (cp && cp->enabled == e_ON) {
             /* If condition test fails, skip this checkpoint */
-            if (cp->condition) {
+            if (cp->program) {
+                if (!mon_evaluate_program(cp->program)) {
+                    continue;
+                }
+            } else if (cp->condition) {
                 if (!mon_evaluate_conditional(cp->condition)) {
                     continue;
                 }
@@ -638,6 +646,7 @@ int breakpoint_add_checkpoint(MON_ADDR start_addr, MON_ADDR end_addr,
     new_cp->hit_count = 0;
     new_cp->ignore_count = 0;
     new_cp->condition = NULL;
+    new_cp->program = NULL;
     new_cp->command = NULL;
     new_cp->check_load = memory_op & e_load;
     new_cp->check_store = memory_op & e_store;
@@ -42,6 +42,7 @@ struct mon_checkpoint_s {
     int hit_count;
     int ignore_count;
     cond_node_t *condition;
+    mon_cond_program_t *program;    /* condition compiled, NULL to interpret it */
     char *command;
     bool stop;
     bool enabled;
@@ -1675,6 +1675,18 @@ void mon_disassemble_lines(MON_ADDR start_addr, MON_ADDR end_addr)
     mem = addr_memspace(start_addr);
     dot_addr[mem] = start_addr;
 
+    /* when starting inside a labelled routine, show where we are */
+    if (!mon_symbol_table_lookup_name(mem, addr_location(start_addr))) {
+        unsigned int offset;
+        char *label = mon_symbol_table_lookup_nearest(mem, addr_location(start_addr), &offset);
+
+        if (label && offset < MON_NEAREST_SYMBOL_RANGE) {
+            mon_out(".%s:%04x   %s+$%x:\n", mon_memspace_string[mem],
+                    addr_location(start_addr), label, offset);
+            linesleft--;
+        }
+    }
+
     i = 0;
     while ((i < len) || (limitlines == 1)) {
         int line_count; /* Number of lines printed by disassembly */
@@ -591,8 +591,20 @@ static void print_dst(uint16_t dst, int max_width, int memory_config) {
     char *name = mon_symbol_table_lookup_name(default_memspace, dst);
     char buf[32];
     char *full_name = NULL;
+    char *near_name = NULL;
+    unsigned int offset;
     size_t l;
 
+    if (!name && dst != 0x0000) {
+        /* entry points without a label of their own, e.g. behind a
+           local label the assembler did not export */
+        name = mon_symbol_table_lookup_nearest(default_memspace, dst, &offset);
+        if (name && offset < MON_NEAREST_SYMBOL_RANGE) {
+            near_name = lib_msprintf("%s+$%x", name, offset);
+        }
+        name = near_name;
+    }
+
     if (!name) {
         if (dst == 0x0000) {
             snprintf(buf, 32, "ROOT");
@@ -626,6 +638,7 @@ static void print_dst(uint16_t dst, int max_width, int memory_config) {
     }
 
     lib_free(full_name);
+    lib_free(near_name);
 }
 
 static int context_memory_config(profiling_context_t *context) {
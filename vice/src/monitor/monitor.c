@@ -74,6 +74,7 @@
 #include "monitor.h"
 #include "monitor_network.h"
 #include "monitor_binary.h"
+#include "mos6510.h"
 #include "montypes.h"
 
 #include "userport_io_sim.h"
@@ -116,8 +117,9 @@ static int init_break_address = -1;
 
 #define MAX_LABEL_LEN 255
 #define MAX_MEMSPACE_NAME_LEN 10
-#define HASH_ARRAY_SIZE 256
-#define HASH_ADDR(x) ((x) % 0xff)
+#define HASH_ARRAY_SIZE 1024
+#define HASH_ADDR(x) ((x) & (HASH_ARRAY_SIZE - 1))
+#define NAME_HASH_MIN_SIZE 256
 #define OP_JSR 0x20
 #define OP_RTI 0x40
 #define OP_RTS 0x60
@@ -136,16 +138,25 @@ monitor_cartridge_commands_t mon_cart_cmd;
 
 /* Types */
 
+/* Every symbol is one entry, linked into the name list (newest first, for
+   printing and saving) and into a chain of both hash tables. */
 struct symbol_entry {
     uint16_t addr;
     char *name;
     struct symbol_entry *next;
+    struct symbol_entry *prev;
+    struct symbol_entry *name_next;
+    struct symbol_entry *addr_next;
 };
 typedef struct symbol_entry symbol_entry_t;
 
 struct symbol_table {
     symbol_entry_t *name_list;
     symbol_entry_t *addr_hash_table[HASH_ARRAY_SIZE];
+    symbol_entry_t **name_hash_table;   /* name_hash_size chains, grows with count */
+    unsigned int name_hash_size;
+    unsigned int count;
+    symbol_entry_t **sorted;            /* by address, rebuilt after changes */
 };
 typedef struct symbol_table symbol_table_t;
 
@@ -1533,7 +1544,7 @@ void monitor_init(monitor_interface_t *maincpu_interface_init,
                   monitor_interface_t *drive_interface_init[],
                   monitor_cpu_type_t **asmarray)
 {
-    int i, j;
+    int i;
     unsigned int dnr;
     monitor_cpu_type_list_t *monitor_cpu_type_list_ptr;
 
@@ -1597,10 +1608,7 @@ void monitor_init(monitor_interface_t *maincpu_interface_init,
         watch_load_count[i] = 0;
         watch_store_count[i] = 0;
         monitor_mask[i] = MI_NONE;
-        monitor_labels[i].name_list = NULL;
-        for (j = 0; j < HASH_ARRAY_SIZE; j++) {
-            monitor_labels[i].addr_hash_table[j] = NULL;
-        }
+        memset(&monitor_labels[i], 0, sizeof(symbol_table_t));
     }
 
     default_memspace = e_comp_space;
@@ -2327,28 +2335,105 @@ static void playback_next_command(void)
 
 static void free_symbol_table(MEMSPACE mem)
 {
+    symbol_table_t *table = &monitor_labels[mem];
     symbol_entry_t *sym_ptr, *temp;
-    int i;
 
-    /* Remove name list */
-    sym_ptr = monitor_labels[mem].name_list;
+    sym_ptr = table->name_list;
     while (sym_ptr) {
-        /* Name memory is freed below. */
         temp = sym_ptr;
         sym_ptr = sym_ptr->next;
+        lib_free(temp->name);
         lib_free(temp);
     }
 
-    /* Remove address hash table */
-    for (i = 0; i < HASH_ARRAY_SIZE; i++) {
-        sym_ptr = monitor_labels[mem].addr_hash_table[i];
-        while (sym_ptr) {
-            lib_free (sym_ptr->name);
-            temp = sym_ptr;
-            sym_ptr = sym_ptr->next;
-            lib_free(temp);
+    lib_free(table->name_hash_table);
+    lib_free(table->sorted);
+    memset(table, 0, sizeof(symbol_table_t));
+}
+
+static unsigned int symbol_name_hash(const char *name)
+{
+    unsigned int hash = 5381;
+
+    while (*name) {
+        hash = (hash * 33) ^ (unsigned char)*name++;
+    }
+    return hash;
+}
+
+/* Double the name hash table once it holds two names per chain on average,
+   so adding the symbols of a large label file stays linear. */
+static void symbol_name_hash_grow(symbol_table_t *table)
+{
+    unsigned int size, i;
+    symbol_entry_t **chains, *sym_ptr;
+
+    if (table->name_hash_table != NULL && table->count < table->name_hash_size * 2) {
+        return;
+    }
+
+    size = table->name_hash_table ? table->name_hash_size * 2 : NAME_HASH_MIN_SIZE;
+    chains = lib_calloc(size, sizeof(symbol_entry_t *));
+
+    for (sym_ptr = table->name_list; sym_ptr; sym_ptr = sym_ptr->next) {
+        i = symbol_name_hash(sym_ptr->name) & (size - 1);
+        sym_ptr->name_next = chains[i];
+        chains[i] = sym_ptr;
+    }
+
+    lib_free(table->name_hash_table);
+    table->name_hash_table = chains;
+    table->name_hash_size = size;
+}
+
+static symbol_entry_t *symbol_find_name(symbol_table_t *table, const char *name)
+{
+    symbol_entry_t *sym_ptr;
+
+    if (table->name_hash_table == NULL) {
+        return NULL;
+    }
+
+    sym_ptr = table->name_hash_table[symbol_name_hash(name) & (table->name_hash_size - 1)];
+    while (sym_ptr) {
+        if (strcmp(sym_ptr->name, name) == 0) {
+            return sym_ptr;
         }
+        sym_ptr = sym_ptr->name_next;
+    }
+    return NULL;
+}
+
+static int symbol_compare_addr(const void *a, const void *b)
+{
+    const symbol_entry_t *sa = *(const symbol_entry_t * const *)a;
+    const symbol_entry_t *sb = *(const symbol_entry_t * const *)b;
+
+    return (int)sa->addr - (int)sb->addr;
+}
+
+/* The array sorted by address is only needed for the nearest symbol lookup,
+   it is built in one go the first time it is needed after a change. */
+static void symbol_sort_by_addr(symbol_table_t *table)
+{
+    symbol_entry_t *sym_ptr;
+    unsigned int i = 0;
+
+    if (table->sorted != NULL || table->count == 0) {
+        return;
     }
+
+    table->sorted = lib_malloc(table->count * sizeof(symbol_entry_t *));
+    for (sym_ptr = table->name_list; sym_ptr; sym_ptr = sym_ptr->next) {
+        table->sorted[i++] = sym_ptr;
+    }
+    qsort(table->sorted, table->count, sizeof(symbol_entry_t *), symbol_compare_addr);
+}
+
+static void symbol_table_changed(symbol_table_t *table)
+{
+    lib_free(table->sorted);
+    table->sorted = NULL;
 }
 
 char *mon_symbol_table_lookup_name(MEMSPACE mem, uint16_t addr)
@@ -2364,12 +2449,53 @@ char *mon_symbol_table_lookup_name(MEMSPACE mem, uint16_t addr)
         if (addr == sym_ptr->addr) {
             return sym_ptr->name;
         }
-        sym_ptr = sym_ptr->next;
+        sym_ptr = sym_ptr->addr_next;
     }
 
     return NULL;
 }
 
+/* look up the symbol at or closest below addr, returns NULL if there is none
+   and stores the distance to it in *offset */
+char *mon_symbol_table_lookup_nearest(MEMSPACE mem, uint16_t addr, unsigned int *offset)
+{
+    symbol_table_t *table;
+    unsigned int lo, hi, mid;
+    char *name;
+
+    if (mem == e_default_space) {
+        mem = default_memspace;
+    }
+
+    /* prefer the same symbol as mon_symbol_table_lookup_name() */
+    name = mon_symbol_table_lookup_name(mem, addr);
+    if (name != NULL) {
+        *offset = 0;
+        return name;
+    }
+
+    table = &monitor_labels[mem];
+    symbol_sort_by_addr(table);
+    if (table->sorted == NULL || table->sorted[0]->addr > addr) {
+        return NULL;
+    }
+
+    /* find the last entry with an address <= addr */
+    lo = 0;
+    hi = table->count;
+    while (hi - lo > 1) {
+        mid = (lo + hi) / 2;
+        if (table->sorted[mid]->addr <= addr) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    *offset = addr - table->sorted[lo]->addr;
+    return mon_symbol_table_lookup_name(mem, table->sorted[lo]->addr);
+}
+
 /* look up a symbol in the given memspace, returns address or -1 on error */
 int mon_symbol_table_lookup_addr(MEMSPACE mem, char *name)
 {
@@ -2385,15 +2511,9 @@ int mon_symbol_table_lookup_addr(MEMSPACE mem, char *name)
         return mon_register_name_to_value(mem, &name[1]);
     }
 
-    sym_ptr = monitor_labels[mem].name_list;
-    while (sym_ptr) {
-        if (strcmp(sym_ptr->name, name) == 0) {
-            return sym_ptr->addr;
-        }
-        sym_ptr = sym_ptr->next;
-    }
+    sym_ptr = symbol_find_name(&monitor_labels[mem], name);
 
-    return -1;
+    return sym_ptr ? sym_ptr->addr : -1;
 }
 
 char * mon_prepend_dot_to_name(char *name)
@@ -2407,9 +2527,11 @@ char * mon_prepend_dot_to_name(char *name)
 
 void mon_add_name_to_symbol_table(MON_ADDR addr, char *name)
 {
+    symbol_table_t *table;
     symbol_entry_t *sym_ptr;
     char *old_name;
     int old_addr;
+    unsigned int i;
     MEMSPACE mem = addr_memspace(addr);
     uint16_t loc = addr_location(addr);
     int silent = (playback_fp != NULL); /* suppress warnings when playing back label file */
@@ -2438,27 +2560,41 @@ void mon_add_name_to_symbol_table(MON_ADDR addr, char *name)
         mon_remove_name_from_symbol_table(mem, name);
     }
 
-    /* Add name to name list */
+    table = &monitor_labels[mem];
+
     sym_ptr = lib_malloc(sizeof(symbol_entry_t));
     sym_ptr->name = name;
     sym_ptr->addr = loc;
 
-    sym_ptr->next = monitor_labels[mem].name_list;
-    monitor_labels[mem].name_list = sym_ptr;
+    /* Add to name list */
+    sym_ptr->prev = NULL;
+    sym_ptr->next = table->name_list;
+    if (table->name_list) {
+        table->name_list->prev = sym_ptr;
+    }
+    table->name_list = sym_ptr;
+    table->count++;
+
+    /* Add name to name hash table, growing it rehashes the new entry too */
+    if (table->name_hash_table != NULL && table->count < table->name_hash_size * 2) {
+        i = symbol_name_hash(name) & (table->name_hash_size - 1);
+        sym_ptr->name_next = table->name_hash_table[i];
+        table->name_hash_table[i] = sym_ptr;
+    } else {
+        symbol_name_hash_grow(table);
+    }
 
     /* Add address to hash table */
-    sym_ptr = lib_malloc(sizeof(symbol_entry_t));
-    sym_ptr->name = name;
-    sym_ptr->addr = addr;
+    sym_ptr->addr_next = table->addr_hash_table[HASH_ADDR(loc)];
+    table->addr_hash_table[HASH_ADDR(loc)] = sym_ptr;
 
-    sym_ptr->next = monitor_labels[mem].addr_hash_table[HASH_ADDR(loc)];
-    monitor_labels[mem].addr_hash_table[HASH_ADDR(loc)] = sym_ptr;
+    symbol_table_changed(table);
 }
 
 void mon_remove_name_from_symbol_table(MEMSPACE mem, char *name)
 {
-    int addr;
-    symbol_entry_t *sym_ptr, *prev_ptr;
+    symbol_table_t *table;
+    symbol_entry_t *sym_ptr, **link;
 
     if (mem == e_default_space) {
         mem = default_memspace;
@@ -2470,47 +2606,43 @@ void mon_remove_name_from_symbol_table(MEMSPACE mem, char *name)
         return;
     }
 
-    if ((addr = mon_symbol_table_lookup_addr(mem, name)) < 0) {
+    table = &monitor_labels[mem];
+
+    sym_ptr = symbol_find_name(table, name);
+    if (sym_ptr == NULL) {
         mon_out("Symbol %s not found.\n", name);
         return;
     }
 
     /* Remove entry in name list */
-    sym_ptr = monitor_labels[mem].name_list;
-    prev_ptr = NULL;
-    while (sym_ptr) {
-        if (strcmp(sym_ptr->name, name) == 0) {
-            /* Name memory is freed below. */
-            addr = sym_ptr->addr;
-            if (prev_ptr) {
-                prev_ptr->next = sym_ptr->next;
-            } else {
-                monitor_labels[mem].name_list = sym_ptr->next;
-            }
-            lib_free(sym_ptr);
-            break;
-        }
-        prev_ptr = sym_ptr;
-        sym_ptr = sym_ptr->next;
+    if (sym_ptr->prev) {
+        sym_ptr->prev->next = sym_ptr->next;
+    } else {
+        table->name_list = sym_ptr->next;
+    }
+    if (sym_ptr->next) {
+        sym_ptr->next->prev = sym_ptr->prev;
     }
 
+    /* Remove entry in name hash table */
+    link = &table->name_hash_table[symbol_name_hash(name) & (table->name_hash_size - 1)];
+    while (*link != sym_ptr) {
+        link = &(*link)->name_next;
+    }
+    *link = sym_ptr->name_next;
+
     /* Remove entry in address hash table */
-    sym_ptr = monitor_labels[mem].addr_hash_table[HASH_ADDR(addr)];
-    prev_ptr = NULL;
-    while (sym_ptr) {
-        if ((addr == sym_ptr->addr) && !strcmp(sym_ptr->name, name)) {
-            lib_free(sym_ptr->name);
-            if (prev_ptr) {
-                prev_ptr->next = sym_ptr->next;
-            } else {
-                monitor_labels[mem].addr_hash_table[HASH_ADDR(addr)] = sym_ptr->next;
-            }
-            lib_free(sym_ptr);
-            return;
-        }
-        prev_ptr = sym_ptr;
-        sym_ptr = sym_ptr->next;
+    link = &table->addr_hash_table[HASH_ADDR(sym_ptr->addr)];
+    while (*link != sym_ptr) {
+        link = &(*link)->addr_next;
     }
+    *link = sym_ptr->addr_next;
+
+    table->count--;
+    symbol_table_changed(table);
+
+    lib_free(sym_ptr->name);
+    lib_free(sym_ptr);
 }
 
 void mon_print_symbol_table(MEMSPACE mem)
@@ -2530,18 +2662,11 @@ void mon_print_symbol_table(MEMSPACE mem)
 
 void mon_clear_symbol_table(MEMSPACE mem)
 {
-    int i;
-
     if (mem == e_default_space) {
         mem = default_memspace;
     }
 
     free_symbol_table(mem);
-    monitor_labels[mem].name_list = NULL;
-
-    for (i = 0; i < HASH_ARRAY_SIZE; i++) {
-        monitor_labels[mem].addr_hash_table[i] = NULL;
-    }
 }
 
 
@@ -2756,6 +2881,384 @@ int mon_evaluate_conditional(cond_node_t *cnode)
 }
 
 
+/* Conditions of checkpoints are compiled into a small register machine
+   program when they are set, so a checkpoint on hot code does not walk the
+   tree and dispatch through the monitor interface for every operand each
+   time it is hit. Each node leaves its value in the slot given by its depth
+   in the tree, so the right operand of a node is found one slot further. */
+
+enum cond_insn_op_e {
+    COND_CONST,         /* slot[dst] = value */
+    COND_REG,           /* slot[dst] = register value through the monitor interface */
+    COND_REG_A,         /* slot[dst] = register of a 6502 CPU, read directly */
+    COND_REG_X,
+    COND_REG_Y,
+    COND_REG_SP,
+    COND_REG_PC,
+    COND_LINE,          /* slot[dst] = current raster line */
+    COND_CYCLE,         /* slot[dst] = current raster cycle */
+    COND_MEM,           /* slot[dst] = byte at address value in bank */
+    COND_MEM_INDIRECT,  /* slot[dst] = byte at address slot[dst] in bank */
+    COND_JUMP_ZERO,     /* if slot[dst] == 0, continue at value */
+    COND_JUMP_TRUE,     /* if slot[dst] != 0, slot[dst] = 1 and continue at value */
+    COND_BOOL,          /* slot[dst] = slot[dst + 1] != 0 */
+    COND_EQU,           /* slot[dst] = slot[dst] op slot[dst + 1] */
+    COND_NEQ,
+    COND_GT,
+    COND_LT,
+    COND_GTE,
+    COND_LTE,
+    COND_ADD,
+    COND_SUB,
+    COND_MUL,
+    COND_DIV,
+    COND_BINARY_AND,
+    COND_BINARY_OR
+};
+
+typedef struct cond_insn_s {
+    uint8_t op;
+    uint8_t dst;
+    int bank;
+    int value;
+    MON_REG reg_num;
+    mos6510_regs_t *regs;
+    monitor_cpu_type_t *cpu;    /* CPU the registers belong to */
+} cond_insn_t;
+
+struct mon_cond_program_s {
+    cond_insn_t *code;
+    int length;
+    int size;
+    int slots;
+    int reads_memory;
+};
+
+static cond_insn_t *cond_emit(mon_cond_program_t *prog, int op, int dst)
+{
+    cond_insn_t *insn;
+
+    if (prog->length == prog->size) {
+        prog->size = prog->size ? prog->size * 2 : 16;
+        prog->code = lib_realloc(prog->code, prog->size * sizeof(cond_insn_t));
+    }
+
+    insn = &prog->code[prog->length++];
+    memset(insn, 0, sizeof(cond_insn_t));
+    insn->op = (uint8_t)op;
+    insn->dst = (uint8_t)dst;
+
+    if (dst + 2 > prog->slots) {
+        prog->slots = dst + 2;
+    }
+    return insn;
+}
+
+static void cond_emit_register(mon_cond_program_t *prog, cond_node_t *cnode, int dst)
+{
+    MEMSPACE reg_mem = reg_memspace(cnode->reg_num);
+    int reg_id = reg_regid(cnode->reg_num);
+    monitor_cpu_type_t *cpu = monitor_cpu_for_memspace[reg_mem];
+    cond_insn_t *insn;
+
+    if (reg_id == e_Rasterline) {
+        cond_emit(prog, COND_LINE, dst);
+        return;
+    }
+    if (reg_id == e_Cycle) {
+        cond_emit(prog, COND_CYCLE, dst);
+        return;
+    }
+
+    /* The main CPU and the 6502 in most drives keep their registers in a
+       mos6510_regs_t, which is up to date whenever checkpoints are checked.
+       Registers of a drive are only read directly if it was emulated when
+       the condition was set.  */
+    if (cpu != NULL && cpu->cpu_type == CPU_6502 && mon_interfaces[reg_mem] != NULL
+        && mon_interfaces[reg_mem]->cpu_regs != NULL
+        && (reg_mem == e_comp_space || check_drive_emu_level_ok(monitor_diskspace_dnr(reg_mem) + 8))) {
+        switch (reg_id) {
+            case e_A:
+                insn = cond_emit(prog, COND_REG_A, dst);
+                break;
+            case e_X:
+                insn = cond_emit(prog, COND_REG_X, dst);
+                break;
+            case e_Y:
+                insn = cond_emit(prog, COND_REG_Y, dst);
+                break;
+            case e_SP:
+                insn = cond_emit(prog, COND_REG_SP, dst);
+                break;
+            case e_PC:
+                insn = cond_emit(prog, COND_REG_PC, dst);
+                break;
+            default:
+                insn = NULL;
+                break;
+        }
+        if (insn != NULL) {
+            insn->reg_num = cnode->reg_num;
+            insn->regs = mon_interfaces[reg_mem]->cpu_regs;
+            insn->cpu = cpu;
+            return;
+        }
+    }
+
+    insn = cond_emit(prog, COND_REG, dst);
+    insn->reg_num = cnode->reg_num;
+}
+
+static int cond_compile_node(mon_cond_program_t *prog, cond_node_t *cnode, int dst)
+{
+    cond_insn_t *insn;
+    int jump;
+
+    if (dst > UINT8_MAX - 2) {
+        log_error(LOG_DEFAULT, "Conditional too deeply nested.");
+        return -1;
+    }
+
+    if (cnode->operation == e_INV) {
+        if (cnode->is_reg) {
+            cond_emit_register(prog, cnode, dst);
+        } else if (cnode->banknum >= 0) {
+            if (cnode->child1 != NULL) {
+                if (cond_compile_node(prog, cnode->child1, dst) < 0) {
+                    return -1;
+                }
+                insn = cond_emit(prog, COND_MEM_INDIRECT, dst);
+            } else {
+                insn = cond_emit(prog, COND_MEM, dst);
+                insn->value = addr_location(cnode->value);
+            }
+            insn->bank = cnode->banknum;
+            prog->reads_memory = 1;
+        } else {
+            insn = cond_emit(prog, COND_CONST, dst);
+            insn->value = cnode->value;
+        }
+        return 0;
+    }
+
+    if (!(cnode->child1 && cnode->child2)) {
+        log_error(LOG_DEFAULT, "No conditional!");
+        return -1;
+    }
+
+    if (cond_compile_node(prog, cnode->child1, dst) < 0) {
+        return -1;
+    }
+
+    /* the operands have no side effects, so && and || can short-circuit */
+    if (cnode->operation == e_LOGICAL_AND || cnode->operation == e_LOGICAL_OR) {
+        jump = prog->length;
+        cond_emit(prog, cnode->operation == e_LOGICAL_AND ? COND_JUMP_ZERO : COND_JUMP_TRUE, dst);
+        if (cond_compile_node(prog, cnode->child2, dst + 1) < 0) {
+            return -1;
+        }
+        cond_emit(prog, COND_BOOL, dst);
+        prog->code[jump].value = prog->length;
+        return 0;
+    }
+
+    if (cond_compile_node(prog, cnode->child2, dst + 1) < 0) {
+        return -1;
+    }
+
+    switch (cnode->operation) {
+        case e_EQU:
+            cond_emit(prog, COND_EQU, dst);
+            break;
+        case e_NEQ:
+            cond_emit(prog, COND_NEQ, dst);
+            break;
+        case e_GT:
+            cond_emit(prog, COND_GT, dst);
+            break;
+        case e_LT:
+            cond_emit(prog, COND_LT, dst);
+            break;
+        case e_GTE:
+            cond_emit(prog, COND_GTE, dst);
+            break;
+        case e_LTE:
+            cond_emit(prog, COND_LTE, dst);
+            break;
+        case e_ADD:
+            cond_emit(prog, COND_ADD, dst);
+            break;
+        case e_SUB:
+            cond_emit(prog, COND_SUB, dst);
+            break;
+        case e_MUL:
+            cond_emit(prog, COND_MUL, dst);
+            break;
+        case e_DIV:
+            cond_emit(prog, COND_DIV, dst);
+            break;
+        case e_BINARY_AND:
+            cond_emit(prog, COND_BINARY_AND, dst);
+            break;
+        case e_BINARY_OR:
+            cond_emit(prog, COND_BINARY_OR, dst);
+            break;
+        default:
+            log_error(LOG_DEFAULT, "Unexpected conditional operator: %d\n",
+                      cnode->operation);
+            return -1;
+    }
+    return 0;
+}
+
+/* Compile a condition, returns NULL if it can only be interpreted by
+   mon_evaluate_conditional().  */
+mon_cond_program_t *mon_compile_conditional(cond_node_t *cnode)
+{
+    mon_cond_program_t *prog = lib_calloc(1, sizeof(mon_cond_program_t));
+
+    if (cond_compile_node(prog, cnode, 0) < 0) {
+        mon_delete_program(prog);
+        return NULL;
+    }
+    return prog;
+}
+
+static int cond_register_get_val(const cond_insn_t *insn)
+{
+    return (monitor_cpu_for_memspace[reg_memspace(insn->reg_num)]->mon_register_get_val)
+               (reg_memspace(insn->reg_num), reg_regid(insn->reg_num));
+}
+
+/* read a register directly unless the CPU of the memspace was switched */
+#define COND_REG_DIRECT(get)                                                    \
+    r[0] = monitor_cpu_for_memspace[reg_memspace(insn->reg_num)] == insn->cpu   \
+           ? get(insn->regs) : (int)cond_register_get_val(insn)
+
+int mon_evaluate_program(mon_cond_program_t *prog)
+{
+    int slot[UINT8_MAX + 1];
+    int old_sidefx = sidefx;
+    int pc = 0;
+    unsigned int line, cycle;
+    int half_cycle;
+
+    if (prog->reads_memory) {
+        /* make sure we peek when doing the break point, otherwise weird
+           stuff will happen */
+        sidefx = 0;
+    }
+
+    while (pc < prog->length) {
+        const cond_insn_t *insn = &prog->code[pc++];
+        int *r = &slot[insn->dst];
+
+        switch (insn->op) {
+            case COND_CONST:
+                r[0] = insn->value;
+                break;
+            case COND_REG:
+                r[0] = cond_register_get_val(insn);
+                break;
+            case COND_REG_A:
+                COND_REG_DIRECT(MOS6510_REGS_GET_A);
+                break;
+            case COND_REG_X:
+                COND_REG_DIRECT(MOS6510_REGS_GET_X);
+                break;
+            case COND_REG_Y:
+                COND_REG_DIRECT(MOS6510_REGS_GET_Y);
+                break;
+            case COND_REG_SP:
+                COND_REG_DIRECT(MOS6510_REGS_GET_SP);
+                break;
+            case COND_REG_PC:
+                COND_REG_DIRECT(MOS6510_REGS_GET_PC);
+                break;
+            case COND_LINE:
+                mon_interfaces[e_comp_space]->get_line_cycle(&line, &cycle, &half_cycle);
+                r[0] = line;
+                break;
+            case COND_CYCLE:
+                mon_interfaces[e_comp_space]->get_line_cycle(&line, &cycle, &half_cycle);
+                r[0] = cycle;
+                break;
+            case COND_MEM:
+                r[0] = mon_get_mem_val_ex(e_comp_space, insn->bank, (uint16_t)insn->value);
+                break;
+            case COND_MEM_INDIRECT:
+                r[0] = mon_get_mem_val_ex(e_comp_space, insn->bank, (uint16_t)r[0]);
+                break;
+            case COND_JUMP_ZERO:
+                if (r[0] == 0) {
+                    pc = insn->value;
+                }
+                break;
+            case COND_JUMP_TRUE:
+                if (r[0] != 0) {
+                    r[0] = 1;
+                    pc = insn->value;
+                }
+                break;
+            case COND_BOOL:
+                r[0] = (r[1] != 0);
+                break;
+            case COND_EQU:
+                r[0] = (r[0] == r[1]);
+                break;
+            case COND_NEQ:
+                r[0] = (r[0] != r[1]);
+                break;
+            case COND_GT:
+                r[0] = (r[0] > r[1]);
+                break;
+            case COND_LT:
+                r[0] = (r[0] < r[1]);
+                break;
+            case COND_GTE:
+                r[0] = (r[0] >= r[1]);
+                break;
+            case COND_LTE:
+                r[0] = (r[0] <= r[1]);
+                break;
+            case COND_ADD:
+                r[0] = r[0] + r[1];
+                break;
+            case COND_SUB:
+                r[0] = r[0] - r[1];
+                break;
+            case COND_MUL:
+                r[0] = r[0] * r[1];
+                break;
+            case COND_DIV:
+                if (r[1] == 0) {
+                    log_error(LOG_DEFAULT, "Division by zero in conditional\n");
+                    r[0] = 0;
+                } else {
+                    r[0] = r[0] / r[1];
+                }
+                break;
+            case COND_BINARY_AND:
+                r[0] = r[0] & r[1];
+                break;
+            case COND_BINARY_OR:
+                r[0] = r[0] | r[1];
+                break;
+        }
+    }
+
+    sidefx = old_sidefx;
+    return slot[0];
+}
+
+void mon_delete_program(mon_cond_program_t *prog)
+{
+    if (prog) {
+        lib_free(prog->code);
+        lib_free(prog);
+    }
+}
+
 void mon_delete_conditional(cond_node_t *cnode)
 {
     if (!cnode) {
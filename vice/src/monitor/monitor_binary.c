@@ -58,6 +58,7 @@
 #include "mon_register.h"
 
 #include "version.h"
+#include "vsyncapi.h"
 
 #ifdef USE_SVN_REVISION
 # include "svnversion.h"
@@ -112,6 +113,7 @@ enum t_binary_command {
     e_MON_CMD_DISPLAY_GET = 0x84,
     e_MON_CMD_VICE_INFO = 0x85,
     e_MON_CMD_CPUHISTORY_GET = 0x86,
+    e_MON_CMD_FRAME_STATS_GET = 0x87,
 
     e_MON_CMD_PALETTE_GET = 0x91,
 
@@ -161,6 +163,7 @@ enum t_binary_response {
     e_MON_RESPONSE_DISPLAY_GET = 0x84,
     e_MON_RESPONSE_VICE_INFO = 0x85,
     e_MON_RESPONSE_CPUHISTORY_GET = 0x86,
+    e_MON_RESPONSE_FRAME_STATS_GET = 0x87,
 
     e_MON_RESPONSE_PALETTE_GET = 0x91,
 
@@ -1436,6 +1439,48 @@ static void monitor_binary_process_vice_info(binary_command_t *command)
     monitor_binary_response(sizeof(response), e_MON_RESPONSE_VICE_INFO, e_MON_ERR_OK, command->request_id, response);
 }
 
+static void monitor_binary_process_frame_stats_get(binary_command_t *command)
+{
+    vsync_frame_stats_t stats;
+    unsigned char *response, *response_cursor;
+    uint32_t response_length;
+    unsigned int i;
+
+    if (command->length < 1) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+
+    vsyncarch_get_frame_stats(&stats, command->body[0] & 0x01);
+
+    response_length = 4 * 5 + 1 + 2 * (2 + VSYNC_HISTOGRAM_BUCKETS * 4);
+    response = lib_malloc(response_length);
+    response_cursor = response;
+
+    response_cursor = write_uint32(stats.frames, response_cursor);
+    response_cursor = write_uint32(stats.skipped_frames, response_cursor);
+    response_cursor = write_uint32(stats.late_frames, response_cursor);
+    response_cursor = write_uint32(stats.sleep_latency_us, response_cursor);
+    response_cursor = write_uint32((uint32_t)stats.audio_adjust_ppm, response_cursor);
+
+    *response_cursor = VSYNC_HISTOGRAM_BUCKETS;
+    ++response_cursor;
+
+    response_cursor = write_uint16(VSYNC_FRAME_TIME_BUCKET_US, response_cursor);
+    for (i = 0; i < VSYNC_HISTOGRAM_BUCKETS; i++) {
+        response_cursor = write_uint32(stats.frame_time[i], response_cursor);
+    }
+
+    response_cursor = write_uint16(VSYNC_LATENESS_BUCKET_US, response_cursor);
+    for (i = 0; i < VSYNC_HISTOGRAM_BUCKETS; i++) {
+        response_cursor = write_uint32(stats.lateness[i], response_cursor);
+    }
+
+    monitor_binary_response(response_length, e_MON_RESPONSE_FRAME_STATS_GET, e_MON_ERR_OK, command->request_id, response);
+
+    lib_free(response);
+}
+
 #ifdef FEATURE_CPUMEMHISTORY
 static void monitor_binary_process_cpuhistory(binary_command_t *command)
 {
@@ -1831,6 +1876,8 @@ static void monitor_binary_process_command(unsigned char * pbuffer)
         monitor_binary_process_vice_info(&command);
     } else if (command_type == e_MON_CMD_CPUHISTORY_GET) {
         monitor_binary_process_cpuhistory(&command);
+    } else if (command_type == e_MON_CMD_FRAME_STATS_GET) {
+        monitor_binary_process_frame_stats_get(&command);
 
     } else if (command_type == e_MON_CMD_EXIT) {
         monitor_binary_process_exit(&command);
@@ -176,6 +176,9 @@ struct cond_node_s {
 };
 typedef struct cond_node_s cond_node_t;
 
+/* compiled form of a cond_node_t tree, see mon_compile_conditional() */
+typedef struct mon_cond_program_s mon_cond_program_t;
+
 typedef void monitor_toggle_func_t(int value);
 
 /* Defines */
@@ -208,6 +211,10 @@ typedef void monitor_toggle_func_t(int value);
 
 #define DEFAULT_DISASSEMBLY_SIZE 40
 
+/* how far below an address the nearest symbol may be to be shown as
+   "symbol+offset" */
+#define MON_NEAREST_SYMBOL_RANGE 0x100
+
 #define any_watchpoints_load(mem) (watchpoints_load[(mem)] != NULL)
 #define any_watchpoints_store(mem) (watchpoints_store[(mem)] != NULL)
 
@@ -299,6 +306,9 @@ bool check_drive_emu_level_ok(int drive_num);
 void mon_print_conditional(cond_node_t *cnode);
 void mon_delete_conditional(cond_node_t *cnode);
 int mon_evaluate_conditional(cond_node_t *cnode);
+mon_cond_program_t *mon_compile_conditional(cond_node_t *cnode);
+int mon_evaluate_program(mon_cond_program_t *prog);
+void mon_delete_program(mon_cond_program_t *prog);
 int mon_write_snapshot(const char* name, int save_roms, int save_disks, int even_mode);
 int mon_read_snapshot(const char* name, int even_mode);
 bool mon_is_valid_addr(MON_ADDR a);
@@ -319,6 +329,7 @@ void mon_exit(void);
 void mon_quit(void);
 void mon_keyboard_feed(const char *string);
 char *mon_symbol_table_lookup_name(MEMSPACE mem, uint16_t addr);
+char *mon_symbol_table_lookup_nearest(MEMSPACE mem, uint16_t addr, unsigned int *offset);
 int mon_symbol_table_lookup_addr(MEMSPACE mem, char *name);
 char* mon_prepend_dot_to_name(char *name);
 void mon_add_name_to_symbol_table(MON_ADDR addr, char *name);
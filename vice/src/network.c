@@ -41,6 +41,11 @@
 #include <strings.h>
 #endif
 
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+
 #include "archdep.h"
 #include "cmdline.h"
 #include "interrupt.h"
@@ -51,6 +56,7 @@
 #include "mos6510.h"
 #include "network.h"
 #include "resources.h"
+#include "snapshot.h"
 #include "types.h"
 #include "uiapi.h"
 #include "util.h"
@@ -91,6 +97,32 @@ static int current_frame, frame_to_play;
 static event_list_state_t *frame_event_list = NULL;
 static char *snapshotfilename;
 
+/* Rollback mode: instead of waiting frame_delta frames for the remote input,
+   the remote host is assumed to do nothing, a snapshot of every frame is kept
+   in memory and the emulation rewinds to the frame where the assumption turned
+   out to be wrong. frame_event_list then holds the local input of the last
+   rollback_window frames, indexed by frame number modulo frame_delta. */
+static int network_rollback_enabled;
+static int network_rollback_frames;
+
+static int rollback_window;             /* frames that can be rolled back, 0 = lockstep */
+static event_list_state_t **rollback_remote = NULL;
+static snapshot_memory_t *rollback_snapshots = NULL;
+static int rollback_frame;              /* frame boundary reached last */
+static int rollback_remote_next;        /* next frame expected from the remote host */
+static int rollback_resim_frame = -1;   /* next frame to re-simulate, -1 if none */
+static int rollback_warp;               /* warp mode to restore after re-simulation */
+
+/* UDP transport, see network_udp_send_frame() */
+static int network_udp_enabled;
+static int network_redundant_frames;
+
+static unsigned int rollback_count;
+static unsigned int rollback_resim_frames;
+static tick_t rollback_resim_ticks;
+static tick_t rollback_resim_start;
+static tick_t rollback_stats_start;
+
 static int set_server_name(const char *val, void *param)
 {
     util_string_set(&server_name, val);
@@ -126,6 +158,38 @@ static int set_network_control(int val, void *param)
     return 0;
 }
 
+static int set_network_rollback_enabled(int val, void *param)
+{
+    network_rollback_enabled = val ? 1 : 0;
+    return 0;
+}
+
+static int set_network_udp_enabled(int val, void *param)
+{
+    network_udp_enabled = val ? 1 : 0;
+    return 0;
+}
+
+static int set_network_redundant_frames(int val, void *param)
+{
+    if (val < 0 || val > 16) {
+        return -1;
+    }
+
+    network_redundant_frames = val;
+    return 0;
+}
+
+static int set_network_rollback_frames(int val, void *param)
+{
+    if (val < 2 || val > 50) {
+        return -1;
+    }
+
+    network_rollback_frames = val;
+    return 0;
+}
+
 /*---------- Resources ------------------------------------------------*/
 
 static const resource_string_t resources_string[] = {
@@ -141,6 +205,14 @@ static const resource_int_t resources_int[] = {
       &res_server_port, set_server_port, NULL },
     { "NetworkControl", NETWORK_CONTROL_DEFAULT, RES_EVENT_SAME, NULL,
       &network_control, set_network_control, NULL },
+    { "NetworkRollback", 0, RES_EVENT_NO, NULL,
+      &network_rollback_enabled, set_network_rollback_enabled, NULL },
+    { "NetworkRollbackFrames", 8, RES_EVENT_NO, NULL,
+      &network_rollback_frames, set_network_rollback_frames, NULL },
+    { "NetworkUDP", 0, RES_EVENT_NO, NULL,
+      &network_udp_enabled, set_network_udp_enabled, NULL },
+    { "NetworkRedundantFrames", 3, RES_EVENT_NO, NULL,
+      &network_redundant_frames, set_network_redundant_frames, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -225,6 +297,24 @@ static const cmdline_option_t cmdline_options[] =
     { "-netplayctrl", CALL_FUNCTION, CMDLINE_ATTRIB_NEED_ARGS,
       network_control_cmd, NULL, NULL, NULL,
       "<key,joy1,joy2,dev,rsrc>", "Set the netplay control elements (keyboard, joystick1, joystick2, devices and resources), each item takes a value (0: None, 1: Server, 2: Client, 3: Both)" },
+    { "-netplayrollback", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "NetworkRollback", (resource_value_t)1,
+      NULL, "Enable rollback netplay (the server decides)" },
+    { "+netplayrollback", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "NetworkRollback", (resource_value_t)0,
+      NULL, "Use lockstep netplay with a fixed frame delay" },
+    { "-netplayrollbackframes", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "NetworkRollbackFrames", NULL,
+      "<frames>", "Set how many frames rollback netplay can rewind (2..50)" },
+    { "-netplayudp", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "NetworkUDP", (resource_value_t)1,
+      NULL, "Send the netplay input over UDP (the server decides)" },
+    { "+netplayudp", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "NetworkUDP", (resource_value_t)0,
+      NULL, "Send the netplay input over the TCP connection" },
+    { "-netplayredundancy", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "NetworkRedundantFrames", NULL,
+      "<frames>", "Set how many previous frames of input each UDP packet repeats (0..16)" },
     CMDLINE_LIST_END
 };
 
@@ -250,6 +340,44 @@ static void network_free_frame_event_list(void)
     event_destroy_image_list();
 }
 
+static void network_rollback_free(void)
+{
+    int i;
+
+    if (rollback_remote != NULL) {
+        for (i = 0; i < frame_delta; i++) {
+            if (rollback_remote[i] != NULL) {
+                event_clear_list(rollback_remote[i]);
+                lib_free(rollback_remote[i]);
+            }
+        }
+        lib_free(rollback_remote);
+        rollback_remote = NULL;
+    }
+    if (rollback_snapshots != NULL) {
+        for (i = 0; i < rollback_window; i++) {
+            snapshot_memory_free(&rollback_snapshots[i]);
+        }
+        lib_free(rollback_snapshots);
+        rollback_snapshots = NULL;
+    }
+    rollback_window = 0;
+}
+
+static void network_rollback_init(int window)
+{
+    rollback_window = window;
+    rollback_remote = lib_calloc((size_t)frame_delta, sizeof(event_list_state_t *));
+    rollback_snapshots = lib_calloc((size_t)window, sizeof(snapshot_memory_t));
+    rollback_frame = -1;
+    rollback_remote_next = 0;
+    rollback_resim_frame = -1;
+    rollback_count = 0;
+    rollback_resim_frames = 0;
+    rollback_resim_ticks = 0;
+    rollback_stats_start = tick_now();
+}
+
 static void network_event_record_sync_test(uint16_t addr, void *data)
 {
     uint8_t regbuf[5 * 4];
@@ -272,7 +400,9 @@ static void network_init_frame_event_list(void)
     frame_buffer_full = 0;
     event_register_event_list(&(frame_event_list[0]));
     event_init_image_list();
-    interrupt_maincpu_trigger_trap(network_event_record_sync_test, (void *)0);
+    if (rollback_window == 0) {
+        interrupt_maincpu_trigger_trap(network_event_record_sync_test, (void *)0);
+    }
 }
 
 static void network_prepare_next_frame(void)
@@ -405,6 +535,697 @@ static ssize_t network_send_buffer(vice_network_socket_t * s, const uint8_t *buf
     return 0;
 }
 
+/* Send one frame of events over the TCP connection.  */
+static int network_tcp_send_frame(const uint8_t *buf, unsigned int len)
+{
+    uint8_t send_len4[4];
+
+    util_int_to_le_buf4(send_len4, (int)len);
+    if (network_send_buffer(network_socket, send_len4, 4) < 0
+        || network_send_buffer(network_socket, buf, len) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Receive one frame of events from the TCP connection. Returns 1 and a
+   buffer to be freed by the caller, 0 if block is not set and nothing
+   arrived yet, -1 on error.  */
+static int network_tcp_recv_frame(int block, uint8_t **buf, unsigned int *len)
+{
+    unsigned int recv_len;
+    uint8_t recv_len4[4];
+
+    do {
+        if (!block && vice_network_select_poll_one(network_socket) <= 0) {
+            return 0;
+        }
+
+        if (network_recv_buffer(network_socket, recv_len4, 4) < 0) {
+            ui_display_statustext("Remote host disconnected.", true);
+            network_disconnect();
+            return -1;
+        }
+
+        recv_len = util_le_buf4_to_int(recv_len4);
+        if (recv_len == 0 && suspended == 0) {
+            /* remote host suspended emulation */
+            ui_display_statustext("Remote host suspending...", false);
+            suspended = 1;
+            vsync_suspend_speed_eval();
+        }
+    } while (recv_len == 0);
+
+    if (suspended == 1) {
+        ui_display_statustext("", false);
+    }
+
+    *buf = lib_malloc(recv_len);
+
+    if (network_recv_buffer(network_socket, *buf, recv_len) < 0) {
+        lib_free(*buf);
+        *buf = NULL;
+        return -1;
+    }
+
+    *len = recv_len;
+    return 1;
+}
+
+/*---------- UDP transport --------------------------------------------*/
+
+/* With the UDP transport the per-frame event buffers go over a datagram
+   socket instead of the TCP connection, so a late or lost segment does not
+   stall the emulation until TCP retransmits it. Each packet repeats the
+   frames the peer did not acknowledge yet, and at least the last
+   NetworkRedundantFrames ones, so a lost packet is usually covered by the
+   next one. The receiver puts the frames back in order by their sequence
+   number. Frames too big for a datagram (attached images) still go over
+   the TCP connection, the datagrams only mark their place.
+
+   Packet layout, little endian:
+     0  'V' 'N' type count
+     4  packet sequence number
+     8  sequence number of the first frame in the packet
+    12  first frame the sender has not received yet (ack)
+    16  send time (tick_now() of the sender)
+    20  send time of the last packet received from the peer
+    24  ticks between receiving that packet and sending this one
+    28  count times: frame size (or UDP_FRAME_ON_TCP), event buffer
+ */
+
+#define UDP_PACKET_HELLO    0
+#define UDP_PACKET_FRAMES   1
+#define UDP_PACKET_SUSPEND  2
+
+#define UDP_HEADER_SIZE     28
+#define UDP_PACKET_MAX      1400        /* stay below the usual path MTU */
+#define UDP_FRAME_ON_TCP    0xffffffffU
+#define UDP_FRAMES          64          /* frames in flight, must exceed the frame delay */
+#define UDP_QUEUE           64          /* packets between receive thread and emulation */
+#define UDP_TIMEOUT         10          /* seconds without packets until disconnecting */
+#define UDP_REPORT_INTERVAL 10          /* seconds between statistics in the log */
+
+#define UDP_FRAME_EMPTY     0
+#define UDP_FRAME_DATA      1
+#define UDP_FRAME_TCP       2
+
+typedef struct udp_frame_s {
+    uint8_t *data;
+    unsigned int size;
+    int state;
+} udp_frame_t;
+
+static vice_network_socket_t *udp_socket = NULL;
+static udp_frame_t udp_sent[UDP_FRAMES];
+static udp_frame_t udp_received[UDP_FRAMES];
+static uint32_t udp_send_seq;           /* sequence number of the next local frame */
+static uint32_t udp_peer_ack;           /* first local frame the peer is missing */
+static uint32_t udp_recv_next;          /* next remote frame to hand out */
+static uint32_t udp_packet_seq;
+static uint32_t udp_last_packet_seq;
+static uint32_t udp_last_send_tick;     /* send time of the last packet received */
+static tick_t udp_last_arrival;
+static int udp_remote_suspended;
+
+static unsigned int udp_packets_lost;
+static unsigned int udp_frames_recovered;
+static unsigned int udp_packets_resent;
+static tick_t udp_rtt;                  /* smoothed round trip time */
+static double udp_jitter;               /* interarrival jitter as in RFC 3550 */
+static tick_t udp_stats_start;
+
+static uint8_t udp_poll_buffer[UDP_PACKET_MAX];
+
+#ifdef USE_VICE_THREAD
+/* The receive thread only moves raw datagrams into udp_queue, they are
+   parsed on the emulation thread. udp_queue_head is only written by the
+   receive thread and udp_queue_tail only by the emulation thread.  */
+typedef struct udp_packet_s {
+    tick_t arrival;
+    unsigned int size;
+    uint8_t data[UDP_PACKET_MAX];
+} udp_packet_t;
+
+static udp_packet_t udp_queue[UDP_QUEUE];
+static atomic_uint udp_queue_head;
+static atomic_uint udp_queue_tail;
+static atomic_uint udp_queue_dropped;
+static atomic_int udp_thread_stop;
+static pthread_t udp_thread;
+static int udp_thread_running = 0;
+#endif
+
+static unsigned int network_udp_write_header(uint8_t *buf, int type, unsigned int count,
+                                             uint32_t first, uint32_t ack)
+{
+    tick_t now = tick_now();
+
+    buf[0] = 'V';
+    buf[1] = 'N';
+    buf[2] = (uint8_t)type;
+    buf[3] = (uint8_t)count;
+    util_dword_to_le_buf(&buf[4], ++udp_packet_seq);
+    util_dword_to_le_buf(&buf[8], first);
+    util_dword_to_le_buf(&buf[12], ack);
+    util_dword_to_le_buf(&buf[16], now);
+    util_dword_to_le_buf(&buf[20], udp_last_send_tick);
+    util_dword_to_le_buf(&buf[24], udp_last_packet_seq ? now - udp_last_arrival : 0);
+
+    return UDP_HEADER_SIZE;
+}
+
+static void network_udp_send_hello(vice_network_socket_t *s)
+{
+    uint8_t buf[UDP_HEADER_SIZE];
+
+    network_udp_write_header(buf, UDP_PACKET_HELLO, 0, 0, 0);
+    vice_network_send(s, buf, sizeof(buf), SEND_FLAGS);
+}
+
+/* start of every hello packet, see network_udp_write_header() */
+static const uint8_t udp_hello_start[4] = { 'V', 'N', UDP_PACKET_HELLO, 0 };
+
+static int network_udp_is_hello(const uint8_t *buf, ssize_t size)
+{
+    return size >= UDP_HEADER_SIZE && memcmp(buf, udp_hello_start, sizeof(udp_hello_start)) == 0;
+}
+
+/* first remote frame that has not arrived yet */
+static uint32_t network_udp_received_upto(void)
+{
+    uint32_t frame = udp_recv_next;
+
+    while (frame - udp_recv_next < UDP_FRAMES
+           && udp_received[frame % UDP_FRAMES].state != UDP_FRAME_EMPTY) {
+        frame++;
+    }
+    return frame;
+}
+
+static void network_udp_send_packet(int type)
+{
+    uint8_t buf[UDP_PACKET_MAX];
+    unsigned int size;
+    uint32_t first = udp_send_seq;
+    uint32_t frame;
+    unsigned int count = 0;
+
+    if (type == UDP_PACKET_FRAMES && udp_send_seq > 0) {
+        uint32_t newest = udp_send_seq - 1;
+
+        first = newest > (uint32_t)network_redundant_frames ? newest - network_redundant_frames : 0;
+        if (udp_peer_ack < first) {
+            first = udp_peer_ack;
+        }
+        if (newest - first >= UDP_FRAMES) {
+            first = newest - (UDP_FRAMES - 1);
+        }
+
+        /* drop the oldest frames until the packet fits */
+        for (;;) {
+            size = UDP_HEADER_SIZE;
+            for (frame = first; frame <= newest; frame++) {
+                size += 4;
+                if (udp_sent[frame % UDP_FRAMES].state == UDP_FRAME_DATA) {
+                    size += udp_sent[frame % UDP_FRAMES].size;
+                }
+            }
+            if (size <= UDP_PACKET_MAX || first == newest) {
+                break;
+            }
+            first++;
+        }
+        count = newest - first + 1;
+    }
+
+    size = network_udp_write_header(buf, type, count, first, network_udp_received_upto());
+    for (frame = first; frame < first + count; frame++) {
+        udp_frame_t *slot = &udp_sent[frame % UDP_FRAMES];
+
+        if (slot->state == UDP_FRAME_DATA) {
+            util_dword_to_le_buf(&buf[size], slot->size);
+            memcpy(&buf[size + 4], slot->data, slot->size);
+            size += 4 + slot->size;
+        } else {
+            util_dword_to_le_buf(&buf[size], UDP_FRAME_ON_TCP);
+            size += 4;
+        }
+    }
+
+    /* a lost or refused datagram is covered by the next one */
+    vice_network_send(udp_socket, buf, size, SEND_FLAGS);
+}
+
+static int network_udp_send_frame(const uint8_t *buf, unsigned int len)
+{
+    udp_frame_t *slot = &udp_sent[udp_send_seq % UDP_FRAMES];
+
+    lib_free(slot->data);
+    slot->data = NULL;
+
+    if (len > UDP_PACKET_MAX - UDP_HEADER_SIZE - 4) {
+        if (network_tcp_send_frame(buf, len) < 0) {
+            return -1;
+        }
+        slot->size = 0;
+        slot->state = UDP_FRAME_TCP;
+    } else {
+        slot->data = lib_malloc(len);
+        memcpy(slot->data, buf, len);
+        slot->size = len;
+        slot->state = UDP_FRAME_DATA;
+    }
+    udp_send_seq++;
+
+    network_udp_send_packet(UDP_PACKET_FRAMES);
+    return 0;
+}
+
+static void network_udp_process_packet(uint8_t *buf, unsigned int size, tick_t arrival)
+{
+    uint32_t packet_seq, first, ack, send_tick, echo_tick, hold;
+    uint32_t frame, newest, len;
+    unsigned int count, i, offset;
+
+    if (size < UDP_HEADER_SIZE || buf[0] != 'V' || buf[1] != 'N'
+        || buf[2] == UDP_PACKET_HELLO) {
+        return;
+    }
+
+    count = buf[3];
+    packet_seq = util_le_buf_to_dword(&buf[4]);
+    first = util_le_buf_to_dword(&buf[8]);
+    ack = util_le_buf_to_dword(&buf[12]);
+    send_tick = util_le_buf_to_dword(&buf[16]);
+    echo_tick = util_le_buf_to_dword(&buf[20]);
+    hold = util_le_buf_to_dword(&buf[24]);
+
+    if (packet_seq > udp_last_packet_seq) {
+        if (udp_last_packet_seq != 0) {
+            int32_t d = (int32_t)((arrival - udp_last_arrival) - (send_tick - udp_last_send_tick));
+
+            udp_packets_lost += packet_seq - udp_last_packet_seq - 1;
+            udp_jitter += ((d < 0 ? -d : d) - udp_jitter) / 16.0;
+        }
+        if (echo_tick != 0) {
+            tick_t rtt = arrival - echo_tick - hold;
+
+            udp_rtt = udp_rtt ? (7 * udp_rtt + rtt) / 8 : rtt;
+        }
+        udp_last_packet_seq = packet_seq;
+        udp_last_send_tick = send_tick;
+        udp_last_arrival = arrival;
+    }
+
+    if (buf[2] == UDP_PACKET_SUSPEND) {
+        udp_remote_suspended = 1;
+        return;
+    }
+    if (buf[2] != UDP_PACKET_FRAMES) {
+        return;
+    }
+    udp_remote_suspended = 0;
+
+    if (ack > udp_peer_ack) {
+        udp_peer_ack = ack;
+    }
+
+    newest = first + count - 1;
+    offset = UDP_HEADER_SIZE;
+    for (i = 0; i < count; i++) {
+        if (offset + 4 > size) {
+            return;
+        }
+        frame = first + i;
+        len = util_le_buf_to_dword(&buf[offset]);
+        offset += 4;
+        if (len != UDP_FRAME_ON_TCP && len > size - offset) {
+            return;
+        }
+
+        if (frame >= udp_recv_next && frame - udp_recv_next < UDP_FRAMES) {
+            udp_frame_t *slot = &udp_received[frame % UDP_FRAMES];
+
+            if (slot->state == UDP_FRAME_EMPTY) {
+                if (len == UDP_FRAME_ON_TCP) {
+                    slot->state = UDP_FRAME_TCP;
+                } else {
+                    slot->data = lib_malloc(len);
+                    memcpy(slot->data, &buf[offset], len);
+                    slot->size = len;
+                    slot->state = UDP_FRAME_DATA;
+                }
+                if (frame != newest) {
+                    /* the packet that carried it first got lost */
+                    udp_frames_recovered++;
+                }
+            }
+        }
+
+        if (len != UDP_FRAME_ON_TCP) {
+            offset += len;
+        }
+    }
+}
+
+#ifdef USE_VICE_THREAD
+static void *network_udp_thread(void *unused)
+{
+    while (!atomic_load(&udp_thread_stop)) {
+        unsigned int head, tail;
+        ssize_t size;
+
+        if (vice_network_select_wait_one(udp_socket, 100) <= 0) {
+            continue;
+        }
+
+        head = atomic_load_explicit(&udp_queue_head, memory_order_relaxed);
+        tail = atomic_load_explicit(&udp_queue_tail, memory_order_acquire);
+
+        if (head - tail >= UDP_QUEUE) {
+            /* emulation is not keeping up, drop the packet */
+            vice_network_receive(udp_socket, udp_poll_buffer, sizeof(udp_poll_buffer), 0);
+            atomic_fetch_add(&udp_queue_dropped, 1);
+            continue;
+        }
+
+        size = vice_network_receive(udp_socket, udp_queue[head % UDP_QUEUE].data, UDP_PACKET_MAX, 0);
+        if (size <= 0) {
+            continue;
+        }
+        udp_queue[head % UDP_QUEUE].size = (unsigned int)size;
+        udp_queue[head % UDP_QUEUE].arrival = tick_now();
+
+        atomic_store_explicit(&udp_queue_head, head + 1, memory_order_release);
+    }
+    return NULL;
+}
+#endif
+
+/* parse everything that arrived since the last call */
+static void network_udp_poll(void)
+{
+    ssize_t size;
+
+#ifdef USE_VICE_THREAD
+    if (udp_thread_running) {
+        unsigned int tail = atomic_load_explicit(&udp_queue_tail, memory_order_relaxed);
+        unsigned int head = atomic_load_explicit(&udp_queue_head, memory_order_acquire);
+
+        while (tail != head) {
+            udp_packet_t *packet = &udp_queue[tail % UDP_QUEUE];
+
+            network_udp_process_packet(packet->data, packet->size, packet->arrival);
+            tail++;
+        }
+        atomic_store_explicit(&udp_queue_tail, tail, memory_order_release);
+        return;
+    }
+#endif
+
+    while (vice_network_select_poll_one(udp_socket) > 0) {
+        size = vice_network_receive(udp_socket, udp_poll_buffer, sizeof(udp_poll_buffer), 0);
+        if (size <= 0) {
+            break;
+        }
+        network_udp_process_packet(udp_poll_buffer, (unsigned int)size, tick_now());
+    }
+}
+
+static int network_udp_recv_frame(int block, uint8_t **buf, unsigned int *len)
+{
+    tick_t last_resend = tick_now();
+    int suspend_shown = 0;
+    udp_frame_t *slot;
+
+    for (;;) {
+        network_udp_poll();
+
+        slot = &udp_received[udp_recv_next % UDP_FRAMES];
+        if (slot->state != UDP_FRAME_EMPTY) {
+            break;
+        }
+        if (!block) {
+            return 0;
+        }
+
+        if (udp_remote_suspended && !suspend_shown) {
+            ui_display_statustext("Remote host suspending...", false);
+            vsync_suspend_speed_eval();
+            suspend_shown = 1;
+        }
+        if (!udp_remote_suspended
+            && tick_now_delta(udp_last_arrival) > UDP_TIMEOUT * tick_per_second()) {
+            ui_display_statustext("Remote host disconnected.", true);
+            network_disconnect();
+            return -1;
+        }
+        /* our last packet might have been lost too, or both sides wait */
+        if (tick_now_delta(last_resend) > tick_per_second() / 20) {
+            network_udp_send_packet(UDP_PACKET_FRAMES);
+            udp_packets_resent++;
+            last_resend = tick_now();
+        }
+
+#ifdef USE_VICE_THREAD
+        if (udp_thread_running) {
+            tick_sleep(tick_per_second() / 1000);
+            continue;
+        }
+#endif
+        vice_network_select_wait_one(udp_socket, 5);
+    }
+
+    if (suspend_shown) {
+        ui_display_statustext("", false);
+    }
+
+    udp_recv_next++;
+    if (slot->state == UDP_FRAME_TCP) {
+        slot->state = UDP_FRAME_EMPTY;
+        return network_tcp_recv_frame(1, buf, len);
+    }
+
+    *buf = slot->data;
+    *len = slot->size;
+    slot->data = NULL;
+    slot->state = UDP_FRAME_EMPTY;
+    return 1;
+}
+
+static void network_udp_report(void)
+{
+    tick_t elapsed;
+    unsigned int dropped = 0;
+
+    if (udp_socket == NULL) {
+        return;
+    }
+
+    elapsed = tick_now_delta(udp_stats_start);
+    if (elapsed < UDP_REPORT_INTERVAL * tick_per_second()) {
+        return;
+    }
+
+#ifdef USE_VICE_THREAD
+    dropped = atomic_exchange(&udp_queue_dropped, 0);
+#endif
+    log_message(LOG_DEFAULT,
+                "netplay: UDP round trip %u ms, jitter %.1f ms; %u packets lost, %u frames recovered from repeated input, %u packets resent, %u dropped during the last %u s.",
+                TICK_TO_MILLI(udp_rtt), udp_jitter * 1000.0 / tick_per_second(),
+                udp_packets_lost, udp_frames_recovered, udp_packets_resent, dropped,
+                (unsigned int)(elapsed / tick_per_second()));
+
+    udp_packets_lost = 0;
+    udp_frames_recovered = 0;
+    udp_packets_resent = 0;
+    udp_stats_start = tick_now();
+}
+
+static void network_udp_open(vice_network_socket_t *s)
+{
+    udp_socket = s;
+    udp_send_seq = 0;
+    udp_peer_ack = 0;
+    udp_recv_next = 0;
+    udp_packet_seq = 0;
+    udp_last_packet_seq = 0;
+    udp_last_send_tick = 0;
+    udp_last_arrival = tick_now();
+    udp_remote_suspended = 0;
+    udp_packets_lost = 0;
+    udp_frames_recovered = 0;
+    udp_packets_resent = 0;
+    udp_rtt = 0;
+    udp_jitter = 0.0;
+    udp_stats_start = tick_now();
+
+#ifdef USE_VICE_THREAD
+    atomic_store(&udp_queue_head, 0);
+    atomic_store(&udp_queue_tail, 0);
+    atomic_store(&udp_queue_dropped, 0);
+    atomic_store(&udp_thread_stop, 0);
+    if (pthread_create(&udp_thread, NULL, network_udp_thread, NULL) == 0) {
+        udp_thread_running = 1;
+    } else {
+        log_error(LOG_DEFAULT, "netplay: cannot start the UDP receive thread, polling instead.");
+    }
+#endif
+}
+
+static void network_udp_close(void)
+{
+    int i;
+
+    if (udp_socket == NULL) {
+        return;
+    }
+
+#ifdef USE_VICE_THREAD
+    if (udp_thread_running) {
+        atomic_store(&udp_thread_stop, 1);
+        pthread_join(udp_thread, NULL);
+        udp_thread_running = 0;
+    }
+#endif
+
+    vice_network_socket_close(udp_socket);
+    udp_socket = NULL;
+
+    for (i = 0; i < UDP_FRAMES; i++) {
+        lib_free(udp_sent[i].data);
+        lib_free(udp_received[i].data);
+    }
+    memset(udp_sent, 0, sizeof(udp_sent));
+    memset(udp_received, 0, sizeof(udp_received));
+}
+
+/* Set up the UDP transport after the TCP handshake. The server offers it,
+   the client confirms over TCP whether datagrams got through both ways.  */
+static int network_udp_negotiate(int offer)
+{
+    vice_network_socket_address_t *addr;
+    vice_network_socket_t *s = NULL;
+    uint8_t use_udp = 0;
+    uint8_t confirm = 0;
+    int i;
+
+    if (network_mode == NETWORK_SERVER_CONNECTED) {
+        if (offer) {
+            addr = vice_network_address_generate(server_bind_address, server_port);
+            if (addr != NULL) {
+                s = vice_network_datagram_server(addr);
+                vice_network_address_close(addr);
+            }
+            use_udp = s != NULL;
+        }
+        if (network_send_buffer(network_socket, &use_udp, sizeof(use_udp)) < 0) {
+            goto fail;
+        }
+        if (!use_udp) {
+            return 0;
+        }
+        /* only the hello of the client connected over TCP is accepted */
+        if (vice_network_datagram_accept(s, network_socket, udp_hello_start,
+                                         sizeof(udp_hello_start), 3000) == 0) {
+            for (i = 0; i < 3; i++) {
+                network_udp_send_hello(s);
+            }
+        }
+        if (network_recv_buffer(network_socket, &confirm, sizeof(confirm)) < 0) {
+            goto fail;
+        }
+    } else {
+        if (network_recv_buffer(network_socket, &use_udp, sizeof(use_udp)) < 0) {
+            return -1;
+        }
+        if (!use_udp) {
+            return 0;
+        }
+        addr = vice_network_address_generate(server_name, server_port);
+        if (addr != NULL) {
+            s = vice_network_datagram_client(addr);
+            vice_network_address_close(addr);
+        }
+        for (i = 0; s != NULL && i < 30 && !confirm; i++) {
+            network_udp_send_hello(s);
+            if (vice_network_select_wait_one(s, 100) > 0) {
+                ssize_t size = vice_network_receive(s, udp_poll_buffer, sizeof(udp_poll_buffer), 0);
+
+                confirm = network_udp_is_hello(udp_poll_buffer, size);
+            }
+        }
+        if (network_send_buffer(network_socket, &confirm, sizeof(confirm)) < 0) {
+            goto fail;
+        }
+    }
+
+    if (!confirm) {
+        log_warning(LOG_DEFAULT, "netplay: UDP packets do not get through, using TCP.");
+        goto fail;
+    }
+
+    network_udp_open(s);
+    return 1;
+
+fail:
+    if (s != NULL) {
+        vice_network_socket_close(s);
+    }
+    return 0;
+}
+
+/* Send the events of one frame to the remote host.  */
+static int network_send_frame(const uint8_t *buf, unsigned int len)
+{
+    if (udp_socket != NULL) {
+        return network_udp_send_frame(buf, len);
+    }
+    return network_tcp_send_frame(buf, len);
+}
+
+/* Receive the events of the next remote frame, see network_tcp_recv_frame().  */
+static int network_recv_frame(int block, uint8_t **buf, unsigned int *len)
+{
+    if (udp_socket != NULL) {
+        return network_udp_recv_frame(block, buf, len);
+    }
+    return network_tcp_recv_frame(block, buf, len);
+}
+
+/* Both hosts send this right after connecting. Bump the version whenever
+   the handshake or the frame format changes, VICE versions without it send
+   the snapshot (server) or nothing (client) instead and are rejected too. */
+static const uint8_t network_protocol_magic[4] = { 'V', 'N', 'E', 'T' };
+#define NETWORK_PROTOCOL_VERSION    2
+#define NETWORK_PROTOCOL_TIMEOUT    3000
+
+static int network_check_protocol(void)
+{
+    uint8_t buf[sizeof(network_protocol_magic) + 1];
+
+    memcpy(buf, network_protocol_magic, sizeof(network_protocol_magic));
+    buf[sizeof(network_protocol_magic)] = NETWORK_PROTOCOL_VERSION;
+    if (network_send_buffer(network_socket, buf, sizeof(buf)) < 0) {
+        return -1;
+    }
+
+    if (vice_network_select_wait_one(network_socket, NETWORK_PROTOCOL_TIMEOUT) <= 0
+        || network_recv_buffer(network_socket, buf, sizeof(buf)) < 0
+        || memcmp(buf, network_protocol_magic, sizeof(network_protocol_magic)) != 0) {
+        log_error(LOG_DEFAULT, "netplay: remote host does not speak netplay protocol version %d.",
+                  NETWORK_PROTOCOL_VERSION);
+        return -1;
+    }
+    if (buf[sizeof(network_protocol_magic)] != NETWORK_PROTOCOL_VERSION) {
+        log_error(LOG_DEFAULT, "netplay: remote host uses netplay protocol version %d, expected %d.",
+                  buf[sizeof(network_protocol_magic)], NETWORK_PROTOCOL_VERSION);
+        return -1;
+    }
+    return 0;
+}
+
 #define NUM_OF_TESTPACKETS 50
 
 typedef struct {
@@ -416,6 +1237,8 @@ static int network_test_delay(void)
 {
     int i, j, ret = -1;
     uint8_t new_frame_delta = 5; /* default to use on error */
+    uint8_t new_rollback_window = 0;
+    int udp = 0;
     unsigned char *buf;
     testpacket pkt;
 
@@ -462,6 +1285,21 @@ static int network_test_delay(void)
         if (network_send_buffer(network_socket, &new_frame_delta, sizeof(new_frame_delta)) < 0) {
             goto exiterror;
         }
+        /* the server decides whether both sides use rollback */
+        if (network_rollback_enabled) {
+            new_rollback_window = (uint8_t)network_rollback_frames;
+        }
+        if (network_send_buffer(network_socket, &new_rollback_window, sizeof(new_rollback_window)) < 0) {
+            new_rollback_window = 0;
+            goto exiterror;
+        }
+        /* the frames in flight have to fit into the UDP frame rings */
+        udp = network_udp_negotiate(network_udp_enabled
+                                    && (new_rollback_window > 0 ? new_rollback_window + 2
+                                        : new_frame_delta) < UDP_FRAMES / 2);
+        if (udp < 0) {
+            goto exiterror;
+        }
     } else {
         DBG(("network_test_delay (client)"));
         /* network_mode == NETWORK_CLIENT */
@@ -474,14 +1312,35 @@ static int network_test_delay(void)
         }
         network_recv_buffer(network_socket, &new_frame_delta,
                             sizeof(new_frame_delta));
+        if (network_recv_buffer(network_socket, &new_rollback_window,
+                                sizeof(new_rollback_window)) < 0) {
+            new_rollback_window = 0;
+        }
+        udp = network_udp_negotiate(0);
+        if (udp < 0) {
+            goto exiterror;
+        }
     }
     ret = 0;
 exiterror:
     network_free_frame_event_list();
-    frame_delta = new_frame_delta;
-    network_init_frame_event_list();
-    sprintf(st, "Using %d frames delay.", frame_delta);
-    log_debug(LOG_DEFAULT, "netplay connected with %d frames delta.", frame_delta);
+    network_rollback_free();
+    if (new_rollback_window > 0) {
+        /* local input of the window, the frame being played and the one
+           being recorded */
+        frame_delta = new_rollback_window + 2;
+        network_rollback_init(new_rollback_window);
+        network_init_frame_event_list();
+        sprintf(st, "Using rollback over up to %d frames%s.", rollback_window,
+                udp > 0 ? " over UDP" : "");
+        log_debug(LOG_DEFAULT, "netplay connected with rollback over %d frames.", rollback_window);
+    } else {
+        frame_delta = new_frame_delta;
+        network_init_frame_event_list();
+        sprintf(st, "Using %d frames delay%s.", frame_delta,
+                udp > 0 ? " over UDP" : "");
+        log_debug(LOG_DEFAULT, "netplay connected with %d frames delta.", frame_delta);
+    }
     ui_display_statustext(st, true);
     return ret;
 }
@@ -501,6 +1360,13 @@ static void network_server_connect_trap(uint16_t addr, void *data)
     vsync_suspend_speed_eval();
     sound_suspend();
 
+    if (network_check_protocol() < 0) {
+        ui_error("The client uses an incompatible netplay version.");
+        vice_network_socket_close(network_socket);
+        network_socket = NULL;
+        return;
+    }
+
     /* Create snapshot and send it */
     snapshotfilename = archdep_tmpnam();
     if (machine_write_snapshot(snapshotfilename, 1, 1, 0) == 0) {
@@ -796,6 +1662,14 @@ int network_connect_client(void)
         return -1;
     }
 
+    if (network_check_protocol() < 0) {
+        ui_error("The server uses an incompatible netplay version.");
+        lib_free(snapshotfilename);
+        vice_network_socket_close(network_socket);
+        network_socket = NULL;
+        return -1;
+    }
+
     ui_display_statustext("Receiving snapshot from server...", false);
     if (network_recv_buffer(network_socket, recv_buf4, 4) < 0) {
         lib_free(snapshotfilename);
@@ -827,6 +1701,11 @@ int network_connect_client(void)
 void network_disconnect(void)
 {
     DBG(("network_disconnect (network_mode was:%u)", network_mode));
+    if (rollback_resim_frame >= 0) {
+        vsync_set_warp_mode(rollback_warp);
+        rollback_resim_frame = -1;
+    }
+    network_udp_close();
     vice_network_socket_close(network_socket);
     if (network_mode == NETWORK_SERVER_CONNECTED) {
         network_mode = NETWORK_SERVER;
@@ -845,7 +1724,15 @@ void network_suspend(void)
         return;
     }
 
-    network_send_buffer(network_socket, (uint8_t *)&dummy_buf_len, sizeof(unsigned int));
+    if (udp_socket != NULL) {
+        int i;
+
+        for (i = 0; i < 3; i++) {
+            network_udp_send_packet(UDP_PACKET_SUSPEND);
+        }
+    } else {
+        network_send_buffer(network_socket, (uint8_t *)&dummy_buf_len, sizeof(unsigned int));
+    }
 
     suspended = 1;
 }
@@ -858,7 +1745,6 @@ static void network_hook_connected_send(void)
 {
     uint8_t *local_event_buf = NULL;
     unsigned int send_len;
-    uint8_t send_len4[4];
 
     DBGT(("network_hook_connected_send"));
 
@@ -870,11 +1756,7 @@ static void network_hook_connected_send(void)
     t1 = tick_now();
 #endif
 
-    util_int_to_le_buf4(send_len4, (int)send_len);
-    if (network_send_buffer(network_socket, send_len4, 4) < 0) {
-        ui_display_statustext("Remote host disconnected.", true);
-        network_disconnect();
-    } else if (network_send_buffer(network_socket, local_event_buf, send_len) < 0) {
+    if (network_send_frame(local_event_buf, send_len) < 0) {
         ui_display_statustext("Remote host disconnected.", true);
         network_disconnect();
     }
@@ -889,7 +1771,6 @@ static void network_hook_connected_receive(void)
 {
     uint8_t *remote_event_buf = NULL;
     unsigned int recv_len;
-    uint8_t recv_len4[4];
     event_list_state_t *remote_event_list;
     event_list_state_t *client_event_list, *server_event_list;
 
@@ -902,31 +1783,7 @@ static void network_hook_connected_receive(void)
     }
 
     if (frame_buffer_full) {
-        do {
-            if (network_recv_buffer(network_socket, recv_len4, 4) < 0) {
-                ui_display_statustext("Remote host disconnected.", true);
-                network_disconnect();
-                return;
-            }
-
-            recv_len = util_le_buf4_to_int(recv_len4);
-            if (recv_len == 0 && suspended == 0) {
-                /* remote host suspended emulation */
-                ui_display_statustext("Remote host suspending...", false);
-                suspended = 1;
-                vsync_suspend_speed_eval();
-            }
-        } while (recv_len == 0);
-
-        if (suspended == 1) {
-            ui_display_statustext("", false);
-        }
-
-        remote_event_buf = lib_malloc(recv_len);
-
-        if (network_recv_buffer(network_socket, remote_event_buf,
-                                recv_len) < 0) {
-            lib_free(remote_event_buf);
+        if (network_recv_frame(1, &remote_event_buf, &recv_len) <= 0) {
             return;
         }
 
@@ -974,6 +1831,182 @@ static void network_hook_connected_receive(void)
 #endif
 }
 
+/* play the local and remote input of a frame; server first, then client */
+static void network_rollback_playback(int frame)
+{
+    event_list_state_t *local_list = &(frame_event_list[frame % frame_delta]);
+    event_list_state_t *remote_list = NULL;
+
+    /* input not received yet is predicted to be nothing */
+    if (frame < rollback_remote_next) {
+        remote_list = rollback_remote[frame % frame_delta];
+    }
+
+    if (network_mode == NETWORK_SERVER_CONNECTED) {
+        event_playback_event_list(local_list);
+    }
+    if (remote_list != NULL) {
+        event_playback_event_list(remote_list);
+    }
+    if (network_mode != NETWORK_SERVER_CONNECTED) {
+        event_playback_event_list(local_list);
+    }
+}
+
+/* save the state at the start of a frame, then apply its input */
+static void network_rollback_save_trap(uint16_t addr, void *data)
+{
+    int frame = vice_ptr_to_int(data);
+
+    snapshot_memory_select(&(rollback_snapshots[frame % rollback_window]));
+    if (machine_write_snapshot("", 0, 0, 0) < 0) {
+        log_error(LOG_DEFAULT, "netplay: cannot save rollback state of frame %d.", frame);
+    }
+    snapshot_memory_select(NULL);
+
+    network_rollback_playback(frame);
+}
+
+/* go back to the start of a mispredicted frame and apply the real input */
+static void network_rollback_restore_trap(uint16_t addr, void *data)
+{
+    int frame = vice_ptr_to_int(data);
+    int failed;
+
+    snapshot_memory_select(&(rollback_snapshots[frame % rollback_window]));
+    failed = machine_read_snapshot("", 0) < 0;
+    snapshot_memory_select(NULL);
+
+    if (failed) {
+        ui_error("Cannot roll back netplay state - disconnecting.");
+        network_disconnect();
+        return;
+    }
+
+    network_rollback_playback(frame);
+}
+
+/* Receive the input of the next remote frame, NULL if it did not arrive yet
+   and block is not set. */
+static event_list_state_t *network_rollback_receive(int block)
+{
+    uint8_t *remote_event_buf;
+    unsigned int recv_len;
+    event_list_state_t *remote_event_list;
+    int result;
+
+    result = network_recv_frame(block, &remote_event_buf, &recv_len);
+    if (result == 0) {
+        return NULL;
+    }
+    if (result < 0) {
+        if (network_connected()) {
+            ui_display_statustext("Remote host disconnected.", true);
+            network_disconnect();
+        }
+        return NULL;
+    }
+    suspended = 0;
+
+    remote_event_list = network_create_event_list(remote_event_buf);
+    lib_free(remote_event_buf);
+
+    return remote_event_list;
+}
+
+static void network_rollback_report(void)
+{
+    tick_t elapsed = tick_now_delta(rollback_stats_start);
+
+    if (elapsed < tick_per_second()) {
+        return;
+    }
+
+    if (rollback_count > 0) {
+        log_message(LOG_DEFAULT,
+                    "netplay: %u rollbacks, %u frames re-simulated in %u ms during the last %.1f s.",
+                    rollback_count, rollback_resim_frames,
+                    (unsigned int)((uint64_t)rollback_resim_ticks * 1000 / tick_per_second()),
+                    (double)elapsed / tick_per_second());
+    }
+
+    rollback_count = 0;
+    rollback_resim_frames = 0;
+    rollback_resim_ticks = 0;
+    rollback_stats_start = tick_now();
+}
+
+static void network_hook_rollback(void)
+{
+    int frame;
+    int mispredicted = -1;
+    event_list_state_t *remote_event_list;
+
+    if (rollback_resim_frame >= 0) {
+        /* catching up after a rollback, the input is known already */
+        frame = rollback_resim_frame++;
+        rollback_resim_frames++;
+        interrupt_maincpu_trigger_trap(network_rollback_save_trap, vice_int_to_ptr(frame));
+        if (frame == rollback_frame) {
+            rollback_resim_frame = -1;
+            vsync_set_warp_mode(rollback_warp);
+            rollback_resim_ticks += tick_now_delta(rollback_resim_start);
+        }
+        return;
+    }
+
+    frame = ++rollback_frame;
+
+    network_hook_connected_send();
+    if (!network_connected()) {
+        return;
+    }
+
+    /* Take whatever remote input arrived; only wait when the oldest frame
+       that could still be rolled back is about to be dropped.  */
+    while (rollback_remote_next <= frame) {
+        int slot = rollback_remote_next % frame_delta;
+
+        remote_event_list = network_rollback_receive(rollback_remote_next <= frame - rollback_window);
+        if (remote_event_list == NULL) {
+            if (!network_connected()) {
+                return;
+            }
+            break;
+        }
+
+        if (rollback_remote[slot] != NULL) {
+            event_clear_list(rollback_remote[slot]);
+            lib_free(rollback_remote[slot]);
+        }
+        rollback_remote[slot] = remote_event_list;
+
+        if (mispredicted < 0 && rollback_remote_next < frame
+            && remote_event_list->base->type != EVENT_LIST_END) {
+            mispredicted = rollback_remote_next;
+        }
+        rollback_remote_next++;
+    }
+
+    /* record the local input for the next frame */
+    current_frame = (frame + 1) % frame_delta;
+    event_clear_list(&(frame_event_list[current_frame]));
+    event_register_event_list(&(frame_event_list[current_frame]));
+
+    if (mispredicted >= 0) {
+        rollback_count++;
+        rollback_resim_start = tick_now();
+        rollback_resim_frame = mispredicted + 1;
+        rollback_warp = vsync_get_warp_mode();
+        vsync_set_warp_mode(1);
+        interrupt_maincpu_trigger_trap(network_rollback_restore_trap, vice_int_to_ptr(mispredicted));
+    } else {
+        interrupt_maincpu_trigger_trap(network_rollback_save_trap, vice_int_to_ptr(frame));
+    }
+
+    network_rollback_report();
+}
+
 void network_hook(void)
 {
     if (network_mode == NETWORK_IDLE) {
@@ -991,12 +2024,16 @@ void network_hook(void)
         }
     }
 
-    if (network_connected()) {
+    if (network_connected() && rollback_window > 0) {
+        network_hook_rollback();
+    } else if (network_connected()) {
         network_hook_connected_send();
         network_hook_connected_receive();
         DBGT(("network_hook timing: %5ld %5ld %5ld; total: %5ld",
                   t2 - t1, t3 - t2, t4 - t3, t4 - t1));
     }
+
+    network_udp_report();
 }
 
 void network_shutdown(void)
@@ -1005,6 +2042,7 @@ void network_shutdown(void)
         network_disconnect();
     }
 
+    network_rollback_free();
     network_free_frame_event_list();
     lib_free(server_name);
     lib_free(server_bind_address);
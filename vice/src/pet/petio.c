@@ -82,6 +82,26 @@ static io_source_list_t petio_ed00_head = { NULL, NULL, NULL };
 static io_source_list_t petio_ee00_head = { NULL, NULL, NULL };
 static io_source_list_t petio_ef00_head = { NULL, NULL, NULL };
 
+/* per-address dispatch tables, one for each I/O page, see cartio.h */
+static io_source_t io_source_shared;
+#define IO_SOURCE_SHARED (&io_source_shared)
+
+static io_source_t *petio_8800_dispatch[0x100];
+static io_source_t *petio_8900_dispatch[0x100];
+static io_source_t *petio_8a00_dispatch[0x100];
+static io_source_t *petio_8b00_dispatch[0x100];
+static io_source_t *petio_8c00_dispatch[0x100];
+static io_source_t *petio_8d00_dispatch[0x100];
+static io_source_t *petio_8e00_dispatch[0x100];
+static io_source_t *petio_8f00_dispatch[0x100];
+static io_source_t *petio_e900_dispatch[0x100];
+static io_source_t *petio_ea00_dispatch[0x100];
+static io_source_t *petio_eb00_dispatch[0x100];
+static io_source_t *petio_ec00_dispatch[0x100];
+static io_source_t *petio_ed00_dispatch[0x100];
+static io_source_t *petio_ee00_dispatch[0x100];
+static io_source_t *petio_ef00_dispatch[0x100];
+
 static void io_source_detach(io_source_detach_t *source)
 {
     switch (source->det_id) {
@@ -283,9 +303,10 @@ static void io_source_log_collisions(uint16_t addr, int amount, io_source_list_t
     }
 }
 
-static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
+static inline uint8_t io_read(io_source_list_t *list, io_source_t **dispatch, uint16_t addr)
 {
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0xff];
     int io_source_counter = 0;
     int io_source_valid = 0;
     uint8_t realval = 0;
@@ -293,6 +314,18 @@ static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
     uint8_t firstval = 0;
     unsigned int lowest_order = 0xffffffff;
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->read != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            retval = device->read((uint16_t)(addr & device->address_mask));
+            if (device->io_source_valid) {
+                return retval;
+            }
+        }
+        return read_unused(addr);
+    }
+
     while (current) {
         if (current->device->read != NULL) {
             if ((addr >= current->device->start_address) && (addr <= current->device->end_address)) {
@@ -379,13 +412,23 @@ static inline uint8_t io_peek(io_source_list_t *list, uint16_t addr)
     return read_unused(addr);
 }
 
-static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value)
+static inline void io_store(io_source_list_t *list, io_source_t **dispatch, uint16_t addr, uint8_t value)
 {
     int writes = 0;
     uint16_t addy = 0xffff;
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0xff];
     void (*store)(uint16_t address, uint8_t data) = NULL;
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->store != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            device->store((uint16_t)(addr & device->address_mask), value);
+        }
+        return;
+    }
+
     while (current) {
         if (current->device->store != NULL) {
             if (addr >= current->device->start_address && addr <= current->device->end_address) {
@@ -409,6 +452,50 @@ static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value
 
 /* ---------------------------------------------------------------------------------------------------------- */
 
+static void io_source_dispatch_build(io_source_list_t *list, io_source_t **dispatch, unsigned int base)
+{
+    io_source_list_t *current = list->next;
+    unsigned int start;
+    unsigned int end;
+    unsigned int i;
+
+    memset(dispatch, 0, sizeof(io_source_t *) * 0x100);
+
+    while (current) {
+        start = current->device->start_address;
+        end = current->device->end_address;
+        if (start < base) {
+            start = base;
+        }
+        if (end > base + 0xff) {
+            end = base + 0xff;
+        }
+        for (i = start; i <= end; i++) {
+            dispatch[i - base] = dispatch[i - base] ? IO_SOURCE_SHARED : current->device;
+        }
+        current = current->next;
+    }
+}
+
+void io_source_dispatch_update(void)
+{
+    io_source_dispatch_build(&petio_8800_head, petio_8800_dispatch, 0x8800);
+    io_source_dispatch_build(&petio_8900_head, petio_8900_dispatch, 0x8900);
+    io_source_dispatch_build(&petio_8a00_head, petio_8a00_dispatch, 0x8a00);
+    io_source_dispatch_build(&petio_8b00_head, petio_8b00_dispatch, 0x8b00);
+    io_source_dispatch_build(&petio_8c00_head, petio_8c00_dispatch, 0x8c00);
+    io_source_dispatch_build(&petio_8d00_head, petio_8d00_dispatch, 0x8d00);
+    io_source_dispatch_build(&petio_8e00_head, petio_8e00_dispatch, 0x8e00);
+    io_source_dispatch_build(&petio_8f00_head, petio_8f00_dispatch, 0x8f00);
+    io_source_dispatch_build(&petio_e900_head, petio_e900_dispatch, 0xe900);
+    io_source_dispatch_build(&petio_ea00_head, petio_ea00_dispatch, 0xea00);
+    io_source_dispatch_build(&petio_eb00_head, petio_eb00_dispatch, 0xeb00);
+    io_source_dispatch_build(&petio_ec00_head, petio_ec00_dispatch, 0xec00);
+    io_source_dispatch_build(&petio_ed00_head, petio_ed00_dispatch, 0xed00);
+    io_source_dispatch_build(&petio_ee00_head, petio_ee00_dispatch, 0xee00);
+    io_source_dispatch_build(&petio_ef00_head, petio_ef00_dispatch, 0xef00);
+}
+
 io_source_list_t *io_source_register(io_source_t *device)
 {
     io_source_list_t *current = NULL;
@@ -481,6 +568,8 @@ io_source_list_t *io_source_register(io_source_t *device)
     retval->next = NULL;
     retval->device->order = order++;
 
+    io_source_dispatch_update();
+
     return retval;
 }
 
@@ -505,6 +594,8 @@ void io_source_unregister(io_source_list_t *device)
     }
 
     lib_free(device);
+
+    io_source_dispatch_update();
 }
 
 void cartio_shutdown(void)
@@ -612,7 +703,7 @@ void cartio_set_highest_order(unsigned int nr)
 uint8_t petio_8800_read(uint16_t addr)
 {
     DBGRW(("IO: io-8800 r %04x\n", addr));
-    return io_read(&petio_8800_head, addr);
+    return io_read(&petio_8800_head, petio_8800_dispatch, addr);
 }
 
 uint8_t petio_8800_peek(uint16_t addr)
@@ -624,13 +715,13 @@ uint8_t petio_8800_peek(uint16_t addr)
 void petio_8800_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-8800 w %04x %02x\n", addr, value));
-    io_store(&petio_8800_head, addr, value);
+    io_store(&petio_8800_head, petio_8800_dispatch, addr, value);
 }
 
 uint8_t petio_8900_read(uint16_t addr)
 {
     DBGRW(("IO: io-8900 r %04x\n", addr));
-    return io_read(&petio_8900_head, addr);
+    return io_read(&petio_8900_head, petio_8900_dispatch, addr);
 }
 
 uint8_t petio_8900_peek(uint16_t addr)
@@ -642,13 +733,13 @@ uint8_t petio_8900_peek(uint16_t addr)
 void petio_8900_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-8900 w %04x %02x\n", addr, value));
-    io_store(&petio_8900_head, addr, value);
+    io_store(&petio_8900_head, petio_8900_dispatch, addr, value);
 }
 
 uint8_t petio_8a00_read(uint16_t addr)
 {
     DBGRW(("IO: io-8a00 r %04x\n", addr));
-    return io_read(&petio_8a00_head, addr);
+    return io_read(&petio_8a00_head, petio_8a00_dispatch, addr);
 }
 
 uint8_t petio_8a00_peek(uint16_t addr)
@@ -660,13 +751,13 @@ uint8_t petio_8a00_peek(uint16_t addr)
 void petio_8a00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-8a00 w %04x %02x\n", addr, value));
-    io_store(&petio_8a00_head, addr, value);
+    io_store(&petio_8a00_head, petio_8a00_dispatch, addr, value);
 }
 
 uint8_t petio_8b00_read(uint16_t addr)
 {
     DBGRW(("IO: io-8b00 r %04x\n", addr));
-    return io_read(&petio_8b00_head, addr);
+    return io_read(&petio_8b00_head, petio_8b00_dispatch, addr);
 }
 
 uint8_t petio_8b00_peek(uint16_t addr)
@@ -678,13 +769,13 @@ uint8_t petio_8b00_peek(uint16_t addr)
 void petio_8b00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-8b00 w %04x %02x\n", addr, value));
-    io_store(&petio_8b00_head, addr, value);
+    io_store(&petio_8b00_head, petio_8b00_dispatch, addr, value);
 }
 
 uint8_t petio_8c00_read(uint16_t addr)
 {
     DBGRW(("IO: io-8c00 r %04x\n", addr));
-    return io_read(&petio_8c00_head, addr);
+    return io_read(&petio_8c00_head, petio_8c00_dispatch, addr);
 }
 
 uint8_t petio_8c00_peek(uint16_t addr)
@@ -696,13 +787,13 @@ uint8_t petio_8c00_peek(uint16_t addr)
 void petio_8c00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-8c00 w %04x %02x\n", addr, value));
-    io_store(&petio_8c00_head, addr, value);
+    io_store(&petio_8c00_head, petio_8c00_dispatch, addr, value);
 }
 
 uint8_t petio_8d00_read(uint16_t addr)
 {
     DBGRW(("IO: io-8d00 r %04x\n", addr));
-    return io_read(&petio_8d00_head, addr);
+    return io_read(&petio_8d00_head, petio_8d00_dispatch, addr);
 }
 
 uint8_t petio_8d00_peek(uint16_t addr)
@@ -714,13 +805,13 @@ uint8_t petio_8d00_peek(uint16_t addr)
 void petio_8d00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-8d00 w %04x %02x\n", addr, value));
-    io_store(&petio_8d00_head, addr, value);
+    io_store(&petio_8d00_head, petio_8d00_dispatch, addr, value);
 }
 
 uint8_t petio_8e00_read(uint16_t addr)
 {
     DBGRW(("IO: io-8e00 r %04x\n", addr));
-    return io_read(&petio_8e00_head, addr);
+    return io_read(&petio_8e00_head, petio_8e00_dispatch, addr);
 }
 
 uint8_t petio_8e00_peek(uint16_t addr)
@@ -732,13 +823,13 @@ uint8_t petio_8e00_peek(uint16_t addr)
 void petio_8e00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-8e00 w %04x %02x\n", addr, value));
-    io_store(&petio_8e00_head, addr, value);
+    io_store(&petio_8e00_head, petio_8e00_dispatch, addr, value);
 }
 
 uint8_t petio_8f00_read(uint16_t addr)
 {
     DBGRW(("IO: io-8f00 r %04x\n", addr));
-    return io_read(&petio_8f00_head, addr);
+    return io_read(&petio_8f00_head, petio_8f00_dispatch, addr);
 }
 
 uint8_t petio_8f00_peek(uint16_t addr)
@@ -750,13 +841,13 @@ uint8_t petio_8f00_peek(uint16_t addr)
 void petio_8f00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-8f00 w %04x %02x\n", addr, value));
-    io_store(&petio_8f00_head, addr, value);
+    io_store(&petio_8f00_head, petio_8f00_dispatch, addr, value);
 }
 
 uint8_t petio_e900_read(uint16_t addr)
 {
     DBGRW(("IO: io-e900 r %04x\n", addr));
-    return io_read(&petio_e900_head, addr);
+    return io_read(&petio_e900_head, petio_e900_dispatch, addr);
 }
 
 uint8_t petio_e900_peek(uint16_t addr)
@@ -768,13 +859,13 @@ uint8_t petio_e900_peek(uint16_t addr)
 void petio_e900_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-e900 w %04x %02x\n", addr, value));
-    io_store(&petio_e900_head, addr, value);
+    io_store(&petio_e900_head, petio_e900_dispatch, addr, value);
 }
 
 uint8_t petio_ea00_read(uint16_t addr)
 {
     DBGRW(("IO: io-ea00 r %04x\n", addr));
-    return io_read(&petio_ea00_head, addr);
+    return io_read(&petio_ea00_head, petio_ea00_dispatch, addr);
 }
 
 uint8_t petio_ea00_peek(uint16_t addr)
@@ -786,13 +877,13 @@ uint8_t petio_ea00_peek(uint16_t addr)
 void petio_ea00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-ea00 w %04x %02x\n", addr, value));
-    io_store(&petio_ea00_head, addr, value);
+    io_store(&petio_ea00_head, petio_ea00_dispatch, addr, value);
 }
 
 uint8_t petio_eb00_read(uint16_t addr)
 {
     DBGRW(("IO: io-eb00 r %04x\n", addr));
-    return io_read(&petio_eb00_head, addr);
+    return io_read(&petio_eb00_head, petio_eb00_dispatch, addr);
 }
 
 uint8_t petio_eb00_peek(uint16_t addr)
@@ -804,13 +895,13 @@ uint8_t petio_eb00_peek(uint16_t addr)
 void petio_eb00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-eb00 w %04x %02x\n", addr, value));
-    io_store(&petio_eb00_head, addr, value);
+    io_store(&petio_eb00_head, petio_eb00_dispatch, addr, value);
 }
 
 uint8_t petio_ec00_read(uint16_t addr)
 {
     DBGRW(("IO: io-ec00 r %04x\n", addr));
-    return io_read(&petio_ec00_head, addr);
+    return io_read(&petio_ec00_head, petio_ec00_dispatch, addr);
 }
 
 uint8_t petio_ec00_peek(uint16_t addr)
@@ -822,13 +913,13 @@ uint8_t petio_ec00_peek(uint16_t addr)
 void petio_ec00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-ec00 w %04x %02x\n", addr, value));
-    io_store(&petio_ec00_head, addr, value);
+    io_store(&petio_ec00_head, petio_ec00_dispatch, addr, value);
 }
 
 uint8_t petio_ed00_read(uint16_t addr)
 {
     DBGRW(("IO: io-ed00 r %04x\n", addr));
-    return io_read(&petio_ed00_head, addr);
+    return io_read(&petio_ed00_head, petio_ed00_dispatch, addr);
 }
 
 uint8_t petio_ed00_peek(uint16_t addr)
@@ -840,13 +931,13 @@ uint8_t petio_ed00_peek(uint16_t addr)
 void petio_ed00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-ed00 w %04x %02x\n", addr, value));
-    io_store(&petio_ed00_head, addr, value);
+    io_store(&petio_ed00_head, petio_ed00_dispatch, addr, value);
 }
 
 uint8_t petio_ee00_read(uint16_t addr)
 {
     DBGRW(("IO: io-ee00 r %04x\n", addr));
-    return io_read(&petio_ee00_head, addr);
+    return io_read(&petio_ee00_head, petio_ee00_dispatch, addr);
 }
 
 uint8_t petio_ee00_peek(uint16_t addr)
@@ -858,13 +949,13 @@ uint8_t petio_ee00_peek(uint16_t addr)
 void petio_ee00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-ee00 w %04x %02x\n", addr, value));
-    io_store(&petio_ee00_head, addr, value);
+    io_store(&petio_ee00_head, petio_ee00_dispatch, addr, value);
 }
 
 uint8_t petio_ef00_read(uint16_t addr)
 {
     DBGRW(("IO: io-ef00 r %04x\n", addr));
-    return io_read(&petio_ef00_head, addr);
+    return io_read(&petio_ef00_head, petio_ef00_dispatch, addr);
 }
 
 uint8_t petio_ef00_peek(uint16_t addr)
@@ -876,7 +967,7 @@ uint8_t petio_ef00_peek(uint16_t addr)
 void petio_ef00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-ef00 w %04x %02x\n", addr, value));
-    io_store(&petio_ef00_head, addr, value);
+    io_store(&petio_ef00_head, petio_ef00_dispatch, addr, value);
 }
 
 /* ---------------------------------------------------------------------------------------------------------- */
@@ -211,6 +211,15 @@ static const trap_t plus4_serial_traps[] = {
         plus4memrom_trap_read,
         plus4memrom_trap_store
     },
+    {
+        "SerialLoad",
+        0xF09F,
+        0xF0E0,
+        { 0xA9, 0xFD, 0x25 },
+        serial_trap_load,
+        plus4memrom_trap_read,
+        plus4memrom_trap_store
+    },
     {
         "SerialReady",
         0xE216,
@@ -808,7 +817,7 @@ int machine_specific_init(void)
         return -1;
     }
 
-    serial_trap_init(0xa8);
+    serial_trap_init(0xa8, 0x9d);
     serial_iec_bus_init();
 
     rs232drv_init();
@@ -70,6 +70,13 @@ static unsigned int order = 0;
 static io_source_list_t plus4io_fd00_head = { NULL, NULL, NULL };
 static io_source_list_t plus4io_fe00_head = { NULL, NULL, NULL };
 
+/* per-address dispatch tables, one for each I/O page, see cartio.h */
+static io_source_t io_source_shared;
+#define IO_SOURCE_SHARED (&io_source_shared)
+
+static io_source_t *plus4io_fd00_dispatch[0x100];
+static io_source_t *plus4io_fe00_dispatch[0x100];
+
 static void io_source_detach(io_source_detach_t *source)
 {
     switch (source->det_id) {
@@ -284,9 +291,10 @@ static void io_source_log_collisions(uint16_t addr, int amount, io_source_list_t
     }
 }
 
-static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
+static inline uint8_t io_read(io_source_list_t *list, io_source_t **dispatch, uint16_t addr)
 {
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0xff];
     int io_source_counter = 0;
     int io_source_valid = 0;
     uint8_t realval = 0;
@@ -294,6 +302,18 @@ static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
     uint8_t firstval = 0;
     unsigned int lowest_order = 0xffffffff;
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->read != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            retval = device->read((uint16_t)(addr & device->address_mask));
+            if (device->io_source_valid) {
+                return retval;
+            }
+        }
+        return mem_read_open_space(addr);
+    }
+
     while (current) {
         if (current->device->read != NULL) {
             if ((addr >= current->device->start_address) && (addr <= current->device->end_address)) {
@@ -381,13 +401,23 @@ static inline uint8_t io_peek(io_source_list_t *list, uint16_t addr)
     return mem_read_open_space(addr);
 }
 
-static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value)
+static inline void io_store(io_source_list_t *list, io_source_t **dispatch, uint16_t addr, uint8_t value)
 {
     int writes = 0;
     uint16_t addy = 0xffff;
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0xff];
     void (*store)(uint16_t address, uint8_t data) = NULL;
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->store != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            device->store((uint16_t)(addr & device->address_mask), value);
+        }
+        return;
+    }
+
     while (current) {
         if (current->device->store != NULL) {
             if (addr >= current->device->start_address && addr <= current->device->end_address) {
@@ -411,6 +441,37 @@ static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value
 
 /* ---------------------------------------------------------------------------------------------------------- */
 
+static void io_source_dispatch_build(io_source_list_t *list, io_source_t **dispatch, unsigned int base)
+{
+    io_source_list_t *current = list->next;
+    unsigned int start;
+    unsigned int end;
+    unsigned int i;
+
+    memset(dispatch, 0, sizeof(io_source_t *) * 0x100);
+
+    while (current) {
+        start = current->device->start_address;
+        end = current->device->end_address;
+        if (start < base) {
+            start = base;
+        }
+        if (end > base + 0xff) {
+            end = base + 0xff;
+        }
+        for (i = start; i <= end; i++) {
+            dispatch[i - base] = dispatch[i - base] ? IO_SOURCE_SHARED : current->device;
+        }
+        current = current->next;
+    }
+}
+
+void io_source_dispatch_update(void)
+{
+    io_source_dispatch_build(&plus4io_fd00_head, plus4io_fd00_dispatch, 0xfd00);
+    io_source_dispatch_build(&plus4io_fe00_head, plus4io_fe00_dispatch, 0xfe00);
+}
+
 io_source_list_t *io_source_register(io_source_t *device)
 {
     io_source_list_t *current = NULL;
@@ -444,6 +505,8 @@ io_source_list_t *io_source_register(io_source_t *device)
     retval->next = NULL;
     retval->device->order = order++;
 
+    io_source_dispatch_update();
+
     return retval;
 }
 
@@ -468,6 +531,8 @@ void io_source_unregister(io_source_list_t *device)
     }
 
     lib_free(device);
+
+    io_source_dispatch_update();
 }
 
 void cartio_shutdown(void)
@@ -504,7 +569,7 @@ uint8_t plus4io_fd00_read(uint16_t addr)
     if (plus4cart_fd00_read(addr, &value) == CART_READ_VALID) {
         ted.last_cpu_val = value;
     } else {
-        ted.last_cpu_val = io_read(&plus4io_fd00_head, addr);
+        ted.last_cpu_val = io_read(&plus4io_fd00_head, plus4io_fd00_dispatch, addr);
     }
     /*DBG(("IO read: io-fd00 r %04x val %02x", addr, ted.last_cpu_val));*/
     return ted.last_cpu_val;
@@ -527,7 +592,7 @@ void plus4io_fd00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-fd00 w %04x %02x", addr, value));
     ted.last_cpu_val = value;
-    io_store(&plus4io_fd00_head, addr, value);
+    io_store(&plus4io_fd00_head, plus4io_fd00_dispatch, addr, value);
 }
 
 uint8_t plus4io_fe00_read(uint16_t addr)
@@ -539,7 +604,7 @@ uint8_t plus4io_fe00_read(uint16_t addr)
     if (plus4cart_fe00_read(addr, &value) == CART_READ_VALID) {
         ted.last_cpu_val = value;
     } else {
-        ted.last_cpu_val = io_read(&plus4io_fe00_head, addr);
+        ted.last_cpu_val = io_read(&plus4io_fe00_head, plus4io_fe00_dispatch, addr);
     }
     return ted.last_cpu_val;
 }
@@ -559,7 +624,7 @@ void plus4io_fe00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-fe00 w %04x %02x", addr, value));
     ted.last_cpu_val = value;
-    io_store(&plus4io_fe00_head, addr, value);
+    io_store(&plus4io_fe00_head, plus4io_fe00_dispatch, addr, value);
 }
 
 /* ---------------------------------------------------------------------------------------------------------- */
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "archdep.h"
 #include "lib.h"
 #include "log.h"
 #include "cmdline.h"
@@ -56,6 +57,8 @@ struct output_gfx_s {
     screenshot_t screenshot;
     uint8_t *line;
     char *filename;
+    FILE *pbm_fd;       /* current page when writing PBM */
+    uint8_t *pbm_line;  /* packed line when writing PBM */
     unsigned int isopen;
     unsigned int line_pos;
     unsigned int line_no;
@@ -66,6 +69,31 @@ static output_gfx_t output_gfx[NUM_OUTPUT_SELECT];
 
 static unsigned int current_prnr;
 
+/* Name of the gfxoutput driver used for the pages, or "PBM". */
+static char *printer_gfx_format = NULL;
+
+/* ------------------------------------------------------------------------- */
+
+static int set_printer_gfx_format(const char *val, void *param)
+{
+    util_string_set(&printer_gfx_format, val);
+    return 0;
+}
+
+static const resource_string_t resources_string[] = {
+    { "PrinterGraphicsFormat", "BMP", RES_EVENT_NO, NULL,
+      &printer_gfx_format, set_printer_gfx_format, NULL },
+    RESOURCE_STRING_LIST_END
+};
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-prgfxformat", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "PrinterGraphicsFormat", NULL,
+      "<Name>", "Specify file format of graphics printer output (BMP, PNG, PPM, PBM, ...)" },
+    CMDLINE_LIST_END
+};
+
 /* ------------------------------------------------------------------------- */
 
 /*
@@ -128,13 +156,80 @@ static void output_graphics_line_data(screenshot_t *screenshot, uint8_t *data,
 
 /* ------------------------------------------------------------------------- */
 
+/*
+ * PBM pages are written directly instead of going through gfxoutput. Every
+ * line is packed to one bit per pixel (any ink is black) and written out
+ * right away, so a page never has to be kept in memory.
+ */
+static const char *output_graphics_extension(output_gfx_t *o)
+{
+    return (o->gfxoutputdrv != NULL) ? o->gfxoutputdrv->default_extension : "pbm";
+}
+
+static int output_graphics_page_open(output_gfx_t *o)
+{
+    char *name;
+
+    if (o->gfxoutputdrv != NULL) {
+        return o->gfxoutputdrv->open(&o->screenshot, o->filename);
+    }
+
+    name = util_concat(o->filename, ".pbm", NULL);
+    o->pbm_fd = fopen(name, MODE_WRITE);
+    lib_free(name);
+    if (o->pbm_fd == NULL) {
+        return -1;
+    }
+    fprintf(o->pbm_fd, "P4\012# VICE generated printer output\012%u %u\012",
+            o->screenshot.width, o->screenshot.height);
+    return 0;
+}
+
+static void output_graphics_page_write_line(output_gfx_t *o)
+{
+    unsigned int i;
+    unsigned int bytes;
+
+    if (o->gfxoutputdrv != NULL) {
+        (o->gfxoutputdrv->write)(&o->screenshot);
+        return;
+    }
+
+    if (o->pbm_fd == NULL) {
+        return;
+    }
+    bytes = (o->screenshot.width + 7) / 8;
+    memset(o->pbm_line, 0, bytes);
+    for (i = 0; i < o->screenshot.width; i++) {
+        if (o->line[i] != OUTPUT_PIXEL_WHITE) {
+            o->pbm_line[i >> 3] |= (uint8_t)(0x80 >> (i & 7));
+        }
+    }
+    fwrite(o->pbm_line, 1, bytes, o->pbm_fd);
+}
+
+static void output_graphics_page_close(output_gfx_t *o)
+{
+    if (o->gfxoutputdrv != NULL) {
+        o->gfxoutputdrv->close(&o->screenshot);
+        return;
+    }
+
+    if (o->pbm_fd != NULL) {
+        fclose(o->pbm_fd);
+        o->pbm_fd = NULL;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
 /* when creating a filename for a new file, check if that file already exists,
    and if yes, skip that file and try the next one */
 static int advance_outfile_name(unsigned int prnr)
 {
     output_gfx_t *o = &(output_gfx[prnr]);
     int i;
-    char *testname = util_concat(o->filename, ".", o->gfxoutputdrv->default_extension, NULL);
+    char *testname = util_concat(o->filename, ".", output_graphics_extension(o), NULL);
 
     while (util_file_exists(testname)) {
         /* increase page count in filename */
@@ -153,7 +248,7 @@ static int advance_outfile_name(unsigned int prnr)
             }
         }
         lib_free(testname);
-        testname = util_concat(o->filename, ".", o->gfxoutputdrv->default_extension, NULL);
+        testname = util_concat(o->filename, ".", output_graphics_extension(o), NULL);
     }
     lib_free(testname);
     return 0;
@@ -164,16 +259,24 @@ static int output_graphics_open(unsigned int prnr,
 {
     const char *filename;
     int device = 0;
-    output_gfx[prnr].gfxoutputdrv = gfxoutput_get_driver("BMP");
-
-    if (output_gfx[prnr].gfxoutputdrv == NULL) {
-        return -1;
-    }
 
     if (output_gfx[prnr].isopen) {
         return 0;
     }
 
+    if (printer_gfx_format != NULL && util_strcasecmp(printer_gfx_format, "PBM") == 0) {
+        output_gfx[prnr].gfxoutputdrv = NULL;
+    } else {
+        output_gfx[prnr].gfxoutputdrv = gfxoutput_get_driver(printer_gfx_format);
+        if (output_gfx[prnr].gfxoutputdrv == NULL) {
+            log_warning(LOG_DEFAULT, "Printer: unknown graphics format `%s', using BMP.", printer_gfx_format);
+            output_gfx[prnr].gfxoutputdrv = gfxoutput_get_driver("BMP");
+            if (output_gfx[prnr].gfxoutputdrv == NULL) {
+                return -1;
+            }
+        }
+    }
+
     switch (prnr) {
         case 0:
             resources_get_int("Printer4TextDevice", &device);
@@ -215,6 +318,11 @@ static int output_graphics_open(unsigned int prnr,
     output_gfx[prnr].line = lib_malloc(output_parameter->maxcol);
     memset(output_gfx[prnr].line, OUTPUT_PIXEL_WHITE, output_parameter->maxcol);
 
+    if (output_gfx[prnr].pbm_line != NULL) {
+        lib_free(output_gfx[prnr].pbm_line);
+    }
+    output_gfx[prnr].pbm_line = lib_malloc((output_parameter->maxcol + 7) / 8);
+
     output_gfx[prnr].line_pos = 0;
     output_gfx[prnr].line_no = 0;
 
@@ -238,17 +346,17 @@ static void output_graphics_close(unsigned int prnr)
 
         /* output current line */
         current_prnr = prnr;
-        (o->gfxoutputdrv->write)(&o->screenshot);
+        output_graphics_page_write_line(o);
         o->line_no++;
 
         /* fill rest of page with blank lines */
         memset(o->line, OUTPUT_PIXEL_WHITE, o->screenshot.width);
         for (i = o->line_no; i < o->screenshot.height; i++) {
-            (o->gfxoutputdrv->write)(&o->screenshot);
+            output_graphics_page_write_line(o);
         }
 
         /* close output */
-        o->gfxoutputdrv->close(&o->screenshot);
+        output_graphics_page_close(o);
         o->isopen = 0;
     }
 #endif
@@ -265,7 +373,7 @@ static int output_graphics_putc(unsigned int prnr, uint8_t b)
                 return -1;
             }
             /* open output file */
-            o->gfxoutputdrv->open(&o->screenshot, o->filename);
+            output_graphics_page_open(o);
             o->isopen = 1;
             o->line_pos = 0;
             o->line_no = 0;
@@ -273,14 +381,14 @@ static int output_graphics_putc(unsigned int prnr, uint8_t b)
 
         /* write buffered line to output and clear buffer */
         current_prnr = prnr;
-        (o->gfxoutputdrv->write)(&o->screenshot);
+        output_graphics_page_write_line(o);
         memset(o->line, OUTPUT_PIXEL_WHITE, o->screenshot.width);
         o->line_pos = 0;
 
         /* check for bottom of page.  If so, close output file */
         o->line_no++;
         if (o->line_no == o->screenshot.height) {
-            o->gfxoutputdrv->close(&o->screenshot);
+            output_graphics_page_close(o);
             o->isopen = 0;
         }
     } else {
@@ -326,17 +434,17 @@ static int output_graphics_formfeed(unsigned int prnr)
 
         /* output current line */
         current_prnr = prnr;
-        (o->gfxoutputdrv->write)(&o->screenshot);
+        output_graphics_page_write_line(o);
         o->line_no++;
 
         /* fill rest of page with blank lines */
         memset(o->line, OUTPUT_PIXEL_WHITE, o->screenshot.width);
         for (i = o->line_no; i < o->screenshot.height; i++) {
-            (o->gfxoutputdrv->write)(&o->screenshot);
+            output_graphics_page_write_line(o);
         }
 
         /* close output */
-        o->gfxoutputdrv->close(&o->screenshot);
+        output_graphics_page_close(o);
         o->isopen = 0;
     }
 #endif
@@ -356,8 +464,13 @@ void output_graphics_init(void)
         if (output_gfx[i].line) {
             lib_free(output_gfx[i].line);
         }
+        if (output_gfx[i].pbm_line) {
+            lib_free(output_gfx[i].pbm_line);
+        }
         output_gfx[i].filename = NULL;
         output_gfx[i].line = NULL;
+        output_gfx[i].pbm_line = NULL;
+        output_gfx[i].pbm_fd = NULL;
 
         output_gfx[i].line_pos = 0;
     }
@@ -374,8 +487,16 @@ void output_graphics_shutdown(void)
         if (output_gfx[i].line) {
             lib_free(output_gfx[i].line);
         }
+        if (output_gfx[i].pbm_line) {
+            lib_free(output_gfx[i].pbm_line);
+        }
+        if (output_gfx[i].pbm_fd) {
+            fclose(output_gfx[i].pbm_fd);
+        }
         output_gfx[i].filename = NULL;
         output_gfx[i].line = NULL;
+        output_gfx[i].pbm_line = NULL;
+        output_gfx[i].pbm_fd = NULL;
     }
 }
 
@@ -393,5 +514,20 @@ int output_graphics_init_resources(void)
 
     output_select_register(&output_select);
 
+    if (resources_register_string(resources_string) < 0) {
+        return -1;
+    }
+
     return 1;
 }
+
+void output_graphics_shutdown_resources(void)
+{
+    lib_free(printer_gfx_format);
+    printer_gfx_format = NULL;
+}
+
+int output_graphics_init_cmdline_options(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
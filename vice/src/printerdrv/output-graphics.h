@@ -28,6 +28,8 @@
 #define VICE_OUTPUT_GRAPHICS_H
 
 int output_graphics_init_resources(void);
+void output_graphics_shutdown_resources(void);
+int output_graphics_init_cmdline_options(void);
 void output_graphics_init(void);
 void output_graphics_shutdown(void);
 
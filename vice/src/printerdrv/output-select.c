@@ -57,6 +57,9 @@ static output_select_t output_select[NUM_OUTPUT_SELECT];
 /* Pointer to registered printer driver.  */
 static output_select_list_t *output_select_list = NULL;
 
+/* Output device opened by a printer driver and not closed again.  */
+static int output_select_opened[NUM_OUTPUT_SELECT];
+
 
 static int set_output_device(const char *name, void *param)
 {
@@ -243,14 +246,34 @@ void output_select_register(output_select_t *outp_select)
 int output_select_open(unsigned int prnr,
                        struct output_parameter_s *output_parameter)
 {
+    int rc;
+
     DBG(("output_select_open(prnr:%u) device:%u", prnr, prnr + 4));
-    return output_select[prnr].output_open(prnr, output_parameter);
+    rc = output_select[prnr].output_open(prnr, output_parameter);
+    if (rc >= 0) {
+        output_select_opened[prnr] = 1;
+    }
+    return rc;
 }
 
 void output_select_close(unsigned int prnr)
 {
     DBG(("output_select_close(prnr:%u) device:%u", prnr, prnr + 4));
     output_select[prnr].output_close(prnr);
+    output_select_opened[prnr] = 0;
+}
+
+/* Check if any printer has its output device open.  */
+int output_select_is_open(void)
+{
+    unsigned int prnr;
+
+    for (prnr = 0; prnr < NUM_OUTPUT_SELECT; prnr++) {
+        if (output_select_opened[prnr]) {
+            return 1;
+        }
+    }
+    return 0;
 }
 
 int output_select_putc(unsigned int prnr, uint8_t b)
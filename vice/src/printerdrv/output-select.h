@@ -59,5 +59,6 @@ int output_select_getc(unsigned int prnr, uint8_t *b);
 int output_select_flush(unsigned int prnr);
 int output_select_formfeed(unsigned int prnr);
 void output_select_writeline(unsigned int prnr);
+int output_select_is_open(void);
 
 #endif
@@ -81,13 +81,15 @@ int printer_userport_resources_init(void)
 
 void printer_resources_shutdown(void)
 {
+    output_graphics_shutdown_resources();
     output_text_shutdown_resources();
 }
 
 int printer_cmdline_options_init(void)
 {
     DBG(("printer_cmdline_options_init"));
-    if (output_text_init_cmdline_options() < 0
+    if (output_graphics_init_cmdline_options() < 0
+        || output_text_init_cmdline_options() < 0
         || output_select_init_cmdline_options() < 0
         || driver_select_init_cmdline_options() < 0
         || machine_printer_cmdline_options_init() < 0) {
@@ -156,3 +158,12 @@ void printer_formfeed(unsigned int prnr)
     DBG(("printer_formfeed:%u", prnr));
     driver_select_formfeed(prnr);
 }
+
+/** \brief  Check if any printer has its output open
+ *
+ * \return  1 if a printer is open, 0 otherwise
+ */
+int printer_is_open(void)
+{
+    return output_select_is_open();
+}
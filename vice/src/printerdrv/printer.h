@@ -38,6 +38,7 @@ int printer_userport_cmdline_options_init(void);
 void printer_init(void);
 void printer_reset(void);
 void printer_formfeed(unsigned int unit);
+int printer_is_open(void);
 void printer_shutdown(void);
 
 /* Serial interface.  */
@@ -35,6 +35,7 @@
 #include "machine.h"
 #include "raster-canvas.h"
 #include "raster.h"
+#include "runahead.h"
 #include "video.h"
 #include "viewport.h"
 #include "vsync.h"
@@ -107,11 +108,33 @@ inline static void refresh_canvas(raster_t *raster)
 
 void raster_canvas_handle_end_of_frame(raster_t *raster)
 {
-    if (video_disabled_mode) {
+    int drawn = !raster->skip_drawing;
+
+    raster->skip_drawing = 0;
+
+    if (!drawn) {
+        /* none of the lines of this frame were drawn */
+        raster->dont_cache = 1;
+    }
+
+    /* the draw buffer is still complete for screenshots and recording */
+    if (video_disabled_mode || max_throughput_mode) {
+        return;
+    }
+
+    if (raster->can_skip_drawing && vsync_get_skip_frame_drawing()) {
+        /* decide now if the next frame needs to be drawn at all */
+        raster->skip_drawing = vsync_should_skip_frame(raster->canvas)
+                               || runahead_next_frame_hidden();
+        if (!drawn) {
+            return;
+        }
+    } else if (!drawn || vsync_should_skip_frame(raster->canvas)) {
         return;
     }
 
-    if (vsync_should_skip_frame(raster->canvas)) {
+    /* run-ahead only shows the last frame run ahead */
+    if (runahead_frame_hidden) {
         return;
     }
 
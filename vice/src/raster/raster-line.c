@@ -660,11 +660,13 @@ void raster_line_emulate(raster_t *raster)
         raster->blank_enabled = 1;
     }
 
-    if ((raster->current_line >= raster->geometry->first_displayed_line
-         && raster->current_line <= raster->geometry->last_displayed_line)
-        /* handle the case when lines 0+ are displayed in the lower border */
-        || (raster->current_line <= raster->geometry->last_displayed_line - raster->geometry->screen_size.height
-            && raster->geometry->screen_size.height <= raster->geometry->last_displayed_line)
+    /* lines of a frame that will not be shown are treated as invisible */
+    if (!raster->skip_drawing
+        && ((raster->current_line >= raster->geometry->first_displayed_line
+             && raster->current_line <= raster->geometry->last_displayed_line)
+            /* handle the case when lines 0+ are displayed in the lower border */
+            || (raster->current_line <= raster->geometry->last_displayed_line - raster->geometry->screen_size.height
+                && raster->geometry->screen_size.height <= raster->geometry->last_displayed_line))
         ) {
         /* handle lines with no border or with changes that may affect
            the border as visible lines */
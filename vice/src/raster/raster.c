@@ -276,6 +276,8 @@ int raster_init(raster_t *raster,
     raster->dont_cache_all = 1;
     raster->num_cached_lines = 0;
 
+    raster->can_skip_drawing = 0;
+
     raster->fake_draw_buffer_line = NULL;
 
     raster->can_disable_border = 0;
@@ -308,6 +310,7 @@ void raster_reset(raster_t *raster)
     raster->changes->have_on_this_line = 0;
 
     raster->current_line = 0;
+    raster->skip_drawing = 0;
 
     raster->xsmooth = raster->ysmooth = 0;
     raster->sprite_xsmooth = 0;
@@ -153,6 +153,14 @@ struct raster_s {
     /* Don't cache anything, for cycle based emulation */
     int dont_cache_all;
 
+    /* This is != 0 if the video chip keeps all emulation state (like sprite
+       collisions) without the lines being drawn.  */
+    int can_skip_drawing;
+
+    /* If this is != 0, the lines of the current frame are not drawn because
+       the frame will not be shown.  */
+    int skip_drawing;
+
     /* Number of lines that have been recalculated.  When this value reaches
        the number of lines that are displayed in the output, then the cache
        is valid again.  */
@@ -32,9 +32,20 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+
+#include "archdep.h"
+#include "lib.h"
+#include "log.h"
 #include "rawnet.h"
 #include "rawnetarch.h"
+#include "types.h"
 
 int rawnet_resources_init(void)
 {
@@ -63,6 +74,535 @@ void rawnet_set_should_accept_func(int (*func)(unsigned char *, int, int *, int
     should_accept = func;
 }
 
+/* ------------------------------------------------------------------------- */
+/*    frame I/O                                                              */
+
+/*
+ * With threads, a background thread does all the talking to the driver: it
+ * sends the frames the emulated chip queued in tx_ring, and receives frames,
+ * runs them through the chip's address filter and queues the accepted ones
+ * in rx_ring. Both rings have a single producer and a single consumer and
+ * need no lock. rawnet_mutex keeps the emulation from changing the driver
+ * or filter settings while the thread is using them.
+ *
+ * Without threads (or if the thread cannot be started) the same work is
+ * done synchronously when the emulated chip asks for a frame.
+ */
+
+#define RAWNET_FRAME_MAX    1518
+
+#define RAWNET_RX_SLOTS     256     /* must be a power of two, about as deep as a kernel tap queue */
+#define RAWNET_TX_SLOTS     16      /* must be a power of two */
+
+/* frames received per turn, the filter settings are locked meanwhile */
+#define RAWNET_RX_BATCH     32
+
+/* the most frames taken from the driver when dropping the received ones, more
+   than a kernel tap queue holds, so a flooded link cannot stall the emulation */
+#define RAWNET_FLUSH_MAX    4096
+
+/* how long the thread sleeps when there is nothing to do */
+#define RAWNET_IDLE_WAIT_US 1000
+
+typedef struct rawnet_rx_frame_s {
+    int len;
+    int hashed;
+    int hash_index;
+    int rx_ok;
+    int correct_mac;
+    int broadcast;
+    int multicast;
+    int crc_error;
+    uint8_t data[RAWNET_FRAME_MAX];
+} rawnet_rx_frame_t;
+
+typedef struct rawnet_tx_frame_s {
+    int len;
+    int force;
+    int onecoll;
+    int inhibit_crc;
+    int tx_pad_dis;
+    uint8_t data[RAWNET_FRAME_MAX];
+} rawnet_tx_frame_t;
+
+static log_t rawnet_log = LOG_DEFAULT;
+
+static rawnet_rx_frame_t *rx_ring = NULL;
+static rawnet_tx_frame_t *tx_ring = NULL;
+
+/* the driver wants to be called from the emulation only */
+static int synchronous_io = 0;
+
+#ifdef USE_VICE_THREAD
+
+typedef atomic_ulong rawnet_counter_t;
+#define COUNTER_ADD(c, n)   atomic_fetch_add_explicit(&(c), (n), memory_order_relaxed)
+#define COUNTER_GET(c)      atomic_load_explicit(&(c), memory_order_relaxed)
+
+static atomic_uint rx_read;
+static atomic_uint rx_write;
+static atomic_uint tx_read;
+static atomic_uint tx_write;
+
+static pthread_t io_thread;
+static int io_thread_running = 0;
+static atomic_int io_thread_stop;
+
+static pthread_mutex_t rawnet_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* wakes the thread up when a frame is queued for sending */
+static pthread_mutex_t wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+static int wake_pending = 0;
+
+#define RING_LOAD(i)        atomic_load_explicit(&(i), memory_order_acquire)
+#define RING_STORE(i, v)    atomic_store_explicit(&(i), (v), memory_order_release)
+
+#else
+
+typedef unsigned long rawnet_counter_t;
+#define COUNTER_ADD(c, n)   ((c) += (n))
+#define COUNTER_GET(c)      (c)
+
+static unsigned int rx_read;
+static unsigned int rx_write;
+static unsigned int tx_read;
+static unsigned int tx_write;
+
+#define RING_LOAD(i)        (i)
+#define RING_STORE(i, v)    ((i) = (v))
+
+#endif
+
+static rawnet_counter_t stats_rx_frames;
+static rawnet_counter_t stats_rx_bytes;
+static rawnet_counter_t stats_rx_filtered;
+static rawnet_counter_t stats_rx_dropped;
+static rawnet_counter_t stats_tx_frames;
+static rawnet_counter_t stats_tx_bytes;
+static rawnet_counter_t stats_tx_stalls;
+static tick_t stats_start;
+
+/* scratch buffer for frames that do not fit into rx_ring any more */
+static uint8_t rx_discard[RAWNET_FRAME_MAX];
+
+/* Fetch one frame from the driver into the next free slot of rx_ring and
+   filter it. Returns 0 if the driver had no frame. */
+static int io_receive_one(void)
+{
+    unsigned int write = RING_LOAD(rx_write);
+    rawnet_rx_frame_t *frame = &rx_ring[write];
+    int full = ((write + 1) & (RAWNET_RX_SLOTS - 1)) == RING_LOAD(rx_read);
+    uint8_t *buffer = full ? rx_discard : frame->data;
+    int len = RAWNET_FRAME_MAX;
+
+    frame->multicast = 0;
+    if (!rawnet_arch_receive(buffer, &len, &frame->hashed, &frame->hash_index, &frame->rx_ok,
+                             &frame->correct_mac, &frame->broadcast, &frame->crc_error)) {
+        return 0;
+    }
+
+    if (full) {
+        /* like the real chip, frames that arrive while all buffers are in
+           use are missed */
+        COUNTER_ADD(stats_rx_dropped, 1);
+        return 1;
+    }
+
+    /* a driver that has not classified the frame leaves the flags clear */
+    if (!frame->hashed && !frame->correct_mac && !frame->broadcast) {
+        if (!rawnet_should_accept(frame->data, len, &frame->hashed, &frame->hash_index,
+                                  &frame->correct_mac, &frame->broadcast, &frame->multicast)) {
+            COUNTER_ADD(stats_rx_filtered, 1);
+            return 1;
+        }
+    }
+
+    frame->len = len;
+    COUNTER_ADD(stats_rx_frames, 1);
+    COUNTER_ADD(stats_rx_bytes, (unsigned long)len);
+
+    RING_STORE(rx_write, (write + 1) & (RAWNET_RX_SLOTS - 1));
+    return 1;
+}
+
+/* Send all queued frames. Returns the number of frames sent. */
+static int io_transmit_all(void)
+{
+    unsigned int read = RING_LOAD(tx_read);
+    int count = 0;
+
+    while (read != RING_LOAD(tx_write)) {
+        rawnet_tx_frame_t *frame = &tx_ring[read];
+
+        rawnet_arch_transmit(frame->force, frame->onecoll, frame->inhibit_crc,
+                             frame->tx_pad_dis, frame->len, frame->data);
+        COUNTER_ADD(stats_tx_frames, 1);
+        COUNTER_ADD(stats_tx_bytes, (unsigned long)frame->len);
+
+        read = (read + 1) & (RAWNET_TX_SLOTS - 1);
+        RING_STORE(tx_read, read);
+        count++;
+    }
+    return count;
+}
+
+#ifdef USE_VICE_THREAD
+
+static void *rawnet_io_thread(void *unused)
+{
+    struct timespec deadline;
+    int busy;
+    int i;
+
+    while (!atomic_load(&io_thread_stop)) {
+        pthread_mutex_lock(&rawnet_mutex);
+        busy = io_transmit_all();
+        for (i = 0; i < RAWNET_RX_BATCH && io_receive_one(); i++) {
+            busy = 1;
+        }
+        pthread_mutex_unlock(&rawnet_mutex);
+
+        if (busy) {
+            continue;
+        }
+
+        /* the drivers cannot wait for frames, so look again shortly */
+        pthread_mutex_lock(&wake_mutex);
+        if (!wake_pending) {
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += RAWNET_IDLE_WAIT_US * 1000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&wake_cond, &wake_mutex, &deadline);
+        }
+        wake_pending = 0;
+        pthread_mutex_unlock(&wake_mutex);
+    }
+
+    return NULL;
+}
+
+static void io_thread_start(void)
+{
+    atomic_store(&io_thread_stop, 0);
+    if (pthread_create(&io_thread, NULL, rawnet_io_thread, NULL) == 0) {
+        io_thread_running = 1;
+    } else {
+        log_error(rawnet_log, "Cannot start the packet I/O thread, polling instead.");
+    }
+}
+
+static void io_thread_stop_and_join(void)
+{
+    if (io_thread_running) {
+        atomic_store(&io_thread_stop, 1);
+        pthread_mutex_lock(&wake_mutex);
+        wake_pending = 1;
+        pthread_cond_signal(&wake_cond);
+        pthread_mutex_unlock(&wake_mutex);
+        pthread_join(io_thread, NULL);
+        io_thread_running = 0;
+    }
+}
+
+static void io_thread_wake(void)
+{
+    pthread_mutex_lock(&wake_mutex);
+    wake_pending = 1;
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_mutex);
+}
+
+#else
+
+#define io_thread_running   0
+
+static void io_thread_start(void)
+{
+}
+
+static void io_thread_stop_and_join(void)
+{
+}
+
+static void io_thread_wake(void)
+{
+}
+
+#endif
+
+/** \brief  Keep the packet I/O thread away from the driver and the filter
+ *
+ * Must be held while the settings the registered should_accept function
+ * looks at are changed, and around driver calls other than the ones in this
+ * file.
+ */
+void rawnet_lock(void)
+{
+#ifdef USE_VICE_THREAD
+    pthread_mutex_lock(&rawnet_mutex);
+#endif
+}
+
+/** \brief  Release the lock taken by rawnet_lock()
+ */
+void rawnet_unlock(void)
+{
+#ifdef USE_VICE_THREAD
+    pthread_mutex_unlock(&rawnet_mutex);
+#endif
+}
+
+static void rawnet_log_stats(void)
+{
+    double seconds = (double)TICK_TO_MICRO(tick_now_delta(stats_start)) / 1000000.0;
+    unsigned long rx_frames = COUNTER_GET(stats_rx_frames);
+    unsigned long tx_frames = COUNTER_GET(stats_tx_frames);
+
+    if (rx_frames == 0 && tx_frames == 0) {
+        return;
+    }
+
+    log_message(rawnet_log,
+                "Received %lu frames (%lu bytes, %lu filtered out, %lu dropped), sent %lu frames (%lu bytes, %lu times sent directly) in %.1f s: %.0f frames/s.",
+                rx_frames, COUNTER_GET(stats_rx_bytes), COUNTER_GET(stats_rx_filtered),
+                COUNTER_GET(stats_rx_dropped), tx_frames, COUNTER_GET(stats_tx_bytes),
+                COUNTER_GET(stats_tx_stalls), seconds,
+                seconds > 0.0 ? (double)(rx_frames + tx_frames) / seconds : 0.0);
+}
+
+/** \brief  Activate the driver and start the packet I/O
+ *
+ * \param[in]   interface_name  interface to use
+ *
+ * \return  1 on success, 0 on failure (like rawnet_arch_activate())
+ */
+int rawnet_activate(const char *interface_name)
+{
+    if (rawnet_log == LOG_DEFAULT) {
+        rawnet_log = log_open("Rawnet");
+    }
+
+    synchronous_io = 0;
+    if (!rawnet_arch_activate(interface_name)) {
+        return 0;
+    }
+
+    rx_ring = lib_malloc(RAWNET_RX_SLOTS * sizeof(rawnet_rx_frame_t));
+    tx_ring = lib_malloc(RAWNET_TX_SLOTS * sizeof(rawnet_tx_frame_t));
+    RING_STORE(rx_read, 0);
+    RING_STORE(rx_write, 0);
+    RING_STORE(tx_read, 0);
+    RING_STORE(tx_write, 0);
+
+    stats_rx_frames = 0;
+    stats_rx_bytes = 0;
+    stats_rx_filtered = 0;
+    stats_rx_dropped = 0;
+    stats_tx_frames = 0;
+    stats_tx_bytes = 0;
+    stats_tx_stalls = 0;
+    stats_start = tick_now();
+
+    if (!synchronous_io) {
+        io_thread_start();
+    }
+    return 1;
+}
+
+/** \brief  Stop the packet I/O, send what is left and deactivate the driver
+ */
+void rawnet_deactivate(void)
+{
+    io_thread_stop_and_join();
+
+    if (tx_ring != NULL) {
+        io_transmit_all();
+    }
+    rawnet_log_stats();
+
+    rawnet_arch_deactivate();
+
+    lib_free(rx_ring);
+    rx_ring = NULL;
+    lib_free(tx_ring);
+    tx_ring = NULL;
+}
+
+/** \brief  Check if an emulated chip has the host interface open
+ *
+ * \return  1 while active, 0 otherwise
+ */
+int rawnet_is_active(void)
+{
+    return rx_ring != NULL;
+}
+
+/** \brief  Keep the packet I/O on the emulation thread
+ *
+ * For drivers that deliver frames at a given emulated time. Must be called
+ * from the activate function of the driver.
+ */
+void rawnet_request_synchronous_io(void)
+{
+    synchronous_io = 1;
+}
+
+/** \brief  Let the driver know that an emulated frame has ended
+ *
+ * Called by vsync_do_vsync().
+ */
+void rawnet_vsync(void)
+{
+    if (rx_ring == NULL) {
+        return;
+    }
+    rawnet_lock();
+    rawnet_arch_vsync();
+    rawnet_unlock();
+}
+
+/** \brief  Prepare a reset of the emulated chip, frames received so far are
+ *          discarded
+ */
+void rawnet_pre_reset(void)
+{
+    rawnet_lock();
+    rawnet_arch_pre_reset();
+    rawnet_flush_received();
+    rawnet_unlock();
+}
+
+/** \brief  Drop the received frames not yet taken by rawnet_receive()
+ *
+ * For when the emulated receiver is turned on, the queued frames arrived
+ * while it was off. This includes the frames still waiting in the driver,
+ * so it must be called with rawnet_lock() held.
+ */
+void rawnet_flush_received(void)
+{
+    int i;
+
+    if (rx_ring == NULL) {
+        return;
+    }
+
+    for (i = 0; i < RAWNET_FLUSH_MAX && io_receive_one(); i++) {
+        RING_STORE(rx_read, RING_LOAD(rx_write));
+    }
+    RING_STORE(rx_read, RING_LOAD(rx_write));
+}
+
+/** \brief  Drop the received frames already queued in the ring
+ *
+ * For when the filter of the emulated receiver changes: the frames in the
+ * ring went through the old filter. The frames still waiting in the driver
+ * are filtered when they are taken, so they are kept.
+ */
+void rawnet_drop_received(void)
+{
+    if (rx_ring == NULL) {
+        return;
+    }
+
+    RING_STORE(rx_read, RING_LOAD(rx_write));
+}
+
+/** \brief  Finish a reset of the emulated chip
+ */
+void rawnet_post_reset(void)
+{
+    rawnet_lock();
+    rawnet_arch_post_reset();
+    rawnet_unlock();
+}
+
+/** \brief  Queue a frame for sending
+ *
+ * Takes the same parameters as rawnet_arch_transmit(), the frame is copied.
+ */
+void rawnet_transmit(int force, int onecoll, int inhibit_crc, int tx_pad_dis, int txlength, uint8_t *txframe)
+{
+    unsigned int write;
+    rawnet_tx_frame_t *frame;
+
+    if (tx_ring == NULL) {
+        return;
+    }
+    if (txlength > RAWNET_FRAME_MAX) {
+        txlength = RAWNET_FRAME_MAX;
+    }
+
+    write = RING_LOAD(tx_write);
+    if (((write + 1) & (RAWNET_TX_SLOTS - 1)) == RING_LOAD(tx_read)) {
+        /* the thread lags behind; the emulated program already got its
+           frame accepted, so send the backlog right here instead of
+           losing the frame */
+        rawnet_lock();
+        io_transmit_all();
+        rawnet_unlock();
+        COUNTER_ADD(stats_tx_stalls, 1);
+    }
+
+    frame = &tx_ring[write];
+    frame->len = txlength;
+    frame->force = force;
+    frame->onecoll = onecoll;
+    frame->inhibit_crc = inhibit_crc;
+    frame->tx_pad_dis = tx_pad_dis;
+    memcpy(frame->data, txframe, (size_t)txlength);
+    RING_STORE(tx_write, (write + 1) & (RAWNET_TX_SLOTS - 1));
+
+    if (io_thread_running) {
+        io_thread_wake();
+    } else {
+        io_transmit_all();
+    }
+}
+
+/** \brief  Get the next received frame that passed the address filter
+ *
+ * Like rawnet_arch_receive(), but the frame has already been checked with
+ * the registered should_accept function, so *pmulticast is valid as well.
+ *
+ * \return  1 if there was a frame, 0 if not
+ */
+int rawnet_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_index, int *prx_ok, int *pcorrect_mac, int *pbroadcast, int *pmulticast, int *pcrc_error)
+{
+    unsigned int read = RING_LOAD(rx_read);
+    rawnet_rx_frame_t *frame;
+
+    if (rx_ring == NULL) {
+        return 0;
+    }
+    if (!io_thread_running && read == RING_LOAD(rx_write)) {
+        while (io_receive_one() && RING_LOAD(rx_write) == read) {
+            /* skip frames that did not pass the filter */
+        }
+    }
+
+    if (read == RING_LOAD(rx_write)) {
+        return 0;
+    }
+
+    frame = &rx_ring[read];
+    memcpy(pbuffer, frame->data, (size_t)(frame->len < *plen ? frame->len : *plen));
+    *plen = frame->len;
+    *phashed = frame->hashed;
+    *phash_index = frame->hash_index;
+    *prx_ok = frame->rx_ok;
+    *pcorrect_mac = frame->correct_mac;
+    *pbroadcast = frame->broadcast;
+    *pmulticast = frame->multicast;
+    *pcrc_error = frame->crc_error;
+
+    RING_STORE(rx_read, (read + 1) & (RAWNET_RX_SLOTS - 1));
+    return 1;
+}
+
 /* ------------------------------------------------------------------------- */
 /*    functions for selecting and querying available NICs                    */
 
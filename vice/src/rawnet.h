@@ -32,6 +32,8 @@
 #ifndef VICE_RAWNET_H
 #define VICE_RAWNET_H
 
+#include "types.h"
+
 int rawnet_resources_init(void);
 int rawnet_cmdline_options_init(void);
 void rawnet_resources_shutdown(void);
@@ -48,6 +50,33 @@ void rawnet_resources_shutdown(void);
 int rawnet_should_accept(unsigned char *buffer, int length, int *phashed, int *phash_index, int *pcorrect_mac, int *pbroadcast, int *pmulticast);
 void rawnet_set_should_accept_func(int (*func)(unsigned char *, int, int *, int *, int *, int *, int *));
 
+/*
+ Frame I/O for the emulated ethernet chip. These wrap the rawnet_arch_*()
+ functions of the same name; with threads, frames are sent and received by a
+ background thread so the emulation never waits for the driver.
+
+ rawnet_receive() only returns frames that passed the should_accept function,
+ so it has to be registered before rawnet_activate() is called. Changes to
+ the settings that function looks at, and calls to the other rawnet_arch_*()
+ functions while active, must be bracketed by rawnet_lock()/rawnet_unlock().
+*/
+
+int rawnet_activate(const char *interface_name);
+void rawnet_deactivate(void);
+int rawnet_is_active(void);
+void rawnet_pre_reset(void);
+void rawnet_post_reset(void);
+void rawnet_flush_received(void);
+void rawnet_drop_received(void);
+void rawnet_transmit(int force, int onecoll, int inhibit_crc, int tx_pad_dis, int txlength, uint8_t *txframe);
+int rawnet_receive(uint8_t *pbuffer, int *plen, int *phashed, int *phash_index, int *prx_ok, int *pcorrect_mac, int *pbroadcast, int *pmulticast, int *pcrc_error);
+void rawnet_lock(void);
+void rawnet_unlock(void);
+void rawnet_vsync(void);
+
+/* for drivers that must only be called from the emulation thread */
+void rawnet_request_synchronous_io(void);
+
 /*
 
  These functions let the UI enumerate the available interfaces.
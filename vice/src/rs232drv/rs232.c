@@ -264,4 +264,18 @@ void rs232_set_bps(int fd, unsigned int bps)
 #endif
     }
 }
+
+/* tell if received data is waiting, -1 if the driver cannot tell */
+int rs232_rx_pending(int fd)
+{
+    if (fd & RS232_IS_PHYSICAL_DEVICE) {
+        /* the serial port drivers have no way to look ahead */
+        return -1;
+    }
+#ifdef HAVE_RS232NET
+    return rs232net_rx_pending(fd);
+#else
+    return -1;
+#endif
+}
 #endif
@@ -70,6 +70,9 @@ enum rs232handshake_in rs232_get_status(int fd);
 /* set the bps rate of the physical device */
 void rs232_set_bps(int fd, unsigned int bps);
 
+/* Tells if received data is waiting, returns -1 if the driver cannot tell */
+int rs232_rx_pending(int fd);
+
 int rs232_resources_init(void);
 void rs232_resources_shutdown(void);
 int rs232_cmdline_options_init(void);
@@ -26,14 +26,18 @@
 
 #include "vice.h"
 
+#include <string.h>
+
 #include "archdep.h"
 #include "cmdline.h"
 #include "lib.h"
 #include "resources.h"
 #include "rs232.h"
 #include "rs232drv.h"
+#include "runahead.h"
 #include "types.h"
 #include "util.h"
+#include "vsync.h"
 
 #if defined(HAVE_RS232DEV) || defined(HAVE_RS232NET)
 
@@ -159,26 +163,157 @@ int rs232drv_cmdline_options_init(void)
     return rs232_cmdline_options_init();
 }
 
+/* ------------------------------------------------------------------------- */
+
+/* Connections whose user waits to be told about received data. Two entries
+   per device, as the physical and the network driver have their own fds. */
+#define RS232DRV_NOTIFY_MAX (RS232_NUM_DEVICES * 2)
+
+typedef struct rs232drv_notify_s {
+    int fd;
+    rs232drv_rx_notify_t notify;    /*!< NULL if the entry is free */
+    void *data;
+} rs232drv_notify_entry_t;
+
+static rs232drv_notify_entry_t rx_notify[RS232DRV_NOTIFY_MAX];
+
+/* the open connections as fd + 1, 0 for a free entry */
+static int open_fds[RS232DRV_NOTIFY_MAX];
+
+static void rs232drv_notify_drop(int fd)
+{
+    int i;
+
+    for (i = 0; i < RS232DRV_NOTIFY_MAX; i++) {
+        if (rx_notify[i].notify != NULL && rx_notify[i].fd == fd) {
+            rx_notify[i].notify = NULL;
+        }
+    }
+}
+
+/* called at every sync point by vsync */
+static void rs232drv_poll(void)
+{
+    rs232drv_rx_notify_t notify;
+    int i;
+
+    for (i = 0; i < RS232DRV_NOTIFY_MAX; i++) {
+        if (rx_notify[i].notify != NULL && rs232_rx_pending(rx_notify[i].fd) != 0) {
+            /* the callback may ask again right away */
+            notify = rx_notify[i].notify;
+            rx_notify[i].notify = NULL;
+            notify(rx_notify[i].data);
+        }
+    }
+}
+
+/*! \brief Ask to be called back once received data is waiting on fd
+
+ The emulated interfaces can use this to stop polling rs232drv_getc() while
+ the line is idle. The callback is made from the emulation, at one of the
+ sync points vsync makes every few milliseconds of host time. It is also
+ made for things rs232drv_getc() handles without returning a byte, like
+ IP232 line changes or a lost connection.
+
+ Asking again for the same fd replaces the previous request, closing fd
+ cancels it.
+
+ \param fd      the connection, as returned by rs232drv_open()
+ \param notify  the function to call
+ \param data    passed to notify
+
+ \return 1 if notify will be called, 0 if the driver cannot tell when data
+         arrives, so the caller has to keep polling
+*/
+int rs232drv_notify_rx(int fd, rs232drv_rx_notify_t notify, void *data)
+{
+    int i;
+
+    if (fd < 0 || rs232_rx_pending(fd) < 0) {
+        return 0;
+    }
+
+    rs232drv_notify_drop(fd);
+    for (i = 0; i < RS232DRV_NOTIFY_MAX; i++) {
+        if (rx_notify[i].notify == NULL) {
+            rx_notify[i].fd = fd;
+            rx_notify[i].notify = notify;
+            rx_notify[i].data = data;
+            return 1;
+        }
+    }
+    return 0;
+}
+
 void rs232drv_init(void)
 {
     rs232_init();
+    vsync_add_sync_hook(rs232drv_poll);
 }
 
 void rs232drv_reset(void)
 {
+    int i;
+
+    for (i = 0; i < RS232DRV_NOTIFY_MAX; i++) {
+        rx_notify[i].notify = NULL;
+    }
+    /* the drivers close all connections */
+    memset(open_fds, 0, sizeof(open_fds));
     rs232_reset();
 }
 
 int rs232drv_open(int device)
 {
-    return rs232_open(device);
+    int fd;
+    int i;
+
+    /* a frame run ahead is thrown away, it must not open the line */
+    if (runahead_frame_ahead) {
+        return -1;
+    }
+
+    fd = rs232_open(device);
+    if (fd >= 0) {
+        for (i = 0; i < RS232DRV_NOTIFY_MAX; i++) {
+            if (open_fds[i] == 0) {
+                open_fds[i] = fd + 1;
+                break;
+            }
+        }
+    }
+    return fd;
 }
 
 void rs232drv_close(int fd)
 {
+    int i;
+
+    for (i = 0; i < RS232DRV_NOTIFY_MAX; i++) {
+        if (open_fds[i] == fd + 1) {
+            open_fds[i] = 0;
+        }
+    }
+    rs232drv_notify_drop(fd);
     rs232_close(fd);
 }
 
+/*! \brief Check if any emulated interface has a connection open
+
+ \return 1 if a connection is open, 0 otherwise
+*/
+int rs232drv_is_open(void)
+{
+    int i;
+
+    for (i = 0; i < RS232DRV_NOTIFY_MAX; i++) {
+        if (open_fds[i] != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 int rs232drv_putc(int fd, uint8_t b)
 {
     return rs232_putc(fd, b);
@@ -223,6 +358,11 @@ void rs232drv_close(int fd)
 {
 }
 
+int rs232drv_is_open(void)
+{
+    return 0;
+}
+
 int rs232drv_putc(int fd, uint8_t b)
 {
     return -1;
@@ -247,6 +387,11 @@ void rs232drv_set_bps(int fd, unsigned int bps)
 {
 }
 
+int rs232drv_notify_rx(int fd, rs232drv_rx_notify_t notify, void *data)
+{
+    return 0;
+}
+
 int rs232drv_resources_init(void)
 {
     return 0;
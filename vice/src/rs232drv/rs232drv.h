@@ -37,6 +37,7 @@ void rs232drv_init(void);
 void rs232drv_reset(void);
 int rs232drv_open(int device);
 void rs232drv_close(int fd);
+int rs232drv_is_open(void);
 int rs232drv_putc(int fd, uint8_t b);
 int rs232drv_getc(int fd, uint8_t *b);
 
@@ -60,4 +61,10 @@ enum rs232handshake_in rs232drv_get_status(int fd);
 
 void rs232drv_set_bps(int fd, unsigned int bps);
 
+/* called once received data is waiting, see rs232drv_notify_rx() */
+typedef void (*rs232drv_rx_notify_t)(void *data);
+
+/* ask to be called back instead of polling rs232drv_getc() */
+int rs232drv_notify_rx(int fd, rs232drv_rx_notify_t notify, void *data);
+
 #endif
@@ -46,10 +46,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+
 #ifdef HAVE_IO_H
 #include <io.h>
 #endif
 
+#include "archdep.h"
 #include "lib.h"
 #include "log.h"
 #include "rs232.h"
@@ -87,6 +93,53 @@ int rs232net_cmdline_options_init(void)
 
 /* ------------------------------------------------------------------------- */
 
+/* Bytes are buffered in a ring per direction, so the socket is read in chunks
+   instead of polled for every byte, and written once per emulated frame
+   instead of once per byte. With the VICE thread, a single I/O thread serves
+   all connections; otherwise the rings are serviced from rs232net_getc() and
+   rs232net_rx_pending(), one of which is called every few milliseconds while
+   a port is open. */
+
+#define RS232NET_BUFFER_SIZE    4096    /* must be a power of two */
+#define RS232NET_BUFFER_MASK    (RS232NET_BUFFER_SIZE - 1)
+
+/* how long written bytes may be held back to be sent with the following
+   ones, one PAL frame */
+#define RS232NET_TX_DELAY_MS    20
+
+/* send right away once this much is waiting */
+#define RS232NET_TX_CHUNK       1024
+
+/* without the I/O thread, do not look at an idle socket more often */
+#define RS232NET_POLL_US        1000
+
+/* values of rs232net_t.failed */
+#define RS232NET_OK             0
+#define RS232NET_FAILED_ERROR   1
+#define RS232NET_FAILED_EOF     2
+
+#ifdef USE_VICE_THREAD
+
+typedef atomic_uint rs232net_shared_t;
+typedef atomic_ulong rs232net_counter_t;
+
+#define RING_LOAD(i)        atomic_load_explicit(&(i), memory_order_acquire)
+#define RING_STORE(i, v)    atomic_store_explicit(&(i), (v), memory_order_release)
+#define COUNTER_ADD(c, n)   atomic_fetch_add_explicit(&(c), (n), memory_order_relaxed)
+#define COUNTER_GET(c)      atomic_load_explicit(&(c), memory_order_relaxed)
+
+#else
+
+typedef unsigned int rs232net_shared_t;
+typedef unsigned long rs232net_counter_t;
+
+#define RING_LOAD(i)        (i)
+#define RING_STORE(i, v)    ((i) = (v))
+#define COUNTER_ADD(c, n)   ((c) += (n))
+#define COUNTER_GET(c)      (c)
+
+#endif
+
 typedef struct rs232net {
     int inuse; /*!< 0 if the connection has not been opened, 1 otherwise. */
     vice_network_socket_t * fd; /*!< the vice_network_socket_t for the connection.
@@ -98,6 +151,32 @@ typedef struct rs232net {
     int dcd_in;   /*!< ip232 status of DCD line */
     int ri_in;    /*!< ip232 status of RI line */
     int dtr_out;  /*!< ip232 status of DTR line */
+    unsigned int generation; /*!< counts the connections made in this slot */
+
+    /* received bytes, written by the I/O side, read by rs232net_getc() */
+    uint8_t rx_buffer[RS232NET_BUFFER_SIZE];
+    rs232net_shared_t rx_read;
+    rs232net_shared_t rx_write;
+
+    /* bytes to send, written by rs232net_putc(), read by the I/O side */
+    uint8_t tx_buffer[RS232NET_BUFFER_SIZE];
+    rs232net_shared_t tx_read;
+    rs232net_shared_t tx_write;
+
+    /* set by the I/O side when the connection broke, the socket itself is
+       only closed by the emulation after the bytes received so far */
+    rs232net_shared_t failed;
+    int error;
+
+    /* only used by the I/O side */
+    int tx_waiting;     /*!< tx_since is valid */
+    tick_t tx_since;    /*!< when the I/O side first saw the waiting bytes */
+    tick_t rx_polled;   /*!< last poll of the socket, without the thread */
+
+    rs232net_counter_t stats_rx_bytes;
+    rs232net_counter_t stats_rx_calls;
+    rs232net_counter_t stats_tx_bytes;
+    rs232net_counter_t stats_tx_calls;
 } rs232net_t;
 
 /* C99 standard guarantees all members of an object of static storage are
@@ -106,6 +185,235 @@ static rs232net_t fds[RS232_NUM_DEVICES];
 
 static log_t rs232net_log = LOG_DEFAULT;
 
+#ifdef USE_VICE_THREAD
+
+/* protects fds[].inuse and fds[].fd, and the sockets themselves, against the
+   I/O thread */
+static pthread_mutex_t rs232net_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t io_thread;
+static int io_thread_running = 0;
+static atomic_int io_thread_stop;
+
+#define RS232NET_LOCK()     pthread_mutex_lock(&rs232net_mutex)
+#define RS232NET_UNLOCK()   pthread_mutex_unlock(&rs232net_mutex)
+
+#else
+
+#define RS232NET_LOCK()
+#define RS232NET_UNLOCK()
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+/* Receive what fits into the rx ring with a single call. The socket is known
+   to have data. */
+static void io_receive(rs232net_t *conn)
+{
+    unsigned int write = RING_LOAD(conn->rx_write);
+    unsigned int space = RS232NET_BUFFER_SIZE - (write - RING_LOAD(conn->rx_read));
+    unsigned int offset = write & RS232NET_BUFFER_MASK;
+    ssize_t n;
+
+    if (space == 0) {
+        return;
+    }
+    if (space > RS232NET_BUFFER_SIZE - offset) {
+        space = RS232NET_BUFFER_SIZE - offset;
+    }
+
+    n = vice_network_receive(conn->fd, conn->rx_buffer + offset, space, 0);
+    COUNTER_ADD(conn->stats_rx_calls, 1);
+
+    if (n <= 0) {
+        conn->error = n < 0 ? vice_network_get_errorcode() : 0;
+        RING_STORE(conn->failed, n < 0 ? RS232NET_FAILED_ERROR : RS232NET_FAILED_EOF);
+        return;
+    }
+
+    COUNTER_ADD(conn->stats_rx_bytes, (unsigned long)n);
+    RING_STORE(conn->rx_write, write + (unsigned int)n);
+}
+
+/* Send everything in the tx ring */
+static void io_transmit(rs232net_t *conn)
+{
+    unsigned int read = RING_LOAD(conn->tx_read);
+    unsigned int write = RING_LOAD(conn->tx_write);
+    unsigned int offset;
+    unsigned int len;
+    ssize_t n;
+
+    while (read != write) {
+        offset = read & RS232NET_BUFFER_MASK;
+        len = write - read;
+        if (len > RS232NET_BUFFER_SIZE - offset) {
+            len = RS232NET_BUFFER_SIZE - offset;
+        }
+
+        n = vice_network_send(conn->fd, conn->tx_buffer + offset, len, 0);
+        COUNTER_ADD(conn->stats_tx_calls, 1);
+
+        if (n < 0) {
+            conn->error = vice_network_get_errorcode();
+            RING_STORE(conn->failed, RS232NET_FAILED_ERROR);
+            return;
+        }
+
+        COUNTER_ADD(conn->stats_tx_bytes, (unsigned long)n);
+        read += (unsigned int)n;
+        RING_STORE(conn->tx_read, read);
+    }
+}
+
+/* Send the waiting bytes if they are due, returns the milliseconds until
+   they will be */
+static unsigned int io_transmit_due(rs232net_t *conn)
+{
+    unsigned int pending = RING_LOAD(conn->tx_write) - RING_LOAD(conn->tx_read);
+    unsigned long waited;
+
+    if (pending == 0) {
+        conn->tx_waiting = 0;
+        return RS232NET_TX_DELAY_MS;
+    }
+
+    if (!conn->tx_waiting) {
+        conn->tx_waiting = 1;
+        conn->tx_since = tick_now();
+    }
+
+    waited = TICK_TO_MICRO(tick_now_delta(conn->tx_since)) / 1000;
+    if (pending < RS232NET_TX_CHUNK && waited < RS232NET_TX_DELAY_MS) {
+        return RS232NET_TX_DELAY_MS - (unsigned int)waited;
+    }
+
+    conn->tx_waiting = 0;
+    io_transmit(conn);
+    return RS232NET_TX_DELAY_MS;
+}
+
+/* the connection can be serviced by the I/O side */
+static int io_active(rs232net_t *conn)
+{
+    return conn->inuse && conn->fd && !RING_LOAD(conn->failed);
+}
+
+#ifdef USE_VICE_THREAD
+
+static void *rs232net_io_thread(void *unused)
+{
+    vice_network_socket_t *sockets[RS232_NUM_DEVICES];
+    int index[RS232_NUM_DEVICES];
+    unsigned int generation[RS232_NUM_DEVICES];
+    int ready[RS232_NUM_DEVICES];
+    unsigned int timeout;
+    unsigned int due;
+    int count;
+    int i;
+
+    while (!atomic_load(&io_thread_stop)) {
+        timeout = RS232NET_TX_DELAY_MS;
+        count = 0;
+
+        RS232NET_LOCK();
+        for (i = 0; i < RS232_NUM_DEVICES; i++) {
+            if (!io_active(&fds[i])) {
+                continue;
+            }
+            due = io_transmit_due(&fds[i]);
+            if (due < timeout) {
+                timeout = due;
+            }
+            /* leave the socket alone while the ring is full */
+            if (RING_LOAD(fds[i].rx_write) - RING_LOAD(fds[i].rx_read) < RS232NET_BUFFER_SIZE) {
+                sockets[count] = fds[i].fd;
+                index[count] = i;
+                generation[count] = fds[i].generation;
+                count++;
+            }
+        }
+        RS232NET_UNLOCK();
+
+        if (count == 0) {
+            tick_sleep(tick_per_second() / 1000 * timeout);
+            continue;
+        }
+
+        /* the sockets may be closed, or even replaced, while waiting, so check
+           again before touching them */
+        if (vice_network_select_wait_multiple(sockets, ready, count, timeout) > 0) {
+            RS232NET_LOCK();
+            for (i = 0; i < count; i++) {
+                if (ready[i]
+                    && fds[index[i]].generation == generation[i]
+                    && io_active(&fds[index[i]])) {
+                    io_receive(&fds[index[i]]);
+                }
+            }
+            RS232NET_UNLOCK();
+        }
+    }
+
+    return NULL;
+}
+
+static void io_thread_start(void)
+{
+    if (io_thread_running) {
+        return;
+    }
+    atomic_store(&io_thread_stop, 0);
+    if (pthread_create(&io_thread, NULL, rs232net_io_thread, NULL) == 0) {
+        io_thread_running = 1;
+    } else {
+        log_error(rs232net_log, "Cannot start the I/O thread, polling instead.");
+    }
+}
+
+static void io_thread_stop_and_join(void)
+{
+    int i;
+
+    for (i = 0; i < RS232_NUM_DEVICES; i++) {
+        if (fds[i].inuse) {
+            return;
+        }
+    }
+
+    if (io_thread_running) {
+        atomic_store(&io_thread_stop, 1);
+        pthread_join(io_thread, NULL);
+        io_thread_running = 0;
+    }
+}
+
+#endif
+
+/* Service the connection from the emulation when there is no I/O thread */
+static void io_poll(rs232net_t *conn)
+{
+#ifdef USE_VICE_THREAD
+    if (io_thread_running) {
+        return;
+    }
+#endif
+    if (!io_active(conn)) {
+        return;
+    }
+
+    io_transmit_due(conn);
+
+    if (RING_LOAD(conn->rx_read) == RING_LOAD(conn->rx_write)
+        && TICK_TO_MICRO(tick_now_delta(conn->rx_polled)) >= RS232NET_POLL_US) {
+        conn->rx_polled = tick_now();
+        if (vice_network_select_poll_one(conn->fd) > 0) {
+            io_receive(conn);
+        }
+    }
+}
+
 /* ------------------------------------------------------------------------- */
 
 void rs232net_close(int fd);
@@ -133,6 +441,7 @@ void rs232net_reset(void)
 int rs232net_open(int device)
 {
     vice_network_socket_address_t *ad = NULL;
+    vice_network_socket_t *connection;
     int index = -1;
 
     do {
@@ -159,14 +468,33 @@ int rs232net_open(int device)
         DEBUG_LOG_MESSAGE((rs232net_log, "rs232net_open(device=%d).", device));
 
         /* connect socket */
-        fds[i].fd = vice_network_client(ad);
-        if (!fds[i].fd) {
+        connection = vice_network_client(ad);
+        if (!connection) {
             log_error(rs232net_log, "Cant open connection.");
             break;
         }
 
+        RS232NET_LOCK();
+        RING_STORE(fds[i].rx_read, 0);
+        RING_STORE(fds[i].rx_write, 0);
+        RING_STORE(fds[i].tx_read, 0);
+        RING_STORE(fds[i].tx_write, 0);
+        RING_STORE(fds[i].failed, RS232NET_OK);
+        fds[i].tx_waiting = 0;
+        fds[i].rx_polled = tick_now();
+        RING_STORE(fds[i].stats_rx_bytes, 0);
+        RING_STORE(fds[i].stats_rx_calls, 0);
+        RING_STORE(fds[i].stats_tx_bytes, 0);
+        RING_STORE(fds[i].stats_tx_calls, 0);
+        fds[i].fd = connection;
+        fds[i].generation++;
         fds[i].inuse = 1;
         fds[i].useip232 = rs232_useip232[device];
+        RS232NET_UNLOCK();
+
+#ifdef USE_VICE_THREAD
+        io_thread_start();
+#endif
 
         index = i;
 
@@ -181,8 +509,10 @@ int rs232net_open(int device)
 
 static void rs232net_closesocket(int index)
 {
+    RS232NET_LOCK();
     vice_network_socket_close(fds[index].fd);
     fds[index].fd = 0;
+    RS232NET_UNLOCK();
 }
 
 /* closes the rs232 window again */
@@ -206,16 +536,52 @@ void rs232net_close(int fd)
             _rs232net_putc(fd, IP232DTRLO);
         }
 
-        rs232net_closesocket(fd);
+        /* send what is still waiting */
+        RS232NET_LOCK();
+        if (io_active(&fds[fd])) {
+            io_transmit(&fds[fd]);
+        }
+        RS232NET_UNLOCK();
+
+        log_message(rs232net_log, "Connection %d: received %lu bytes in %lu reads, sent %lu bytes in %lu writes.",
+                    fd, COUNTER_GET(fds[fd].stats_rx_bytes), COUNTER_GET(fds[fd].stats_rx_calls),
+                    COUNTER_GET(fds[fd].stats_tx_bytes), COUNTER_GET(fds[fd].stats_tx_calls));
+
+        if (fds[fd].fd) {
+            rs232net_closesocket(fd);
+        }
         fds[fd].inuse = 0;
 
+#ifdef USE_VICE_THREAD
+        io_thread_stop_and_join();
+#endif
     } while (0);
 }
 
+/* Close the socket once the I/O side has reported an error and everything
+   received before has been read. Returns -1 if the socket was closed. */
+static int rs232net_check_failed(int fd)
+{
+    unsigned int failed = RING_LOAD(fds[fd].failed);
+
+    if (failed == RS232NET_OK
+        || RING_LOAD(fds[fd].rx_read) != RING_LOAD(fds[fd].rx_write)) {
+        return 0;
+    }
+
+    if (failed == RS232NET_FAILED_ERROR) {
+        log_error(rs232net_log, "Error on connection: %d.", fds[fd].error);
+    } else {
+        log_error(rs232net_log, "EOF");
+    }
+    rs232net_closesocket(fd);
+    return -1;
+}
+
 /* sends a byte to the RS232 line */
 static int _rs232net_putc(int fd, uint8_t b)
 {
-    ssize_t n;
+    unsigned int write;
 
     if (fd < 0 || fd >= RS232_NUM_DEVICES) {
         log_error(rs232net_log, "Attempt to write to invalid fd %d.", fd);
@@ -231,66 +597,73 @@ static int _rs232net_putc(int fd, uint8_t b)
         return 0;
     }
 
+    if (rs232net_check_failed(fd) < 0) {
+        return -1;
+    }
+
     /* for the beginning... */
     DEBUG_LOG_MESSAGE((rs232net_log, "Output 0x%02x '%c'.", b, isgraph((unsigned char)b) ? b : '.'));
 
-    n = vice_network_send(fds[fd].fd, &b, 1, 0);
-    if (n < 0) {
-        log_error(rs232net_log, "Error writing: %d.", vice_network_get_errorcode());
-        rs232net_closesocket(fd);
-        return -1;
+    write = RING_LOAD(fds[fd].tx_write);
+    if (write - RING_LOAD(fds[fd].tx_read) == RS232NET_BUFFER_SIZE) {
+        /* the other side does not keep up, wait for it like a blocking send
+           would have */
+        RS232NET_LOCK();
+        if (io_active(&fds[fd])) {
+            io_transmit(&fds[fd]);
+        }
+        RS232NET_UNLOCK();
+        if (rs232net_check_failed(fd) < 0) {
+            return -1;
+        }
+        if (write - RING_LOAD(fds[fd].tx_read) == RS232NET_BUFFER_SIZE) {
+            /* the connection broke, but the bytes received before are not
+               read yet. nothing will be sent anymore, drop the byte */
+            return 0;
+        }
     }
 
+    fds[fd].tx_buffer[write & RS232NET_BUFFER_MASK] = b;
+    RING_STORE(fds[fd].tx_write, write + 1);
+
     return 0;
 }
 
-/* gets a byte to the RS232 line, returns !=0 if byte received, byte in *b. */
-static int _rs232net_getc(int fd, uint8_t * b)
+/* gets a byte to the RS232 line, returns !=0 if byte received, byte in *b.
+   With peek, the byte stays in the buffer. */
+static int _rs232net_getc(int fd, uint8_t * b, int peek)
 {
-    int ret;
-    ssize_t no_of_read_byte = -1;
-
-    do {
-        if (fd < 0 || fd >= RS232_NUM_DEVICES) {
-            log_error(rs232net_log, "Attempt to read from invalid fd %d.", fd);
-            break;
-        }
-
-        if (!fds[fd].inuse) {
-            log_error(rs232net_log, "Attempt to read from non-open fd %d.", fd);
-            break;
-        }
+    unsigned int read;
 
-        /* from now on, assume everything is ok,
-           but we have not received any bytes */
-        no_of_read_byte = 0;
+    if (fd < 0 || fd >= RS232_NUM_DEVICES) {
+        log_error(rs232net_log, "Attempt to read from invalid fd %d.", fd);
+        return -1;
+    }
 
-        /* silently drop if socket is shut because of a previous error  */
-        if (!fds[fd].fd) {
-            break;
-        }
+    if (!fds[fd].inuse) {
+        log_error(rs232net_log, "Attempt to read from non-open fd %d.", fd);
+        return -1;
+    }
 
-        ret = vice_network_select_poll_one(fds[fd].fd);
+    /* silently drop if socket is shut because of a previous error  */
+    if (!fds[fd].fd) {
+        return 0;
+    }
 
-        if (ret > 0) {
+    io_poll(&fds[fd]);
 
-            no_of_read_byte = vice_network_receive(fds[fd].fd, b, 1, 0);
-            DEBUG_LOG_MESSAGE((rs232net_log, "Input 0x%02x '%c'.", *b, isgraph((unsigned char)*b) ? *b : '.'));
+    read = RING_LOAD(fds[fd].rx_read);
+    if (read == RING_LOAD(fds[fd].rx_write)) {
+        return rs232net_check_failed(fd);
+    }
 
-            if ( no_of_read_byte != 1 ) {
-                if ( no_of_read_byte < 0 ) {
-                    log_error(rs232net_log, "Error reading: %d.",
-                            vice_network_get_errorcode());
-                } else {
-                    log_error(rs232net_log, "EOF");
-                }
-                rs232net_closesocket(fd);
-                no_of_read_byte = -1;
-            }
-        }
-    } while (0);
+    *b = fds[fd].rx_buffer[read & RS232NET_BUFFER_MASK];
+    if (!peek) {
+        RING_STORE(fds[fd].rx_read, read + 1);
+        DEBUG_LOG_MESSAGE((rs232net_log, "Input 0x%02x '%c'.", *b, isgraph((unsigned char)*b) ? *b : '.'));
+    }
 
-    return (int)no_of_read_byte;
+    return 1;
 }
 
 /* sends a byte to the RS232 line */
@@ -311,6 +684,7 @@ int rs232net_putc(int fd, uint8_t b)
 int rs232net_getc(int fd, uint8_t * b)
 {
     int ret = -1;
+    uint8_t next;
 
     if (fd < 0 || fd >= RS232_NUM_DEVICES) {
         log_error(rs232net_log, "Attempt to read from invalid fd %d.", fd);
@@ -319,24 +693,50 @@ int rs232net_getc(int fd, uint8_t * b)
 
 tryagain:
 
-    ret = _rs232net_getc(fd, b);
-
     if (fds[fd].useip232) {
+        /* only take the escape once the byte following it is there, so the
+           line status changes in the same order as in the data stream */
+        if ((ret = _rs232net_getc(fd, b, 1)) < 1) {
+            return ret;
+        }
         if (*b == IP232MAGIC) {
-            if ((ret = _rs232net_getc(fd, b)) < 1) {
-                return ret;
+            unsigned int read = RING_LOAD(fds[fd].rx_read);
+
+            if (RING_LOAD(fds[fd].rx_write) - read < 2) {
+                if (RING_LOAD(fds[fd].failed)) {
+                    /* the rest will never come */
+                    RING_STORE(fds[fd].rx_read, read + 1);
+                }
+                return rs232net_check_failed(fd);
             }
-            if (*b == IP232MAGIC) {
+            next = fds[fd].rx_buffer[(read + 1) & RS232NET_BUFFER_MASK];
+            RING_STORE(fds[fd].rx_read, read + 2);
+            if (next == IP232MAGIC) {
                 /* literal 0xff */
+                return 1;
             } else {
-                fds[fd].dcd_in = (*b & IP232DCDMASK) == IP232DCDHI ? 1 : 0;
-                fds[fd].ri_in = (*b & IP232RIMASK) == IP232RIHI ? 1 : 0;
+                fds[fd].dcd_in = (next & IP232DCDMASK) == IP232DCDHI ? 1 : 0;
+                fds[fd].ri_in = (next & IP232RIMASK) == IP232RIHI ? 1 : 0;
                 goto tryagain;
             }
         }
     }
 
-    return ret;
+    return _rs232net_getc(fd, b, 0);
+}
+
+/* tells if rs232net_getc() has something to process: bytes, IP232 line
+   changes or a broken connection to report */
+int rs232net_rx_pending(int fd)
+{
+    if (fd < 0 || fd >= RS232_NUM_DEVICES || !fds[fd].inuse || !fds[fd].fd) {
+        return 0;
+    }
+
+    io_poll(&fds[fd]);
+
+    return RING_LOAD(fds[fd].rx_read) != RING_LOAD(fds[fd].rx_write)
+           || RING_LOAD(fds[fd].failed) != RS232NET_OK;
 }
 
 /* set the status lines of the RS232 device */
@@ -361,6 +761,13 @@ int rs232net_set_status(int fd, enum rs232handshake_out status)
                 _rs232net_putc(fd, IP232MAGIC);
                 _rs232net_putc(fd, IP232DTRLO);
             }
+            /* line changes are not held back with the data. the I/O thread
+               may be waiting for the socket, so send them from here */
+            RS232NET_LOCK();
+            if (io_active(&fds[fd])) {
+                io_transmit(&fds[fd]);
+            }
+            RS232NET_UNLOCK();
         }
     }
     fds[fd].dtr_out = dtr;
@@ -53,6 +53,9 @@ int rs232net_set_status(int fd, enum rs232handshake_out status);
 /* write the output handshake lines */
 enum rs232handshake_in rs232net_get_status(int fd);
 
+/* Tells if rs232net_getc() has something to process, without reading it */
+int rs232net_rx_pending(int fd);
+
 int rs232net_resources_init(void);
 void rs232net_resources_shutdown(void);
 int rs232net_cmdline_options_init(void);
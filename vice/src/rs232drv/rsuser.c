@@ -739,6 +739,9 @@ static void int_rsuser(CLOCK offset, void *data)
 
     switch (rxstate) {
         case 0:
+            /* Unlike the ACIA this polls the driver every character time even
+               while the line is idle, as this alarm also keeps the transmit
+               buffer going. */
             if ((rsuser_rtsinv ? 0 : RTS_OUT) == rts && fd >= 0 && rs232drv_getc(fd, &rxdata)) {
                 /* byte received, signal startbit on flag */
                 rxstate++;
@@ -0,0 +1,240 @@
+/** \file   runahead.c
+ * \brief   Run-ahead to hide the input latency of emulated programs
+ *
+ * Most programs only react to input one or more frames after they have read
+ * it. With "RunAheadFrames" set to N, the state of the machine is saved in
+ * memory at the end of every frame, the next N frames are emulated as fast
+ * as possible with only the last of them shown, and the saved state is
+ * restored again. The real frame that follows is emulated at normal speed,
+ * with sound and pacing, but not shown. The frame on screen is therefore
+ * always N frames ahead of the real emulation, and input shows up N frames
+ * earlier.
+ *
+ * Frames run ahead produce no sound and do not pace or poll input. Host
+ * input that arrives in the real frame reaches the emulation right after the
+ * restore, so the next frames run ahead see it.
+ *
+ * Restoring the state cannot undo what left the emulation in a frame run
+ * ahead, so run-ahead is suspended while it would disturb netplay, autostart,
+ * event recording or video recording, and while the machine talks to the
+ * host: ethernet, RS232, printer output, files open for writing through a
+ * virtual drive or the filesystem device, datasette recording, true drive
+ * emulation writing to a disk image, changes in a hard disk or memory card
+ * block cache that are not written back yet, and flash journals that are
+ * not synced yet.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdbool.h>
+
+#include "archdep.h"
+#include "attach.h"
+#include "autostart.h"
+#include "blockcache.h"
+#include "datasette.h"
+#include "drive.h"
+#include "flash040.h"
+#include "interrupt.h"
+#include "joystick.h"
+#include "keyboard.h"
+#include "log.h"
+#include "machine.h"
+#include "maincpu.h"
+#include "network.h"
+#include "printer.h"
+#ifdef HAVE_RAWNET
+#include "rawnet.h"
+#endif
+#include "rs232drv.h"
+#include "runahead.h"
+#include "screenshot.h"
+#include "snapshot.h"
+#include "types.h"
+#include "vice-event.h"
+#include "vsync.h"
+
+bool runahead_frame_hidden = false;
+bool runahead_frame_ahead = false;
+
+/* "RunAheadFrames" */
+static int runahead_frames = 0;
+
+/* 0 in the real frame, otherwise the number of the frame run ahead */
+static int ahead_frame = 0;
+
+static snapshot_memory_t runahead_state;
+
+/* saving or restoring failed, do not try again */
+static bool runahead_failed = false;
+
+/* time spent per real frame */
+static unsigned long stats_frames;
+static uint64_t stats_save_ticks;
+static uint64_t stats_ahead_ticks;
+static uint64_t stats_restore_ticks;
+static tick_t ahead_start_tick;
+
+static bool runahead_possible(void)
+{
+    return runahead_frames > 0
+           && !runahead_failed
+           && !vsync_get_warp_mode()
+           && !max_throughput_mode
+           && !network_connected()
+           && !autostart_in_progress()
+           && !event_record_active()
+           && !event_playback_active()
+           && !screenshot_is_recording()
+           /* frames run ahead must not talk to the outside world */
+#ifdef HAVE_RAWNET
+           && !rawnet_is_active()
+#endif
+           && !rs232drv_is_open()
+           && !printer_is_open()
+           && !file_system_write_channel_open()
+           && !datasette_is_recording()
+           && !drive_gcr_data_pending()
+           && !blockcache_any_dirty()
+           && !flash040core_journal_any_pending();
+}
+
+static void runahead_save_trap(uint16_t addr, void *data)
+{
+    tick_t start = tick_now();
+    int result;
+
+    snapshot_memory_select(&runahead_state);
+    result = machine_write_snapshot("", 0, 0, 0);
+    snapshot_memory_select(NULL);
+
+    if (result < 0) {
+        log_error(LOG_DEFAULT, "Run-ahead: cannot save the machine state, disabling run-ahead.");
+        runahead_failed = true;
+        runahead_frame_hidden = false;
+        return;
+    }
+
+    ahead_start_tick = tick_now();
+    stats_save_ticks += ahead_start_tick - start;
+
+    ahead_frame = 1;
+    runahead_frame_ahead = true;
+    runahead_frame_hidden = runahead_frames > 1;
+}
+
+static void runahead_restore_trap(uint16_t addr, void *data)
+{
+    tick_t start = tick_now();
+    int result;
+
+    stats_ahead_ticks += start - ahead_start_tick;
+
+    snapshot_memory_select(&runahead_state);
+    result = machine_read_snapshot("", 0);
+    snapshot_memory_select(NULL);
+
+    ahead_frame = 0;
+    runahead_frame_ahead = false;
+
+    if (result < 0) {
+        /* the machine is in an unknown state now, much like after a failed
+           snapshot load */
+        log_error(LOG_DEFAULT, "Run-ahead: cannot restore the machine state, disabling run-ahead.");
+        runahead_failed = true;
+        runahead_frame_hidden = false;
+        return;
+    }
+
+    /* the input latched while running ahead was rewound as well */
+    keyboard_latch_resync();
+    joystick_latch_resync();
+
+    stats_restore_ticks += tick_now_delta(start);
+    stats_frames++;
+
+    runahead_frame_hidden = true;
+}
+
+/** \brief  Set the number of frames to run ahead
+ *
+ * \param[in]   frames  frames, 0 disables run-ahead
+ */
+void runahead_set_frames(int frames)
+{
+    runahead_frames = frames;
+    runahead_failed = false;
+}
+
+/** \brief  Advance run-ahead at the end of a frame
+ *
+ * Called by vsync_do_vsync() at the end of every frame, including the frames
+ * run ahead.
+ */
+void runahead_vsync(void)
+{
+    if (runahead_frame_ahead) {
+        if (ahead_frame < runahead_frames) {
+            ahead_frame++;
+            runahead_frame_hidden = ahead_frame < runahead_frames;
+        } else {
+            interrupt_maincpu_trigger_trap(runahead_restore_trap, NULL);
+        }
+        return;
+    }
+
+    if (runahead_possible()) {
+        interrupt_maincpu_trigger_trap(runahead_save_trap, NULL);
+    } else {
+        runahead_frame_hidden = false;
+    }
+}
+
+/** \brief  Tell if the frame after the current one will not be shown
+ *
+ * \return  true if the next frame need not be drawn
+ */
+bool runahead_next_frame_hidden(void)
+{
+    if (runahead_frame_ahead) {
+        /* the real frame after the last frame run ahead is never shown */
+        return ahead_frame >= runahead_frames || ahead_frame + 1 < runahead_frames;
+    }
+    return runahead_possible() && runahead_frames > 1;
+}
+
+/** \brief  Log the time spent on run-ahead and free the saved state
+ */
+void runahead_shutdown(void)
+{
+    if (stats_frames > 0) {
+        log_message(LOG_DEFAULT, "Run-ahead: %lu frames, %lu bytes of state, per frame: save %.3f ms, run ahead %.3f ms, restore %.3f ms.",
+                    stats_frames, (unsigned long)runahead_state.size,
+                    (double)TICK_TO_MICRO(stats_save_ticks / stats_frames) / 1000.0,
+                    (double)TICK_TO_MICRO(stats_ahead_ticks / stats_frames) / 1000.0,
+                    (double)TICK_TO_MICRO(stats_restore_ticks / stats_frames) / 1000.0);
+    }
+
+    snapshot_memory_free(&runahead_state);
+}
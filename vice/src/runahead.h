@@ -0,0 +1,42 @@
+/** \file   runahead.h
+ * \brief   Run-ahead to hide the input latency of emulated programs - header
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_RUNAHEAD_H
+#define VICE_RUNAHEAD_H
+
+#include <stdbool.h>
+
+/* the current frame is not shown */
+extern bool runahead_frame_hidden;
+
+/* the current frame runs ahead of the real emulation and will be undone */
+extern bool runahead_frame_ahead;
+
+void runahead_set_frames(int frames);
+void runahead_vsync(void);
+bool runahead_next_frame_hidden(void);
+void runahead_shutdown(void);
+
+#endif
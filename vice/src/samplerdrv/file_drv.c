@@ -84,9 +84,15 @@
 
 /* #define DEBUG_FILEDRV 1 */
 
+#include <stdio.h>
 #include <string.h> /* for memcpy */
 #include <math.h>
 
+#ifdef USE_VICE_THREAD
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+
 #ifdef USE_MPG123
 #include <mpg123.h>
 #endif
@@ -101,6 +107,7 @@
 
 #include "types.h"
 
+#include "archdep.h"
 #include "cmdline.h"
 #include "file_drv.h"
 #include "lib.h"
@@ -109,6 +116,7 @@
 #include "maincpu.h"
 #include "resources.h"
 #include "sampler.h"
+#include "sampler_stream.h"
 #include "util.h"
 
 static log_t filedrv_log = LOG_DEFAULT;
@@ -130,8 +138,7 @@ static char *sample_name = NULL;
 static unsigned sample_size = 0;
 static int sound_sampling_started = 0;
 
-static unsigned int sound_sample_frame_start;
-static CLOCK old_frame;
+static CLOCK sound_start_frame;
 static unsigned int sound_frames_per_sec;
 static unsigned int sound_cycles_per_frame;
 static unsigned int sound_samples_per_frame;
@@ -154,6 +161,57 @@ static int wav_fmt_extension_bytes = 0;
 static uint8_t *sample_buffer1 = NULL;
 static uint8_t *sample_buffer2 = NULL;
 
+/* converts frames of sample data to unsigned 8 bit samples, channel 2 is only
+   written when both the file and the sampler are stereo */
+typedef void (*convert_samples_t)(const uint8_t *src, unsigned int frames, int channels, uint8_t *out1, uint8_t *out2);
+
+/* Uncompressed WAV, AIFF, AIFC and IFF files are not loaded as a whole. Only
+   the header is read on open, the sample data is read and converted into a
+   sampler stream while sampling, by a thread if possible. */
+
+/* frames read at once */
+#define STREAM_CHUNK        1024
+
+/* largest frame, 2 channels of 64 bit */
+#define STREAM_FRAME_MAX    16
+
+/* give up looking for the sample data after this many bytes */
+#define STREAM_HEADER_MAX   0x100000
+
+/* the header is parsed by the same code as a loaded file, so keep a little
+   zeroed room behind it for the signature checks */
+#define STREAM_HEADER_SLACK 64
+
+/* how long the emulation waits for the reader after a seek */
+#define STREAM_WAIT_MS      100
+
+/* how long the reader sleeps when the stream is full */
+#define STREAM_IDLE_MS      2
+
+static FILE *stream_file = NULL;
+static sampler_stream_t *stream = NULL;
+static unsigned int stream_data_start;
+static unsigned int stream_frame_size;
+static convert_samples_t stream_convert = NULL;
+
+/* reader side: next position to write, and the frame the file is at */
+static uint64_t stream_pos;
+static unsigned int stream_file_frame;
+static int stream_short;
+
+static uint8_t stream_last_sample[2];
+
+static unsigned long stats_frames_read;
+static unsigned long stats_seeks;
+static unsigned long stats_underruns;
+
+#ifdef USE_VICE_THREAD
+static pthread_t stream_thread;
+static int stream_thread_running = 0;
+static int stream_thread_failed = 0;
+static atomic_int stream_thread_stop;
+#endif
+
 static int16_t decode_ulaw(uint8_t sample)
 {
     int16_t t;
@@ -189,109 +247,67 @@ static int16_t decode_alaw(uint8_t sample)
     return ((sample & 0x80) ? t : -t);
 }
 
-static int convert_alaw_buffer(int size, int channels)
+static void convert_alaw_samples(const uint8_t *src, unsigned int frames, int channels, uint8_t *out1, uint8_t *out2)
 {
     unsigned int frame_size = sound_audio_bits * sound_audio_channels / 8;
     unsigned int i;
     signed char sample;
 
-    sample_size = size / frame_size;
-
-    sample_buffer1 = lib_malloc(sample_size);
-    if (channels == SAMPLER_OPEN_STEREO) {
-        if (sound_audio_channels == 2) {
-            sample_buffer2 = lib_malloc(sample_size);
-        } else {
-            sample_buffer2 = sample_buffer1;
-        }
-    }
-
-    for (i = 0; i < sample_size; ++i) {
-        sample = file_buffer[file_pointer + (i * frame_size)];
-        sample_buffer1[i] = (uint8_t)(decode_alaw(sample) >> 8) + 0x80;
+    for (i = 0; i < frames; ++i) {
+        sample = src[i * frame_size];
+        out1[i] = (uint8_t)(decode_alaw(sample) >> 8) + 0x80;
         if (sound_audio_channels == 2 && channels == SAMPLER_OPEN_STEREO) {
-            sample = file_buffer[file_pointer + (i * frame_size) + 1];
-            sample_buffer2[i] = (uint8_t)(decode_alaw(sample) >> 4) + 0x80;
+            sample = src[(i * frame_size) + 1];
+            out2[i] = (uint8_t)(decode_alaw(sample) >> 4) + 0x80;
         }
     }
-    lib_free(file_buffer);
-    file_buffer = NULL;
-    return 0;
 }
 
-static int convert_ulaw_buffer(int size, int channels)
+static void convert_ulaw_samples(const uint8_t *src, unsigned int frames, int channels, uint8_t *out1, uint8_t *out2)
 {
     unsigned int frame_size = sound_audio_bits * sound_audio_channels / 8;
     unsigned int i;
     signed char sample;
 
-    sample_size = size / frame_size;
-
-    sample_buffer1 = lib_malloc(sample_size);
-    if (channels == SAMPLER_OPEN_STEREO) {
-        if (sound_audio_channels == 2) {
-            sample_buffer2 = lib_malloc(sample_size);
-        } else {
-            sample_buffer2 = sample_buffer1;
-        }
-    }
-
-    for (i = 0; i < sample_size; ++i) {
-        sample = file_buffer[file_pointer + (i * frame_size)];
-        sample_buffer1[i] = (uint8_t)(decode_ulaw(sample) >> 8) + 0x80;
+    for (i = 0; i < frames; ++i) {
+        sample = src[i * frame_size];
+        out1[i] = (uint8_t)(decode_ulaw(sample) >> 8) + 0x80;
         if (sound_audio_channels == 2 && channels == SAMPLER_OPEN_STEREO) {
-            sample = file_buffer[file_pointer + (i * frame_size) + 1];
-            sample_buffer2[i] = (uint8_t)(decode_ulaw(sample) >> 3) + 0x80;
+            sample = src[(i * frame_size) + 1];
+            out2[i] = (uint8_t)(decode_ulaw(sample) >> 3) + 0x80;
         }
     }
-    lib_free(file_buffer);
-    file_buffer = NULL;
-    return 0;
 }
 
-static int convert_pcm_buffer(int size, int channels)
+static void convert_pcm_samples(const uint8_t *src, unsigned int frames, int channels, uint8_t *out1, uint8_t *out2)
 {
     unsigned int frame_size = sound_audio_bits * sound_audio_channels / 8;
     unsigned int i;
 
-    sample_size = size / frame_size;
-
-    sample_buffer1 = lib_malloc(sample_size);
-    if (channels == SAMPLER_OPEN_STEREO) {
-        if (sound_audio_channels == 2) {
-            sample_buffer2 = lib_malloc(sample_size);
-        } else {
-            sample_buffer2 = sample_buffer1;
-        }
-    }
-
-    for (i = 0; i < sample_size; ++i) {
+    for (i = 0; i < frames; ++i) {
         if (sound_audio_type == AUDIO_TYPE_PCM_BE) {
-            sample_buffer1[i] = file_buffer[file_pointer + (i * frame_size)];
+            out1[i] = src[i * frame_size];
         } else {
-            sample_buffer1[i] = file_buffer[file_pointer + (i * frame_size) + (sound_audio_bits / 8) - 1];
+            out1[i] = src[(i * frame_size) + (sound_audio_bits / 8) - 1];
         }
         if (sound_audio_bits != 8 || sound_audio_type == AUDIO_TYPE_PCM_AMIGA || sound_audio_type == AUDIO_TYPE_PCM_BE) {
-            sample_buffer1[i] += 0x80;
+            out1[i] += 0x80;
         }
         if (sound_audio_channels == 2 && channels == SAMPLER_OPEN_STEREO) {
             if (sound_audio_type == AUDIO_TYPE_PCM_BE) {
-                sample_buffer2[i] = file_buffer[file_pointer + (i * frame_size) + (frame_size / 2)];
+                out2[i] = src[(i * frame_size) + (frame_size / 2)];
             } else {
-                sample_buffer2[i] = file_buffer[file_pointer + (i * frame_size) + (frame_size / 2) + (sound_audio_bits / 8) - 1];
+                out2[i] = src[(i * frame_size) + (frame_size / 2) + (sound_audio_bits / 8) - 1];
             }
             if (sound_audio_bits != 8 || sound_audio_type == AUDIO_TYPE_PCM_AMIGA || sound_audio_type == AUDIO_TYPE_PCM_BE) {
-                sample_buffer2[i] += 0x80;
+                out2[i] += 0x80;
             }
         }
     }
-    lib_free(file_buffer);
-    file_buffer = NULL;
-    return 0;
 }
 
 /* FIXME: endianess */
-static int convert_float_buffer(int size, int channels)
+static void convert_float_samples(const uint8_t *src, unsigned int frames, int channels, uint8_t *out1, uint8_t *out2)
 {
     unsigned int frame_size = sound_audio_bits * sound_audio_channels / 8;
     unsigned int i;
@@ -299,58 +315,44 @@ static int convert_float_buffer(int size, int channels)
     float f;
     int32_t sample;
 
-    sample_size = size / frame_size;
-
-    sample_buffer1 = lib_malloc(sample_size);
-    if (channels == SAMPLER_OPEN_STEREO) {
-        if (sound_audio_channels == 2) {
-            sample_buffer2 = lib_malloc(sample_size);
-        } else {
-            sample_buffer2 = sample_buffer1;
-        }
-    }
-
-    for (i = 0; i < sample_size; ++i) {
+    for (i = 0; i < frames; ++i) {
         if (sound_audio_type == AUDIO_TYPE_FLOAT_BE) {
-            c[3] = file_buffer[file_pointer + (i * frame_size)];
-            c[2] = file_buffer[file_pointer + (i * frame_size) + 1];
-            c[1] = file_buffer[file_pointer + (i * frame_size) + 2];
-            c[0] = file_buffer[file_pointer + (i * frame_size) + 3];
+            c[3] = src[i * frame_size];
+            c[2] = src[(i * frame_size) + 1];
+            c[1] = src[(i * frame_size) + 2];
+            c[0] = src[(i * frame_size) + 3];
         } else {
-            c[0] = file_buffer[file_pointer + (i * frame_size)];
-            c[1] = file_buffer[file_pointer + (i * frame_size) + 1];
-            c[2] = file_buffer[file_pointer + (i * frame_size) + 2];
-            c[3] = file_buffer[file_pointer + (i * frame_size) + 3];
+            c[0] = src[i * frame_size];
+            c[1] = src[(i * frame_size) + 1];
+            c[2] = src[(i * frame_size) + 2];
+            c[3] = src[(i * frame_size) + 3];
         }
         memcpy(&f, c, sizeof(float));
         f *= (float)0x7fffffff;
         sample = (int32_t)f;
-        sample_buffer1[i] = (uint8_t)((sample >> 24) + 0x80);
+        out1[i] = (uint8_t)((sample >> 24) + 0x80);
         if (sound_audio_channels == 2 && channels == SAMPLER_OPEN_STEREO) {
             if (sound_audio_type == AUDIO_TYPE_FLOAT_BE) {
-                c[3] = file_buffer[file_pointer + (i * frame_size) + 4];
-                c[2] = file_buffer[file_pointer + (i * frame_size) + 5];
-                c[1] = file_buffer[file_pointer + (i * frame_size) + 6];
-                c[0] = file_buffer[file_pointer + (i * frame_size) + 7];
+                c[3] = src[(i * frame_size) + 4];
+                c[2] = src[(i * frame_size) + 5];
+                c[1] = src[(i * frame_size) + 6];
+                c[0] = src[(i * frame_size) + 7];
             } else {
-                c[0] = file_buffer[file_pointer + (i * frame_size) + 4];
-                c[1] = file_buffer[file_pointer + (i * frame_size) + 5];
-                c[2] = file_buffer[file_pointer + (i * frame_size) + 6];
-                c[3] = file_buffer[file_pointer + (i * frame_size) + 7];
+                c[0] = src[(i * frame_size) + 4];
+                c[1] = src[(i * frame_size) + 5];
+                c[2] = src[(i * frame_size) + 6];
+                c[3] = src[(i * frame_size) + 7];
             }
             memcpy(&f, c, sizeof(float));
             f *= (float)0x7fffffff;
             sample = (int32_t)f;
-            sample_buffer2[i] = (uint8_t)((sample >> 24) + 0x80);
+            out2[i] = (uint8_t)((sample >> 24) + 0x80);
         }
     }
-    lib_free(file_buffer);
-    file_buffer = NULL;
-    return 0;
 }
 
 /* FIXME: endianess */
-static int convert_double_buffer(int size, int channels)
+static void convert_double_samples(const uint8_t *src, unsigned int frames, int channels, uint8_t *out1, uint8_t *out2)
 {
     unsigned int frame_size = sound_audio_bits * sound_audio_channels / 8;
     unsigned int i;
@@ -358,72 +360,120 @@ static int convert_double_buffer(int size, int channels)
     double f;
     int32_t sample;
 
-    sample_size = size / frame_size;
-
-    sample_buffer1 = lib_malloc(sample_size);
-    if (channels == SAMPLER_OPEN_STEREO) {
-        if (sound_audio_channels == 2) {
-            sample_buffer2 = lib_malloc(sample_size);
-        } else {
-            sample_buffer2 = sample_buffer1;
-        }
-    }
-
-    for (i = 0; i < sample_size; ++i) {
+    for (i = 0; i < frames; ++i) {
         if (sound_audio_type == AUDIO_TYPE_FLOAT_BE) {
-            c[7] = file_buffer[file_pointer + (i * frame_size)];
-            c[6] = file_buffer[file_pointer + (i * frame_size) + 1];
-            c[5] = file_buffer[file_pointer + (i * frame_size) + 2];
-            c[4] = file_buffer[file_pointer + (i * frame_size) + 3];
-            c[3] = file_buffer[file_pointer + (i * frame_size) + 4];
-            c[2] = file_buffer[file_pointer + (i * frame_size) + 5];
-            c[1] = file_buffer[file_pointer + (i * frame_size) + 6];
-            c[0] = file_buffer[file_pointer + (i * frame_size) + 7];
+            c[7] = src[i * frame_size];
+            c[6] = src[(i * frame_size) + 1];
+            c[5] = src[(i * frame_size) + 2];
+            c[4] = src[(i * frame_size) + 3];
+            c[3] = src[(i * frame_size) + 4];
+            c[2] = src[(i * frame_size) + 5];
+            c[1] = src[(i * frame_size) + 6];
+            c[0] = src[(i * frame_size) + 7];
         } else {
-            c[0] = file_buffer[file_pointer + (i * frame_size)];
-            c[1] = file_buffer[file_pointer + (i * frame_size) + 1];
-            c[2] = file_buffer[file_pointer + (i * frame_size) + 2];
-            c[3] = file_buffer[file_pointer + (i * frame_size) + 3];
-            c[4] = file_buffer[file_pointer + (i * frame_size) + 4];
-            c[5] = file_buffer[file_pointer + (i * frame_size) + 5];
-            c[6] = file_buffer[file_pointer + (i * frame_size) + 6];
-            c[7] = file_buffer[file_pointer + (i * frame_size) + 7];
+            c[0] = src[i * frame_size];
+            c[1] = src[(i * frame_size) + 1];
+            c[2] = src[(i * frame_size) + 2];
+            c[3] = src[(i * frame_size) + 3];
+            c[4] = src[(i * frame_size) + 4];
+            c[5] = src[(i * frame_size) + 5];
+            c[6] = src[(i * frame_size) + 6];
+            c[7] = src[(i * frame_size) + 7];
         }
         memcpy(&f, c, sizeof(double));
         f *= 0x7fffffff;
         sample = (int32_t)f;
-        sample_buffer1[i] = (uint8_t)((sample >> 24) + 0x80);
+        out1[i] = (uint8_t)((sample >> 24) + 0x80);
         if (sound_audio_channels == 2 && channels == SAMPLER_OPEN_STEREO) {
             if (sound_audio_type == AUDIO_TYPE_FLOAT_BE) {
-                c[7] = file_buffer[file_pointer + (i * frame_size) + 8];
-                c[6] = file_buffer[file_pointer + (i * frame_size) + 9];
-                c[5] = file_buffer[file_pointer + (i * frame_size) + 10];
-                c[4] = file_buffer[file_pointer + (i * frame_size) + 11];
-                c[3] = file_buffer[file_pointer + (i * frame_size) + 12];
-                c[2] = file_buffer[file_pointer + (i * frame_size) + 13];
-                c[1] = file_buffer[file_pointer + (i * frame_size) + 14];
-                c[0] = file_buffer[file_pointer + (i * frame_size) + 15];
+                c[7] = src[(i * frame_size) + 8];
+                c[6] = src[(i * frame_size) + 9];
+                c[5] = src[(i * frame_size) + 10];
+                c[4] = src[(i * frame_size) + 11];
+                c[3] = src[(i * frame_size) + 12];
+                c[2] = src[(i * frame_size) + 13];
+                c[1] = src[(i * frame_size) + 14];
+                c[0] = src[(i * frame_size) + 15];
             } else {
-                c[0] = file_buffer[file_pointer + (i * frame_size) + 8];
-                c[1] = file_buffer[file_pointer + (i * frame_size) + 9];
-                c[2] = file_buffer[file_pointer + (i * frame_size) + 10];
-                c[3] = file_buffer[file_pointer + (i * frame_size) + 11];
-                c[4] = file_buffer[file_pointer + (i * frame_size) + 12];
-                c[5] = file_buffer[file_pointer + (i * frame_size) + 13];
-                c[6] = file_buffer[file_pointer + (i * frame_size) + 14];
-                c[7] = file_buffer[file_pointer + (i * frame_size) + 15];
+                c[0] = src[(i * frame_size) + 8];
+                c[1] = src[(i * frame_size) + 9];
+                c[2] = src[(i * frame_size) + 10];
+                c[3] = src[(i * frame_size) + 11];
+                c[4] = src[(i * frame_size) + 12];
+                c[5] = src[(i * frame_size) + 13];
+                c[6] = src[(i * frame_size) + 14];
+                c[7] = src[(i * frame_size) + 15];
             }
             memcpy(&f, c, sizeof(double));
             f *= 0x7fffffff;
             sample = (int32_t)f;
-            sample_buffer2[i] = (uint8_t)((sample >> 24) + 0x80);
+            out2[i] = (uint8_t)((sample >> 24) + 0x80);
         }
     }
+}
+
+static int convert_buffer(int size, int channels, convert_samples_t convert)
+{
+    unsigned int frame_size = sound_audio_bits * sound_audio_channels / 8;
+
+    sample_size = size / frame_size;
+
+    if (stream_file != NULL) {
+        /* only remember where the sample data is, it is read while sampling */
+        if (sample_size == 0 || frame_size > STREAM_FRAME_MAX) {
+            log_error(filedrv_log, "unsupported sample data: %u frames of %u bytes",
+                    sample_size, frame_size);
+            return -1;
+        }
+        stream_data_start = file_pointer;
+        stream_frame_size = frame_size;
+        stream_convert = convert;
+        lib_free(file_buffer);
+        file_buffer = NULL;
+        return 0;
+    }
+
+    sample_buffer1 = lib_malloc(sample_size);
+    if (channels == SAMPLER_OPEN_STEREO) {
+        if (sound_audio_channels == 2) {
+            sample_buffer2 = lib_malloc(sample_size);
+        } else {
+            sample_buffer2 = sample_buffer1;
+        }
+    }
+
+    convert(file_buffer + file_pointer, sample_size, channels, sample_buffer1, sample_buffer2);
+
     lib_free(file_buffer);
     file_buffer = NULL;
     return 0;
 }
 
+static int convert_alaw_buffer(int size, int channels)
+{
+    return convert_buffer(size, channels, convert_alaw_samples);
+}
+
+static int convert_ulaw_buffer(int size, int channels)
+{
+    return convert_buffer(size, channels, convert_ulaw_samples);
+}
+
+static int convert_pcm_buffer(int size, int channels)
+{
+    return convert_buffer(size, channels, convert_pcm_samples);
+}
+
+static int convert_float_buffer(int size, int channels)
+{
+    return convert_buffer(size, channels, convert_float_samples);
+}
+
+static int convert_double_buffer(int size, int channels)
+{
+    return convert_buffer(size, channels, convert_double_samples);
+}
+
 /* ---------------------------------------------------------------------- */
 
 static void check_and_skip_chunk(void)
@@ -2092,11 +2142,259 @@ static int handle_file_type(int channels)
 
 /* ---------------------------------------------------------------------- */
 
+/* Find where the sample data of a RIFF WAVE or IFF (AIFF, AIFC, 8SVX) file
+   starts, walking the chunks the same way the parsers do. Returns 0 for other
+   files, those are loaded as a whole. */
+static unsigned int stream_header_size(FILE *f, unsigned int size)
+{
+    uint8_t header[12];
+    uint8_t chunk[8];
+    const char *data_id;
+    unsigned int data_extra = 0;
+    uint64_t pos = 12;
+    uint32_t len;
+    int riff = 0;
+    int pad = 0;
+
+    if (fseek(f, 0, SEEK_SET) != 0 || fread(header, 1, sizeof(header), f) != sizeof(header)) {
+        return 0;
+    }
+
+    if (!memcmp(header, "RIFF", 4) && !memcmp(header + 8, "WAVE", 4)) {
+        data_id = "data";
+        riff = 1;
+    } else if (!memcmp(header, "FORM", 4) && (!memcmp(header + 8, "AIFF", 4) || !memcmp(header + 8, "AIFC", 4))) {
+        /* the SSND chunk starts with the offset and block size */
+        data_id = "SSND";
+        data_extra = 8;
+        pad = 1;
+    } else if (!memcmp(header, "FORM", 4) && !memcmp(header + 8, "8SVX", 4)) {
+        data_id = "BODY";
+    } else {
+        return 0;
+    }
+
+    while (pos + 8 <= size && pos < STREAM_HEADER_MAX) {
+        if (fseek(f, (long)pos, SEEK_SET) != 0 || fread(chunk, 1, sizeof(chunk), f) != sizeof(chunk)) {
+            return 0;
+        }
+        if (!memcmp(chunk, data_id, 4)) {
+            return (unsigned int)pos + 8 + data_extra;
+        }
+        if (riff) {
+            len = ((uint32_t)chunk[7] << 24) | (chunk[6] << 16) | (chunk[5] << 8) | chunk[4];
+        } else {
+            len = ((uint32_t)chunk[4] << 24) | (chunk[5] << 16) | (chunk[6] << 8) | chunk[7];
+        }
+        if (pad && (len & 1)) {
+            ++len;
+        }
+        pos += 8 + (uint64_t)len;
+    }
+    return 0;
+}
+
+/* Read and convert the next piece of sample data into the stream, returns 0
+   if there is no room for it */
+static int stream_fill(void)
+{
+    uint8_t raw[STREAM_CHUNK * STREAM_FRAME_MAX];
+    uint8_t out1[STREAM_CHUNK];
+    uint8_t out2[STREAM_CHUNK];
+    unsigned int frames;
+    unsigned int frame;
+    size_t got = 0;
+    uint64_t pos;
+
+    if (sampler_stream_seek_pending(stream, &pos)) {
+        stream_pos = pos;
+        sampler_stream_restart(stream, pos);
+    }
+
+    frames = sampler_stream_space(stream);
+    if (frames == 0) {
+        return 0;
+    }
+    if (frames > STREAM_CHUNK) {
+        frames = STREAM_CHUNK;
+    }
+
+    /* the sample loops, read up to the end of the data at most */
+    frame = (unsigned int)(stream_pos % sample_size);
+    if (frames > sample_size - frame) {
+        frames = sample_size - frame;
+    }
+
+    if (frame == stream_file_frame
+        || fseek(stream_file, (long)stream_data_start + (long)frame * (long)stream_frame_size, SEEK_SET) == 0) {
+        got = fread(raw, stream_frame_size, frames, stream_file);
+    }
+    stream_file_frame = frame + (unsigned int)got;
+    stats_frames_read += (unsigned long)got;
+
+    stream_convert(raw, (unsigned int)got, current_channels, out1, out2);
+    if (got < frames) {
+        /* the file is shorter than its header says */
+        memset(out1 + got, 0x80, frames - got);
+        memset(out2 + got, 0x80, frames - got);
+        stream_file_frame = sample_size;
+        stream_short = 1;
+    }
+
+    if (sound_audio_channels == 2 && current_channels == SAMPLER_OPEN_STEREO) {
+        sampler_stream_write(stream, out1, out2, frames);
+    } else {
+        sampler_stream_write(stream, out1, NULL, frames);
+    }
+    stream_pos += frames;
+
+    return 1;
+}
+
+#ifdef USE_VICE_THREAD
+
+static void *stream_thread_main(void *unused)
+{
+    while (!atomic_load(&stream_thread_stop)) {
+        if (!stream_fill()) {
+            tick_sleep(tick_per_second() / 1000 * STREAM_IDLE_MS);
+        }
+    }
+
+    return NULL;
+}
+
+static void stream_thread_start(void)
+{
+    atomic_store(&stream_thread_stop, 0);
+    if (pthread_create(&stream_thread, NULL, stream_thread_main, NULL) == 0) {
+        stream_thread_running = 1;
+    } else {
+        log_error(filedrv_log, "Cannot start the reader thread, reading while sampling instead.");
+        stream_thread_failed = 1;
+    }
+}
+
+static void stream_thread_stop_and_join(void)
+{
+    if (stream_thread_running) {
+        atomic_store(&stream_thread_stop, 1);
+        pthread_join(stream_thread, NULL);
+        stream_thread_running = 0;
+    }
+    stream_thread_failed = 0;
+}
+
+#endif
+
+/* Give the reader a moment, or do its work when there is no reader thread */
+static void stream_wait(void)
+{
+#ifdef USE_VICE_THREAD
+    if (!stream_thread_running && !stream_thread_failed) {
+        stream_thread_start();
+    }
+    if (stream_thread_running) {
+        tick_sleep(tick_per_second() / 10000);
+        return;
+    }
+#endif
+    stream_fill();
+}
+
+static uint8_t stream_get_sample(uint64_t pos, int channel)
+{
+    int index = channel == SAMPLER_CHANNEL_2;
+    tick_t start;
+    uint8_t sample;
+
+    if (sampler_stream_read(stream, pos, channel, &sample)) {
+        stream_last_sample[index] = sample;
+        return sample;
+    }
+
+    /* a reset, a snapshot or a long jump of the clock */
+    if (!sampler_stream_reachable(stream, pos)) {
+        sampler_stream_seek(stream, pos);
+        stats_seeks++;
+    }
+
+    start = tick_now();
+    do {
+        stream_wait();
+        if (sampler_stream_read(stream, pos, channel, &sample)) {
+            stream_last_sample[index] = sample;
+            return sample;
+        }
+    } while (tick_now_delta(start) < tick_per_second() / 1000 * STREAM_WAIT_MS);
+
+    stats_underruns++;
+    return stream_last_sample[index];
+}
+
+static void stream_open(void)
+{
+    stream = sampler_stream_new();
+    stream_pos = 0;
+    stream_file_frame = sample_size;
+    stream_short = 0;
+    stream_last_sample[0] = 0x80;
+    stream_last_sample[1] = 0x80;
+    stats_frames_read = 0;
+    stats_seeks = 0;
+    stats_underruns = 0;
+}
+
+static void stream_close(void)
+{
+#ifdef USE_VICE_THREAD
+    stream_thread_stop_and_join();
+#endif
+
+    if (stream != NULL) {
+        if (stream_short) {
+            log_warning(filedrv_log, "Unexpected end of data in '%s'.", sample_name);
+        }
+        log_message(filedrv_log, "Read %lu frames from '%s', %lu seeks, %lu underruns.",
+                    stats_frames_read, sample_name, stats_seeks, stats_underruns);
+        sampler_stream_free(stream);
+        stream = NULL;
+    }
+    if (stream_file != NULL) {
+        fclose(stream_file);
+        stream_file = NULL;
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void file_free_sample(void)
+{
+    if (sample_buffer1) {
+        if (sample_buffer2) {
+            if (sample_buffer1 != sample_buffer2) {
+                lib_free(sample_buffer2);
+            }
+            sample_buffer2 = NULL;
+        }
+        lib_free(sample_buffer1);
+        sample_buffer1 = NULL;
+    }
+    stream_close();
+    sound_sampling_started = 0;
+}
+
 static void file_load_sample(int channels)
 {
     FILE *sample_file = NULL;
+    unsigned int header_size;
     int err = 0;
 
+    /* the sample may have been loaded already when the name was set */
+    if (sample_buffer1 || stream_file) {
+        file_free_sample();
+    }
+
     current_channels = channels;
 
     if (sample_name != NULL && *sample_name != '\0') {
@@ -2104,22 +2402,38 @@ static void file_load_sample(int channels)
         if (sample_file) {
             fseek(sample_file, 0, SEEK_END);
             file_size = (unsigned int)ftell(sample_file);
+            header_size = stream_header_size(sample_file, file_size);
             fseek(sample_file, 0, SEEK_SET);
-            file_buffer = lib_malloc(file_size);
-            if (fread(file_buffer, 1, file_size, sample_file) != file_size) {
-                log_warning(filedrv_log, "Unexpected end of data in '%s'.", sample_name);
+            if (header_size > 0) {
+                /* only parse the header, the sample data is streamed */
+                file_buffer = lib_calloc(1, header_size + STREAM_HEADER_SLACK);
+                if (fread(file_buffer, 1, header_size, sample_file) != header_size) {
+                    log_warning(filedrv_log, "Unexpected end of data in '%s'.", sample_name);
+                }
+                stream_file = sample_file;
+            } else {
+                file_buffer = lib_malloc(file_size);
+                if (fread(file_buffer, 1, file_size, sample_file) != file_size) {
+                    log_warning(filedrv_log, "Unexpected end of data in '%s'.", sample_name);
+                }
+                fclose(sample_file);
             }
-            fclose(sample_file);
             err = handle_file_type(channels);
             if (!err) {
                 sound_sampling_started = 0;
                 sound_cycles_per_frame = (unsigned int)machine_get_cycles_per_frame();
                 sound_frames_per_sec = (unsigned int)machine_get_cycles_per_second() / sound_cycles_per_frame;
                 sound_samples_per_frame = sound_audio_rate / sound_frames_per_sec;
-                log_message(filedrv_log, "using %s as the sampler file", sample_name);
+                if (stream_file != NULL) {
+                    stream_open();
+                    log_message(filedrv_log, "streaming %s as the sampler file", sample_name);
+                } else {
+                    log_message(filedrv_log, "using %s as the sampler file", sample_name);
+                }
             } else {
                 lib_free(file_buffer);
                 file_buffer = NULL;
+                stream_close();
                 log_error(filedrv_log, "Unknown file type for '%s'.", sample_name);
             }
         } else {
@@ -2128,21 +2442,6 @@ static void file_load_sample(int channels)
     }
 }
 
-static void file_free_sample(void)
-{
-    if (sample_buffer1) {
-        if (sample_buffer2) {
-            if (sample_buffer1 != sample_buffer2) {
-                lib_free(sample_buffer2);
-            }
-            sample_buffer2 = NULL;
-        }
-        lib_free(sample_buffer1);
-        sample_buffer1 = NULL;
-    }
-    sound_sampling_started = 0;
-}
-
 /* ---------------------------------------------------------------------- */
 
 static int set_sample_name(const char *name, void *param)
@@ -2157,7 +2456,7 @@ static int set_sample_name(const char *name, void *param)
         }
     }
 
-    if (sample_buffer1) {
+    if (sample_buffer1 || stream_file) {
         file_free_sample();
     }
 
@@ -2205,51 +2504,52 @@ static int sampler_file_cmdline_options_init(void)
 
 /* ---------------------------------------------------------------------- */
 
-/* For now channel is ignored */
+/* Position of the sample that belongs to the current clock, counted from the
+   start of sampling. Going back in time, by restoring a snapshot or for
+   run-ahead, goes back in the sample as well. */
+static uint64_t file_get_position(void)
+{
+    CLOCK current_frame = maincpu_clk / sound_cycles_per_frame;
+    unsigned int current_cycle = maincpu_clk % sound_cycles_per_frame;
+
+    if (!sound_sampling_started || current_frame < sound_start_frame) {
+        sound_sampling_started = 1;
+        sound_start_frame = current_frame;
+    }
+
+    return (current_frame - sound_start_frame) * sound_samples_per_frame
+           + current_cycle * sound_samples_per_frame / sound_cycles_per_frame;
+}
+
 static uint8_t file_get_sample(int channel)
 {
-    CLOCK current_frame = 0;
-    unsigned int current_cycle = 0;
-    CLOCK frame_diff = 0;
-    unsigned int frame_sample = 0;
+    uint64_t pos;
 
-    if (!sample_buffer1) {
+    if (!sample_buffer1 && !stream) {
         return 0x80;
     }
-    if (!sound_sampling_started) {
-        sound_sampling_started = 1;
-        old_frame = maincpu_clk / sound_cycles_per_frame;
-        return sample_buffer1[0];
-    }
-    current_frame = maincpu_clk / sound_cycles_per_frame;
-    current_cycle = maincpu_clk % sound_cycles_per_frame;
-
-    if (current_frame > old_frame) {
-        frame_diff = current_frame - old_frame;
-        while (frame_diff) {
-            --frame_diff;
-            ++old_frame;
-            sound_sample_frame_start += sound_samples_per_frame;
-            if (sound_sample_frame_start >= sample_size) {
-                sound_sample_frame_start -= sample_size;
-            }
-        }
-    }
-    frame_sample = current_cycle * sound_samples_per_frame / sound_cycles_per_frame;
 
-    return sample_buffer1[(frame_sample + sound_sample_frame_start) % sample_size];
+    pos = file_get_position();
+
+    if (stream) {
+        return stream_get_sample(pos, channel);
+    }
+    if (channel == SAMPLER_CHANNEL_2 && sample_buffer2) {
+        return sample_buffer2[pos % sample_size];
+    }
+    return sample_buffer1[pos % sample_size];
 }
 
 static void file_shutdown(void)
 {
-    if (sample_buffer1) {
+    if (sample_buffer1 || stream_file) {
         file_free_sample();
     }
 }
 
 static void file_reset(void)
 {
-    if (sample_buffer1) {
+    if (sample_buffer1 || stream) {
         sound_sampling_started = 0;
     }
 }
@@ -35,31 +35,125 @@
 #include "maincpu.h"
 #include "portaudio_drv.h"
 #include "sampler.h"
+#include "sampler_stream.h"
 
 #ifdef USE_PORTAUDIO
 #include <portaudio.h>
 
+/* The input arrives in the PortAudio callback and is put into a sampler
+   stream, the same as a streamed file. Without the VICE thread the stream is
+   read once per emulated frame instead. The emulation reads a little behind
+   the newest input, and jumps back or ahead when it gets too close or too far
+   behind. */
+
+#define PORTAUDIO_RATE      44100
+
+/* samples converted at once */
+#define PORTAUDIO_CHUNK     256
+
+/* frames of input kept between the newest sample and the one read, and how
+   far the emulation may fall behind before skipping ahead */
+#define PORTAUDIO_LATENCY_FRAMES        2
+#define PORTAUDIO_LATENCY_MAX_FRAMES    6
+
 static log_t portaudio_log = LOG_DEFAULT;
 
 static int stream_started = 0;
 static PaStream *stream = NULL;
 
-static unsigned int old_frame;
+static sampler_stream_t *samples = NULL;
+
+static int sampling_started = 0;
+static CLOCK start_frame;
+static int64_t read_offset;
 static unsigned int sound_frames_per_sec;
 static unsigned int sound_cycles_per_frame;
 static unsigned int sound_samples_per_frame;
-static unsigned int same_sample = 0;
 
 static int current_channels = 0;
 
-static uint16_t *stream_buffer = NULL;
-static uint8_t old_sample = 0x80;
+static uint8_t old_sample[2];
+
+#ifndef USE_VICE_THREAD
+static CLOCK poll_frame;
+#endif
+
+static unsigned long stats_dropped;
+static unsigned long stats_resyncs;
+
+/* Convert input to unsigned 8 bit and add it to the stream, whatever does not
+   fit is dropped */
+static void portaudio_store(const int16_t *input, unsigned int count)
+{
+    uint8_t left[PORTAUDIO_CHUNK];
+    uint8_t right[PORTAUDIO_CHUNK];
+    unsigned int space = sampler_stream_space(samples);
+    unsigned int n;
+    unsigned int i;
+
+    if (count > space) {
+        stats_dropped += count - space;
+        count = space;
+    }
+
+    while (count > 0) {
+        n = count < PORTAUDIO_CHUNK ? count : PORTAUDIO_CHUNK;
+        for (i = 0; i < n; i++) {
+            left[i] = (uint8_t)((input[i * current_channels] >> 8) + 0x80);
+            if (current_channels == 2) {
+                right[i] = (uint8_t)((input[(i * 2) + 1] >> 8) + 0x80);
+            }
+        }
+        sampler_stream_write(samples, left, current_channels == 2 ? right : NULL, n);
+        input += n * current_channels;
+        count -= n;
+    }
+}
+
+#ifdef USE_VICE_THREAD
+
+static int portaudio_callback(const void *input, void *output, unsigned long frame_count,
+                              const PaStreamCallbackTimeInfo *time_info,
+                              PaStreamCallbackFlags status_flags, void *user_data)
+{
+    if (input != NULL) {
+        portaudio_store(input, (unsigned int)frame_count);
+    }
+    return paContinue;
+}
+
+#else
+
+static void portaudio_poll(void)
+{
+    int16_t buffer[PORTAUDIO_CHUNK * 2];
+    signed long available = Pa_GetStreamReadAvailable(stream);
+    unsigned long n;
+    PaError err;
+
+    while (available > 0) {
+        n = available < PORTAUDIO_CHUNK ? (unsigned long)available : PORTAUDIO_CHUNK;
+        err = Pa_ReadStream(stream, buffer, n);
+        if (err != paNoError && err != paInputOverflowed) {
+            break;
+        }
+        portaudio_store(buffer, (unsigned int)n);
+        available -= (signed long)n;
+    }
+}
+
+#endif
 
 static void portaudio_start_stream(void)
 {
     PaStreamParameters inputParameters;
+    PaStreamCallback *callback = NULL;
     PaError err = paNoError;
 
+#ifdef USE_VICE_THREAD
+    callback = portaudio_callback;
+#endif
+
     inputParameters.device = Pa_GetDefaultInputDevice();
     if (inputParameters.device != paNoDevice) {
         inputParameters.channelCount = current_channels;
@@ -68,21 +162,29 @@ static void portaudio_start_stream(void)
         inputParameters.hostApiSpecificStreamInfo = NULL;
         sound_cycles_per_frame = (unsigned int)machine_get_cycles_per_frame();
         sound_frames_per_sec = (unsigned int)(machine_get_cycles_per_second() / sound_cycles_per_frame);
-        sound_samples_per_frame = 44100 / sound_frames_per_sec;
-        err = Pa_OpenStream(&stream, &inputParameters, NULL, 44100, sound_samples_per_frame, paClipOff, NULL, NULL);
+        sound_samples_per_frame = PORTAUDIO_RATE / sound_frames_per_sec;
+        samples = sampler_stream_new();
+        sampling_started = 0;
+        read_offset = 0;
+        old_sample[0] = 0x80;
+        old_sample[1] = 0x80;
+        stats_dropped = 0;
+        stats_resyncs = 0;
+        err = Pa_OpenStream(&stream, &inputParameters, NULL, PORTAUDIO_RATE, sound_samples_per_frame, paClipOff, callback, NULL);
         if (err == paNoError) {
             err = Pa_StartStream(stream);
             if (err == paNoError) {
                 stream_started = 1;
-                stream_buffer = lib_malloc(sound_samples_per_frame * 2 * current_channels);
-                memset(stream_buffer, 0, sound_samples_per_frame * 2 * current_channels);
-                old_frame = (unsigned int)((maincpu_clk / sound_cycles_per_frame) + 1);
             } else {
                 log_error(portaudio_log, "Could not start stream");
             }
         } else {
             log_error(portaudio_log, "Could not open stream");
         }
+        if (!stream_started) {
+            sampler_stream_free(samples);
+            samples = NULL;
+        }
     } else {
         log_error(portaudio_log, "Could not find a default input device");
     }
@@ -93,9 +195,11 @@ static void portaudio_stop_stream(void)
     Pa_AbortStream(stream);
     Pa_CloseStream(stream);
     stream = NULL;
-    if (stream_buffer) {
-        lib_free(stream_buffer);
-        stream_buffer = NULL;
+    if (samples) {
+        log_message(portaudio_log, "Dropped %lu samples, skipped %lu times.",
+                    stats_dropped, stats_resyncs);
+        sampler_stream_free(samples);
+        samples = NULL;
     }
     stream_started = 0;
 }
@@ -127,53 +231,54 @@ static void portaudio_stop_sampling(void)
 
 static uint8_t portaudio_get_sample(int channel)
 {
-    unsigned int current_frame;
+    CLOCK current_frame;
     unsigned int current_cycle;
-    unsigned int frame_diff;
-    unsigned int frame_sample;
+    unsigned int latency;
+    uint64_t end;
+    int64_t pos;
+    int index = channel == SAMPLER_CHANNEL_2;
+    uint8_t sample;
 
-    if (!stream_buffer) {
+    if (!samples) {
         return 0x80;
     }
-    current_frame = (unsigned int)(maincpu_clk / sound_cycles_per_frame);
+    current_frame = maincpu_clk / sound_cycles_per_frame;
     current_cycle = maincpu_clk % sound_cycles_per_frame;
 
-    if (current_frame > old_frame) {
-        frame_diff = current_frame - old_frame;
-        while (frame_diff) {
-            --frame_diff;
-            ++old_frame;
-            if (Pa_GetStreamReadAvailable(stream) >= sound_samples_per_frame) {
-                Pa_ReadStream(stream, stream_buffer, sound_samples_per_frame);
-                same_sample = 0;
-            } else {
-                ++same_sample;
-                if (same_sample >= sound_samples_per_frame) {
-                    same_sample = 0;
-                    portaudio_stop_stream();
-                    portaudio_start_stream();
-                    log_warning(portaudio_log, "Had to restart the stream");
-                }
-                return old_sample;
-            }
+#ifndef USE_VICE_THREAD
+    if (!sampling_started || current_frame != poll_frame) {
+        poll_frame = current_frame;
+        portaudio_poll();
+    }
+#endif
+
+    if (!sampling_started || current_frame < start_frame) {
+        sampling_started = 1;
+        start_frame = current_frame;
+    }
+
+    pos = (int64_t)((current_frame - start_frame) * sound_samples_per_frame
+                    + current_cycle * sound_samples_per_frame / sound_cycles_per_frame)
+          + read_offset;
+
+    end = sampler_stream_end(samples);
+    latency = sound_samples_per_frame * PORTAUDIO_LATENCY_FRAMES;
+    if (pos < 0
+        || (uint64_t)pos >= end
+        || (uint64_t)pos + sound_samples_per_frame * PORTAUDIO_LATENCY_MAX_FRAMES < end) {
+        if (end < latency) {
+            return old_sample[index];
         }
+        read_offset += (int64_t)(end - latency) - pos;
+        pos = (int64_t)(end - latency);
+        stats_resyncs++;
     }
-    frame_sample = current_cycle * sound_samples_per_frame / sound_cycles_per_frame;
 
-    switch (channel) {
-        case SAMPLER_CHANNEL_1:
-            old_sample = (uint8_t)((stream_buffer[frame_sample * 2] >> 8) + 0x80);
-            break;
-        case SAMPLER_CHANNEL_2:
-            old_sample = (uint8_t)((stream_buffer[(frame_sample * 2) + 1] >> 8) + 0x80);
-            break;
-        case SAMPLER_CHANNEL_DEFAULT:
-        default:
-            old_sample = (uint8_t)((stream_buffer[frame_sample] >> 8) + 0x80);
-            break;
+    if (sampler_stream_read(samples, (uint64_t)pos, channel, &sample)) {
+        old_sample[index] = sample;
     }
 
-    return old_sample;
+    return old_sample[index];
 }
 
 static void portaudio_shutdown(void)
@@ -0,0 +1,280 @@
+/** \file   sampler_stream.c
+ * \brief   Ring buffer between a sampler input and the emulation
+ *
+ * Samples are stored as unsigned 8 bit values, one ring per channel, and are
+ * addressed by their position in the input, counted from the start of
+ * sampling. The producer (a reader thread, or an audio callback) appends at
+ * the end, the emulation reads at the position that belongs to the current
+ * clock.
+ *
+ * The producer stays at most half a ring ahead of the furthest position read,
+ * so the other half keeps the samples just read. Going back a few frames, as
+ * run-ahead does every frame, is served from the ring. For a jump further
+ * away the consumer requests a seek, and the producer starts over at the new
+ * position.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <string.h>
+
+#ifdef USE_VICE_THREAD
+#include <stdatomic.h>
+#endif
+
+#include "lib.h"
+#include "sampler.h"
+#include "sampler_stream.h"
+#include "types.h"
+
+/* samples per channel, must be a power of two */
+#define SAMPLER_STREAM_SIZE     16384
+#define SAMPLER_STREAM_MASK     (SAMPLER_STREAM_SIZE - 1)
+
+/* how far the producer may get ahead of the furthest position read */
+#define SAMPLER_STREAM_AHEAD    (SAMPLER_STREAM_SIZE / 2)
+
+/* how far behind the furthest position read the samples are kept */
+#define SAMPLER_STREAM_HISTORY  (SAMPLER_STREAM_SIZE - SAMPLER_STREAM_AHEAD)
+
+#ifdef USE_VICE_THREAD
+
+typedef atomic_uint sampler_stream_shared_t;
+typedef atomic_uint_least64_t sampler_stream_pos_t;
+
+#define RING_LOAD(i)        atomic_load_explicit(&(i), memory_order_acquire)
+#define RING_STORE(i, v)    atomic_store_explicit(&(i), (v), memory_order_release)
+
+#else
+
+typedef unsigned int sampler_stream_shared_t;
+typedef uint64_t sampler_stream_pos_t;
+
+#define RING_LOAD(i)        (i)
+#define RING_STORE(i, v)    ((i) = (v))
+
+#endif
+
+struct sampler_stream_s {
+    uint8_t buffer[2][SAMPLER_STREAM_SIZE];
+
+    /* written by the producer */
+    sampler_stream_pos_t end;
+    sampler_stream_shared_t seek_done;
+
+    /* written by the consumer */
+    sampler_stream_pos_t want;
+    sampler_stream_pos_t seek_pos;
+    sampler_stream_shared_t seek_request;
+
+    /* consumer only: the furthest position read and where the current run of
+       samples starts */
+    uint64_t read_max;
+    uint64_t read_start;
+    unsigned int request;
+
+    /* producer only */
+    uint64_t write_pos;
+    unsigned int pending;
+};
+
+/** \brief  Create an empty stream, starting at position 0
+ *
+ * \return  new stream
+ */
+sampler_stream_t *sampler_stream_new(void)
+{
+    sampler_stream_t *stream = lib_malloc(sizeof(sampler_stream_t));
+
+    memset(stream->buffer, 0x80, sizeof(stream->buffer));
+    RING_STORE(stream->end, 0);
+    RING_STORE(stream->seek_done, 0);
+    RING_STORE(stream->want, 0);
+    RING_STORE(stream->seek_pos, 0);
+    RING_STORE(stream->seek_request, 0);
+    stream->read_max = 0;
+    stream->read_start = 0;
+    stream->request = 0;
+    stream->write_pos = 0;
+    stream->pending = 0;
+
+    return stream;
+}
+
+/** \brief  Free a stream, the producer must have stopped
+ *
+ * \param[in]   stream  stream
+ */
+void sampler_stream_free(sampler_stream_t *stream)
+{
+    lib_free(stream);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/** \brief  Check if the consumer wants the producer to start over
+ *
+ * \param[in]   stream  stream
+ * \param[out]  pos     position to continue at
+ *
+ * \return  1 if the producer has to call sampler_stream_restart()
+ */
+int sampler_stream_seek_pending(sampler_stream_t *stream, uint64_t *pos)
+{
+    unsigned int request = RING_LOAD(stream->seek_request);
+
+    if (request == RING_LOAD(stream->seek_done)) {
+        return 0;
+    }
+    stream->pending = request;
+    *pos = RING_LOAD(stream->seek_pos);
+    return 1;
+}
+
+/** \brief  Drop everything written and continue at a new position
+ *
+ * \param[in]   stream  stream
+ * \param[in]   pos     position of the next sample written
+ */
+void sampler_stream_restart(sampler_stream_t *stream, uint64_t pos)
+{
+    stream->write_pos = pos;
+    RING_STORE(stream->end, pos);
+    RING_STORE(stream->seek_done, stream->pending);
+}
+
+/** \brief  Get the number of samples the producer may write now
+ *
+ * \param[in]   stream  stream
+ *
+ * \return  number of samples
+ */
+unsigned int sampler_stream_space(sampler_stream_t *stream)
+{
+    uint64_t limit = RING_LOAD(stream->want) + SAMPLER_STREAM_AHEAD;
+
+    if (limit <= stream->write_pos) {
+        return 0;
+    }
+    return (unsigned int)(limit - stream->write_pos);
+}
+
+/** \brief  Append samples to the stream
+ *
+ * \param[in]   stream  stream
+ * \param[in]   left    samples of channel 1
+ * \param[in]   right   samples of channel 2, NULL to use channel 1
+ * \param[in]   count   number of samples, at most sampler_stream_space()
+ */
+void sampler_stream_write(sampler_stream_t *stream, const uint8_t *left, const uint8_t *right, unsigned int count)
+{
+    unsigned int index = (unsigned int)(stream->write_pos & SAMPLER_STREAM_MASK);
+    unsigned int first = SAMPLER_STREAM_SIZE - index;
+
+    if (right == NULL) {
+        right = left;
+    }
+    if (first > count) {
+        first = count;
+    }
+
+    memcpy(stream->buffer[0] + index, left, first);
+    memcpy(stream->buffer[1] + index, right, first);
+    memcpy(stream->buffer[0], left + first, count - first);
+    memcpy(stream->buffer[1], right + first, count - first);
+
+    stream->write_pos += count;
+    RING_STORE(stream->end, stream->write_pos);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/** \brief  Read a sample
+ *
+ * \param[in]   stream  stream
+ * \param[in]   pos     position of the sample
+ * \param[in]   channel SAMPLER_CHANNEL_2 for channel 2, channel 1 otherwise
+ * \param[out]  sample  the sample
+ *
+ * \return  1 if the sample was available, 0 if not (yet)
+ */
+int sampler_stream_read(sampler_stream_t *stream, uint64_t pos, int channel, uint8_t *sample)
+{
+    if (RING_LOAD(stream->seek_done) != stream->request
+        || pos < stream->read_start
+        || pos + SAMPLER_STREAM_HISTORY < stream->read_max
+        || pos >= RING_LOAD(stream->end)) {
+        return 0;
+    }
+
+    /* the producer may only overwrite samples that are out of reach now */
+    if (pos > stream->read_max) {
+        stream->read_max = pos;
+        RING_STORE(stream->want, pos);
+    }
+
+    *sample = stream->buffer[channel == SAMPLER_CHANNEL_2][pos & SAMPLER_STREAM_MASK];
+    return 1;
+}
+
+/** \brief  Check if a sample will become available without a seek
+ *
+ * \param[in]   stream  stream
+ * \param[in]   pos     position of the sample
+ *
+ * \return  1 if the producer will get there, 0 if a seek is needed
+ */
+int sampler_stream_reachable(sampler_stream_t *stream, uint64_t pos)
+{
+    return pos >= stream->read_start
+           && pos + SAMPLER_STREAM_HISTORY >= stream->read_max
+           && pos < stream->read_max + SAMPLER_STREAM_AHEAD;
+}
+
+/** \brief  Ask the producer to continue at a new position
+ *
+ * \param[in]   stream  stream
+ * \param[in]   pos     position
+ */
+void sampler_stream_seek(sampler_stream_t *stream, uint64_t pos)
+{
+    stream->read_max = pos;
+    stream->read_start = pos;
+    stream->request++;
+
+    RING_STORE(stream->want, pos);
+    RING_STORE(stream->seek_pos, pos);
+    RING_STORE(stream->seek_request, stream->request);
+}
+
+/** \brief  Get the position after the last sample written
+ *
+ * \param[in]   stream  stream
+ *
+ * \return  position
+ */
+uint64_t sampler_stream_end(sampler_stream_t *stream)
+{
+    return RING_LOAD(stream->end);
+}
@@ -0,0 +1,48 @@
+/** \file   sampler_stream.h
+ * \brief   Ring buffer between a sampler input and the emulation - header
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_SAMPLER_STREAM_H
+#define VICE_SAMPLER_STREAM_H
+
+#include "types.h"
+
+typedef struct sampler_stream_s sampler_stream_t;
+
+sampler_stream_t *sampler_stream_new(void);
+void sampler_stream_free(sampler_stream_t *stream);
+
+/* producer side */
+int sampler_stream_seek_pending(sampler_stream_t *stream, uint64_t *pos);
+void sampler_stream_restart(sampler_stream_t *stream, uint64_t pos);
+unsigned int sampler_stream_space(sampler_stream_t *stream);
+void sampler_stream_write(sampler_stream_t *stream, const uint8_t *left, const uint8_t *right, unsigned int count);
+
+/* consumer side */
+int sampler_stream_read(sampler_stream_t *stream, uint64_t pos, int channel, uint8_t *sample);
+int sampler_stream_reachable(sampler_stream_t *stream, uint64_t pos);
+void sampler_stream_seek(sampler_stream_t *stream, uint64_t pos);
+uint64_t sampler_stream_end(sampler_stream_t *stream);
+
+#endif
@@ -192,6 +192,7 @@ static const trap_t scpu64_serial_traps[] = {
     { "SerialSaListen", 0xED37, 0xEDAB, { 0x20, 0x8E, 0xEE }, serial_trap_attention, scpu64_trap_read, scpu64_trap_store },
     { "SerialSendByte", 0xED41, 0xEDAB, { 0x20, 0x97, 0xEE }, serial_trap_send, scpu64_trap_read, scpu64_trap_store },
     { "SerialReceiveByte", 0xEE14, 0xEDAB, { 0xA9, 0x00, 0x85 }, serial_trap_receive, scpu64_trap_read, scpu64_trap_store },
+    { "SerialLoad", 0xF4F3, 0xF528, { 0xA9, 0xFD, 0x25 }, serial_trap_load, scpu64_trap_read, scpu64_trap_store },
     { "SerialReady", 0xEEA9, 0xEDAB, { 0xAD, 0x00, 0xDD }, serial_trap_ready, scpu64_trap_read, scpu64_trap_store },
     { NULL, 0, 0, { 0, 0, 0 }, NULL, NULL, NULL }
 };
@@ -816,7 +817,7 @@ int machine_specific_init(void)
         return -1;
     }
 
-    serial_trap_init(0xa4);
+    serial_trap_init(0xa4, 0xae);
     serial_iec_bus_init();
 
     /* Initialize RS232 handler.  */
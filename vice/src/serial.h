@@ -82,10 +82,11 @@ void serial_shutdown(void);
 int serial_install_traps(void);
 int serial_remove_traps(void);
 
-void serial_trap_init(uint16_t tmpin);
+void serial_trap_init(uint16_t tmpin, uint16_t loadptr);
 int serial_trap_attention(void);
 int serial_trap_send(void);
 int serial_trap_receive(void);
+int serial_trap_load(void);
 int serial_trap_ready(void);
 void serial_traps_reset(void);
 void serial_trap_eof_callback_set(void (*func)(void));
@@ -74,6 +74,9 @@ extern int traps_enabled_device[MAX_DEVICES]; /* FIXME */
 /* Address of serial TMP register.  */
 static uint16_t tmp_in;
 
+/* Address of the pointer used by the Kernal LOAD loop.  */
+static uint16_t load_ptr;
+
 /* On which channel did listen happen to?  */
 static uint8_t TrapDevice;
 static uint8_t TrapSecondary;
@@ -275,6 +278,63 @@ int serial_trap_receive(void)
 }
 
 
+/* Receive the remainder of a file in the Kernal LOAD loop.  Instead of
+   running the loop (STOP check, IECIN, STA (ptr),Y, increment pointer) once
+   per byte, all bytes are read until EOF and stored to memory directly.
+   VERIFY is left to the Kernal, as is a timeout, which the loop retries.  */
+int serial_trap_load(void)
+{
+    uint16_t addr;
+    uint8_t data = 0;
+    uint8_t st;
+
+    if (!device_uses_serial_traps(ActiveDevice)) {
+        DBG(("serial_trap_load aborted (dev %d) no traps", ActiveDevice));
+        return 0;
+    }
+
+    /* VERIFY flag */
+    if (mem_read(0x93) != 0) {
+        return 0;
+    }
+
+    DBG(("serial_trap_load (TrapDevice 0x%02x)", TrapDevice));
+
+    if (TrapSecondary == 0) {
+        send_listen_talk_secondary(SECONDARY + 0);
+    }
+
+    addr = (uint16_t)(mem_read(load_ptr) | (mem_read((uint16_t)(load_ptr + 1)) << 8));
+
+    do {
+        st = serial_get_st() & 0xfd;
+        mem_store((uint16_t)0x90, st);
+        data = serial_iec_bus_read(TrapDevice, TrapSecondary, serial_set_st);
+        st = serial_get_st();
+        if (st & 0x02) {
+            /* timeout, let the Kernal loop handle it */
+            mem_store(load_ptr, (uint8_t)(addr & 0xff));
+            mem_store((uint16_t)(load_ptr + 1), (uint8_t)(addr >> 8));
+            return 0;
+        }
+        mem_store(addr, data);
+        addr++;
+    } while (!(st & 0x40));
+
+    mem_store(tmp_in, data);
+    mem_store(load_ptr, (uint8_t)(addr & 0xff));
+    mem_store((uint16_t)(load_ptr + 1), (uint8_t)(addr >> 8));
+
+    if (eof_callback_func != NULL) {
+        eof_callback_func();
+    }
+
+    maincpu_set_carry(0);
+    maincpu_set_interrupt(0);
+
+    return 1;
+}
+
 /* Kernal loops serial-port (0xdd00) to see when serial is ready: fake it.
    EEA9 Get serial data and clk in (TKSA subroutine).  */
 
@@ -306,11 +366,12 @@ int serial_cmdline_options_init(void)
     return serial_iec_device_cmdline_options_init();
 }
 
-void serial_trap_init(uint16_t tmpin)
+void serial_trap_init(uint16_t tmpin, uint16_t loadptr)
 {
     serial_iec_device_init();
 
     tmp_in = tmpin;
+    load_ptr = loadptr;
 }
 
 /* FIXME: bad name, this function is basically the main/top entry point for
@@ -59,6 +59,27 @@ static void set_sid_engine_with_fallback(int engine)
 
 static int intended_sid_engine = -1;
 
+/* Tell if the sound settings of a snapshot differ from the ones in use, model
+   is -1 for snapshots without it */
+static int sid_snapshot_settings_differ(int sids, int sound, int engine, int model)
+{
+    int value;
+
+    if (resources_get_int("SidStereo", &value) < 0 || value != sids) {
+        return 1;
+    }
+    if (resources_get_int("Sound", &value) < 0 || value != sound) {
+        return 1;
+    }
+    if (resources_get_int("SidEngine", &value) < 0 || value != engine) {
+        return 1;
+    }
+    if (model >= 0 && (resources_get_int("SidModel", &value) < 0 || value != model)) {
+        return 1;
+    }
+    return 0;
+}
+
 /* ---------------------------------------------------------------------*/
 
 /* SID snapshot module format:
@@ -235,6 +256,7 @@ static int sid_snapshot_read_module_simple(snapshot_t *s, int sidnr)
     const char *snap_module_name_simple = NULL;
     int sids = 0;
     int sid_address;
+    int reopen = 1;
 
     switch (sidnr) {
         default:
@@ -279,29 +301,34 @@ static int sid_snapshot_read_module_simple(snapshot_t *s, int sidnr)
     /* Handle 1.3+ snapshots differently */
     if (!snapshot_version_is_smaller(major_version, minor_version, 1, 3)) {
         if (sidnr == 0) {
-            if (SMR_B_INT(m, &sids) < 0) {
-                goto fail;
-            }
-            resources_set_int("SidStereo", sids);
+            int has_model = !snapshot_version_is_smaller(major_version, minor_version, 1, 4);
+
             if (0
+                || SMR_B_INT(m, &sids) < 0
                 || SMR_B(m, &tmp[0]) < 0
-                || SMR_B(m, &tmp[1]) < 0) {
+                || SMR_B(m, &tmp[1]) < 0
+                || (has_model && SMR_B(m, &tmp[34]) < 0)) {
                 goto fail;
             }
-            screenshot_prepare_reopen();
-            sound_close();
-            screenshot_try_reopen();
-            resources_set_int("Sound", (int)tmp[0]);
-
             intended_sid_engine = tmp[1];
-            set_sid_engine_with_fallback(tmp[1]);
 
-            if (!snapshot_version_is_smaller(major_version, minor_version, 1, 4)) {
-                if (0
-                    || SMR_B(m, &tmp[0]) < 0) {
-                    goto fail;
+            /* snapshots taken and restored many times a second (run-ahead,
+               netplay rollback) have the settings in use, do not reopen the
+               sound device for them */
+            if (sid_snapshot_settings_differ(sids, tmp[0], tmp[1], has_model ? tmp[34] : -1)) {
+                resources_set_int("SidStereo", sids);
+                screenshot_prepare_reopen();
+                sound_close();
+                screenshot_try_reopen();
+                resources_set_int("Sound", (int)tmp[0]);
+
+                set_sid_engine_with_fallback(tmp[1]);
+
+                if (has_model) {
+                    resources_set_int("SidModel", (int)tmp[34]);
                 }
-                resources_set_int("SidModel", (int)tmp[0]);
+            } else {
+                reopen = 0;
             }
         } else {
             if (SMR_W_INT(m, &sid_address) < 0) {
@@ -316,7 +343,9 @@ static int sid_snapshot_read_module_simple(snapshot_t *s, int sidnr)
             goto fail;
         }
         memcpy(sid_get_siddata(sidnr), &tmp[2], 32);
-        sound_open();
+        if (reopen) {
+            sound_open();
+        }
         return snapshot_module_close(m);
     }
 
@@ -61,6 +61,15 @@ static char *current_machine_name = NULL;
 static char *current_filename = NULL;
 static size_t current_fpos = 0;
 
+/* memory buffer the next snapshot is written to/read from, NULL for files */
+static snapshot_memory_t *current_memory = NULL;
+
+#ifdef HAVE_OPEN_MEMSTREAM
+/* open_memstream() buffer of the memory snapshot being written */
+static char *memory_stream_buffer = NULL;
+static size_t memory_stream_size = 0;
+#endif
+
 static const char snapshot_magic_string[] = "VICE Snapshot File\032";
 static const char snapshot_version_magic_string[] = "VICE Version\032";
 
@@ -93,6 +102,9 @@ struct snapshot_s {
 
     /* Flag: are we writing it?  */
     int write_mode;
+
+    /* Memory buffer backing the snapshot, NULL for real files.  */
+    snapshot_memory_t *memory;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -798,6 +810,97 @@ int snapshot_module_close(snapshot_module_t *m)
 
 /* ------------------------------------------------------------------------- */
 
+/* Snapshots in memory are used where a snapshot is taken and restored many
+   times a second (netplay rollback) and must not touch the file system.
+   Without open_memstream()/fmemopen() an anonymous tmpfile() is used.  */
+
+void snapshot_memory_select(snapshot_memory_t *mem)
+{
+    current_memory = mem;
+}
+
+void snapshot_memory_free(snapshot_memory_t *mem)
+{
+    lib_free(mem->data);
+    mem->data = NULL;
+    mem->size = 0;
+    mem->alloc = 0;
+}
+
+static FILE *snapshot_memory_fopen(snapshot_memory_t *mem)
+{
+    FILE *f;
+
+    if (mem->data == NULL || mem->size == 0) {
+        return NULL;
+    }
+#ifdef HAVE_FMEMOPEN
+    f = fmemopen(mem->data, mem->size, MODE_READ);
+#else
+    f = tmpfile();
+    if (f != NULL) {
+        if (fwrite(mem->data, 1, mem->size, f) != mem->size) {
+            fclose(f);
+            return NULL;
+        }
+        rewind(f);
+    }
+#endif
+    return f;
+}
+
+/* Close a memory snapshot; when writing, the data ends up in s->memory.  */
+static int snapshot_memory_fclose(snapshot_t *s)
+{
+    snapshot_memory_t *mem = s->memory;
+    int retval = 0;
+
+    if (!s->write_mode) {
+        fclose(s->file);
+        return 0;
+    }
+
+#ifdef HAVE_OPEN_MEMSTREAM
+    /* the buffer and size are only final after the stream is closed */
+    if (fclose(s->file) == EOF) {
+        snapshot_error = SNAPSHOT_WRITE_CLOSE_EOF_ERROR;
+        retval = -1;
+    } else {
+        if (memory_stream_size > mem->alloc) {
+            mem->data = lib_realloc(mem->data, memory_stream_size);
+            mem->alloc = memory_stream_size;
+        }
+        memcpy(mem->data, memory_stream_buffer, memory_stream_size);
+        mem->size = memory_stream_size;
+    }
+    free(memory_stream_buffer);
+    memory_stream_buffer = NULL;
+#else
+    {
+        long size;
+
+        fseek(s->file, 0, SEEK_END);
+        size = ftell(s->file);
+        rewind(s->file);
+        if (size < 0) {
+            size = 0;
+        }
+        if ((size_t)size > mem->alloc) {
+            mem->data = lib_realloc(mem->data, (size_t)size);
+            mem->alloc = (size_t)size;
+        }
+        if (fread(mem->data, 1, (size_t)size, s->file) != (size_t)size) {
+            snapshot_error = SNAPSHOT_WRITE_CLOSE_EOF_ERROR;
+            retval = -1;
+            size = 0;
+        }
+        mem->size = (size_t)size;
+        fclose(s->file);
+    }
+#endif
+    return retval;
+}
+
 snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t minor_version, const char *snapshot_machine_name)
 {
     FILE *f;
@@ -806,7 +909,15 @@ snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t
 
     current_filename = (char *)filename;
 
-    f = fopen(filename, MODE_WRITE);
+    if (current_memory != NULL) {
+#ifdef HAVE_OPEN_MEMSTREAM
+        f = open_memstream(&memory_stream_buffer, &memory_stream_size);
+#else
+        f = tmpfile();
+#endif
+    } else {
+        f = fopen(filename, MODE_WRITE);
+    }
     if (f == NULL) {
         snapshot_error = SNAPSHOT_CANNOT_CREATE_SNAPSHOT_ERROR;
         return NULL;
@@ -854,12 +965,20 @@ snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t
     s->file = f;
     s->first_module_offset = ftell(f);
     s->write_mode = 1;
+    s->memory = current_memory;
 
     return s;
 
 fail:
     fclose(f);
-    archdep_remove(filename);
+    if (current_memory != NULL) {
+#ifdef HAVE_OPEN_MEMSTREAM
+        free(memory_stream_buffer);
+        memory_stream_buffer = NULL;
+#endif
+    } else {
+        archdep_remove(filename);
+    }
     return NULL;
 }
 
@@ -879,7 +998,11 @@ snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, u
     current_filename = (char *)filename;
     current_module = NULL;
 
-    f = zfile_fopen(filename, MODE_READ);
+    if (current_memory != NULL) {
+        f = snapshot_memory_fopen(current_memory);
+    } else {
+        f = zfile_fopen(filename, MODE_READ);
+    }
     if (f == NULL) {
         snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
         return NULL;
@@ -940,8 +1063,12 @@ snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, u
     s->file = f;
     s->first_module_offset = ftell(f);
     s->write_mode = 0;
+    s->memory = current_memory;
 
-    vsync_suspend_speed_eval();
+    /* restoring a snapshot from memory is quick and must not upset pacing */
+    if (current_memory == NULL) {
+        vsync_suspend_speed_eval();
+    }
     return s;
 
 fail:
@@ -953,7 +1080,9 @@ int snapshot_close(snapshot_t *s)
 {
     int retval;
 
-    if (!s->write_mode) {
+    if (s->memory != NULL) {
+        retval = snapshot_memory_fclose(s);
+    } else if (!s->write_mode) {
         if (zfile_fclose(s->file) == EOF) {
             snapshot_error = SNAPSHOT_READ_CLOSE_EOF_ERROR;
             retval = -1;
@@ -68,6 +68,13 @@
 typedef struct snapshot_module_s snapshot_module_t;
 typedef struct snapshot_s snapshot_t;
 
+/* Snapshot kept in memory instead of a file, see snapshot_memory_select().  */
+typedef struct snapshot_memory_s {
+    uint8_t *data;      /* snapshot contents */
+    size_t size;        /* size of the snapshot in bytes */
+    size_t alloc;       /* allocated size of data */
+} snapshot_memory_t;
+
 void snapshot_display_error(void);
 
 int snapshot_module_write_byte(snapshot_module_t *m, uint8_t data);
@@ -136,6 +143,11 @@ snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t
 snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, uint8_t *minor_version_return, const char *snapshot_machine_name);
 int snapshot_close(snapshot_t *s);
 
+/* Redirect snapshot_create()/snapshot_open() to a memory buffer, the file
+   name is ignored while set. Pass NULL to go back to files.  */
+void snapshot_memory_select(snapshot_memory_t *mem);
+void snapshot_memory_free(snapshot_memory_t *mem);
+
 void snapshot_set_error(int error);
 int snapshot_get_error(void);
 
@@ -524,6 +524,203 @@ vice_network_socket_t * vice_network_client(const vice_network_socket_address_t
     return sockfd == INVALID_SOCKET ? NULL : vice_network_alloc_new_socket(sockfd);
 }
 
+/*! \brief Open a datagram socket and bind it to a local address
+
+  \param local_address
+     The local address to bind to.
+
+  \return
+     0 on error;
+     else, a handle to the socket on success.
+
+  \remark
+     The socket receives from anyone until it is connected to its
+     peer with vice_network_datagram_accept().
+*/
+vice_network_socket_t *vice_network_datagram_server(const vice_network_socket_address_t * local_address)
+{
+#if defined(SO_REUSEADDR)
+    const int so_setting = 1;
+#endif
+    int sockfd = INVALID_SOCKET;
+    int error = 1;
+    int err;
+
+    assert(local_address != NULL);
+
+    do {
+        if (socket_init() < 0) {
+            break;
+        }
+
+        sockfd = (int)socket(local_address->domain, SOCK_DGRAM, 0);
+        if (sockfd == INVALID_SOCKET) {
+            err = errno;
+            log_error(LOG_DEFAULT,
+                "vice_network_datagram_server(): socket() returned INVALID_SOCKET: %s",
+                strerror(err));
+            break;
+        }
+
+#if defined(SO_REUSEADDR)
+        setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, (const void*)&so_setting, sizeof(so_setting));
+#endif
+
+        if (bind(sockfd, &local_address->address.generic, local_address->len) < 0) {
+            err = errno;
+            log_error(LOG_DEFAULT,
+                "vice_network_datagram_server(): bind() failed: %s",
+                strerror(err));
+            break;
+        }
+        error = 0;
+    } while (0);
+
+    if (error) {
+        if (sockfd != INVALID_SOCKET) {
+            closesocket(sockfd);
+        }
+        sockfd = INVALID_SOCKET;
+    }
+
+    return sockfd == INVALID_SOCKET ? NULL : vice_network_alloc_new_socket(sockfd);
+}
+
+/*! \brief Open a datagram socket connected to a remote address
+
+  \param server_address
+     The address datagrams are sent to and accepted from.
+
+  \return
+     0 on error;
+     else, a handle to the socket on success.
+*/
+vice_network_socket_t *vice_network_datagram_client(const vice_network_socket_address_t * server_address)
+{
+    int sockfd = INVALID_SOCKET;
+    int error = 1;
+
+    assert(server_address != NULL);
+
+    do {
+        if (socket_init() < 0) {
+            break;
+        }
+
+        sockfd = (int)socket(server_address->domain, SOCK_DGRAM, 0);
+        if (sockfd == INVALID_SOCKET) {
+            break;
+        }
+
+        if (connect(sockfd, &server_address->address.generic, server_address->len) < 0) {
+            break;
+        }
+        error = 0;
+    } while (0);
+
+    if (error) {
+        if (sockfd != INVALID_SOCKET) {
+            closesocket(sockfd);
+        }
+        sockfd = INVALID_SOCKET;
+    }
+
+    return sockfd == INVALID_SOCKET ? NULL : vice_network_alloc_new_socket(sockfd);
+}
+
+/*! \internal \brief Check if two socket addresses belong to the same host
+
+  \return
+     1 if the hosts are the same, 0 else. The ports are not compared.
+*/
+static int socket_address_same_host(const union socket_addresses_u * a, const union socket_addresses_u * b)
+{
+    if (a->generic.sa_family != b->generic.sa_family) {
+        return 0;
+    }
+
+    switch (a->generic.sa_family) {
+        case AF_INET:
+            return a->ipv4.sin_addr.s_addr == b->ipv4.sin_addr.s_addr;
+#ifdef HAVE_IPV6
+        case AF_INET6:
+            return memcmp(&a->ipv6.sin6_addr, &b->ipv6.sin6_addr, sizeof a->ipv6.sin6_addr) == 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+/*! \brief Wait for a hello datagram from a peer and connect to its sender
+
+  \param sockfd
+     The socket that has been opened with vice_network_datagram_server()
+
+  \param peer
+     A connected stream socket. Only datagrams coming from the same host
+     are accepted.
+
+  \param hello
+     The bytes an accepted datagram has to start with.
+
+  \param hello_length
+     The number of bytes in hello.
+
+  \param timeout_ms
+     How long to wait for a datagram, in milliseconds.
+
+  \return
+     0 on success, -1 on timeout or error.
+
+  \remark
+     Datagrams from other hosts, and ones that do not start with the hello,
+     are dropped. The accepted datagram is consumed. Afterwards, only
+     datagrams from the same sender are received and vice_network_send()
+     can be used.
+*/
+int vice_network_datagram_accept(vice_network_socket_t * sockfd, vice_network_socket_t * peer,
+                                 const void * hello, size_t hello_length, unsigned int timeout_ms)
+{
+    vice_network_socket_address_t peer_address;
+    char buffer[64];
+    ssize_t received;
+    tick_t start = tick_now();
+    unsigned int elapsed_ms;
+
+    if (hello_length > sizeof buffer) {
+        return -1;
+    }
+
+    initialize_socket_address(&peer_address);
+    if (getpeername(peer->sockfd, &peer_address.address.generic, &peer_address.len) < 0) {
+        return -1;
+    }
+
+    for (;;) {
+        elapsed_ms = (unsigned int)(TICK_TO_MICRO(tick_now_delta(start)) / 1000);
+        if (elapsed_ms >= timeout_ms
+            || vice_network_select_wait_one(sockfd, timeout_ms - elapsed_ms) <= 0) {
+            return -1;
+        }
+
+        initialize_socket_address(&sockfd->address);
+
+        received = recvfrom(sockfd->sockfd, buffer, sizeof buffer, 0,
+                            &sockfd->address.address.generic, &sockfd->address.len);
+        if (received >= (ssize_t)hello_length
+            && memcmp(buffer, hello, hello_length) == 0
+            && socket_address_same_host(&sockfd->address.address, &peer_address.address)) {
+            break;
+        }
+    }
+
+    if (connect(sockfd->sockfd, &sockfd->address.address.generic, sockfd->address.len) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
 /*! \internal \brief Generate an IPv4 socket address
 
   Initialises a socket address with an IPv4 address.
@@ -1080,6 +1277,33 @@ int vice_network_select_poll_one(vice_network_socket_t * readsockfd)
     return select( readsockfd->sockfd + 1, &fdsockset, NULL, NULL, &timeout);
 }
 
+/*! \brief Wait until a socket has incoming data to receive
+
+  \param readsockfd
+     The socket to wait for
+
+  \param timeout_ms
+     The maximum time to wait, in milliseconds
+
+  \return
+     1 if the specified socket has data; 0 if no data arrived
+     in time, and -1 in case of an error.
+*/
+int vice_network_select_wait_one(vice_network_socket_t * readsockfd, unsigned int timeout_ms)
+{
+    TIMEVAL timeout;
+
+    fd_set fdsockset;
+
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    FD_ZERO(&fdsockset);
+    FD_SET(readsockfd->sockfd, &fdsockset);
+
+    return select( readsockfd->sockfd + 1, &fdsockset, NULL, NULL, &timeout);
+}
+
 /*! \brief Monitor multiple sockets
 
   This function blocks for many different connections and returns when any
@@ -1114,6 +1338,62 @@ int vice_network_select_multiple(vice_network_socket_t ** readsockfd)
     return select(max_sockfd + 1, &fdsockset, NULL, NULL, &time);
 }
 
+/*! \brief Wait until any of several sockets has incoming data
+
+  Unlike vice_network_select_multiple(), this tells which of the
+  sockets are ready and takes the timeout as parameter.
+
+  \param readsockfd
+     Array of the sockets to monitor
+
+  \param ready
+     Array of the same size; each entry is set to 1 if the socket
+     at the same index has data, and to 0 otherwise.
+
+  \param count
+     Number of sockets in the arrays
+
+  \param timeout_ms
+     The maximum time to wait, in milliseconds
+
+  \return
+     The number of sockets that have data; 0 if no data arrived
+     in time, and -1 in case of an error.
+*/
+int vice_network_select_wait_multiple(vice_network_socket_t ** readsockfd, int * ready,
+                                      int count, unsigned int timeout_ms)
+{
+    fd_set fdsockset;
+    SOCKET max_sockfd = INVALID_SOCKET;
+    TIMEVAL timeout;
+    int ret;
+    int i;
+
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    FD_ZERO(&fdsockset);
+    for (i = 0; i < count; i++) {
+        FD_SET(readsockfd[i]->sockfd, &fdsockset);
+        if (max_sockfd == INVALID_SOCKET || readsockfd[i]->sockfd > max_sockfd) {
+            max_sockfd = readsockfd[i]->sockfd;
+        }
+        ready[i] = 0;
+    }
+
+    if (max_sockfd == INVALID_SOCKET) {
+        return -1;
+    }
+
+    ret = select(max_sockfd + 1, &fdsockset, NULL, NULL, &timeout);
+    if (ret > 0) {
+        for (i = 0; i < count; i++) {
+            ready[i] = FD_ISSET(readsockfd[i]->sockfd, &fdsockset) ? 1 : 0;
+        }
+    }
+    return ret;
+}
+
 /*! \brief Get the error of the last socket operation
 
   This function determines the error code for the last
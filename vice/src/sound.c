@@ -51,6 +51,7 @@
 #include "mainlock.h"
 #include "monitor.h"
 #include "resources.h"
+#include "runahead.h"
 #include "sound.h"
 #include "types.h"
 #include "uiapi.h"
@@ -1105,7 +1106,8 @@ int sound_open(void)
     int channels_cap;
     int channels;
     const sound_device_t *pdev, *rdev;
-    char *playname, *recname;
+    const char *playname;
+    char *recname;
     char *playparam, *recparam;
     char *err;
     int speed;
@@ -1133,6 +1135,10 @@ int sound_open(void)
     if (playname && playname[0] == '\0') {
         playname = NULL;
     }
+    if (max_throughput_mode) {
+        /* keep emulating the sound chips, but output nothing */
+        playname = "dummy";
+    }
 
     playparam = device_arg;
     if (playparam && playparam[0] == '\0') {
@@ -1386,7 +1392,7 @@ static int sound_run_sound(void)
         }
     }
 
-    /* if "disable sound emulation on warp" is enabled, exit */
+    /* if "disable sound emulation on warp" is enabled, exit. */
     if ((sound_emulation_enabled_on_warp == 0) && warp_mode_enabled) {
         snddata.lastclk = maincpu_clk;
         return 0;
@@ -1448,7 +1454,11 @@ static int sound_run_sound(void)
          }
      }
 
-    snddata.bufptr += nr;
+    /* frames run ahead are undone again and must not be heard. the chips
+       are still clocked, programs may read OSC3/ENV3 */
+    if (!runahead_frame_ahead) {
+        snddata.bufptr += nr;
+    }
     snddata.lastclk = maincpu_clk;
 
     return 0;
@@ -1525,7 +1535,7 @@ bool sound_flush(void)
         sid_state_changed = FALSE;
     }
 
-    if (warp_mode_enabled && snddata.recdev == NULL) {
+    if ((warp_mode_enabled || max_throughput_mode) && snddata.recdev == NULL) {
         snddata.bufptr = 0;
         goto done;
     }
@@ -1639,6 +1649,18 @@ done:
     return !sound_is_timing_source;
 }
 
+/* Fraction of the device buffer that is filled with samples not played
+   yet, or -1.0 if the device cannot tell.  */
+double sound_get_buffer_fill(void)
+{
+    if (!sdev_open || !snddata.playdev || !snddata.playdev->bufferspace
+        || snddata.bufsize <= 0 || snddata.issuspended) {
+        return -1.0;
+    }
+
+    return 1.0 - (double)snddata.playdev->bufferspace() / snddata.bufsize;
+}
+
 /* suspend sid (eg. before pause) */
 void sound_suspend(void)
 {
@@ -1835,6 +1857,10 @@ void sound_snapshot_prepare(void)
 
 void sound_snapshot_finish(void)
 {
+    /* the clock may have gone back, and the sound device is only reopened
+       when the snapshot has other settings */
+    snddata.fclk = SOUNDCLK_CONSTANT(maincpu_clk);
+    snddata.wclk = maincpu_clk;
     snddata.lastclk = maincpu_clk;
 }
 
@@ -250,6 +250,7 @@ sound_desc_t *sound_get_valid_devices(int type, int sort);
 void sound_init(unsigned int clock_rate, unsigned int ticks_per_frame);
 void sound_reset(void);
 bool sound_flush(void);
+double sound_get_buffer_fill(void);
 void sound_suspend(void);
 void sound_resume(void);
 int sound_open(void);
@@ -58,6 +58,16 @@ static int tape_snapshot_write_t64image_module(snapshot_t *s)
 
 static int tape_snapshot_read_t64image_module(snapshot_t *s)
 {
+    uint8_t major_version, minor_version;
+    snapshot_module_t *m;
+
+    /* nothing to complain about if the snapshot has no T64 image */
+    m = snapshot_module_open(s, "T64IMAGE", &major_version, &minor_version);
+    if (m == NULL) {
+        return 0;
+    }
+    snapshot_module_close(m);
+
     log_error(tape_snapshot_log, "T64 snapshot support is not implemented");
     return 0; /* should be -1, but that would make snapshots with default settings fail */
 }
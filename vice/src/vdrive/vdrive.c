@@ -258,6 +258,35 @@ void vdrive_close_all_channels(vdrive_t *vdrive)
     }
 }
 
+/*
+ * Check if a channel that can write to the image is open: a file opened
+ * for writing or appending, a REL file, or a direct access buffer.
+ */
+
+int vdrive_write_channel_open(vdrive_t *vdrive)
+{
+    unsigned int i;
+    bufferinfo_t *p;
+
+    for (i = 0; i <= 15; i++) {
+        p = &(vdrive->buffers[i]);
+        switch (p->mode) {
+            case BUFFER_SEQUENTIAL:
+                if (p->readmode == CBMDOS_FAM_WRITE
+                    || p->readmode == CBMDOS_FAM_APPEND) {
+                    return 1;
+                }
+                break;
+            case BUFFER_RELATIVE:
+            case BUFFER_MEMORY_BUFFER:
+                return 1;
+            default:
+                break;
+        }
+    }
+    return 0;
+}
+
 /* ------------------------------------------------------------------------- */
 
 /*
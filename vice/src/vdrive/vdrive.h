@@ -235,6 +235,7 @@ void vdrive_device_shutdown(vdrive_t *vdrive);
 int vdrive_attach_image(struct disk_image_s *image, unsigned int unit, unsigned int drive, vdrive_t *vdrive);
 void vdrive_detach_image(struct disk_image_s *image, unsigned int unit, unsigned int drive, vdrive_t *vdrive);
 void vdrive_close_all_channels(vdrive_t *vdrive);
+int vdrive_write_channel_open(vdrive_t *vdrive);
 void vdrive_close_all_channels_partition(vdrive_t *vdrive, int part);
 int vdrive_get_max_sectors(vdrive_t *vdrive, unsigned int track);
 int vdrive_get_max_sectors_per_head(vdrive_t *vdrive, unsigned int track);
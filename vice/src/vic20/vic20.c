@@ -212,6 +212,15 @@ static const trap_t vic20_serial_traps[] = {
         vic20memrom_trap_read,
         vic20memrom_trap_store
     },
+    {
+        "SerialLoad",
+        0xF58A,
+        0xF5BF,
+        { 0xA9, 0xFD, 0x25 },
+        serial_trap_load,
+        vic20memrom_trap_read,
+        vic20memrom_trap_store
+    },
     {
         "SerialReady",
         0xE4B2,
@@ -925,7 +934,7 @@ int machine_specific_init(void)
         return -1;
     }
 
-    serial_trap_init(0xa4);
+    serial_trap_init(0xa4, 0xae);
     serial_iec_bus_init();
 
     /* Initialize RS232 handler.  */
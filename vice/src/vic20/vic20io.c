@@ -69,6 +69,14 @@ static io_source_list_t vic20io0_head = { NULL, NULL, NULL };
 static io_source_list_t vic20io2_head = { NULL, NULL, NULL };
 static io_source_list_t vic20io3_head = { NULL, NULL, NULL };
 
+/* per-address dispatch tables, one for each I/O range, see cartio.h */
+static io_source_t io_source_shared;
+#define IO_SOURCE_SHARED (&io_source_shared)
+
+static io_source_t *vic20io0_dispatch[0x400];
+static io_source_t *vic20io2_dispatch[0x400];
+static io_source_t *vic20io3_dispatch[0x400];
+
 static void io_source_detach(io_source_detach_t *source)
 {
     switch (source->det_id) {
@@ -277,15 +285,34 @@ static void io_source_log_collisions(uint16_t addr, int amount, io_source_list_t
 /* FIXME: the upper 4 bits of the mask are used to indicate the register size if not equal to the mask,
           this is done as a temporary HACK to keep mirrors working and still get the correct register size,
           this needs to be fixed properly after the 3.6 release */
-static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
+static inline uint8_t io_read(io_source_list_t *list, io_source_t **dispatch, uint16_t addr)
 {
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0x3ff];
     int io_source_counter = 0;
     uint8_t realval = 0;
     uint8_t retval = 0;
     uint8_t firstval = 0;
     unsigned int lowest_order = 0xffffffff;
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->read != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            retval = device->read((uint16_t)(addr & (device->address_mask & 0x3ff)));
+            if (device->io_source_valid) {
+                if (device->io_source_prio == 1) {
+                    return retval;
+                }
+                if (device->io_source_prio != -1) {
+                    vic20_cpu_last_data = retval;
+                }
+            }
+        }
+        vic20_mem_v_bus_read(addr);
+        return vic20_cpu_last_data;
+    }
+
     while (current) {
         if (current->device->read != NULL) {
             if ((addr >= current->device->start_address) && (addr <= current->device->end_address)) {
@@ -378,12 +405,23 @@ static inline uint8_t io_peek(io_source_list_t *list, uint16_t addr)
 /* FIXME: the upper 4 bits of the mask are used to indicate the register size if not equal to the mask,
           this is done as a temporary HACK to keep mirrors working and still get the correct register size,
           this needs to be fixed properly after the 3.6 release */
-static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value)
+static inline void io_store(io_source_list_t *list, io_source_t **dispatch, uint16_t addr, uint8_t value)
 {
     io_source_list_t *current = list->next;
+    io_source_t *device = dispatch[addr & 0x3ff];
 
     vic20_cpu_last_data = value;
 
+    /* fast path, at most one device responds to this address */
+    if (device != IO_SOURCE_SHARED) {
+        if ((device != NULL) && (device->store != NULL) &&
+            (addr >= device->start_address) && (addr <= device->end_address)) {
+            device->store((uint16_t)(addr & (device->address_mask & 0x3ff)), value);
+        }
+        vic20_mem_v_bus_store(addr);
+        return;
+    }
+
     while (current) {
         if (current->device->store != NULL) {
             if (addr >= current->device->start_address && addr <= current->device->end_address) {
@@ -397,6 +435,38 @@ static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value
 
 /* ---------------------------------------------------------------------------------------------------------- */
 
+static void io_source_dispatch_build(io_source_list_t *list, io_source_t **dispatch, unsigned int base)
+{
+    io_source_list_t *current = list->next;
+    unsigned int start;
+    unsigned int end;
+    unsigned int i;
+
+    memset(dispatch, 0, sizeof(io_source_t *) * 0x400);
+
+    while (current) {
+        start = current->device->start_address;
+        end = current->device->end_address;
+        if (start < base) {
+            start = base;
+        }
+        if (end > base + 0x3ff) {
+            end = base + 0x3ff;
+        }
+        for (i = start; i <= end; i++) {
+            dispatch[i - base] = dispatch[i - base] ? IO_SOURCE_SHARED : current->device;
+        }
+        current = current->next;
+    }
+}
+
+void io_source_dispatch_update(void)
+{
+    io_source_dispatch_build(&vic20io0_head, vic20io0_dispatch, 0x9000);
+    io_source_dispatch_build(&vic20io2_head, vic20io2_dispatch, 0x9800);
+    io_source_dispatch_build(&vic20io3_head, vic20io3_dispatch, 0x9c00);
+}
+
 io_source_list_t *io_source_register(io_source_t *device)
 {
     io_source_list_t *current = NULL;
@@ -433,6 +503,8 @@ io_source_list_t *io_source_register(io_source_t *device)
     retval->next = NULL;
     retval->device->order = order++;
 
+    io_source_dispatch_update();
+
     return retval;
 }
 
@@ -457,6 +529,8 @@ void io_source_unregister(io_source_list_t *device)
     }
 
     lib_free(device);
+
+    io_source_dispatch_update();
 }
 
 void cartio_shutdown(void)
@@ -492,7 +566,7 @@ void cartio_set_highest_order(unsigned int nr)
 uint8_t vic20io0_read(uint16_t addr)
 {
     DBGRW(("IO: io0 r %04x\n", addr));
-    return io_read(&vic20io0_head, addr);
+    return io_read(&vic20io0_head, vic20io0_dispatch, addr);
 }
 
 uint8_t vic20io0_peek(uint16_t addr)
@@ -504,13 +578,13 @@ uint8_t vic20io0_peek(uint16_t addr)
 void vic20io0_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io0 w %04x %02x\n", addr, value));
-    io_store(&vic20io0_head, addr, value);
+    io_store(&vic20io0_head, vic20io0_dispatch, addr, value);
 }
 
 uint8_t vic20io2_read(uint16_t addr)
 {
     DBGRW(("IO: io2 r %04x\n", addr));
-    return io_read(&vic20io2_head, addr);
+    return io_read(&vic20io2_head, vic20io2_dispatch, addr);
 }
 
 uint8_t vic20io2_peek(uint16_t addr)
@@ -522,13 +596,13 @@ uint8_t vic20io2_peek(uint16_t addr)
 void vic20io2_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io2 w %04x %02x\n", addr, value));
-    io_store(&vic20io2_head, addr, value);
+    io_store(&vic20io2_head, vic20io2_dispatch, addr, value);
 }
 
 uint8_t vic20io3_read(uint16_t addr)
 {
     DBGRW(("IO: io3 r %04x\n", addr));
-    return io_read(&vic20io3_head, addr);
+    return io_read(&vic20io3_head, vic20io3_dispatch, addr);
 }
 
 uint8_t vic20io3_peek(uint16_t addr)
@@ -540,7 +614,7 @@ uint8_t vic20io3_peek(uint16_t addr)
 void vic20io3_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io3 w %04x %02x\n", addr, value));
-    io_store(&vic20io3_head, addr, value);
+    io_store(&vic20io3_head, vic20io3_dispatch, addr, value);
 }
 
 /* ---------------------------------------------------------------------------------------------------------- */
@@ -39,6 +39,11 @@ typedef struct vice_network_socket_address_s vice_network_socket_address_t;
 vice_network_socket_t * vice_network_server(const vice_network_socket_address_t * server_address);
 vice_network_socket_t * vice_network_client(const vice_network_socket_address_t * server_address);
 
+vice_network_socket_t * vice_network_datagram_server(const vice_network_socket_address_t * local_address);
+vice_network_socket_t * vice_network_datagram_client(const vice_network_socket_address_t * server_address);
+int vice_network_datagram_accept(vice_network_socket_t * sockfd, vice_network_socket_t * peer,
+                                 const void * hello, size_t hello_length, unsigned int timeout_ms);
+
 vice_network_socket_address_t * vice_network_address_generate(const char * address, unsigned short port);
 void vice_network_address_close(vice_network_socket_address_t *);
 
@@ -50,7 +55,10 @@ ssize_t vice_network_send(vice_network_socket_t * sockfd, const void * buffer, s
 ssize_t vice_network_receive(vice_network_socket_t * sockfd, void * buffer, size_t buffer_length, int flags);
 
 int vice_network_select_poll_one(vice_network_socket_t * readsockfd);
+int vice_network_select_wait_one(vice_network_socket_t * readsockfd, unsigned int timeout_ms);
 int vice_network_select_multiple(vice_network_socket_t ** readsockfd);
+int vice_network_select_wait_multiple(vice_network_socket_t ** readsockfd, int * ready,
+                                      int count, unsigned int timeout_ms);
 
 int vice_network_get_errorcode(void);
 
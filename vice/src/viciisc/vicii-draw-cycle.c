@@ -141,7 +141,8 @@ static const uint8_t colors[] = {
     COL_NONE, COL_NONE, COL_NONE, COL_NONE          /* ECM=1 BMM=1 MCM=1 */
 };
 
-static DRAW_INLINE void draw_graphics(int i)
+/* With render == 0 only the priority bits needed for collisions are kept. */
+static DRAW_INLINE void draw_graphics(int i, int render)
 {
     uint8_t px;
     uint8_t cc;
@@ -192,8 +193,14 @@ static DRAW_INLINE void draw_graphics(int i)
     gbuf_mc_flop ^= 1;
 
     /* Determine pixel color and priority */
-    vmode = vmode11_pipe | vmode16_pipe;
     pixel_pri = (px & 0x2);
+    pri_buffer[i] = pixel_pri;
+
+    if (!render) {
+        return;
+    }
+
+    vmode = vmode11_pipe | vmode16_pipe;
     cc = colors[vmode | px];
 
     /* lookup colors and render pixel */
@@ -221,10 +228,9 @@ static DRAW_INLINE void draw_graphics(int i)
     }
 
     render_buffer[i] = cc;
-    pri_buffer[i] = pixel_pri;
 }
 
-static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags)
+static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags, int render)
 {
     int vis_en;
 
@@ -232,34 +238,34 @@ static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags)
 
     /* render pixels */
     /* pixel 0 */
-    draw_graphics(0);
+    draw_graphics(0, render);
     /* pixel 1 */
-    draw_graphics(1);
+    draw_graphics(1, render);
     /* pixel 2 */
-    draw_graphics(2);
+    draw_graphics(2, render);
     /* pixel 3 */
-    draw_graphics(3);
+    draw_graphics(3, render);
     /* pixel 4 */
     vmode16_pipe = ( vicii.regs[0x16] & 0x10 ) >> 2;
     if (vicii.color_latency) {
         /* handle rising edge of internal signal */
         vmode11_pipe |= ( vicii.regs[0x11] & 0x60 ) >> 2;
     }
-    draw_graphics(4);
+    draw_graphics(4, render);
     /* pixel 5 */
-    draw_graphics(5);
+    draw_graphics(5, render);
     /* pixel 6 */
     if (vicii.color_latency) {
         /* handle falling edge of internal signal */
         vmode11_pipe &= ( vicii.regs[0x11] & 0x60 ) >> 2;
     }
-    draw_graphics(6);
+    draw_graphics(6, render);
     /* pixel 7 */
     if (vmode16_pipe && !vmode16_pipe2) {
         gbuf_mc_flop = 0;
     }
     vmode16_pipe2 = vmode16_pipe;
-    draw_graphics(7);
+    draw_graphics(7, render);
 
     if (!vicii.color_latency) {
         vmode11_pipe = ( vicii.regs[0x11] & 0x60 ) >> 2;
@@ -339,7 +345,7 @@ static DRAW_INLINE void trigger_sprites(int xpos, uint8_t candidate_bits)
     }
 }
 
-static DRAW_INLINE void draw_sprites(int i)
+static DRAW_INLINE void draw_sprites(int i, int render)
 {
     int s;
     int active_sprite;
@@ -402,7 +408,7 @@ static DRAW_INLINE void draw_sprites(int i)
         uint8_t pixel_pri = pri_buffer[i];
         int as = active_sprite;
         uint8_t spri = sprite_pri_bits & (1 << as);
-        if (!(pixel_pri && spri)) {
+        if (render && !(pixel_pri && spri)) {
             switch (sbuf_pixel_reg[as]) {
                 case 1:
                     render_buffer[i] = COL_D025;
@@ -466,7 +472,7 @@ static DRAW_INLINE void update_sprite_xpos(void)
 
 
 
-static DRAW_INLINE void draw_sprites8(unsigned int cycle_flags)
+static DRAW_INLINE void draw_sprites8(unsigned int cycle_flags, int render)
 {
     uint8_t candidate_bits;
     uint8_t dma_cycle_0 = 0;
@@ -489,28 +495,28 @@ static DRAW_INLINE void draw_sprites8(unsigned int cycle_flags)
     /* process and render sprites */
     /* pixel 0 */
     trigger_sprites(xpos + 0, candidate_bits);
-    draw_sprites(0);
+    draw_sprites(0, render);
     /* pixel 1 */
     trigger_sprites(xpos + 1, candidate_bits);
-    draw_sprites(1);
+    draw_sprites(1, render);
     /* pixel 2 */
     sprite_active_bits &= ~dma_cycle_2;
     trigger_sprites(xpos + 2, candidate_bits);
-    draw_sprites(2);
+    draw_sprites(2, render);
     /* pixel 3 */
     sprite_halt_bits |= dma_cycle_0;
     trigger_sprites(xpos + 3, candidate_bits);
-    draw_sprites(3);
+    draw_sprites(3, render);
     /* pixel 4 */
     if (spr_en) {
         sprite_pending_bits = vicii.sprite_display_bits;
     }
     update_sprite_data(cycle_flags);
     trigger_sprites(xpos + 4, candidate_bits);
-    draw_sprites(4);
+    draw_sprites(4, render);
     /* pixel 5 */
     trigger_sprites(xpos + 5, candidate_bits);
-    draw_sprites(5);
+    draw_sprites(5, render);
     /* pixel 6 */
     if (!vicii.color_latency) {
         update_sprite_mc_bits_8565();
@@ -518,14 +524,14 @@ static DRAW_INLINE void draw_sprites8(unsigned int cycle_flags)
     sprite_pri_bits = vicii.regs[0x1b];
     sprite_expx_bits = vicii.regs[0x1d];
     trigger_sprites(xpos + 6, candidate_bits);
-    draw_sprites(6);
+    draw_sprites(6, render);
     /* pixel 7 */
     if (vicii.color_latency) {
         update_sprite_mc_bits_6569();
     }
     sprite_halt_bits &= ~dma_cycle_2;
     trigger_sprites(xpos + 7, candidate_bits);
-    draw_sprites(7);
+    draw_sprites(7, render);
 
     /* pipe xpos */
     update_sprite_xpos();
@@ -538,10 +544,15 @@ static DRAW_INLINE void draw_sprites8(unsigned int cycle_flags)
  *
  ******/
 
-static DRAW_INLINE void draw_border8(void)
+static DRAW_INLINE void draw_border8(int render)
 {
     uint8_t csel = vicii.regs[0x16] & 0x8;
 
+    if (!render) {
+        border_state = vicii.main_border;
+        return;
+    }
+
 #if 1
     /* early exit for the no border case */
     if (!(border_state || vicii.main_border)) {
@@ -623,7 +634,7 @@ static DRAW_INLINE void draw_colors_8565(int offs, int i)
     pixel_buffer[i] = render_buffer[i];
 }
 
-static DRAW_INLINE void draw_colors8(void)
+static DRAW_INLINE void draw_colors8(int render)
 {
     int offs = vicii.dbuf_offset;
 
@@ -637,6 +648,12 @@ static DRAW_INLINE void draw_colors8(void)
         cregs[last_color_reg] = last_color_value;
     }
 
+    if (!render) {
+        vicii.dbuf_offset += 8;
+        update_cregs();
+        return;
+    }
+
     /* render pixels */
     if (vicii.color_latency) {
         draw_colors_6569(offs, 0);
@@ -676,13 +693,22 @@ void vicii_draw_cycle(void)
         vicii.dbuf_offset = 0;
     }
 
-    draw_graphics8(cycle_flags_pipe);
-
-    draw_sprites8(cycle_flags_pipe);
-
-    draw_border8();
-
-    draw_colors8();
+    /*
+     * When the frame is not going to be shown, only the state that
+     * affects emulation (graphics sequencer, sprite sequencers and
+     * collisions) is kept up to date.
+     */
+    if (vicii.raster.skip_drawing) {
+        draw_graphics8(cycle_flags_pipe, 0);
+        draw_sprites8(cycle_flags_pipe, 0);
+        draw_border8(0);
+        draw_colors8(0);
+    } else {
+        draw_graphics8(cycle_flags_pipe, 1);
+        draw_sprites8(cycle_flags_pipe, 1);
+        draw_border8(1);
+        draw_colors8(1);
+    }
 
     cycle_flags_pipe = vicii.cycle_flags;
 }
@@ -212,6 +212,9 @@ static int init_raster(void)
     }
     raster_modes_set_idle_mode(raster->modes, VICII_DUMMY_MODE);
 
+    /* collisions are handled in vicii-draw-cycle.c, even without drawing */
+    raster->can_skip_drawing = 1;
+
     resources_touch("VICIIVideoCache");
 
     vicii_set_geometry();
@@ -44,6 +44,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef HAVE_LIMITS_H
 #include <limits.h>
@@ -52,18 +53,24 @@
 #include "archdep.h"
 #include "cmdline.h"
 #include "debug.h"
+#include "inputqueue.h"
 #include "joystick.h"
 #include "kbdbuf.h"
 #include "lib.h"
 #include "log.h"
 #include "maincpu.h"
 #include "machine.h"
+#include "mainchannel.h"
 #ifdef HAVE_NETWORK
 #include "monitor_network.h"
 #include "monitor_binary.h"
 #endif
 #include "network.h"
+#ifdef HAVE_RAWNET
+#include "rawnet.h"
+#endif
 #include "resources.h"
+#include "runahead.h"
 #include "sound.h"
 #include "types.h"
 #include "videoarch.h"
@@ -119,12 +126,43 @@ void vsync_on_vsync_do(vsync_callback_func_t callback_func, void *callback_param
     callback_queue->size++;
 }
 
+/* functions called at every sync point, to look for host events that are not
+   tied to the video frame */
+#define VSYNC_SYNC_HOOKS_MAX 4
+
+static void (*sync_hooks[VSYNC_SYNC_HOOKS_MAX])(void);
+static int sync_hooks_count;
+
+/** \brief Call hook at every sync point, every few milliseconds of host time
+ *
+ * Meant for drivers that wake up parts of the emulation when the host has
+ * something for them, so those do not have to poll.
+ */
+void vsync_add_sync_hook(void (*hook)(void))
+{
+    int i;
+
+    for (i = 0; i < sync_hooks_count; i++) {
+        if (sync_hooks[i] == hook) {
+            return;
+        }
+    }
+    if (sync_hooks_count == VSYNC_SYNC_HOOKS_MAX) {
+        log_error(LOG_DEFAULT, "vsync_add_sync_hook(): too many hooks.");
+        return;
+    }
+    sync_hooks[sync_hooks_count++] = hook;
+}
+
 /** \brief Keep executing on_vsync_do callbacks until none are scheduled. */
 static void execute_vsync_callbacks(void)
 {
     int i;
     callback_queue_t *executing_queue;
 
+    /* commands posted by the UI run at the same safe point */
+    mainchannel_process();
+
     while (callback_queue->size) {
 
         /* We'll iterate over this queue */
@@ -139,6 +177,9 @@ static void execute_vsync_callbacks(void)
         }
 
         executing_queue->size = 0;
+
+        /* long running callbacks such as pause must still see UI commands */
+        mainchannel_process();
     }
 }
 
@@ -164,6 +205,20 @@ static tick_t warp_render_tick_interval;
 /* Triggers the vice thread to update its priorty */
 static volatile int update_thread_priority = 1;
 
+/* "FramePacingSpin": finish waits for the next sync point by spinning */
+static int frame_pacing_spin;
+
+/* "SkipFrameDrawing": do not draw frames that will not be shown */
+static int skip_frame_drawing;
+
+/* "InputPollLines": poll host input every that many raster lines, 0 = only at
+   the sync points */
+static int input_poll_lines;
+static int input_poll_line_count;
+
+/* "RunAheadFrames": show the frame that many frames ahead of the emulation */
+static int run_ahead_frames;
+
 static int set_relative_speed(int val, void *param)
 {
     if (val == 0) {
@@ -200,6 +255,43 @@ static int set_initial_warp_mode_resource(int val, void *param)
     return 0;
 }
 
+static int set_frame_pacing_spin(int val, void *param)
+{
+    frame_pacing_spin = val ? 1 : 0;
+
+    return 0;
+}
+
+static int set_skip_frame_drawing(int val, void *param)
+{
+    skip_frame_drawing = val ? 1 : 0;
+
+    return 0;
+}
+
+static int set_input_poll_lines(int val, void *param)
+{
+    if (val < 0 || val > 1000) {
+        return -1;
+    }
+    input_poll_lines = val;
+    input_poll_line_count = 0;
+    input_queue_enable(val > 0);
+
+    return 0;
+}
+
+static int set_run_ahead_frames(int val, void *param)
+{
+    if (val < 0 || val > 8) {
+        return -1;
+    }
+    run_ahead_frames = val;
+    runahead_set_frames(val);
+
+    return 0;
+}
+
 /* Vsync-related resources. */
 static const resource_int_t resources_int[] = {
     { "Speed", 100, RES_EVENT_SAME, NULL,
@@ -207,6 +299,14 @@ static const resource_int_t resources_int[] = {
     { "InitialWarpMode", 0, RES_EVENT_STRICT, (resource_value_t)0,
       /* FIXME: maybe RES_EVENT_NO */
       &initial_warp_mode_resource, set_initial_warp_mode_resource, NULL },
+    { "FramePacingSpin", 0, RES_EVENT_NO, NULL,
+      &frame_pacing_spin, set_frame_pacing_spin, NULL },
+    { "SkipFrameDrawing", 0, RES_EVENT_NO, NULL,
+      &skip_frame_drawing, set_skip_frame_drawing, NULL },
+    { "InputPollLines", 0, RES_EVENT_NO, NULL,
+      &input_poll_lines, set_input_poll_lines, NULL },
+    { "RunAheadFrames", 0, RES_EVENT_NO, NULL,
+      &run_ahead_frames, set_run_ahead_frames, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -241,6 +341,24 @@ static const cmdline_option_t cmdline_options[] =
     { "+warp", CALL_FUNCTION, CMDLINE_ATTRIB_NONE,
       set_initial_warp_mode_cmdline, vice_int_to_ptr(0), NULL, NULL,
       NULL, "Do not initially enable warp mode (default)" },
+    { "-framepacingspin", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "FramePacingSpin", (resource_value_t)1,
+      NULL, "Sleep until shortly before each sync point and spin for the rest" },
+    { "+framepacingspin", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "FramePacingSpin", (resource_value_t)0,
+      NULL, "Only sleep until each sync point (default)" },
+    { "-skipframedrawing", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SkipFrameDrawing", (resource_value_t)1,
+      NULL, "Do not draw frames that are skipped in warp mode" },
+    { "+skipframedrawing", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SkipFrameDrawing", (resource_value_t)0,
+      NULL, "Draw all frames, even those that are skipped in warp mode (default)" },
+    { "-inputpolllines", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "InputPollLines", NULL,
+      "<lines>", "Poll host input every <lines> raster lines (0: only every few milliseconds of host time)" },
+    { "-runaheadframes", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "RunAheadFrames", NULL,
+      "<frames>", "Show the emulation <frames> frames ahead to hide input lag (0: off, max. 8)" },
     CMDLINE_LIST_END
 };
 
@@ -277,6 +395,12 @@ static CLOCK last_sync_clk;
 
 static tick_t sync_target_tick;
 
+/* -maxthroughput: frames, emulated cycles and host time since the first frame */
+static unsigned long max_throughput_frames;
+static uint64_t max_throughput_cycles;
+static CLOCK max_throughput_last_clk;
+static tick_t max_throughput_start_tick;
+
 static int timer_speed = 0;
 static bool sync_reset = true;
 static bool metrics_reset = false;
@@ -343,10 +467,50 @@ void vsync_init(void (*hook)(void))
     vsync_suspend_speed_eval();
 }
 
+static void max_throughput_report(void)
+{
+    double seconds;
+
+    if (max_throughput_frames < 2) {
+        return;
+    }
+
+    seconds = (double)TICK_TO_MICRO(tick_now_delta(max_throughput_start_tick)) / 1000000.0;
+    if (seconds <= 0.0) {
+        return;
+    }
+
+    log_message(vsync_log, "Max throughput: %lu frames, %"PRIu64" cycles in %.3f s: %.0f cycles/s, %.1f fps (%.0f%% of real time)",
+                max_throughput_frames - 1, max_throughput_cycles, seconds,
+                (double)max_throughput_cycles / seconds,
+                (double)(max_throughput_frames - 1) / seconds,
+                (double)max_throughput_cycles / seconds * 100.0 / cycles_per_sec);
+}
+
+/* In -maxthroughput mode a frame only needs to be counted. */
+static void max_throughput_frame(void)
+{
+    CLOCK clk = maincpu_clk;
+
+    if (max_throughput_frames++ == 0) {
+        max_throughput_start_tick = tick_now();
+    } else if (clk > max_throughput_last_clk) {
+        max_throughput_cycles += clk - max_throughput_last_clk;
+    }
+    max_throughput_last_clk = clk;
+}
+
 void vsync_shutdown(void)
 {
     int i;
 
+    if (max_throughput_mode) {
+        max_throughput_report();
+    }
+
+    mainchannel_shutdown();
+    runahead_shutdown();
+
     for (i = 0; i < 2; i++) {
         if (callback_queues[i].queue) {
             lib_free(callback_queues[i].queue);
@@ -383,6 +547,20 @@ void vsyncarch_get_metrics(double *cpu_percent, double *emulated_fps, int *is_wa
     METRIC_UNLOCK();
 }
 
+/* Make the speed values visible to the UI without taking any lock. */
+static void publish_state(void)
+{
+    mainchannel_state_t *state = mainchannel_state_edit();
+
+    METRIC_LOCK();
+    state->cpu_percent = vsync_metric_cpu_percent;
+    state->emulated_fps = vsync_metric_emulated_fps;
+    state->warp_enabled = warp_enabled;
+    METRIC_UNLOCK();
+
+    mainchannel_state_publish();
+}
+
 /*
  * TODO: Grow measurements array as needed so 5 seconds can be stored.
  * This will allow warp measurements to be stablise!
@@ -487,6 +665,151 @@ static void update_performance_metrics(tick_t frame_tick)
     }
 }
 
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Pacing. The operating system usually wakes us up later than asked, by an
+ * amount that depends on the host and its load. The wake-up latency is
+ * measured on every sleep, and with FramePacingSpin the sleep ends early
+ * by that much and the rest of the wait is spent spinning on the clock.
+ * The spin is bounded, so a host with a poor timer loses some precision
+ * instead of a CPU core.
+ */
+
+/* never spin longer than this, nor longer than this part of the wait */
+#define PACING_MAX_SPIN_US          2000
+#define PACING_MAX_SPIN_FRACTION    8
+#define PACING_INITIAL_LATENCY_US   100
+
+/* smoothed oversleep and its mean deviation, in ticks */
+static double pacing_latency_mean;
+static double pacing_latency_dev;
+static tick_t pacing_sleep_latency;
+
+/*
+ * Audio feedback. If the sound device is not the timing source, host clock
+ * and sound card clock drift apart, and the device buffer slowly runs full
+ * or empty. The emulation speed is nudged by up to AUDIO_MAX_ADJUST to keep
+ * the buffer half full.
+ */
+#define AUDIO_TARGET_FILL   0.5
+#define AUDIO_MAX_ADJUST    0.005
+#define AUDIO_FILL_SMOOTH   0.95
+
+static double audio_fill_smoothed = -1.0;
+static double audio_rate_adjust;
+
+static vsync_frame_stats_t frame_stats;
+
+static void pacing_reset(void)
+{
+    pacing_latency_mean = (double)tick_per_second() * PACING_INITIAL_LATENCY_US / MICRO_PER_SECOND;
+    pacing_latency_dev = 0.0;
+    pacing_sleep_latency = (tick_t)pacing_latency_mean;
+}
+
+/* Wait for ticks with the mainlock released.  */
+static void pacing_wait(tick_t ticks)
+{
+    tick_t start;
+    tick_t spin_ticks;
+    tick_t sleep_ticks;
+    tick_t slept_ticks;
+    double oversleep;
+    double limit;
+
+    if (!frame_pacing_spin) {
+        mainlock_yield_and_sleep(ticks);
+        return;
+    }
+
+    if (pacing_sleep_latency == 0 && pacing_latency_mean == 0.0) {
+        pacing_reset();
+    }
+
+    mainlock_yield_begin();
+
+    start = tick_now();
+
+    spin_ticks = ticks / PACING_MAX_SPIN_FRACTION;
+    if (spin_ticks > pacing_sleep_latency) {
+        spin_ticks = pacing_sleep_latency;
+    }
+
+    if (ticks > spin_ticks) {
+        sleep_ticks = ticks - spin_ticks;
+        tick_sleep(sleep_ticks);
+
+        slept_ticks = tick_now_delta(start);
+        oversleep = slept_ticks > sleep_ticks ? (double)(slept_ticks - sleep_ticks) : 0.0;
+
+        /* like the retransmission timer estimate of TCP: mean + 2 * deviation */
+        pacing_latency_dev += ((oversleep > pacing_latency_mean
+                                ? oversleep - pacing_latency_mean
+                                : pacing_latency_mean - oversleep) - pacing_latency_dev) / 4.0;
+        pacing_latency_mean += (oversleep - pacing_latency_mean) / 8.0;
+
+        limit = (double)tick_per_second() * PACING_MAX_SPIN_US / MICRO_PER_SECOND;
+        pacing_sleep_latency = (tick_t)(pacing_latency_mean + 2.0 * pacing_latency_dev < limit
+                                        ? pacing_latency_mean + 2.0 * pacing_latency_dev
+                                        : limit);
+    }
+
+    while (tick_now_delta(start) < ticks) {
+        /* spin for the rest */
+    }
+
+    mainlock_yield_end();
+}
+
+static void pacing_update_audio_feedback(void)
+{
+    double fill = sound_get_buffer_fill();
+    double adjust;
+
+    if (fill < 0.0) {
+        audio_fill_smoothed = -1.0;
+        audio_rate_adjust = 0.0;
+        return;
+    }
+
+    if (audio_fill_smoothed < 0.0) {
+        audio_fill_smoothed = fill;
+    }
+    audio_fill_smoothed = AUDIO_FILL_SMOOTH * audio_fill_smoothed + (1.0 - AUDIO_FILL_SMOOTH) * fill;
+
+    /* a fuller buffer means we produce too fast, so take more host time */
+    adjust = (audio_fill_smoothed - AUDIO_TARGET_FILL) * 2.0 * AUDIO_MAX_ADJUST;
+    if (adjust > AUDIO_MAX_ADJUST) {
+        adjust = AUDIO_MAX_ADJUST;
+    } else if (adjust < -AUDIO_MAX_ADJUST) {
+        adjust = -AUDIO_MAX_ADJUST;
+    }
+    audio_rate_adjust = adjust;
+}
+
+static void histogram_add(uint32_t *histogram, tick_t ticks, unsigned int bucket_us)
+{
+    uint64_t bucket = (uint64_t)TICK_TO_MICRO(ticks) / bucket_us;
+
+    histogram[bucket < VSYNC_HISTOGRAM_BUCKETS ? bucket : VSYNC_HISTOGRAM_BUCKETS - 1]++;
+}
+
+void vsyncarch_get_frame_stats(vsync_frame_stats_t *stats, int reset)
+{
+    METRIC_LOCK();
+
+    *stats = frame_stats;
+    stats->sleep_latency_us = TICK_TO_MICRO(pacing_sleep_latency);
+    stats->audio_adjust_ppm = (int32_t)(audio_rate_adjust * 1000000.0);
+
+    if (reset) {
+        memset(&frame_stats, 0, sizeof(frame_stats));
+    }
+
+    METRIC_UNLOCK();
+}
+
 void vsync_do_end_of_line(void)
 {
     const int microseconds_between_sync = 2 * 1000;
@@ -497,6 +820,7 @@ void vsync_do_end_of_line(void)
     tick_t ticks_until_target;
 
     bool tick_based_sync_timing;
+    int i;
 
     CLOCK main_cpu_clock = maincpu_clk;
     CLOCK sync_clk_delta;
@@ -519,6 +843,22 @@ void vsync_do_end_of_line(void)
         return;
     }
 
+    /* frames run ahead are not paced and see no new input */
+    if (runahead_frame_ahead) {
+        return;
+    }
+
+    /* poll host input every few lines so programs see it mid-frame */
+    if (input_poll_lines > 0 && !warp_enabled && !max_throughput_mode
+        && ++input_poll_line_count >= input_poll_lines) {
+        input_poll_line_count = 0;
+        vsyncarch_poll_input();
+        joystick();
+        /* key events posted by the UI thread */
+        mainchannel_process();
+        input_queue_process();
+    }
+
     /* deal with any accumulated sound immediately */
     tick_based_sync_timing = sound_flush();
 
@@ -543,7 +883,9 @@ void vsync_do_end_of_line(void)
     /* is it time to consider keyboard, joystick ? */
     if (tick_delta >= tick_between_sync) {
 
-        if (warp_enabled) {
+        mainchannel_process();
+
+        if (warp_enabled || max_throughput_mode) {
             /* During warp we need to periodically allow the UI a chance with the mainlock */
             mainlock_yield();
         } else {
@@ -557,6 +899,9 @@ void vsync_do_end_of_line(void)
 
             /* amount of host ticks that represents the emulated duration */
             sync_emulated_ticks = (double)tick_per_second() * sync_clk_delta / emulated_clk_per_second;
+            if (tick_based_sync_timing) {
+                sync_emulated_ticks *= 1.0 + audio_rate_adjust;
+            }
 
             /* combine with leftover offset from last sync */
             sync_emulated_ticks += sync_emulated_ticks_offset;
@@ -580,7 +925,7 @@ void vsync_do_end_of_line(void)
 
                 /* If we can't rely on the audio device for timing, slow down here. */
                 if (tick_based_sync_timing) {
-                    mainlock_yield_and_sleep(ticks_until_target);
+                    pacing_wait(ticks_until_target);
                 }
             } else if ((tick_t)0 - ticks_until_target > tick_per_second()) {
                 /* We are more than a second behind, reset sync and accept that we're not running at full speed. */
@@ -596,11 +941,17 @@ void vsync_do_end_of_line(void)
             }
         }
 
+        /* the reference point of vsync_host_tick_to_clk() */
+        last_sync_tick = tick_now;
+        last_sync_clk = main_cpu_clock;
+
         /* deal with pending user input */
         joystick();
+        input_queue_process();
 
-        last_sync_tick = tick_now;
-        last_sync_clk = main_cpu_clock;
+        for (i = 0; i < sync_hooks_count; i++) {
+            sync_hooks[i]();
+        }
     }
 
     /* Do we need to update the thread priority? */
@@ -617,6 +968,36 @@ void vsync_do_end_of_line(void)
     }
 }
 
+/* Map a host time to the emulated clock. The pacing clock has the emulated
+   clock at last_sync_clk due at host time sync_target_tick, or at
+   last_sync_tick if the emulation was running late. Host times after that
+   map to later clocks at the emulated speed, earlier ones to earlier
+   clocks. */
+CLOCK vsync_host_tick_to_clk(tick_t tick)
+{
+    tick_t base = sync_target_tick;
+    int32_t offset;
+    CLOCK cycles;
+
+    if (warp_enabled || max_throughput_mode || sync_reset) {
+        return maincpu_clk;
+    }
+
+    /* when running late, do not hold events back by the lag */
+    if ((int32_t)(last_sync_tick - base) > 0) {
+        base = last_sync_tick;
+    }
+
+    offset = (int32_t)(tick - base);
+    if (offset >= 0) {
+        return last_sync_clk + (CLOCK)((double)offset * emulated_clk_per_second / tick_per_second());
+    }
+
+    cycles = (CLOCK)((double)-offset * emulated_clk_per_second / tick_per_second());
+
+    return cycles < last_sync_clk ? last_sync_clk - cycles : 0;
+}
+
 bool vsync_should_skip_frame(struct video_canvas_s *canvas)
 {
     tick_t now = tick_now();
@@ -642,6 +1023,9 @@ bool vsync_should_skip_frame(struct video_canvas_s *canvas)
                 /* next render tick is further ahead than it should be */
                 canvas->warp_next_render_tick = now + warp_render_tick_interval;
             }
+            METRIC_LOCK();
+            frame_stats.skipped_frames++;
+            METRIC_UNLOCK();
             /* skip this frame */
             return true;
         } else {
@@ -660,6 +1044,12 @@ bool vsync_should_skip_frame(struct video_canvas_s *canvas)
     return false;
 }
 
+/* Whether frames that vsync_should_skip_frame() skips need not be drawn. */
+int vsync_get_skip_frame_drawing(void)
+{
+    return skip_frame_drawing;
+}
+
 /* This is called at the end of each screen frame. */
 void vsync_do_vsync(struct video_canvas_s *c)
 {
@@ -668,6 +1058,13 @@ void vsync_do_vsync(struct video_canvas_s *c)
     tick_t now;
     tick_t network_hook_time = 0;
 
+    /* frames run ahead are undone again, only the emulation needs the hook */
+    if (runahead_frame_ahead) {
+        vsync_hook();
+        runahead_vsync();
+        return;
+    }
+
     monitor_vsync_hook();
 
     /*
@@ -683,6 +1080,10 @@ void vsync_do_vsync(struct video_canvas_s *c)
 
     vsync_hook();
 
+#ifdef HAVE_RAWNET
+    rawnet_vsync();
+#endif
+
     if (network_connected()) {
         /* TODO - re-eval if any of this network stuff makes sense */
         network_hook_time = tick_now_delta(network_hook_time);
@@ -698,9 +1099,34 @@ void vsync_do_vsync(struct video_canvas_s *c)
     debug_check_autoplay_mode();
 #endif
 
+    if (max_throughput_mode) {
+        max_throughput_frame();
+
+        vsyncarch_postsync();
+        execute_vsync_callbacks();
+        kbdbuf_flush();
+        publish_state();
+        return;
+    }
+
     now = tick_now_after(last_vsync);
     update_performance_metrics(now);
 
+    if (!warp_enabled && !sync_reset) {
+        METRIC_LOCK();
+        frame_stats.frames++;
+        histogram_add(frame_stats.frame_time, now - last_vsync, VSYNC_FRAME_TIME_BUCKET_US);
+        if ((tick_t)(now - sync_target_tick) < tick_per_second()) {
+            /* behind the point in time the emulated clock says we should be at */
+            frame_stats.late_frames++;
+            histogram_add(frame_stats.lateness, now - sync_target_tick, VSYNC_LATENESS_BUCKET_US);
+        } else {
+            frame_stats.lateness[0]++;
+        }
+        METRIC_UNLOCK();
+        pacing_update_audio_feedback();
+    }
+
     vsyncarch_postsync();
 
 #ifdef VSYNC_DEBUG
@@ -712,5 +1138,9 @@ void vsync_do_vsync(struct video_canvas_s *c)
 
     kbdbuf_flush();
 
+    publish_state();
+
+    runahead_vsync();
+
     last_vsync = now;
 }
@@ -27,6 +27,9 @@
 #ifndef VICE_VSYNC_H
 #define VICE_VSYNC_H
 
+#include "archdep.h"
+#include "types.h"
+
 /* Manually defined */
 /* To enable/disable this option by hand change the 0 below to 1. */
 #if 0
@@ -51,9 +54,12 @@ void vsync_set_machine_parameter(double refresh_rate, long cycles);
 double vsync_get_refresh_frequency(void);
 void vsync_do_end_of_line(void);
 bool vsync_should_skip_frame(struct video_canvas_s *canvas);
+int vsync_get_skip_frame_drawing(void);
 void vsync_do_vsync(struct video_canvas_s *c);
 void vsync_on_vsync_do(vsync_callback_func_t callback_func, void *callback_param);
+void vsync_add_sync_hook(void (*hook)(void));
 void vsync_set_warp_mode(int val);
 int vsync_get_warp_mode(void);
+CLOCK vsync_host_tick_to_clk(tick_t tick);
 
 #endif
@@ -29,6 +29,8 @@
 
 #include "vice.h"
 
+#include "types.h"
+
 struct video_canvas_s;
 
 typedef void (*void_hook_t)(void);
@@ -36,12 +38,35 @@ typedef void (*void_hook_t)(void);
 /* current performance metrics */
 void vsyncarch_get_metrics(double *cpu_percent, double *emulated_fps, int *warp_enabled);
 
+#define VSYNC_HISTOGRAM_BUCKETS     64
+#define VSYNC_FRAME_TIME_BUCKET_US  500     /* width of a frame time bucket */
+#define VSYNC_LATENESS_BUCKET_US    100     /* width of a lateness bucket */
+
+/* Per-frame timing since the last reset. The last bucket of a histogram
+   also counts everything beyond it. Frames in warp mode only show up in
+   skipped_frames. */
+typedef struct vsync_frame_stats_s {
+    uint32_t frames;            /* frames measured */
+    uint32_t skipped_frames;    /* frames that were not rendered */
+    uint32_t late_frames;       /* frames that ended behind schedule */
+    uint32_t sleep_latency_us;  /* measured wake-up latency of the host */
+    int32_t audio_adjust_ppm;   /* speed correction from the audio buffer fill */
+    uint32_t frame_time[VSYNC_HISTOGRAM_BUCKETS];  /* host time per emulated frame */
+    uint32_t lateness[VSYNC_HISTOGRAM_BUCKETS];    /* how far behind schedule a frame ended */
+} vsync_frame_stats_t;
+
+/* copy the frame timing statistics, and start over if reset is set */
+void vsyncarch_get_frame_stats(vsync_frame_stats_t *stats, int reset);
+
 /* this is called before vsync_do_vsync does the synchroniation */
 void vsyncarch_presync(void);
 
 /* this is called after vsync_do_vsync did the synchroniation */
 void vsyncarch_postsync(void);
 
+/* this is called every "InputPollLines" raster lines to pick up host input */
+void vsyncarch_poll_input(void);
+
 /* called to advance the emulation by one frame */
 void vsyncarch_advance_frame(void);
 